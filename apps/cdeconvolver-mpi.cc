@@ -294,6 +294,12 @@ class CdeconvolverApp : public askap::Application
                     itsResidualCube->writeSlice(dirty, channel);
                     itsModelCube->writeSlice(model, channel);
                     itsRestoredCube->writeSlice(restored, channel);
+                    // the next rank writes to the same cubes, so buffered slices
+                    // have to be on disk before it is triggered
+                    itsPsfCube->flush();
+                    itsResidualCube->flush();
+                    itsModelCube->flush();
+                    itsRestoredCube->flush();
 
                     if (comms.rank() < comms.nProcs()-1) { // last rank doesnot use this method
                       int buf;
@@ -172,6 +172,7 @@ class CimagerApp : public askap::Application
                             ASKAPLOG_INFO_STR(logger, "*** Starting major cycle " << cycle << " ***");
                             imager.calcNE();
                             imager.solveNE();
+                            imager.writeMetrics(cycle);
 
                             stats.logSummary();
 
@@ -204,6 +205,8 @@ class CimagerApp : public askap::Application
 
                     /// This is the final step - restore the image and write it out
                     imager.writeModel();
+                    // metrics of the final imaging pass and restore are labelled by the number of cycles
+                    imager.writeMetrics(nCycles);
                 }
                 stats.logSummary();
             } catch (const askap::AskapError& x) {
@@ -36,12 +36,17 @@
 #include <vector>
 #include <algorithm>
 #include <iterator>
+#include <thread>
+#include <mutex>
+#include <exception>
 
 // ASKAPsoft includes
 #include <askap/askap/AskapError.h>
 #include <askap/askap/AskapLogging.h>
 #include <askap/askap/StatReporter.h>
 #include <askap/askap/Log4cxxLogSink.h>
+#include <askap/utils/BoundedQueue.h>
+#include <askap/utils/TileUtils.h>
 #include <boost/shared_ptr.hpp>
 #include <boost/exception/all.hpp>
 #include <boost/program_options.hpp>
@@ -49,6 +54,7 @@
 #include <casacore/casa/aips.h>
 #include <casacore/casa/Quanta.h>
 #include <casacore/casa/Arrays/Vector.h>
+#include <casacore/casa/Arrays/Matrix.h>
 #include <casacore/casa/Arrays/Cube.h>
 #include <casacore/casa/Arrays/MatrixMath.h>
 #include <casacore/tables/Tables/TableDesc.h>
@@ -56,6 +62,7 @@
 #include <casacore/tables/DataMan/IncrementalStMan.h>
 #include <casacore/tables/DataMan/StandardStMan.h>
 #include <casacore/tables/DataMan/TiledShapeStMan.h>
+#include <casacore/tables/DataMan/TiledStManAccessor.h>
 //#include <casacore/tables/DataMan/DataManAccessor.h>
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 #include <casacore/ms/MeasurementSets/MSColumns.h>
@@ -429,35 +436,245 @@ Vector<double> collectTimes(const std::vector< boost::shared_ptr<const ROMSColum
     return mergedTimes;
 }
 
-void mergeMainTable(const std::vector< boost::shared_ptr<const ROMSColumns> >& srcMscs,
-                    boost::shared_ptr<casa::MeasurementSet>& dest, const IPosition& tileShape,
-                    uInt nBaselines, bool dryRun, bool detectMissingIntegrations)
+/// @brief obtain the tile shape of the DATA column
+/// @param[in] ms measurement set
+/// @return tile shape or an empty IPosition if DATA is not stored with a tiled storage manager
+IPosition dataTileShape(const casa::MeasurementSet& ms)
+{
+    try {
+        const ROTiledStManAccessor acc(ms, MS::columnName(MS::DATA), True);
+        return acc.tileShape(0);
+    } catch (const AipsError&) {}
+    return IPosition();
+}
+
+/// @brief set up the tile cache of the DATA and FLAG columns for whole spectrum access
+/// @details Data are accessed by row blocks covering all correlations and channels, so
+/// the cache has to hold one row of tiles. Otherwise every getColumnRange/putColumnRange
+/// call goes to disk several times.
+/// @param[in] ms measurement set
+void setSpectrumCache(const casa::MeasurementSet& ms)
 {
-    uInt nMS = srcMscs.size();
+    const char* columns[] = {"DATA", "FLAG"};
+    for (uInt col = 0; col < 2; ++col) {
+        try {
+            ROTiledStManAccessor acc(ms, columns[col], True);
+            const IPosition tile = acc.tileShape(0);
+            const IPosition cube = acc.hypercubeShape(0);
+            ASKAPDEBUGASSERT(tile.nelements() == 3 && cube.nelements() == 3);
+            const uInt nBuckets = ((cube(0) - 1) / tile(0) + 1) * ((cube(1) - 1) / tile(1) + 1);
+            acc.setCacheSize(0, nBuckets, False);
+            ASKAPLOG_DEBUG_STR(logger, "Cache for "<<columns[col]<<" of "<<ms.tableName()<<" set to "<<
+                               nBuckets<<" buckets of shape "<<tile);
+        } catch (const AipsError&) {}
+    }
+}
+
+// Chooses the number of channels per tile from the layout of the inputs: the largest
+// channel tiling which neither makes output tiles straddle the boundary between two
+// inputs nor cuts across the tiles of any input.
+casa::uInt tuneTileNchan(const std::vector< boost::shared_ptr<const casa::MeasurementSet> >& in,
+                         const std::vector< boost::shared_ptr<const ROMSColumns> >& inColumns)
+{
+    std::vector<casa::uInt> nChan(in.size()), tileNchan(in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+        nChan[i] = inColumns[i]->data().shape(0)(1);
+        const IPosition tile = dataTileShape(*in[i]);
+        tileNchan[i] = tile.nelements() == 3 ? std::min(casa::uInt(tile(1)), nChan[i]) : 1u;
+    }
+    return askap::utils::commonTileNchan(nChan, tileNchan);
+}
+
+/// @brief row layout of the merged main table
+/// @details Describes how integrations (or, without missing integration detection,
+/// blocks of tileNrow rows) of every input map onto the output rows and tiles.
+/// It is computed up front so that reader threads can work independently on
+/// their own input measurement set.
+struct MergeLayout {
+    /// @brief number of rows in the output
+    uInt nRows;
+    /// @brief number of integrations (or row blocks)
+    uInt nTimes;
+    /// @brief rows per integration (or per row block)
+    uInt nBase;
+    /// @brief integrations per output tile
+    uInt nIntPerTile;
+    /// @brief merged time stamps, only filled when detecting missing integrations
     Vector<double> mergedTimes;
-    uInt nRows = srcMscs[0]->nrow();
+    /// @brief first source row of integration j in input i, -1 if the integration is missing
+    Matrix<Int> srcRow;
+    /// @brief input used to fill the metadata columns of integration j
+    Vector<uInt> metaSource;
+
+    /// @return number of output rows for the given integration
+    uInt rowsInIntegration(uInt j) const { return std::min(nBase, nRows - j * nBase); }
+
+    /// @return number of output tiles in the row direction
+    uInt nTiles() const { return (nTimes + nIntPerTile - 1) / nIntPerTile; }
+};
+
+MergeLayout makeLayout(const std::vector< boost::shared_ptr<const ROMSColumns> >& srcMscs,
+                       const IPosition& tileShape, uInt nBaselines, bool detectMissingIntegrations)
+{
+    const uInt nMS = srcMscs.size();
+    MergeLayout layout;
+    layout.nRows = srcMscs[0]->nrow();
     // nTimes is really the number of tiles in the row direction
     // unless we are detecting missing integrations
-    uInt nTimes = nRows / tileShape(2);
-    if (nRows % tileShape(2) != 0) nTimes++;
+    layout.nTimes = layout.nRows / tileShape(2);
+    if (layout.nRows % tileShape(2) != 0) layout.nTimes++;
     // baselines per tile
-    uInt nBase = tileShape(2);
+    layout.nBase = tileShape(2);
     // Check for missing integrations
     // This assumes ASKAP data with fixed number of baselines per integration throughout
     if (detectMissingIntegrations) {
-        mergedTimes = collectTimes(srcMscs);
-        nTimes = mergedTimes.nelements();
-        nRows = nBaselines * nTimes;
+        layout.mergedTimes = collectTimes(srcMscs);
+        layout.nTimes = layout.mergedTimes.nelements();
+        layout.nRows = nBaselines * layout.nTimes;
         // baselines per integration
-        nBase = nBaselines;
+        layout.nBase = nBaselines;
     }
+    layout.nIntPerTile = std::max(1u, uInt(tileShape(2)) / layout.nBase);
+
+    const double tol = 1.0; // tolerance for comparing timestamps is 1s
+    layout.srcRow.resize(nMS, layout.nTimes);
+    layout.srcRow = -1;
+    for (uInt i = 0; i < nMS; ++i) {
+        if (detectMissingIntegrations) {
+            const casa::Vector<double> times = srcMscs[i]->time().getColumn();
+            for (uInt j = 0, row = 0; j < layout.nTimes; ++j) {
+                if (row < times.nelements() && abs(times(row) - layout.mergedTimes(j)) < tol) {
+                    layout.srcRow(i, j) = row;
+                    row += layout.nBase;
+                }
+            }
+        } else {
+            for (uInt j = 0; j < layout.nTimes; ++j) {
+                layout.srcRow(i, j) = j * layout.nBase;
+            }
+        }
+    }
+    // Find first MS that has each timeslot
+    layout.metaSource.resize(layout.nTimes);
+    for (uInt j = 0; j < layout.nTimes; ++j) {
+        uInt k = 0;
+        for (; k < nMS && layout.srcRow(k, j) < 0; ++k) {}
+        ASKAPCHECK(k < nMS, "Logic error in mergeMainTable");
+        layout.metaSource(j) = k;
+    }
+    return layout;
+}
+
+// Copies the simple cells (i.e. those not needing merging) of the main table.
+// These are taken from the first input measurement set having the integration.
+void copyMainTableMetadata(const std::vector< boost::shared_ptr<const ROMSColumns> >& srcMscs,
+                           MSColumns& dc, const MergeLayout& layout)
+{
+    for (uInt j = 0, outRow = 0; j < layout.nTimes; outRow += layout.rowsInIntegration(j), ++j) {
+        const uInt nRowsThisInt = layout.rowsInIntegration(j);
+        const uInt k = layout.metaSource(j);
+        const ROMSColumns& sc(*srcMscs[k]);
+        const Slicer destRowSlicer(IPosition(1, outRow), IPosition(1, nRowsThisInt), Slicer::endIsLength);
+        const Slicer srcRowSlicer(IPosition(1, layout.srcRow(k, j)), IPosition(1, nRowsThisInt), Slicer::endIsLength);
+        dc.scanNumber().putColumnRange(destRowSlicer, sc.scanNumber().getColumnRange(srcRowSlicer));
+        dc.fieldId().putColumnRange(destRowSlicer, sc.fieldId().getColumnRange(srcRowSlicer));
+        dc.dataDescId().putColumnRange(destRowSlicer, sc.dataDescId().getColumnRange(srcRowSlicer));
+        dc.time().putColumnRange(destRowSlicer, sc.time().getColumnRange(srcRowSlicer));
+        dc.timeCentroid().putColumnRange(destRowSlicer, sc.timeCentroid().getColumnRange(srcRowSlicer));
+        dc.arrayId().putColumnRange(destRowSlicer, sc.arrayId().getColumnRange(srcRowSlicer));
+        dc.processorId().putColumnRange(destRowSlicer, sc.processorId().getColumnRange(srcRowSlicer));
+        dc.exposure().putColumnRange(destRowSlicer, sc.exposure().getColumnRange(srcRowSlicer));
+        dc.interval().putColumnRange(destRowSlicer, sc.interval().getColumnRange(srcRowSlicer));
+        dc.observationId().putColumnRange(destRowSlicer, sc.observationId().getColumnRange(srcRowSlicer));
+        dc.antenna1().putColumnRange(destRowSlicer, sc.antenna1().getColumnRange(srcRowSlicer));
+        dc.antenna2().putColumnRange(destRowSlicer, sc.antenna2().getColumnRange(srcRowSlicer));
+        dc.feed1().putColumnRange(destRowSlicer, sc.feed1().getColumnRange(srcRowSlicer));
+        dc.feed2().putColumnRange(destRowSlicer, sc.feed2().getColumnRange(srcRowSlicer));
+        dc.uvw().putColumnRange(destRowSlicer, sc.uvw().getColumnRange(srcRowSlicer));
+        dc.flagRow().putColumnRange(destRowSlicer, sc.flagRow().getColumnRange(srcRowSlicer));
+        dc.weight().putColumnRange(destRowSlicer, sc.weight().getColumnRange(srcRowSlicer));
+        dc.sigma().putColumnRange(destRowSlicer, sc.sigma().getColumnRange(srcRowSlicer));
+    }
+}
+
+/// @brief data and flags of one input covering the rows of one output tile
+struct ChannelBlock {
+    casa::Cube<casa::Complex> data;
+    casa::Cube<casa::Bool> flag;
+    /// @brief row offset into data/flag for each integration of the tile, -1 if missing
+    std::vector<int> offset;
+};
+
+typedef utils::BoundedQueue<boost::shared_ptr<ChannelBlock> > ChannelBlockQueue;
+
+// Reads the channel blocks of the given inputs tile by tile and passes them to the writer.
+// Each reader thread owns its inputs exclusively, casacore tables are not accessed
+// from more than one thread.
+void readChannelBlocks(const std::vector< boost::shared_ptr<const ROMSColumns> >& srcMscs,
+                       const std::vector<uInt>& inputs, const MergeLayout& layout,
+                       std::vector<boost::shared_ptr<ChannelBlockQueue> >& queues, bool dryRun)
+{
+    for (uInt tile = 0; tile < layout.nTiles(); ++tile) {
+        const uInt firstInt = tile * layout.nIntPerTile;
+        const uInt lastInt = std::min(layout.nTimes, firstInt + layout.nIntPerTile);
+        for (std::vector<uInt>::const_iterator ci = inputs.begin(); ci != inputs.end(); ++ci) {
+            const uInt i = *ci;
+            boost::shared_ptr<ChannelBlock> block(new ChannelBlock);
+            block->offset.resize(lastInt - firstInt, -1);
+            // integrations present in the given input are stored contiguously, so the whole tile
+            // can be read with a single call
+            Int firstRow = -1;
+            uInt nRows = 0;
+            for (uInt j = firstInt; j < lastInt; ++j) {
+                if (layout.srcRow(i, j) >= 0) {
+                    if (firstRow < 0) {
+                        firstRow = layout.srcRow(i, j);
+                    }
+                    ASKAPDEBUGASSERT(layout.srcRow(i, j) == firstRow + Int(nRows));
+                    block->offset[j - firstInt] = nRows;
+                    nRows += layout.rowsInIntegration(j);
+                }
+            }
+            if (nRows > 0 && !dryRun) {
+                const Slicer srcDataSlicer(IPosition(1, firstRow), IPosition(1, nRows), Slicer::endIsLength);
+                block->data = srcMscs[i]->data().getColumnRange(srcDataSlicer);
+                block->flag = srcMscs[i]->flag().getColumnRange(srcDataSlicer);
+            }
+            if (!queues[i]->push(block)) {
+                // writer has given up
+                return;
+            }
+        }
+    }
+    for (std::vector<uInt>::const_iterator ci = inputs.begin(); ci != inputs.end(); ++ci) {
+        queues[*ci]->close();
+    }
+}
+
+void mergeMainTable(const std::vector< boost::shared_ptr<const ROMSColumns> >& srcMscs,
+                    boost::shared_ptr<casa::MeasurementSet>& dest, const IPosition& tileShape,
+                    uInt nBaselines, bool dryRun, bool detectMissingIntegrations,
+                    uInt nReaders = 0, uInt prefetch = 1)
+{
+    const uInt nMS = srcMscs.size();
+    const MergeLayout layout = makeLayout(srcMscs, tileShape, nBaselines, detectMissingIntegrations);
+    const uInt nRows = layout.nRows;
     boost::shared_ptr<MSColumns> dc;
     if (!dryRun) {
         dc = boost::shared_ptr<MSColumns>(new MSColumns(*dest));
         // Add rows upfront
         dest->addRow(nRows);
+        // a full row of output tiles is written at once
+        setSpectrumCache(*dest);
     }
     ASKAPLOG_INFO_STR(logger,  "Number of rows in output:"<< nRows<<", tileshape = "<< tileShape);
+
+    // 1: Copy over the simple cells (i.e. those not needing merging)
+    if (!dryRun) {
+        ASKAPLOG_INFO_STR(logger,  "Copying main table metadata columns");
+        copyMainTableMetadata(srcMscs, *dc, layout);
+    }
+
     // 2: Size the matrix for data and flag
     const uInt nPol = srcMscs[0]->data().shape(0)(0);
     uInt nChanTotal = 0;
@@ -466,118 +683,124 @@ void mergeMainTable(const std::vector< boost::shared_ptr<const ROMSColumns> >& s
         nChan(i) = srcMscs[i]->data().shape(0)(1);
         nChanTotal += nChan(i);
     }
-    casa::Cube<casa::Complex> data(nPol, nChanTotal,tileShape(2));
-    casa::Cube<casa::Bool> flag(nPol, nChanTotal,tileShape(2));
 
-    int lastPerc = 0;
-    uInt nIntperTile = tileShape(2)/nBase;
-    uInt lastTileStart = nTimes - 1;
-    uInt lastTileSize = nRows - lastTileStart * nBase;
-    if (detectMissingIntegrations) {
-        lastTileStart = (nTimes / nIntperTile) * nIntperTile;
-        lastTileSize = (nTimes - lastTileStart) * nBase;
+    // 3: Start the reader threads, inputs are distributed round robin
+    if (nReaders == 0) {
+        nReaders = std::max(1u, std::thread::hardware_concurrency());
     }
-    //ASKAPLOG_INFO_STR(logger, "last tile start "<< lastTileStart << ", last tile size = "<<lastTileSize);
-    Vector<uInt> row(nMS,0);
-    uInt dataRow = 0;
-    const double tol = 1.0; // tolerance for comparing timestamps is 1s
-    // For each integration
-    for (uInt j = 0, outRow=0; j < nTimes; j++, outRow+=nBase) {
-        const Slicer destRowSlicer(IPosition(1, outRow), IPosition(1, nBase), Slicer::endIsLength);
-        if (10*outRow/nRows > lastPerc/10) {
-            if (detectMissingIntegrations) {
-                ASKAPLOG_INFO_STR(logger,  "Merging row " <<  outRow<< " of " << nRows <<", Integration "<<j<<"/"<<nTimes);
-            } else {
-                ASKAPLOG_INFO_STR(logger,  "Merging row " <<  outRow<< " of " << nRows);
-            }
-            lastPerc = 100*outRow/nRows;
+    nReaders = std::min(nReaders, nMS);
+    ASKAPLOG_INFO_STR(logger, "Using "<<nReaders<<" reader thread(s), prefetching up to "<<prefetch<<
+                      " tile(s) per input");
+    std::vector<boost::shared_ptr<ChannelBlockQueue> > queues(nMS);
+    for (uInt i = 0; i < nMS; ++i) {
+        queues[i].reset(new ChannelBlockQueue(std::max(1u, prefetch)));
+    }
+    std::mutex errorMutex;
+    std::exception_ptr readerError;
+    std::vector<std::thread> readers;
+    for (uInt thread = 0; thread < nReaders; ++thread) {
+        std::vector<uInt> inputs;
+        for (uInt i = thread; i < nMS; i += nReaders) {
+            inputs.push_back(i);
         }
-
-        // Find first MS that has this timeslot
-        casa::Bool found = False;
-        uInt k = 0;
-        if (detectMissingIntegrations) {
-            for (k = 0; k< srcMscs.size(); k++) {
-                if (abs(srcMscs[k]->time()(row(k)) - mergedTimes(j)) < tol)  break;
+        readers.push_back(std::thread([&, inputs]() {
+            try {
+                readChannelBlocks(srcMscs, inputs, layout, queues, dryRun);
+            } catch (...) {
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!readerError) {
+                        readerError = std::current_exception();
+                    }
+                }
+                for (uInt i = 0; i < nMS; ++i) {
+                    queues[i]->abort();
+                }
             }
-        }
-        ASKAPCHECK(k<srcMscs.size(),"Logic error in mergeMainTable");
-        const ROMSColumns& sc(*srcMscs[k]);
-        const Slicer srcRowSlicer(IPosition(1,row(k)),IPosition(1,nBase), Slicer::endIsLength);
-        //ASKAPLOG_INFO_STR(logger, "Integration # "<<j << ", outRow = "<<outRow << ", row("<<k<<")="<<row(k));
-        // 1: Copy over the simple cells (i.e. those not needing merging)
-        if (!dryRun) {
-            dc->scanNumber().putColumnRange(destRowSlicer, sc.scanNumber().getColumnRange(srcRowSlicer));
-            dc->fieldId().putColumnRange(destRowSlicer, sc.fieldId().getColumnRange(srcRowSlicer));
-            dc->dataDescId().putColumnRange(destRowSlicer, sc.dataDescId().getColumnRange(srcRowSlicer));
-            dc->time().putColumnRange(destRowSlicer, sc.time().getColumnRange(srcRowSlicer));
-            dc->timeCentroid().putColumnRange(destRowSlicer, sc.timeCentroid().getColumnRange(srcRowSlicer));
-            dc->arrayId().putColumnRange(destRowSlicer, sc.arrayId().getColumnRange(srcRowSlicer));
-            dc->processorId().putColumnRange(destRowSlicer, sc.processorId().getColumnRange(srcRowSlicer));
-            dc->exposure().putColumnRange(destRowSlicer, sc.exposure().getColumnRange(srcRowSlicer));
-            dc->interval().putColumnRange(destRowSlicer, sc.interval().getColumnRange(srcRowSlicer));
-            dc->observationId().putColumnRange(destRowSlicer, sc.observationId().getColumnRange(srcRowSlicer));
-            dc->antenna1().putColumnRange(destRowSlicer, sc.antenna1().getColumnRange(srcRowSlicer));
-            dc->antenna2().putColumnRange(destRowSlicer, sc.antenna2().getColumnRange(srcRowSlicer));
-            dc->feed1().putColumnRange(destRowSlicer, sc.feed1().getColumnRange(srcRowSlicer));
-            dc->feed2().putColumnRange(destRowSlicer, sc.feed2().getColumnRange(srcRowSlicer));
-            dc->uvw().putColumnRange(destRowSlicer, sc.uvw().getColumnRange(srcRowSlicer));
-            dc->flagRow().putColumnRange(destRowSlicer, sc.flagRow().getColumnRange(srcRowSlicer));
-            dc->weight().putColumnRange(destRowSlicer, sc.weight().getColumnRange(srcRowSlicer));
-            dc->sigma().putColumnRange(destRowSlicer, sc.sigma().getColumnRange(srcRowSlicer));
-        }
-        if (j == lastTileStart) {
-            // for the last set of rows we need to resize
-            data.resize(nPol,nChanTotal,lastTileSize);
-            flag.resize(nPol,nChanTotal,lastTileSize);
-        }
+        }));
+    }
 
-        // 3: Copy the data from each input into the output matrix
-        uInt destChan = 0;
-        uInt destRow = (j % nIntperTile) * nBase;
-        for (uInt i = 0; i < nMS; ++i) {
-            // check if data is available
-            if (!detectMissingIntegrations || abs(srcMscs[i]->time()(row(i)) - mergedTimes(j)) < tol) {
-                if (!dryRun) {
-                    const Slicer srcDataSlicer(IPosition(1,row(i)),IPosition(1,nBase), Slicer::endIsLength);
-                    const casa::Cube<casa::Complex> srcData = srcMscs[i]->data().getColumnRange(srcDataSlicer);
-                    const casa::Cube<casa::Bool> srcFlag = srcMscs[i]->flag().getColumnRange(srcDataSlicer);
-                    for (uInt irow = 0, our; irow < nBase; irow++) {
-                        data(Slice(), Slice(destChan,nChan(i)), destRow + irow) = srcData(Slice(), Slice(), irow);
-                        flag(Slice(), Slice(destChan,nChan(i)), destRow + irow) = srcFlag(Slice(), Slice(), irow);
+    // 4: Assemble full tiles from the channel blocks of each input and write them out
+    try {
+        casa::Cube<casa::Complex> data;
+        casa::Cube<casa::Bool> flag;
+        int lastPerc = 0;
+        for (uInt tile = 0, dataRow = 0; tile < layout.nTiles(); ++tile) {
+            const uInt firstInt = tile * layout.nIntPerTile;
+            const uInt lastInt = std::min(layout.nTimes, firstInt + layout.nIntPerTile);
+            uInt tileRows = 0;
+            for (uInt j = firstInt; j < lastInt; ++j) {
+                tileRows += layout.rowsInIntegration(j);
+            }
+            if (10 * dataRow / nRows > lastPerc / 10) {
+                ASKAPLOG_INFO_STR(logger,  "Merging row " << dataRow << " of " << nRows <<
+                                  ", tile " << tile << "/" << layout.nTiles());
+                lastPerc = 100 * dataRow / nRows;
+            }
+            if (!dryRun && (data.nplane() != tileRows)) {
+                // the last tile may be smaller
+                data.resize(nPol, nChanTotal, tileRows);
+                flag.resize(nPol, nChanTotal, tileRows);
+            }
+            uInt destChan = 0;
+            for (uInt i = 0; i < nMS; ++i) {
+                boost::shared_ptr<ChannelBlock> block;
+                if (!queues[i]->pop(block)) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (readerError) {
+                        std::rethrow_exception(readerError);
                     }
+                    ASKAPTHROW(AskapError, "Reader thread for input " << i << " terminated prematurely");
                 }
-                row(i) += nBase;
-            } else {
-                // no data for this integration for this MS, set flags
-                if (!dryRun) {
-                    for (uInt irow = 0; irow < nBase; irow++) {
-                        data(Slice(), Slice(destChan,nChan(i)), destRow + irow) = 0;
-                        flag(Slice(), Slice(destChan,nChan(i)), destRow + irow) = True;
+                ASKAPDEBUGASSERT(block);
+                for (uInt j = firstInt, destRow = 0; j < lastInt; destRow += layout.rowsInIntegration(j), ++j) {
+                    const uInt nRowsThisInt = layout.rowsInIntegration(j);
+                    const int offset = block->offset[j - firstInt];
+                    if (offset >= 0) {
+                        if (!dryRun) {
+                            data(Slice(), Slice(destChan, nChan(i)), Slice(destRow, nRowsThisInt)) =
+                                 block->data(Slice(), Slice(), Slice(offset, nRowsThisInt));
+                            flag(Slice(), Slice(destChan, nChan(i)), Slice(destRow, nRowsThisInt)) =
+                                 block->flag(Slice(), Slice(), Slice(offset, nRowsThisInt));
+                        }
+                    } else {
+                        // no data for this integration for this MS, set flags
+                        if (!dryRun) {
+                            data(Slice(), Slice(destChan, nChan(i)), Slice(destRow, nRowsThisInt)) = 0;
+                            flag(Slice(), Slice(destChan, nChan(i)), Slice(destRow, nRowsThisInt)) = True;
+                        }
+                        ASKAPLOG_INFO_STR(logger,  "Missing integration for input file " <<
+                            srcMscs[i]->time().table().tableName() << " at " <<
+                            MVTime(layout.mergedTimes(j)/C::day).string(MVTime::YMD));
                     }
                 }
-                ASKAPLOG_INFO_STR(logger,  "Missing integration for input file " <<  srcMscs[i]->time().table().tableName()
-                    << " at row " << row(i) << ", "<<MVTime(mergedTimes(j)/C::day).string(MVTime::YMD));
+                destChan += nChan(i);
             }
-            destChan += nChan(i);
-        }
-        // 4: Add those merged cells when we've filled a tile or reached the end
-        if ((j+1) % nIntperTile == 0 || j == nTimes - 1) {
-            //ASKAPLOG_INFO_STR(logger, "Writing tile at int# "<<j << "/"<<nTimes<<" data row ="<<
-            //dataRow<< ", data shape = "<<data.shape());
             if (!dryRun) {
-                const Slicer dataRowSlicer(IPosition(1, dataRow), IPosition(1, data.shape()(2)),
+                const Slicer dataRowSlicer(IPosition(1, dataRow), IPosition(1, tileRows),
                         Slicer::endIsLength);
                 dc->data().putColumnRange(dataRowSlicer, data);
                 dc->flag().putColumnRange(dataRowSlicer, flag);
             }
-            dataRow += nIntperTile * nBase;
+            dataRow += tileRows;
+        }
+    } catch (...) {
+        for (uInt i = 0; i < nMS; ++i) {
+            queues[i]->abort();
         }
+        for (std::vector<std::thread>::iterator it = readers.begin(); it != readers.end(); ++it) {
+            it->join();
+        }
+        throw;
+    }
+    for (std::vector<std::thread>::iterator it = readers.begin(); it != readers.end(); ++it) {
+        it->join();
     }
 }
 
 void merge(const std::vector<std::string>& inFiles, const std::string& outFile, casa::uInt tileNcorr = 4,
-    casa::uInt tileNchan = 1, casa::uInt tileNrow = 0, bool dryRun = false)
+    casa::uInt tileNchan = 0, casa::uInt tileNrow = 0, bool dryRun = false, casa::uInt nReaders = 0,
+    casa::uInt prefetch = 1)
 {
     // Open the input measurement sets
     std::vector< boost::shared_ptr<const casa::MeasurementSet> > in;
@@ -611,7 +834,14 @@ void merge(const std::vector<std::string>& inFiles, const std::string& outFile,
         "All input MeasurementSets should have the same number of rows");
 
     if (tileNcorr < 1) tileNcorr = 1;
-    if (tileNchan < 1) tileNchan = 1;
+    if (tileNchan < 1) {
+        // derive channel tiling from the inputs
+        tileNchan = tuneTileNchan(in, inColumns);
+        ASKAPLOG_INFO_STR(logger, "Setting tileNchan to " << tileNchan << " to match the input layout");
+    }
+    for (size_t i = 0; i < in.size(); ++i) {
+        setSpectrumCache(*in[i]);
+    }
     // Set tileNrow large, but not so large that caching takes > 1GB
     bool detectMissingIntegrations = false;
     if (tileNrow==0) {
@@ -682,7 +912,7 @@ void merge(const std::vector<std::string>& inFiles, const std::string& outFile,
     // Merge main table
     ASKAPLOG_INFO_STR(logger,  "Merging main table");
     mergeMainTable(inColumns,out,IPosition(3,tileNcorr,tileNchan,tileNrow), nBaselines, dryRun,
-                    detectMissingIntegrations);
+                    detectMissingIntegrations, nReaders, prefetch);
     // Uncomment this to check if the caching is working
     //RODataManAccessor(**(in.begin()), "TiledData", False).showCacheStatistics (cout);
     //if (!dryRun) RODataManAccessor(*out, "TiledData", False).showCacheStatistics (cout);
@@ -713,6 +943,8 @@ int main(int argc, const char** argv)
         int tileNcorr;
         int tileNchan;
         int tileNrow;
+        int nReaders;
+        int prefetch;
         bool dryRun;
         std::string outName;
         std::vector<std::string> inNamesVec;
@@ -723,8 +955,10 @@ int main(int argc, const char** argv)
         desc.add_options()
         ("help,h", "produce help message")
         ("tileNcorr,x", po::value<int>(&tileNcorr)->default_value(4), "Number of correlations per tile")
-        ("tileNchan,c", po::value<int>(&tileNchan)->default_value(1), "Number of channels per tile")
+        ("tileNchan,c", po::value<int>(&tileNchan)->default_value(0), "Number of channels per tile (0 - derive from the inputs)")
         ("tileNrow,r", po::value<int>(&tileNrow)->default_value(0), "Number of rows per tile")
+        ("readers,t", po::value<int>(&nReaders)->default_value(0), "Number of reader threads (0 - one per input, up to the number of cores)")
+        ("prefetch,p", po::value<int>(&prefetch)->default_value(1), "Number of tiles prefetched per input")
         ("dryrun,d", po::value<bool>(&dryRun)->default_value(false),"Don't produce any output")
         ("input-file,i", po::value< vector<string> >(&inNames), "Input file(s) - you can also just list them after the other options")
         ("output-file,o",po::value<std::string>(&outName)->default_value("out.ms"),"Output filename");
@@ -787,7 +1021,8 @@ int main(int argc, const char** argv)
                 inNamesVec.push_back(*it);
         }
 
-        merge(inNamesVec, outName, tileNcorr, tileNchan, tileNrow, dryRun);
+        ASKAPCHECK(nReaders >= 0 && prefetch > 0, "Number of readers should be non-negative and prefetch positive");
+        merge(inNamesVec, outName, tileNcorr, tileNchan, tileNrow, dryRun, nReaders, prefetch);
 
         stats.logSummary();
         ///==============================================================================
@@ -0,0 +1,475 @@
+/// @file
+///
+/// @brief benchmark of the gridders on synthetic data
+/// @details Gridders created by VisGridderFactory (Box, SphFunc, WProject, WStack,
+/// AWProject and AProjectWStack by default) grid and degrid synthetic data which are
+/// generated in memory, so no measurement set is required. The uvw coverage is either a set
+/// of earth rotation tracks for a random array or uniformly distributed random uvw's,
+/// channel frequencies are either regular or random. For each gridder, the throughput
+/// (Mvis/s), kernel performance (GFlop/s), the time spent building convolution functions
+/// and indices, FFT time, peak resident memory and its growth while the gridder ran are written
+/// in JSON. Every gridder works with the same visibilities, the model added by degridding is
+/// removed before the next pass.
+///
+/// Usage: tGridderBenchmark [-inputs parsetFile]
+///
+/// All parameters are optional (see defaults below): gridders, nantennas, maxbaseline (m),
+/// latitude (deg), declination (deg), uvwdistribution (tracks or random), nsteps, hourangle
+/// (total range in hours), frequency (Hz, the first channel), nchannels, channelwidth (Hz),
+/// frequencydistribution (regular or random), npol (1, 2 or 4), npix, cellsize (arcsec),
+/// taylorterm (if positive, visibilities are weighted as for this Taylor term of multi-frequency
+/// synthesis with the reference frequency in the middle of the band), ncycles, seed and
+/// output (file name, the standard output is used if empty). Gridder
+/// parameters can be given in the usual way, e.g. gridder.WProject.nwplanes = 65, and override
+/// defaults derived from the synthetic data.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+// Package level header file
+#include "askap/askap_synthesis.h"
+
+// ASKAPsoft includes
+#include <askap/askap/AskapLogging.h>
+#include <askap/askap/AskapError.h>
+#include <askap/askap/AskapUtil.h>
+#include <askap/askap/Log4cxxLogSink.h>
+#include <askap/askapparallel/AskapParallel.h>
+#include <askap/utils/CommandLineParser.h>
+#include <askap/scimath/fitting/Axes.h>
+#include <askap/gridding/VisGridderFactory.h>
+#include <askap/gridding/TableVisGridder.h>
+#include <askap/gridding/VisWeightsMultiFrequency.h>
+#include <askap/parallel/ParallelAccessor.h>
+#include <Common/ParameterSet.h>
+
+#include <casacore/casa/Arrays/Cube.h>
+#include <casacore/casa/Arrays/Matrix.h>
+#include <casacore/casa/Arrays/ArrayMath.h>
+#include <casacore/casa/BasicSL/Constants.h>
+#include <casacore/casa/Logging/LogIO.h>
+#include <casacore/casa/OS/Timer.h>
+#include <casacore/coordinates/Coordinates/DirectionCoordinate.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+ASKAP_LOGGER(logger, ".tGridderBenchmark");
+
+using namespace askap;
+using namespace askap::synthesis;
+
+namespace {
+
+/// @brief synthetic chunk of data, one per integration
+typedef boost::shared_ptr<ParallelAccessor> ChunkPtr;
+
+/// @brief uniform random number in [0,1)
+/// @details A simple linear congruential generator, so the data are the same on all platforms
+/// @param[in,out] state generator state
+double uniform(unsigned long &state)
+{
+    state = (state * 6364136223846793005ul + 1442695040888963407ul);
+    return double(state >> 11) / 9007199254740992.;
+}
+
+/// @brief value of a memory field of /proc/self/status
+/// @param[in] field field name, e.g. VmRSS
+/// @return value in MB or a negative value if the field is not available
+double procStatus(const std::string &field)
+{
+    std::ifstream is("/proc/self/status");
+    std::string line;
+    while (std::getline(is, line)) {
+         if (line.compare(0, field.size() + 1, field + ":") == 0) {
+             // in kilobytes
+             return std::atof(line.c_str() + field.size() + 1) / 1024.;
+         }
+    }
+    return -1.;
+}
+
+/// @brief reset the peak resident set size of the process
+/// @details Supported by linux since 4.0, otherwise peakRSS keeps giving the peak since the start
+void resetPeakRSS()
+{
+    std::ofstream os("/proc/self/clear_refs");
+    os << "5";
+}
+
+/// @brief current resident set size of the process
+/// @return current memory usage in MB
+double currentRSS()
+{
+    const double result = procStatus("VmRSS");
+    return result >= 0. ? result : 0.;
+}
+
+/// @brief peak resident set size of the process
+/// @return peak memory usage in MB since the last resetPeakRSS
+double peakRSS()
+{
+    const double result = procStatus("VmHWM");
+    if (result >= 0.) {
+        return result;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // in kilobytes on linux
+    return double(usage.ru_maxrss) / 1024.;
+}
+
+/// @brief generate synthetic data
+/// @param[in] parset benchmark parameters
+/// @param[in] phaseCentre phase and pointing centre
+/// @return chunks of data
+std::vector<ChunkPtr> makeChunks(const LOFAR::ParameterSet &parset, const casacore::MVDirection &phaseCentre)
+{
+    const int nAnt = parset.getInt32("nantennas", 36);
+    const double maxBaseline = parset.getDouble("maxbaseline", 6000.);
+    const double lat = parset.getDouble("latitude", -26.7) * casacore::C::pi / 180.;
+    const double dec = phaseCentre.getLat();
+    const std::string uvwDistribution = parset.getString("uvwdistribution", "tracks");
+    const int nSteps = parset.getInt32("nsteps", 32);
+    const double haRange = parset.getDouble("hourangle", 8.) * casacore::C::pi / 12.;
+    const double freq0 = parset.getDouble("frequency", 1.4e9);
+    const int nChan = parset.getInt32("nchannels", 16);
+    const double chanWidth = parset.getDouble("channelwidth", 1e6);
+    const std::string freqDistribution = parset.getString("frequencydistribution", "regular");
+    const int nPol = parset.getInt32("npol", 1);
+    unsigned long state = parset.getUint32("seed", 1);
+    ASKAPCHECK(nAnt > 1, "At least two antennas are required, you have "<<nAnt);
+    ASKAPCHECK(nSteps > 0 && nChan > 0, "Number of integrations and channels should be positive");
+    ASKAPCHECK(uvwDistribution == "tracks" || uvwDistribution == "random",
+               "uvwdistribution is supposed to be either tracks or random, you have "<<uvwDistribution);
+    ASKAPCHECK(freqDistribution == "regular" || freqDistribution == "random",
+               "frequencydistribution is supposed to be either regular or random, you have "<<freqDistribution);
+
+    casacore::Vector<casacore::Stokes::StokesTypes> stokes(nPol);
+    if (nPol == 1) {
+        stokes[0] = casacore::Stokes::I;
+    } else if (nPol == 2) {
+        stokes[0] = casacore::Stokes::XX;
+        stokes[1] = casacore::Stokes::YY;
+    } else {
+        ASKAPCHECK(nPol == 4, "npol is supposed to be 1, 2 or 4, you have "<<nPol);
+        stokes[0] = casacore::Stokes::XX;
+        stokes[1] = casacore::Stokes::XY;
+        stokes[2] = casacore::Stokes::YX;
+        stokes[3] = casacore::Stokes::YY;
+    }
+
+    casacore::Vector<casacore::Double> freqs(nChan);
+    for (int chan = 0; chan < nChan; ++chan) {
+         freqs[chan] = freq0 + chanWidth * (freqDistribution == "regular" ? double(chan) : uniform(state) * nChan);
+    }
+
+    // antennas uniformly distributed within a circle, converted to the equatorial frame
+    casacore::Matrix<double> xyz(nAnt, 3);
+    for (int ant = 0; ant < nAnt; ++ant) {
+         const double r = 0.5 * maxBaseline * std::sqrt(uniform(state));
+         const double phi = 2. * casacore::C::pi * uniform(state);
+         const double east = r * std::cos(phi);
+         const double north = r * std::sin(phi);
+         xyz(ant, 0) = -std::sin(lat) * north;
+         xyz(ant, 1) = east;
+         xyz(ant, 2) = std::cos(lat) * north;
+    }
+    const int nBaselines = nAnt * (nAnt - 1) / 2;
+
+    std::vector<ChunkPtr> chunks(nSteps);
+    for (int step = 0; step < nSteps; ++step) {
+         ChunkPtr chunk(new ParallelAccessor);
+         ParallelAccessor &acc = *chunk;
+         const double ha = nSteps > 1 ? haRange * (double(step) / (nSteps - 1) - 0.5) : 0.;
+         acc.itsTime = 4e9 + ha / casacore::C::_2pi * 86164.;
+         acc.itsFrequency.assign(freqs);
+         acc.itsStokes.assign(stokes);
+         acc.itsAntenna1.resize(nBaselines);
+         acc.itsAntenna2.resize(nBaselines);
+         acc.itsFeed1.resize(nBaselines);
+         acc.itsFeed2.resize(nBaselines);
+         acc.itsFeed1.set(0u);
+         acc.itsFeed2.set(0u);
+         acc.itsFeed1PA.resize(nBaselines);
+         acc.itsFeed2PA.resize(nBaselines);
+         const float pa = std::atan2(std::cos(lat) * std::sin(ha),
+                                     std::sin(lat) * std::cos(dec) - std::cos(lat) * std::sin(dec) * std::cos(ha));
+         acc.itsFeed1PA.set(pa);
+         acc.itsFeed2PA.set(pa);
+         acc.itsPointingDir1.resize(nBaselines);
+         acc.itsPointingDir2.resize(nBaselines);
+         acc.itsDishPointing1.resize(nBaselines);
+         acc.itsDishPointing2.resize(nBaselines);
+         acc.itsPointingDir1.set(phaseCentre);
+         acc.itsPointingDir2.set(phaseCentre);
+         acc.itsDishPointing1.set(phaseCentre);
+         acc.itsDishPointing2.set(phaseCentre);
+         acc.itsUVW.resize(nBaselines);
+         int row = 0;
+         for (int ant1 = 0; ant1 < nAnt; ++ant1) {
+              for (int ant2 = ant1 + 1; ant2 < nAnt; ++ant2, ++row) {
+                   acc.itsAntenna1[row] = ant1;
+                   acc.itsAntenna2[row] = ant2;
+                   if (uvwDistribution == "tracks") {
+                       const double bx = xyz(ant2, 0) - xyz(ant1, 0);
+                       const double by = xyz(ant2, 1) - xyz(ant1, 1);
+                       const double bz = xyz(ant2, 2) - xyz(ant1, 2);
+                       acc.itsUVW[row](0) = std::sin(ha) * bx + std::cos(ha) * by;
+                       acc.itsUVW[row](1) = -std::sin(dec) * std::cos(ha) * bx + std::sin(dec) * std::sin(ha) * by +
+                                            std::cos(dec) * bz;
+                       acc.itsUVW[row](2) = std::cos(dec) * std::cos(ha) * bx - std::cos(dec) * std::sin(ha) * by +
+                                            std::sin(dec) * bz;
+                   } else {
+                       for (int dim = 0; dim < 3; ++dim) {
+                            acc.itsUVW[row](dim) = maxBaseline * (uniform(state) - 0.5) * (dim < 2 ? 1. : 0.5);
+                       }
+                   }
+              }
+         }
+         acc.itsVisibility.resize(nBaselines, nChan, nPol);
+         acc.itsVisibility.set(casacore::Complex(1., 0.));
+         acc.itsNoise.resize(nBaselines, nChan, nPol);
+         acc.itsNoise.set(casacore::Complex(1., 1.));
+         acc.itsFlag.resize(nBaselines, nChan, nPol);
+         acc.itsFlag.set(false);
+         chunks[step] = chunk;
+    }
+    return chunks;
+}
+
+/// @brief largest w-term in wavelengths
+/// @param[in] chunks synthetic data
+/// @return the largest absolute value of w in wavelengths
+double maxW(const std::vector<ChunkPtr> &chunks)
+{
+    double result = 0.;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+         const double maxFreq = casacore::max(chunks[i]->frequency());
+         for (casacore::uInt row = 0; row < chunks[i]->nRow(); ++row) {
+              result = std::max(result, std::abs(chunks[i]->uvw()[row](2)) * maxFreq / casacore::C::c);
+         }
+    }
+    return result;
+}
+
+/// @brief parameters of the given gridder
+/// @details Defaults suitable for the synthetic data are overridden by the parameters given by the user
+/// @param[in] parset benchmark parameters
+/// @param[in] name gridder name
+/// @param[in] wmax largest w-term in wavelengths
+/// @return parset to be passed to VisGridderFactory
+LOFAR::ParameterSet gridderParset(const LOFAR::ParameterSet &parset, const std::string &name, double wmax)
+{
+    LOFAR::ParameterSet result;
+    const std::string prefix = "gridder." + name + ".";
+    result.replace(prefix + "wmax", utility::toString(wmax * 1.01 + 1.));
+    result.replace(prefix + "nwplanes", "33");
+    result.replace(prefix + "oversample", "4");
+    result.replace(prefix + "maxsupport", "512");
+    result.replace(prefix + "cutoff", "0.001");
+    result.replace(prefix + "diameter", "12m");
+    result.replace(prefix + "blockage", "2m");
+    result.adoptCollection(parset);
+    result.replace("gridder", name);
+    return result;
+}
+
+/// @brief write the result of one run in JSON
+/// @param[in] os output stream
+/// @param[in] name gridder name
+/// @param[in] gridder gridder used for gridding (statistics are obtained from it)
+/// @param[in] degridder gridder used for degridding
+/// @param[in] gridTime wall time of all grid calls (in seconds)
+/// @param[in] degridTime wall time of all degrid calls (in seconds)
+/// @param[in] fftTime wall time of initialisation and finalisation, i.e. mainly FFTs (in seconds)
+/// @param[in] nVis number of visibilities processed in each direction
+/// @param[in] rssBefore memory usage before the gridders were created (in MB)
+void writeResult(std::ostream &os, const std::string &name, const TableVisGridder &gridder,
+                 const TableVisGridder &degridder, double gridTime, double degridTime, double fftTime, double nVis,
+                 double rssBefore)
+{
+    const double peak = peakRSS();
+    os << "    {\"gridder\": \"" << name << "\", \"nvis\": " << nVis << "," << std::endl;
+    os << "     \"grid\": {\"time\": " << gridTime << ", \"mvis_per_s\": " << nVis / gridTime * 1e-6 <<
+          ", \"gflops\": " << (gridder.timeGridded() > 0. ? 8e-9 * gridder.pointsGridded() / gridder.timeGridded() : 0.) <<
+          "}," << std::endl;
+    os << "     \"degrid\": {\"time\": " << degridTime << ", \"mvis_per_s\": " << nVis / degridTime * 1e-6 <<
+          ", \"gflops\": " << (degridder.timeDegridded() > 0. ?
+                               8e-9 * degridder.pointsDegridded() / degridder.timeDegridded() : 0.) << "}," << std::endl;
+    os << "     \"cf_time\": " << gridder.timeConvFunctions() + degridder.timeConvFunctions() <<
+          ", \"coordinate_time\": " << gridder.timeCoordinates() + degridder.timeCoordinates() <<
+          ", \"fft_time\": " << fftTime << ", \"peak_rss_mb\": " << peak <<
+          ", \"rss_growth_mb\": " << std::max(0., peak - rssBefore) << "}";
+}
+
+} // anonymous namespace
+
+// Main function
+int main(int argc, const char** argv)
+{
+    // This class must have scope outside the main try/catch block
+    askap::askapparallel::AskapParallel comms(argc, argv);
+
+    try {
+        // Ensure that CASA log messages are captured
+        casa::LogSinkInterface* globalSink = new Log4cxxLogSink();
+        casa::LogSink::globalSink(globalSink);
+
+        cmdlineparser::Parser parser; // a command line parser
+        // command line parameter, all benchmark parameters have defaults
+        cmdlineparser::FlaggedParameter<std::string> inputsPar("-inputs", "");
+        parser.add(inputsPar, cmdlineparser::Parser::return_default);
+        parser.process(argc, argv);
+        const std::string parsetFile = inputsPar;
+        const LOFAR::ParameterSet parset = parsetFile.size() ? LOFAR::ParameterSet(parsetFile) : LOFAR::ParameterSet();
+
+        std::vector<std::string> defaultGridders;
+        defaultGridders.push_back("Box");
+        defaultGridders.push_back("SphFunc");
+        defaultGridders.push_back("WProject");
+        defaultGridders.push_back("WStack");
+        defaultGridders.push_back("AWProject");
+        defaultGridders.push_back("AProjectWStack");
+        const std::vector<std::string> gridders = parset.getStringVector("gridders", defaultGridders);
+        const int nCycles = parset.getInt32("ncycles", 2);
+        const int taylorTerm = parset.getInt32("taylorterm", 0);
+        ASKAPCHECK(taylorTerm >= 0, "Taylor term is supposed to be non-negative, you have "<<taylorTerm);
+        ASKAPCHECK(nCycles > 0, "Number of passes over the data is supposed to be positive, you have "<<nCycles);
+        const int npix = parset.getInt32("npix", 1024);
+        const double cellSize = parset.getDouble("cellsize", 10.) * casacore::C::arcsec;
+        const double dec = parset.getDouble("declination", -45.) * casacore::C::pi / 180.;
+        const casacore::MVDirection phaseCentre(0., dec);
+
+        casacore::Timer timer;
+        timer.mark();
+        const std::vector<ChunkPtr> chunks = makeChunks(parset, phaseCentre);
+        const double wmax = maxW(chunks);
+        double nVis = 0.;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+             nVis += double(chunks[i]->visibility().nelements());
+        }
+        nVis *= nCycles;
+        // degridding adds the model to the visibilities, every pass starts from these
+        std::vector<casacore::Cube<casacore::Complex> > originalVis(chunks.size());
+        for (size_t i = 0; i < chunks.size(); ++i) {
+             originalVis[i] = chunks[i]->visibility().copy();
+        }
+        ASKAPLOG_INFO_STR(logger, "Generated "<<chunks.size()<<" chunks of synthetic data in "<<timer.real()<<
+                          " s, wmax = "<<wmax<<" wavelengths");
+
+        // image with a few point sources to degrid
+        scimath::Axes axes;
+        casacore::Matrix<double> xform(2, 2, 0.);
+        xform.diagonal().set(1.);
+        axes.addDirectionAxis(casacore::DirectionCoordinate(casacore::MDirection::J2000,
+                     casacore::Projection(casacore::Projection::SIN), phaseCentre.getLong(), phaseCentre.getLat(),
+                     -cellSize, cellSize, xform, npix / 2, npix / 2));
+        axes.addStokesAxis(casacore::Vector<casacore::Stokes::StokesTypes>(1, casacore::Stokes::I));
+        const casacore::Vector<casacore::Double> &freqs = chunks[0]->frequency();
+        axes.add("FREQUENCY", casacore::min(freqs), casacore::max(freqs));
+        const casacore::IPosition shape(4, npix, npix, 1, 1);
+        casacore::Array<imtype> model(shape, imtype(0.));
+        model(casacore::IPosition(4, npix / 2, npix / 2, 0, 0)) = 1.;
+        model(casacore::IPosition(4, npix / 3, 2 * npix / 3, 0, 0)) = 0.5;
+        casacore::Array<imtype> image(shape);
+
+        const std::string output = parset.getString("output", "");
+        std::ofstream file;
+        if (output.size()) {
+            file.open(output.c_str());
+            ASKAPCHECK(file, "Unable to open "<<output);
+        }
+        std::ostream &os = output.size() ? file : std::cout;
+        os << "{" << std::endl;
+        os << "  \"config\": {\"nchunks\": " << chunks.size() << ", \"nrow\": " << chunks[0]->nRow() <<
+              ", \"nchannels\": " << chunks[0]->nChannel() << ", \"npol\": " << chunks[0]->nPol() <<
+              ", \"npix\": " << npix << ", \"taylorterm\": " << taylorTerm << ", \"ncycles\": " << nCycles <<
+              ", \"wmax\": " << wmax << "}," << std::endl;
+        os << "  \"results\": [" << std::endl;
+        for (size_t g = 0; g < gridders.size(); ++g) {
+             ASKAPLOG_INFO_STR(logger, "Benchmarking "<<gridders[g]<<" gridder");
+             resetPeakRSS();
+             const double rssBefore = currentRSS();
+             const IVisGridder::ShPtr prototype = VisGridderFactory::make(gridderParset(parset, gridders[g], wmax));
+             const boost::shared_ptr<TableVisGridder> gridder =
+                   boost::dynamic_pointer_cast<TableVisGridder>(prototype->clone());
+             const boost::shared_ptr<TableVisGridder> degridder =
+                   boost::dynamic_pointer_cast<TableVisGridder>(prototype->clone());
+             ASKAPCHECK(gridder && degridder, "Gridder "<<gridders[g]<<" is not derived from TableVisGridder");
+             if (taylorTerm > 0) {
+                 casacore::Double refFreq = 0.5 * (casacore::min(freqs) + casacore::max(freqs));
+                 const std::string context = ".i.taylor." + utility::toString(taylorTerm);
+                 gridder->initVisWeights(IVisWeights::ShPtr(new VisWeightsMultiFrequency(refFreq)));
+                 gridder->customiseForContext(context);
+                 degridder->initVisWeights(IVisWeights::ShPtr(new VisWeightsMultiFrequency(refFreq)));
+                 degridder->customiseForContext(context);
+             }
+
+             double gridTime = 0., degridTime = 0., fftTime = 0.;
+             for (int cycle = 0; cycle < nCycles; ++cycle) {
+                  timer.mark();
+                  gridder->initialiseGrid(axes, shape, false);
+                  degridder->initialiseDegrid(axes, model);
+                  fftTime += timer.real();
+                  for (size_t i = 0; i < chunks.size(); ++i) {
+                       chunks[i]->rwVisibility() = originalVis[i];
+                       timer.mark();
+                       degridder->degrid(*chunks[i]);
+                       degridTime += timer.real();
+                       timer.mark();
+                       gridder->grid(*chunks[i]);
+                       gridTime += timer.real();
+                  }
+                  timer.mark();
+                  gridder->finaliseGrid(image);
+                  degridder->finaliseDegrid();
+                  fftTime += timer.real();
+             }
+             writeResult(os, gridders[g], *gridder, *degridder, gridTime, degridTime, fftTime, nVis, rssBefore);
+             os << (g + 1 < gridders.size() ? "," : "") << std::endl;
+        }
+        os << "  ]" << std::endl << "}" << std::endl;
+        ///==============================================================================
+    } catch (const cmdlineparser::XParser &ex) {
+        ASKAPLOG_FATAL_STR(logger, "Command line parser error, wrong arguments " << argv[0]);
+        std::cerr << "Usage: " << argv[0] << " [-inputs parsetFile]" << std::endl;
+    } catch (const askap::AskapError& x) {
+        ASKAPLOG_FATAL_STR(logger, "Askap error in " << argv[0] << ": " << x.what());
+        std::cerr << "Askap error in " << argv[0] << ": " << x.what() << std::endl;
+        exit(1);
+    } catch (const std::exception& x) {
+        ASKAPLOG_FATAL_STR(logger, "Unexpected exception in " << argv[0] << ": " << x.what());
+        std::cerr << "Unexpected exception in " << argv[0] << ": " << x.what() << std::endl;
+        exit(1);
+    }
+
+    return 0;
+}
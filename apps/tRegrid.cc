@@ -0,0 +1,144 @@
+/// @file
+///
+/// @brief benchmark of image plane regridding used in snap-shot imaging
+/// @details Regrids a number of image planes between the target frame and frames
+/// corresponding to different fitted planes w = Au + Bv, both with casacore::ImageRegrid
+/// (as SnapShotImagingGridderAdapter does by default) and with ImagePlaneRegridder. Each
+/// fit is regridded twice (image and weights) as in gridding and the whole sequence is
+/// repeated to mimic major cycles, which reuse the same fits.
+///
+/// Usage: tRegrid [size] [number of fits] [number of cycles]
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/gridding/ImagePlaneRegridder.h>
+
+#include <casacore/casa/Arrays/Matrix.h>
+#include <casacore/casa/Arrays/ArrayMath.h>
+#include <casacore/casa/OS/Timer.h>
+#include <casacore/coordinates/Coordinates/CoordinateSystem.h>
+#include <casacore/coordinates/Coordinates/DirectionCoordinate.h>
+#include <casacore/images/Images/TempImage.h>
+#include <casacore/images/Images/ImageRegrid.h>
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+using namespace askap::synthesis;
+
+namespace {
+
+casacore::DirectionCoordinate makeCoordinate(const double a, const double b, const int size)
+{
+    casacore::Matrix<casacore::Double> xform(2, 2, 0.);
+    xform.diagonal() = 1.;
+    casacore::Vector<casacore::Double> projParams(2);
+    projParams[0] = -a;
+    projParams[1] = -b;
+    const casacore::Projection projection(casacore::Projection::SIN, projParams);
+    return casacore::DirectionCoordinate(casacore::MDirection::J2000, projection,
+                casacore::Quantity(187.5, "deg"), casacore::Quantity(-45., "deg"),
+                casacore::Quantity(-2., "arcsec"), casacore::Quantity(2., "arcsec"),
+                xform, size / 2, size / 2);
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+    const int size = argc > 1 ? std::atoi(argv[1]) : 4096;
+    const int nFits = argc > 2 ? std::atoi(argv[2]) : 8;
+    const int nCycles = argc > 3 ? std::atoi(argv[3]) : 2;
+    const casacore::IPosition shape(2, size, size);
+    std::cout << "Regridding " << size << "x" << size << " planes for " << nFits << " fits and " <<
+                 nCycles << " cycles" << std::endl;
+
+    casacore::Matrix<imtype> input(shape);
+    for (int y = 0; y < size; ++y) {
+         for (int x = 0; x < size; ++x) {
+              input(x, y) = std::sin(0.01 * x) * std::cos(0.013 * y);
+         }
+    }
+    const casacore::DirectionCoordinate target = makeCoordinate(0., 0., size);
+    std::vector<casacore::DirectionCoordinate> fits;
+    for (int fit = 0; fit < nFits; ++fit) {
+         // a track of fitted planes similar to what is seen for a long observation
+         const double ha = -1. + 2. * fit / std::max(nFits - 1, 1);
+         fits.push_back(makeCoordinate(0.3 * std::sin(ha), 0.2 * std::cos(ha) - 0.2, size));
+    }
+
+    const casacore::Interpolate2D::Method methods[2] = {casacore::Interpolate2D::LINEAR,
+                                                        casacore::Interpolate2D::CUBIC};
+    const char* names[2] = {"linear", "cubic"};
+    for (int m = 0; m < 2; ++m) {
+         casacore::Timer timer;
+         // ImageRegrid with the default coordinate decimation of the snap-shot adapter
+         casacore::CoordinateSystem csOut;
+         csOut.addCoordinate(target);
+         casacore::TempImage<imtype> outImg(casacore::TiledShape(shape), csOut,
+                                            double(shape.product() * sizeof(double)) / 1048576. + 100);
+         casacore::TempImage<imtype> inImg(casacore::TiledShape(shape), csOut,
+                                           double(shape.product() * sizeof(double)) / 1048576. + 100);
+         casacore::ImageRegrid<imtype> regridder;
+         casacore::Matrix<imtype> reference(shape, imtype(0.));
+         timer.mark();
+         for (int cycle = 0; cycle < nCycles; ++cycle) {
+              for (int fit = 0; fit < nFits; ++fit) {
+                   casacore::CoordinateSystem csIn;
+                   csIn.addCoordinate(fits[fit]);
+                   inImg.setCoordinateInfo(csIn);
+                   inImg.put(input);
+                   for (int pass = 0; pass < 2; ++pass) {
+                        regridder.regrid(outImg, methods[m], casacore::IPosition(2, 0, 1), inImg, false, 3);
+                        reference += outImg.get();
+                   }
+              }
+         }
+         const double slowTime = timer.real();
+
+         ImagePlaneRegridder fast(methods[m], 4096);
+         casacore::Matrix<imtype> result(shape, imtype(0.));
+         double firstCycleTime = 0.;
+         timer.mark();
+         for (int cycle = 0; cycle < nCycles; ++cycle) {
+              for (int fit = 0; fit < nFits; ++fit) {
+                   for (int pass = 0; pass < 2; ++pass) {
+                        fast.regrid(input, fits[fit], result, target, true);
+                   }
+              }
+              if (cycle == 0) {
+                  firstCycleTime = timer.real();
+              }
+         }
+         const double fastTime = timer.real();
+         const double regrids = 2. * nFits * nCycles;
+         std::cout << names[m] << ": ImageRegrid " << slowTime / regrids << " s per plane, ImagePlaneRegridder " <<
+                      fastTime / regrids << " s per plane (first cycle " << firstCycleTime / (2. * nFits) <<
+                      " s per plane), speed-up " << slowTime / fastTime << ", max difference " <<
+                      casacore::max(casacore::abs(reference - result)) << std::endl;
+    }
+    return 0;
+}
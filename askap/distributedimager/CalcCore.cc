@@ -162,6 +162,8 @@ void CalcCore::doCalc()
             itsEquation = fftEquation;
         } else {
             ASKAPLOG_DEBUG_STR(logger, "Calibration will be performed using solution source");
+            // the PSF depends on the calibration solution which is not tracked by the cache
+            ASKAPCHECK(!parset().getBool("cachepsf", false), "cachepsf can not be used when calibration is applied");
             boost::shared_ptr<ICalibrationApplicator> calME(\
             new CalibrationApplicatorME(getSolutionSource()));
             // fine tune parameters
@@ -144,9 +144,10 @@ ContinuumWorker::ContinuumWorker(LOFAR::ParameterSet& parset,
 
 ContinuumWorker::~ContinuumWorker()
 {
-
-
-
+  // remove split files prefetched for workunits which were never processed
+  for (std::set<string>::const_iterator it = itsPrefetchedFiles.begin(); it != itsPrefetchedFiles.end(); ++it) {
+    boost::filesystem::remove_all(it->c_str());
+  }
 }
 
 void ContinuumWorker::run(void)
@@ -319,11 +320,8 @@ void ContinuumWorker::clearWorkUnitCache()
   }
 }
 
-void ContinuumWorker::cacheWorkUnit(ContinuumWorkUnit& wu, LOFAR::ParameterSet& unitParset)
+string ContinuumWorker::cachedDatasetName(const ContinuumWorkUnit& wu, const LOFAR::ParameterSet& unitParset) const
 {
-
-
-
   boost::filesystem::path mspath = boost::filesystem::path(wu.get_dataset());
   const string ms = mspath.filename().string();
 
@@ -332,6 +330,86 @@ void ContinuumWorker::cacheWorkUnit(ContinuumWorkUnit& wu, LOFAR::ParameterSet&
   std::ostringstream pstr;
 
   pstr << shm_root << "/" << ms << "_chan_" << wu.get_localChannel() + 1 << "_beam_" << wu.get_beam() << ".ms";
+  return pstr.str();
+}
+
+void ContinuumWorker::prefetchWorkUnits(size_t first)
+{
+  // This splits the given workunit together with the following ones from the same
+  // dataset in a single pass over the input (the dataset is otherwise read again
+  // for every channel and beam). The split files are picked up by cacheWorkUnit.
+  ASKAPDEBUGASSERT(first < workUnits.size());
+  const LOFAR::ParameterSet& firstParset = itsParsets[first];
+  const int fanout = firstParset.getInt32("splitter.fanout", 1);
+  if (fanout < 2 || !itsComms.inGroup(0)) {
+    return;
+  }
+  const string dataset = workUnits[first].get_dataset();
+
+  std::vector<SplitTarget> targets;
+  std::vector<string> flagFiles;
+  for (size_t unit = first; unit < workUnits.size() && targets.size() < size_t(fanout); ++unit) {
+    const ContinuumWorkUnit& wu = workUnits[unit];
+    if (wu.get_payloadType() != ContinuumWorkUnit::WORK || wu.get_dataset() != dataset) {
+      continue;
+    }
+    const string outms = cachedDatasetName(wu, itsParsets[unit]);
+    const string outms_flag = outms + ".working";
+    struct stat buffer;
+    if (stat(outms.c_str(), &buffer) == 0 || stat(outms_flag.c_str(), &buffer) == 0) {
+      // already done or someone else is writing
+      continue;
+    }
+    SplitTarget target;
+    target.outvis = outms;
+    target.startChan = wu.get_localChannel() + 1;
+    target.endChan = target.startChan;
+    if (itsParsets[unit].isDefined("beams")) {
+      const vector<uint32_t> beams = itsParsets[unit].getUint32Vector("beams", true);
+      target.beams.insert(beams.begin(), beams.end());
+    }
+    // drop trigger
+    ofstream trigger;
+    trigger.open(outms_flag.c_str());
+    trigger.close();
+    flagFiles.push_back(outms_flag);
+    targets.push_back(target);
+  }
+  if (targets.size() < 2) {
+    // nothing to gain, leave it to cacheWorkUnit
+    for (size_t i = 0; i < flagFiles.size(); ++i) {
+      unlink(flagFiles[i].c_str());
+    }
+    return;
+  }
+
+  ASKAPLOG_INFO_STR(logger, "Splitting " << targets.size() << " workunits from " << dataset << " in a single pass");
+  LOFAR::ParameterSet splitParset = firstParset;
+  MSSplitter mySplitter(splitParset);
+  int status = 1;
+  try {
+    status = mySplitter.split(dataset, targets, splitParset);
+  } catch (...) {
+    for (size_t i = 0; i < flagFiles.size(); ++i) {
+      unlink(flagFiles[i].c_str());
+    }
+    throw;
+  }
+  for (size_t i = 0; i < flagFiles.size(); ++i) {
+    unlink(flagFiles[i].c_str());
+  }
+  ASKAPCHECK(status == 0, "Single pass split of " << dataset << " into " << targets.size() <<
+             " workunits failed with status " << status);
+  for (size_t i = 0; i < targets.size(); ++i) {
+    itsPrefetchedFiles.insert(targets[i].outvis);
+  }
+}
+
+void ContinuumWorker::cacheWorkUnit(ContinuumWorkUnit& wu, LOFAR::ParameterSet& unitParset)
+{
+  std::ostringstream pstr;
+
+  pstr << cachedDatasetName(wu, unitParset);
 
   const string outms = pstr.str();
   pstr << ".working";
@@ -350,7 +428,12 @@ void ContinuumWorker::cacheWorkUnit(ContinuumWorkUnit& wu, LOFAR::ParameterSet&
       sleep(1);
     }
     if (stat(outms.c_str(), &buffer) == 0) {
-      ASKAPLOG_WARN_STR(logger, "Split file already exists");
+      if (itsPrefetchedFiles.erase(outms) > 0) {
+        ASKAPLOG_DEBUG_STR(logger, "Using prefetched split file " << outms);
+        this->cached_files.push_back(outms);
+      } else {
+        ASKAPLOG_WARN_STR(logger, "Split file already exists");
+      }
     } else if (stat(outms.c_str(), &buffer) != 0 && stat(outms_flag.c_str(), &buffer) != 0) {
       // file cannot be read
 
@@ -360,8 +443,11 @@ void ContinuumWorker::cacheWorkUnit(ContinuumWorkUnit& wu, LOFAR::ParameterSet&
       trigger.close();
       MSSplitter mySplitter(unitParset);
 
-      mySplitter.split(wu.get_dataset(), outms, wu.get_localChannel() + 1, wu.get_localChannel() + 1, 1, unitParset);
+      const int status = mySplitter.split(wu.get_dataset(), outms, wu.get_localChannel() + 1,
+                                          wu.get_localChannel() + 1, 1, unitParset);
       unlink(outms_flag.c_str());
+      ASKAPCHECK(status == 0, "Splitting channel " << wu.get_localChannel() + 1 << " of " <<
+                 wu.get_dataset() << " into " << outms << " failed with status " << status);
       this->cached_files.push_back(outms);
 
     }
@@ -714,6 +800,8 @@ void ContinuumWorker::processChannels()
   if (workUnits.size() == 0) {
     ASKAPLOG_INFO_STR(logger,"No work todo");
 
+    flushCubes();
+
     // write out the beam log
     ASKAPLOG_INFO_STR(logger, "About to log the full set of restoring beams");
     logBeamInfo();
@@ -803,6 +891,7 @@ void ContinuumWorker::processChannels()
       if (usetmpfs) {
         // probably in spectral line mode
         // copy the caching here ...
+        prefetchWorkUnits(workUnitCount);
         cacheWorkUnit(workUnits[workUnitCount], itsParsets[workUnitCount]);
 
         localChannel = 0;
@@ -931,6 +1020,7 @@ void ContinuumWorker::processChannels()
 
           if (usetmpfs) {
             // probably in spectral line mode
+            prefetchWorkUnits(tempWorkUnitCount);
             cacheWorkUnit(workUnits[tempWorkUnitCount], itsParsets[tempWorkUnitCount]);
 
             localChannel = 0;
@@ -1189,6 +1279,8 @@ void ContinuumWorker::processChannels()
         itsComms.barrier(itsComms.theWorkers());
         ASKAPLOG_INFO_STR(logger, "Rank " << itsComms.rank() << " passed barrier");
 
+        flushCubes();
+
         // write out the beam log
         ASKAPLOG_INFO_STR(logger, "About to log the full set of restoring beams");
         logBeamInfo();
@@ -1418,12 +1510,32 @@ void ContinuumWorker::processChannels()
     }
   }
 
+  flushCubes();
+
   // write out the beam log
   ASKAPLOG_INFO_STR(logger, "About to log the full set of restoring beams");
   logBeamInfo();
 
 }
 
+void ContinuumWorker::flushCubes()
+{
+  const boost::shared_ptr<CubeBuilder<casacore::Float> > floatCubes[] = {itsImageCube, itsPSFCube,
+          itsResidualCube, itsWeightsCube, itsPSFimageCube, itsRestoredCube};
+  for (size_t i = 0; i < sizeof(floatCubes) / sizeof(floatCubes[0]); ++i) {
+    if (floatCubes[i]) {
+      floatCubes[i]->flush();
+    }
+  }
+  const boost::shared_ptr<CubeBuilder<casacore::Complex> > complexCubes[] = {itsPCFCube, itsPSFGridCube,
+          itsGriddedVis};
+  for (size_t i = 0; i < sizeof(complexCubes) / sizeof(complexCubes[0]); ++i) {
+    if (complexCubes[i]) {
+      complexCubes[i]->flush();
+    }
+  }
+}
+
 void ContinuumWorker::copyModel(askap::scimath::Params::ShPtr SourceParams, askap::scimath::Params::ShPtr SinkParams)
 {
   askap::scimath::Params& src = *SourceParams;
@@ -30,6 +30,7 @@
 
 // System includes
 #include <string>
+#include <set>
 
 // ASKAPsoft includes
 #include "boost/shared_ptr.hpp"
@@ -78,8 +79,16 @@ class ContinuumWorker
         // Whether the gridder is a Mosaicking one
         bool itsGridderCanMosaick;
 
+        // files split ahead of time by prefetchWorkUnits which have not been used yet
+        std::set<string> itsPrefetchedFiles;
+
         // Cache a workunit to a different location
         void cacheWorkUnit(ContinuumWorkUnit& wu, LOFAR::ParameterSet& unitParset);
+        // Name of the cached copy of a workunit
+        string cachedDatasetName(const ContinuumWorkUnit& wu, const LOFAR::ParameterSet& unitParset) const;
+        // Cache the given workunit and up to "splitter.fanout"-1 subsequent workunits
+        // sharing its dataset with a single pass over the dataset
+        void prefetchWorkUnits(size_t first);
         // Process a workunit
         void preProcessWorkUnit(ContinuumWorkUnit& wu);
         // Compress all continuous channel allocations into individual workunits
@@ -165,6 +174,11 @@ class ContinuumWorker
         unsigned int itsBeamReferenceChannel;
         void logBeamInfo();
 
+        /// @brief wait for all cubes to be written
+        /// @details Errors of the asynchronous writers are rethrown here rather than
+        /// only being logged when the cubes are destroyed.
+        void flushCubes();
+
 
 };
 
@@ -31,11 +31,19 @@
 
 // System includes
 #include <string>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <type_traits>
 
 // ASKAPsoft includes
 #include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
 #include <Common/ParameterSet.h>
 #include <askap/imageaccess/ImageAccessFactory.h>
+#include <askap/distributedimager/FitsPlaneWriter.h>
 
 
 #include <casacore/images/Images/PagedImage.h>
@@ -47,8 +55,22 @@
 namespace askap {
 namespace cp {
 
+/// @brief builds image cubes from individual channels
+/// @details Slices can optionally be written asynchronously (parset parameter
+/// Images.asyncwrite = true). In this case writeSlice only copies the slice into
+/// a buffer bounded by Images.writebuffer (in MB, default 512) and a background
+/// thread writes the buffered slices, coalescing adjacent channels into a single
+/// write. The buffer is flushed before any metadata are updated and on destruction.
+///
+/// When several writers fill a single FITS cube (singleoutputfile = true with
+/// nwriters > 1), the channel planes are written directly at their offsets in the
+/// file by each writer (see FitsPlaneWriter) rather than serialised through cfitsio.
+/// The cube creator preallocates the full data unit, so the result is identical to
+/// the serially written cube and no cubemerge step is needed. This can be switched
+/// off with Images.parallelwrite = false. Cubes which can't be written this way (e.g.
+/// on a file system without flock) are written through the image accessor.
 template <class T>
-class CubeBuilder {
+class CubeBuilder : public boost::noncopyable {
     public:
         /// Constructor
         CubeBuilder(const LOFAR::ParameterSet& parset,
@@ -64,6 +86,11 @@ class CubeBuilder {
 
         void writeSlice(const casacore::Array<T>& arr, const casacore::uInt chan);
 
+        /// @brief wait until all buffered slices are written
+        /// @details Does nothing in the synchronous mode. Errors encountered
+        /// by the background writer are rethrown here.
+        void flush();
+
         casacore::CoordinateSystem
         createCoordinateSystem(const LOFAR::ParameterSet& parset,
                                const casacore::uInt nx,
@@ -79,9 +106,85 @@ class CubeBuilder {
 
     private:
 
+        /// @brief set up asynchronous and parallel writing if requested in the parset
+        /// @param[in] parset parset
+        /// @param[in] created true if this object has just created the cube
+        void initWriter(const LOFAR::ParameterSet& parset, const bool created);
+
+        /// @brief write an array at the given channel
+        /// @details Goes through the plane writer in the parallel mode
+        void writeArray(const casacore::Array<T>& arr, const casacore::uInt chan);
+
+        /// @brief check whether planes are written directly into a shared FITS cube
+        /// @details The check of the file is done on the first call, which happens after
+        /// the cube has been created for all writers. The result depends on the file only,
+        /// so all writers of the cube come to the same decision.
+        /// @return true if the plane writer is to be used
+        bool parallelWrite();
+
+        /// @brief access the plane writer, opening the cube on first use
+        /// @details Writers which did not create the cube may be constructed before
+        /// the cube exists, so the file is only opened when needed.
+        FitsPlaneWriter& planeWriter();
+
+        /// @brief lock the header against parallel plane writes
+        /// @return lock object, empty unless writing in parallel
+        boost::shared_ptr<FitsPlaneWriter::HeaderLock> headerLock();
+
+        /// @brief background writer thread
+        void writerLoop();
+
+        /// @brief write a block of contiguous channels
+        /// @param[in] slices buffered slices keyed by channel, all contiguous
+        void writeBlock(const std::map<casacore::uInt, casacore::Array<T> >& slices);
 
         boost::shared_ptr<accessors::IImageAccess<T> > itsCube;
 
+        /// @brief true if slices are written by the background thread
+        bool itsAsync;
+
+        /// @brief maximum amount of buffered data in bytes
+        size_t itsBufferBudget;
+
+        /// @brief slices waiting to be written, keyed by channel
+        std::map<casacore::uInt, casacore::Array<T> > itsPending;
+
+        /// @brief amount of buffered data in bytes
+        size_t itsPendingBytes;
+
+        /// @brief true while the writer thread is writing a block
+        bool itsWriting;
+
+        /// @brief true when the writer thread has to finish
+        bool itsStopping;
+
+        /// @brief first error encountered by the writer thread
+        std::exception_ptr itsWriterError;
+
+        /// @brief statistics: bytes written, time spent writing (s), blocks,
+        /// largest number of buffered slices and sum of buffered slices at each write
+        double itsBytesWritten;
+        double itsWriteTime;
+        size_t itsBlocksWritten;
+        size_t itsMaxQueueDepth;
+        size_t itsSumQueueDepth;
+
+        /// @brief true if planes are to be written directly into a shared FITS cube
+        bool itsParallelWrite;
+
+        /// @brief true if the cube can be written directly (see parallelWrite)
+        bool itsParallelWriteSupported;
+
+        /// @brief ensures the cube is checked only once
+        std::once_flag itsParallelWriteChecked;
+
+        /// @brief direct writer for the parallel mode
+        boost::shared_ptr<FitsPlaneWriter> itsPlaneWriter;
+
+        std::thread itsWriterThread;
+        std::mutex itsMutex;
+        std::condition_variable itsPendingChanged;
+
 
     /// Image name from parset - must start with "image."
         std::string itsFilename;
@@ -56,6 +56,7 @@
 #include <casacore/casa/Quanta/MVTime.h>
 #include <casacore/casa/Quanta/Unit.h>
 #include <casacore/casa/Quanta/QC.h>
+#include <casacore/casa/OS/Timer.h>
 
 ASKAP_LOGGER(CubeBuilderLogger, ".CubeBuilder");
 
@@ -210,6 +211,7 @@ CubeBuilder<casacore::Complex>::CubeBuilder(const LOFAR::ParameterSet& parset,co
     ASKAPLOG_INFO_STR(CubeBuilderLogger, "Instantiating Cube Builder by co-opting existing Complex cube");
     boost::shared_ptr<CasaImageAccess<casacore::Complex> > iaCASA(new CasaImageAccess<casacore::Complex>());
     itsCube = iaCASA;
+    initWriter(parset, false);
 }
 
 template <class T>
@@ -243,7 +245,7 @@ CubeBuilder<T>::CubeBuilder(const LOFAR::ParameterSet& parset,const std::string&
 
     ASKAPLOG_INFO_STR(CubeBuilderLogger, "Instantiating Cube Builder co-opting existing cube");
     itsCube = accessors::imageAccessFactory(parset);
-
+    initWriter(parset, false);
 }
 template <> inline
 CubeBuilder<casacore::Complex>::CubeBuilder(const LOFAR::ParameterSet& parset,
@@ -331,6 +333,7 @@ CubeBuilder<casacore::Complex>::CubeBuilder(const LOFAR::ParameterSet& parset,
     itsCube->setUnits(itsFilename,"Jy/pixel");
 
     ASKAPLOG_INFO_STR(CubeBuilderLogger, "Instantiated Cube Builder by creating cube " << itsFilename);
+    initWriter(parset, true);
 }
 
 template <class T>
@@ -418,16 +421,261 @@ CubeBuilder<T>::CubeBuilder(const LOFAR::ParameterSet& parset,
     itsCube->setUnits(itsFilename,"Jy/pixel");
 
     ASKAPLOG_INFO_STR(CubeBuilderLogger, "Instantiated Cube Builder by creating cube " << itsFilename);
+    initWriter(parset, true);
 }
 template < class T >
 CubeBuilder<T>::~CubeBuilder()
 {
+    if (itsAsync) {
+        // flush on close
+        {
+            std::lock_guard<std::mutex> lock(itsMutex);
+            itsStopping = true;
+        }
+        itsPendingChanged.notify_all();
+        itsWriterThread.join();
+        if (itsWriterError) {
+            try {
+                std::rethrow_exception(itsWriterError);
+            } catch (const std::exception &ex) {
+                ASKAPLOG_ERROR_STR(CubeBuilderLogger, "Asynchronous write to " << itsFilename <<
+                                   " failed: " << ex.what());
+            } catch (...) {
+                ASKAPLOG_ERROR_STR(CubeBuilderLogger, "Asynchronous write to " << itsFilename <<
+                                   " failed with an unknown exception");
+            }
+        }
+        if (itsBlocksWritten > 0) {
+            ASKAPLOG_INFO_STR(CubeBuilderLogger, "Asynchronous writer for " << itsFilename << " wrote " <<
+                              itsBytesWritten / 1048576. << " MB in " << itsBlocksWritten << " blocks at " <<
+                              (itsWriteTime > 0 ? itsBytesWritten / 1048576. / itsWriteTime : 0.) <<
+                              " MB/s, queue depth: mean " << double(itsSumQueueDepth) / itsBlocksWritten <<
+                              " max " << itsMaxQueueDepth << " slices");
+        }
+    }
+}
+
+/// @brief write planes of a float cube with the direct writer
+inline void writeFitsPlanes(FitsPlaneWriter& writer, const casacore::Array<casacore::Float>& arr,
+                            const casacore::uInt chan)
+{
+    writer.write(arr, chan);
 }
+
+/// @brief other pixel types are not supported by the direct writer
+template < class T >
+void writeFitsPlanes(FitsPlaneWriter&, const casacore::Array<T>&, const casacore::uInt)
+{
+    ASKAPTHROW(AskapError, "Parallel writing is only supported for float cubes");
+}
+
+template < class T >
+void CubeBuilder<T>::initWriter(const LOFAR::ParameterSet& parset, const bool created)
+{
+    // several writers filling one FITS cube write their planes directly into the file
+    const bool singleCube = parset.getInt32("nwriters", 1) > 1 && parset.getBool("singleoutputfile", false);
+    itsParallelWriteSupported = false;
+    itsParallelWrite = parset.getBool("Images.parallelwrite", singleCube) &&
+                       std::is_same<T, casacore::Float>::value &&
+                       parset.getString("imagetype", "casa") == "fits";
+    if (itsParallelWrite) {
+        // other writers are constructed before the creator has written the cube, they
+        // decide on first use (see parallelWrite) when the file is complete
+        if (created && parallelWrite()) {
+            planeWriter().preallocate();
+        }
+    } else if (singleCube && parset.getString("imagetype", "casa") != "fits") {
+        ASKAPLOG_DEBUG_STR(CubeBuilderLogger, "Writers of " << itsFilename <<
+                           " share the cube through the image accessor");
+    }
+
+    itsAsync = parset.getBool("Images.asyncwrite", false);
+    itsBufferBudget = size_t(parset.getUint32("Images.writebuffer", 512)) * 1048576;
+    itsPendingBytes = 0;
+    itsWriting = false;
+    itsStopping = false;
+    itsBytesWritten = 0.;
+    itsWriteTime = 0.;
+    itsBlocksWritten = 0;
+    itsMaxQueueDepth = 0;
+    itsSumQueueDepth = 0;
+    if (itsAsync) {
+        ASKAPLOG_INFO_STR(CubeBuilderLogger, "Slices of " << itsFilename <<
+                          " will be written asynchronously, buffer size " << itsBufferBudget / 1048576 << " MB");
+        itsWriterThread = std::thread(&CubeBuilder<T>::writerLoop, this);
+    }
+}
+
 template < class T >
 void CubeBuilder<T>::writeSlice(const casacore::Array<T>& arr, const casacore::uInt chan)
 {
-    casacore::IPosition where(4, 0, 0, 0, chan);
-    itsCube->write(itsFilename,arr, where);
+    if (!itsAsync) {
+        writeArray(arr, chan);
+        return;
+    }
+    // the caller is free to reuse the array, so take a deep copy
+    const casacore::Array<T> slice = arr.copy();
+    const size_t nBytes = slice.nelements() * sizeof(T);
+    std::unique_lock<std::mutex> lock(itsMutex);
+    // always accept a slice into an empty buffer, otherwise wait for space
+    itsPendingChanged.wait(lock, [&]{ return itsWriterError || itsPending.empty() ||
+                                      itsPendingBytes + nBytes <= itsBufferBudget; });
+    if (itsWriterError) {
+        std::rethrow_exception(itsWriterError);
+    }
+    if (itsPending.find(chan) != itsPending.end()) {
+        // a newer version of the same channel replaces the buffered one
+        itsPendingBytes -= itsPending[chan].nelements() * sizeof(T);
+    }
+    itsPending[chan] = slice;
+    itsPendingBytes += nBytes;
+    itsMaxQueueDepth = std::max(itsMaxQueueDepth, itsPending.size());
+    lock.unlock();
+    itsPendingChanged.notify_all();
+}
+
+template < class T >
+void CubeBuilder<T>::flush()
+{
+    if (!itsAsync) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(itsMutex);
+    itsPendingChanged.wait(lock, [this]{ return itsWriterError || (itsPending.empty() && !itsWriting); });
+    if (itsWriterError) {
+        std::rethrow_exception(itsWriterError);
+    }
+}
+
+template < class T >
+void CubeBuilder<T>::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(itsMutex);
+    while (true) {
+        itsPendingChanged.wait(lock, [this]{ return itsStopping || !itsPending.empty(); });
+        if (itsPending.empty()) {
+            // stopping and nothing left to write
+            break;
+        }
+        // take the first run of contiguous channels
+        std::map<casacore::uInt, casacore::Array<T> > block;
+        size_t blockBytes = 0;
+        const size_t queueDepth = itsPending.size();
+        typename std::map<casacore::uInt, casacore::Array<T> >::iterator it = itsPending.begin();
+        const casacore::IPosition sliceShape = it->second.shape();
+        for (casacore::uInt chan = it->first; it != itsPending.end() && it->first == chan &&
+             it->second.shape().isEqual(sliceShape); ++chan) {
+            blockBytes += it->second.nelements() * sizeof(T);
+            block.insert(*it);
+            itsPending.erase(it++);
+        }
+        itsWriting = true;
+        lock.unlock();
+
+        try {
+            casacore::Timer timer;
+            timer.mark();
+            writeBlock(block);
+            const double elapsed = timer.real();
+            lock.lock();
+            itsWriteTime += elapsed;
+            itsBytesWritten += blockBytes;
+            ++itsBlocksWritten;
+            itsSumQueueDepth += queueDepth;
+            ASKAPLOG_DEBUG_STR(CubeBuilderLogger, "Wrote " << block.size() << " channel(s) starting at " <<
+                               block.begin()->first << " into " << itsFilename << " at " <<
+                               (elapsed > 0 ? blockBytes / 1048576. / elapsed : 0.) << " MB/s, " <<
+                               queueDepth << " slice(s) were queued");
+        } catch (...) {
+            lock.lock();
+            itsWriterError = std::current_exception();
+            itsPending.clear();
+        }
+        itsPendingBytes -= std::min(itsPendingBytes, blockBytes);
+        itsWriting = false;
+        itsPendingChanged.notify_all();
+        if (itsWriterError) {
+            break;
+        }
+    }
+}
+
+template < class T >
+void CubeBuilder<T>::writeBlock(const std::map<casacore::uInt, casacore::Array<T> >& slices)
+{
+    ASKAPDEBUGASSERT(slices.size() > 0);
+    const casacore::Array<T>& first = slices.begin()->second;
+    if (slices.size() == 1 || first.ndim() != 4 || first.shape()(3) != 1) {
+        // nothing to coalesce
+        for (typename std::map<casacore::uInt, casacore::Array<T> >::const_iterator it = slices.begin();
+             it != slices.end(); ++it) {
+            writeArray(it->second, it->first);
+        }
+        return;
+    }
+    casacore::IPosition blockShape = first.shape();
+    blockShape(3) = slices.size();
+    casacore::Array<T> buffer(blockShape);
+    casacore::IPosition blc(4, 0);
+    casacore::IPosition trc = blockShape - 1;
+    casacore::uInt plane = 0;
+    for (typename std::map<casacore::uInt, casacore::Array<T> >::const_iterator it = slices.begin();
+         it != slices.end(); ++it, ++plane) {
+        blc(3) = trc(3) = plane;
+        buffer(blc, trc) = it->second;
+    }
+    writeArray(buffer, slices.begin()->first);
+}
+
+template < class T >
+void CubeBuilder<T>::writeArray(const casacore::Array<T>& arr, const casacore::uInt chan)
+{
+    if (parallelWrite()) {
+        writeFitsPlanes(planeWriter(), arr, chan);
+    } else {
+        const casacore::IPosition where(4, 0, 0, 0, chan);
+        itsCube->write(itsFilename, arr, where);
+    }
+}
+
+template < class T >
+bool CubeBuilder<T>::parallelWrite()
+{
+    if (!itsParallelWrite) {
+        return false;
+    }
+    // the writer thread and the main thread may get here first
+    std::call_once(itsParallelWriteChecked, [this]() {
+        itsParallelWriteSupported = FitsPlaneWriter::isSupported(itsFilename);
+        if (itsParallelWriteSupported) {
+            ASKAPLOG_INFO_STR(CubeBuilderLogger, "Channel planes of " << itsFilename <<
+                              " will be written directly into the shared FITS cube");
+        } else {
+            ASKAPLOG_WARN_STR(CubeBuilderLogger, "Unable to write planes directly into " << itsFilename <<
+                              ", falling back to the image accessor");
+        }
+    });
+    return itsParallelWriteSupported;
+}
+
+template < class T >
+FitsPlaneWriter& CubeBuilder<T>::planeWriter()
+{
+    ASKAPDEBUGASSERT(itsParallelWrite && itsParallelWriteSupported);
+    if (!itsPlaneWriter) {
+        itsPlaneWriter.reset(new FitsPlaneWriter(itsFilename, itsCube->shape(itsFilename)));
+    }
+    return *itsPlaneWriter;
+}
+
+template < class T >
+boost::shared_ptr<FitsPlaneWriter::HeaderLock> CubeBuilder<T>::headerLock()
+{
+    boost::shared_ptr<FitsPlaneWriter::HeaderLock> lock;
+    if (parallelWrite()) {
+        lock.reset(new FitsPlaneWriter::HeaderLock(planeWriter()));
+    }
+    return lock;
 }
 
 template < class T >
@@ -524,18 +772,25 @@ CubeBuilder<T>::createCoordinateSystem(const LOFAR::ParameterSet& parset,
 template <class T>
 void CubeBuilder<T>::addBeam(casacore::Vector<casacore::Quantum<double> > &beam)
 {
+        flush();
+        const boost::shared_ptr<FitsPlaneWriter::HeaderLock> lock = headerLock();
         itsCube->setBeamInfo(itsFilename,beam[0].getValue("rad"),beam[1].getValue("rad"),beam[2].getValue("rad"));
-        setUnits("Jy/beam");
+        // not via setUnits, the header lock is already held
+        itsCube->setUnits(itsFilename,"Jy/beam");
 }
 template <class T>
 void CubeBuilder<T>::setUnits(const std::string &units)
 {
+    flush();
+    const boost::shared_ptr<FitsPlaneWriter::HeaderLock> lock = headerLock();
     itsCube->setUnits(itsFilename,units);
 }
 
 template <class T>
 void CubeBuilder<T>::setDateObs(const casacore::MVEpoch &dateObs)
 {
+    flush();
+    const boost::shared_ptr<FitsPlaneWriter::HeaderLock> lock = headerLock();
     String date, timesys;
     casacore::FITSDateUtil::toFITS(date, timesys, casacore::MVTime(dateObs));
     itsCube->setMetadataKeyword(itsFilename,"DATE-OBS", date, "Date of observation");
@@ -0,0 +1,269 @@
+/// @file FitsPlaneWriter.cc
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+// Include own header file first
+#include <askap/distributedimager/FitsPlaneWriter.h>
+
+// System includes
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+// ASKAPsoft includes
+#include <askap/askap/AskapError.h>
+#include <askap/askap/AskapLogging.h>
+#include <casacore/casa/OS/CanonicalConversion.h>
+
+ASKAP_LOGGER(logger, ".FitsPlaneWriter");
+
+using namespace askap::cp;
+
+namespace {
+
+/// @brief FITS block size in bytes
+const size_t fitsBlock = 2880;
+
+/// @brief FITS header card size in bytes
+const size_t fitsCard = 80;
+
+/// @brief resolve the name of the file on disk
+/// @details The FITS image accessor appends ".fits" to the image name
+std::string fitsFileName(const std::string &name)
+{
+    struct stat buf;
+    if (stat(name.c_str(), &buf) == 0 || name.size() < 5 || name.substr(name.size() - 5) == ".fits") {
+        return name;
+    }
+    return name + ".fits";
+}
+
+/// @brief read exactly the requested number of bytes at the given offset
+/// @return false if the end of file was reached
+bool readAt(int fd, char *buf, size_t size, off_t offset)
+{
+    while (size > 0) {
+        const ssize_t done = pread(fd, buf, size, offset);
+        if (done < 0 && errno == EINTR) {
+            continue;
+        }
+        ASKAPCHECK(done >= 0, "Read failed: " << strerror(errno));
+        if (done == 0) {
+            return false;
+        }
+        buf += done;
+        size -= done;
+        offset += done;
+    }
+    return true;
+}
+
+/// @brief extract the keyword name of a header card
+std::string cardKeyword(const char *card)
+{
+    std::string key(card, 8);
+    return key.substr(0, key.find_last_not_of(' ') + 1);
+}
+
+/// @brief extract a numeric value of a header card
+double cardValue(const char *card)
+{
+    const std::string value(card + 10, fitsCard - 10);
+    return std::strtod(value.c_str(), 0);
+}
+
+/// @brief RAII wrapper around flock
+class FileLock {
+public:
+    FileLock(int fd, int operation) : itsFD(fd)
+    {
+        while (flock(itsFD, operation) != 0) {
+            ASKAPCHECK(errno == EINTR, "Unable to lock the file: " << strerror(errno));
+        }
+    }
+    ~FileLock() { flock(itsFD, LOCK_UN); }
+private:
+    const int itsFD;
+};
+
+} // anonymous namespace
+
+FitsPlaneWriter::FitsPlaneWriter(const std::string &name, const casacore::IPosition &shape) :
+    itsName(fitsFileName(name)), itsFD(-1), itsPlaneSize(0), itsNChan(0)
+{
+    ASKAPCHECK(shape.nelements() > 1, "Cube shape should have at least two axes, you have " << shape);
+    itsFD = open(itsName.c_str(), O_RDWR);
+    ASKAPCHECK(itsFD >= 0, "Unable to open " << itsName << " for parallel writing: " << strerror(errno));
+
+    // check that the layout of the primary array is what we expect
+    FileLock lock(itsFD, LOCK_SH);
+    std::vector<char> block(fitsBlock);
+    std::vector<long> naxis;
+    int bitpix = 0;
+    double bscale = 1.;
+    double bzero = 0.;
+    bool foundEnd = false;
+    for (off_t offset = 0; !foundEnd; offset += fitsBlock) {
+        ASKAPCHECK(readAt(itsFD, block.data(), fitsBlock, offset), "Unexpected end of file in the header of " << itsName);
+        for (size_t card = 0; card < fitsBlock && !foundEnd; card += fitsCard) {
+            const std::string key = cardKeyword(&block[card]);
+            if (key == "END") {
+                foundEnd = true;
+            } else if (key == "BITPIX") {
+                bitpix = static_cast<int>(cardValue(&block[card]));
+            } else if (key == "NAXIS") {
+                naxis.resize(static_cast<size_t>(cardValue(&block[card])), 0);
+            } else if (key.compare(0, 5, "NAXIS") == 0) {
+                const size_t axis = std::atoi(key.c_str() + 5);
+                ASKAPCHECK(axis >= 1 && axis <= naxis.size(), "Unexpected keyword " << key << " in " << itsName);
+                naxis[axis - 1] = static_cast<long>(cardValue(&block[card]));
+            } else if (key == "BSCALE") {
+                bscale = cardValue(&block[card]);
+            } else if (key == "BZERO") {
+                bzero = cardValue(&block[card]);
+            }
+        }
+    }
+    ASKAPCHECK(bitpix == -32, "Parallel writing requires BITPIX=-32, " << itsName << " has " << bitpix);
+    ASKAPCHECK(bscale == 1. && bzero == 0., "Parallel writing does not support scaled data in " << itsName);
+    ASKAPCHECK(naxis.size() == shape.nelements(), "Number of axes in " << itsName << " (" << naxis.size() <<
+               ") does not match the cube shape " << shape);
+    for (size_t axis = 0; axis < naxis.size(); ++axis) {
+        ASKAPCHECK(naxis[axis] == shape(axis), "Axis " << axis + 1 << " of " << itsName << " has length " <<
+                   naxis[axis] << ", expected cube shape is " << shape);
+    }
+    itsNChan = shape(shape.nelements() - 1);
+    itsPlaneSize = shape.product() / itsNChan;
+    ASKAPLOG_DEBUG_STR(logger, "Opened " << itsName << " for parallel writing of " << itsNChan <<
+                       " planes of " << itsPlaneSize << " pixels");
+}
+
+FitsPlaneWriter::~FitsPlaneWriter()
+{
+    if (itsFD >= 0) {
+        if (close(itsFD) != 0) {
+            ASKAPLOG_WARN_STR(logger, "Error closing " << itsName << ": " << strerror(errno));
+        }
+    }
+}
+
+bool FitsPlaneWriter::isSupported(const std::string &name)
+{
+    const std::string fileName = fitsFileName(name);
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<char> block(fitsBlock);
+    bool result = readAt(fd, block.data(), fitsBlock, 0) &&
+                  cardKeyword(&block[0]) == "SIMPLE" && cardKeyword(&block[fitsCard]) == "BITPIX" &&
+                  static_cast<int>(cardValue(&block[fitsCard])) == -32;
+    if (result) {
+        // some parallel file systems are mounted without flock support (ENOSYS or EINVAL)
+        int status;
+        while ((status = flock(fd, LOCK_SH)) != 0 && errno == EINTR) {}
+        if (status == 0) {
+            flock(fd, LOCK_UN);
+        } else {
+            ASKAPLOG_WARN_STR(logger, "File locking is not available for " << fileName << ": " << strerror(errno));
+            result = false;
+        }
+    }
+    close(fd);
+    return result;
+}
+
+off_t FitsPlaneWriter::dataOffset() const
+{
+    std::vector<char> block(fitsBlock);
+    for (off_t offset = 0; readAt(itsFD, block.data(), fitsBlock, offset); offset += fitsBlock) {
+        for (size_t card = 0; card < fitsBlock; card += fitsCard) {
+            if (cardKeyword(&block[card]) == "END") {
+                return offset + fitsBlock;
+            }
+        }
+    }
+    ASKAPTHROW(AskapError, "No END card found in the header of " << itsName);
+}
+
+void FitsPlaneWriter::preallocate()
+{
+    FileLock lock(itsFD, LOCK_EX);
+    const off_t dataSize = static_cast<off_t>(itsPlaneSize * itsNChan * sizeof(float));
+    const off_t fileSize = (dataOffset() + dataSize + fitsBlock - 1) / fitsBlock * fitsBlock;
+    struct stat buf;
+    ASKAPCHECK(fstat(itsFD, &buf) == 0, "Unable to stat " << itsName << ": " << strerror(errno));
+    if (buf.st_size < fileSize) {
+        ASKAPCHECK(ftruncate(itsFD, fileSize) == 0, "Unable to preallocate " << itsName << ": " << strerror(errno));
+    }
+}
+
+void FitsPlaneWriter::write(const casacore::Array<float> &arr, const casacore::uInt chan)
+{
+    ASKAPCHECK(arr.nelements() % itsPlaneSize == 0, "Parallel writer expects whole planes of " << itsPlaneSize <<
+               " pixels, got an array of shape " << arr.shape());
+    const size_t nPlanes = arr.nelements() / itsPlaneSize;
+    ASKAPCHECK(chan + nPlanes <= itsNChan, "Channels " << chan << " to " << chan + nPlanes - 1 <<
+               " are outside the cube with " << itsNChan << " channels");
+
+    // convert to big-endian IEEE as stored in FITS
+    itsBuffer.resize(arr.nelements() * sizeof(float));
+    bool deleteIt;
+    const float *data = arr.getStorage(deleteIt);
+    casacore::CanonicalConversion::fromLocal(itsBuffer.data(), data, arr.nelements());
+    arr.freeStorage(data, deleteIt);
+
+    FileLock lock(itsFD, LOCK_SH);
+    off_t offset = dataOffset() + static_cast<off_t>(chan * itsPlaneSize * sizeof(float));
+    const char *buf = itsBuffer.data();
+    size_t size = itsBuffer.size();
+    while (size > 0) {
+        const ssize_t done = pwrite(itsFD, buf, size, offset);
+        if (done < 0 && errno == EINTR) {
+            continue;
+        }
+        ASKAPCHECK(done > 0, "Write of channel " << chan << " into " << itsName << " failed: " << strerror(errno));
+        buf += done;
+        size -= done;
+        offset += done;
+    }
+}
+
+FitsPlaneWriter::HeaderLock::HeaderLock(const FitsPlaneWriter &writer) : itsFD(writer.itsFD)
+{
+    while (flock(itsFD, LOCK_EX) != 0) {
+        ASKAPCHECK(errno == EINTR, "Unable to lock " << writer.itsName << ": " << strerror(errno));
+    }
+}
+
+FitsPlaneWriter::HeaderLock::~HeaderLock()
+{
+    flock(itsFD, LOCK_UN);
+}
@@ -0,0 +1,118 @@
+/// @file FitsPlaneWriter.h
+///
+/// Class to write channel planes directly into a preallocated FITS cube
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+#ifndef ASKAP_CP_SIMAGER_FITSPLANEWRITER_H
+#define ASKAP_CP_SIMAGER_FITSPLANEWRITER_H
+
+// System includes
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// ASKAPsoft includes
+#include <boost/noncopyable.hpp>
+#include <casacore/casa/Arrays/Array.h>
+#include <casacore/casa/Arrays/IPosition.h>
+
+namespace askap {
+namespace cp {
+
+/// @brief writes channel planes of a float FITS cube at their byte offsets
+/// @details This class allows several processes to fill one FITS cube in parallel.
+/// The cube has to be created first (with the header and the full data unit), then
+/// every writer opens it with this class and writes whole planes directly at
+/// offset header size + channel * plane size, without going through cfitsio.
+/// The data are converted to big-endian IEEE floats exactly as cfitsio does for
+/// BITPIX = -32, so the file is byte-identical to one written serially.
+///
+/// Header updates done through the image accessor (e.g. beam or units) may grow
+/// the header and move the data unit. Such updates have to be wrapped into
+/// HeaderLock, which takes an exclusive lock on the file. Plane writes hold a
+/// shared lock and re-read the header size, so they never race with a header update.
+class FitsPlaneWriter : public boost::noncopyable {
+    public:
+        /// @brief open an existing FITS cube
+        /// @param[in] name file name (".fits" is appended if the name does not exist)
+        /// @param[in] shape expected shape of the cube, the last axis is the channel
+        FitsPlaneWriter(const std::string &name, const casacore::IPosition &shape);
+
+        /// @brief close the file
+        ~FitsPlaneWriter();
+
+        /// @brief check whether the given image can be written by this class
+        /// @param[in] name file name (".fits" is appended if the name does not exist)
+        /// @return true if the file is a FITS file with a float primary array on a file
+        /// system which supports flock
+        static bool isSupported(const std::string &name);
+
+        /// @brief extend the file to hold the full data unit
+        /// @details Pads the file with zeros up to the end of the data unit rounded up
+        /// to the FITS block size, as cfitsio does when the file is closed. After this
+        /// call the size of the file does not depend on the order of plane writes.
+        void preallocate();
+
+        /// @brief write one or more contiguous channel planes
+        /// @param[in] arr array with whole planes, the last axis runs over channels
+        /// @param[in] chan first channel to write
+        void write(const casacore::Array<float> &arr, const casacore::uInt chan);
+
+        /// @brief exclusive lock for header updates
+        /// @details Keep the object alive while the header is being changed by another
+        /// library, e.g. when the beam or units are set via the image accessor.
+        class HeaderLock : public boost::noncopyable {
+            public:
+                explicit HeaderLock(const FitsPlaneWriter &writer);
+                ~HeaderLock();
+            private:
+                const int itsFD;
+        };
+
+    private:
+        /// @brief parse the header
+        /// @return offset of the data unit in bytes
+        /// @note the caller should hold a lock on the file
+        off_t dataOffset() const;
+
+        /// @brief resolved file name
+        std::string itsName;
+
+        /// @brief file descriptor
+        int itsFD;
+
+        /// @brief number of pixels in one channel plane
+        size_t itsPlaneSize;
+
+        /// @brief number of channels
+        size_t itsNChan;
+
+        /// @brief conversion buffer
+        std::vector<char> itsBuffer;
+};
+
+}
+}
+
+#endif
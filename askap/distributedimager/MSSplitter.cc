@@ -35,6 +35,9 @@
 #include <utility>
 #include <limits>
 #include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <exception>
 
 // ASKAPsoft includes
 #include <askap/askap/AskapError.h>
@@ -43,6 +46,7 @@
 #include <askap/askap/AskapUtil.h>
 #include <askap/askap/StatReporter.h>
 #include <askap/askap/Log4cxxLogSink.h>
+#include <askap/utils/BoundedQueue.h>
 #include <boost/shared_ptr.hpp>
 #include <Common/ParameterSet.h>
 #include <casacore/casa/OS/File.h>
@@ -51,6 +55,7 @@
 #include <casacore/casa/Arrays/Slicer.h>
 #include <casacore/casa/Arrays/Array.h>
 #include <casacore/casa/Arrays/Vector.h>
+#include <casacore/casa/Arrays/Matrix.h>
 #include <casacore/casa/Arrays/Cube.h>
 #include <casacore/casa/Quanta/MVTime.h>
 #include <casacore/tables/Tables/TableDesc.h>
@@ -471,8 +476,17 @@ bool MSSplitter::rowIsFiltered(uint32_t scanid, uint32_t fieldid,
                                uint32_t feed1, uint32_t feed2,
                                double time) const
 {
+    return rowIsFiltered(scanid, fieldid, feed1, feed2, time, itsBeams);
+}
+
+bool MSSplitter::rowIsFiltered(uint32_t scanid, uint32_t fieldid,
+                               uint32_t feed1, uint32_t feed2,
+                               double time, const std::set<uint32_t>& beams) const
+{
+    const std::set<uint32_t>& selectedBeams = beams.empty() ? itsBeams : beams;
+
     // Include all rows if no filters exist
-    if (!rowFiltersExist()) return false;
+    if (!rowFiltersExist() && selectedBeams.empty()) return false;
 
     if (time < itsTimeBegin || time > itsTimeEnd) return true;
 
@@ -480,9 +494,9 @@ bool MSSplitter::rowIsFiltered(uint32_t scanid, uint32_t fieldid,
 
     if (!itsFieldIds.empty() && itsFieldIds.find(fieldid) == itsFieldIds.end()) return true;
 
-    if (!itsBeams.empty()) {
-        if (itsBeams.find(feed1) == itsBeams.end() ||
-            itsBeams.find(feed2) == itsBeams.end()) {
+    if (!selectedBeams.empty()) {
+        if (selectedBeams.find(feed1) == selectedBeams.end() ||
+            selectedBeams.find(feed2) == selectedBeams.end()) {
             // beam not found in any element of row
             return true;
         }
@@ -674,44 +688,14 @@ void MSSplitter::splitMainTable(const casacore::MeasurementSet& source,
             }
 
             // Create the output data/flag/sigma
-            casacore::Cube<casacore::Complex> outdata(nPol, nChanOut, nRowsThisIteration);
-            casacore::Cube<casacore::Bool> outflag(nPol, nChanOut, nRowsThisIteration);
+            casacore::Cube<casacore::Complex> outdata;
+            casacore::Cube<casacore::Bool> outflag;
             // This is only needed if generating sigmaSpectra, but that should be the
-            // case with width>1, and this avoids testing in the tight loops below
-            casacore::Cube<casacore::Float> outsigma(nPol, nChanOut, nRowsThisIteration);
+            // case with width>1, and this avoids testing in the tight loops
+            casacore::Cube<casacore::Float> outsigma;
 
             // Average data and combine flag information
-            for (uInt pol = 0; pol < nPol; ++pol) {
-                for (uInt destChan = 0; destChan < nChanOut; ++destChan) {
-                    for (uInt r = 0; r < nRowsThisIteration; ++r) {
-                        casacore::Complex sum(0.0, 0.0);
-                        casacore::Float varsum = 0.0;
-                        casacore::uInt sumcount = 0;
-
-                        // Starting at the appropriate offset into the source data, average "width"
-                        // channels together
-                        for (uInt i = (destChan * width); i < (destChan * width) + width; ++i) {
-                            ASKAPDEBUGASSERT(i < nChanIn);
-                            if (inflag(pol, i, r)) continue;
-                            sum += indata(pol, i, r);
-                            varsum += insigma(pol, i, r) * insigma(pol, i, r);
-                            sumcount++;
-                        }
-
-                        // Now the input channels have been averaged, write the data to
-                        // the output cubes
-                        if (sumcount > 0) {
-                            outdata(pol, destChan, r) = casacore::Complex(sum.real() / sumcount,
-                                                                      sum.imag() / sumcount);
-                            outflag(pol, destChan, r) = false;
-                            outsigma(pol, destChan, r) = sqrt(varsum) / sumcount;
-                        } else {
-                            outflag(pol, destChan, r) = true;
-                        }
-
-                    }
-                }
-            }
+            averageChannels(indata, inflag, insigma, width, outdata, outflag, outsigma);
 
             // Put (write) the output data/flag
             dc.data().putColumnRange(dstrowslicer, destarrslicer, outdata);
@@ -767,9 +751,27 @@ int MSSplitter::split(const std::string& invis, const std::string& outvis,
         return 1;
     }
 
+    SplitTarget target;
+    target.outvis = outvis;
+    target.startChan = startChan;
+    target.endChan = endChan;
+    target.width = width;
+    boost::shared_ptr<casacore::MeasurementSet> out = createAndCopySubtables(in, target, parset);
+
+    // Split main table
+    ASKAPLOG_DEBUG_STR(logger,  "Splitting main table");
+    splitMainTable(in, *out, startChan, endChan, width);
+
+    return 0;
+}
+
+boost::shared_ptr<casacore::MeasurementSet> MSSplitter::createAndCopySubtables(
+        const casacore::MeasurementSet& in, const SplitTarget& target,
+        const LOFAR::ParameterSet& parset)
+{
     // Add a sigma spectrum to the output measurement set?
     casacore::Bool addSigmaSpec = false;
-    if ((width > 1) || in.isColumn(MS::SIGMA_SPECTRUM)) {
+    if ((target.width > 1) || in.isColumn(MS::SIGMA_SPECTRUM)) {
         addSigmaSpec = true;
     }
 
@@ -778,7 +780,7 @@ int MSSplitter::split(const std::string& invis, const std::string& outvis,
     const casacore::uInt tileNchan = parset.getUint32("stman.tilenchan", 1);
 
     boost::shared_ptr<casacore::MeasurementSet>
-        out(create(outvis, addSigmaSpec, bucketSize, tileNcorr, tileNchan));
+        out(create(target.outvis, addSigmaSpec, bucketSize, tileNcorr, tileNchan));
 
     // Copy ANTENNA
     ASKAPLOG_DEBUG_STR(logger,  "Copying ANTENNA table");
@@ -813,12 +815,393 @@ int MSSplitter::split(const std::string& invis, const std::string& outvis,
 
     // Split SPECTRAL_WINDOW
     ASKAPLOG_DEBUG_STR(logger,  "Splitting SPECTRAL_WINDOW table");
-    splitSpectralWindow(in, *out, startChan, endChan, width, spwId);
+    splitSpectralWindow(in, *out, target.startChan, target.endChan, target.width, spwId);
 
-    // Split main table
-    ASKAPLOG_DEBUG_STR(logger,  "Splitting main table");
-    splitMainTable(in, *out, startChan, endChan, width);
+    return out;
+}
+
+void MSSplitter::averageChannels(const casacore::Cube<casacore::Complex>& indata,
+                                 const casacore::Cube<casacore::Bool>& inflag,
+                                 const casacore::Cube<casacore::Float>& insigma,
+                                 const uint32_t width,
+                                 casacore::Cube<casacore::Complex>& outdata,
+                                 casacore::Cube<casacore::Bool>& outflag,
+                                 casacore::Cube<casacore::Float>& outsigma)
+{
+    const uInt nPol = indata.nrow();
+    const uInt nChanIn = indata.ncolumn();
+    const uInt nChanOut = nChanIn / width;
+    const uInt nRows = indata.nplane();
+    outdata.resize(nPol, nChanOut, nRows);
+    outflag.resize(nPol, nChanOut, nRows);
+    outsigma.resize(nPol, nChanOut, nRows);
+
+    for (uInt pol = 0; pol < nPol; ++pol) {
+        for (uInt destChan = 0; destChan < nChanOut; ++destChan) {
+            for (uInt r = 0; r < nRows; ++r) {
+                casacore::Complex sum(0.0, 0.0);
+                casacore::Float varsum = 0.0;
+                casacore::uInt sumcount = 0;
+
+                // Starting at the appropriate offset into the source data, average "width"
+                // channels together
+                for (uInt i = (destChan * width); i < (destChan * width) + width; ++i) {
+                    ASKAPDEBUGASSERT(i < nChanIn);
+                    if (inflag(pol, i, r)) continue;
+                    sum += indata(pol, i, r);
+                    varsum += insigma(pol, i, r) * insigma(pol, i, r);
+                    sumcount++;
+                }
+
+                // Now the input channels have been averaged, write the data to
+                // the output cubes
+                if (sumcount > 0) {
+                    outdata(pol, destChan, r) = casacore::Complex(sum.real() / sumcount,
+                                                              sum.imag() / sumcount);
+                    outflag(pol, destChan, r) = false;
+                    outsigma(pol, destChan, r) = sqrt(varsum) / sumcount;
+                } else {
+                    outflag(pol, destChan, r) = true;
+                }
+            }
+        }
+    }
+}
+
+/// @brief block of rows read from the input by a single pass split
+/// @details The block is filled by the reader and shared read-only between
+/// all writer threads. Visibility cubes cover the union of the channel ranges
+/// of all outputs.
+struct MSSplitter::SourceBlock {
+    casacore::Vector<casacore::Int> scanNumber;
+    casacore::Vector<casacore::Int> fieldId;
+    casacore::Vector<casacore::Int> dataDescId;
+    casacore::Vector<casacore::Double> time;
+    casacore::Vector<casacore::Double> timeCentroid;
+    casacore::Vector<casacore::Int> arrayId;
+    casacore::Vector<casacore::Int> processorId;
+    casacore::Vector<casacore::Double> exposure;
+    casacore::Vector<casacore::Double> interval;
+    casacore::Vector<casacore::Int> observationId;
+    casacore::Vector<casacore::Int> antenna1;
+    casacore::Vector<casacore::Int> antenna2;
+    casacore::Vector<casacore::Int> feed1;
+    casacore::Vector<casacore::Int> feed2;
+    casacore::Matrix<casacore::Double> uvw;
+    casacore::Vector<casacore::Bool> flagRow;
+    casacore::Matrix<casacore::Float> weight;
+    casacore::Matrix<casacore::Float> sigma;
+    casacore::Cube<casacore::Complex> data;
+    casacore::Cube<casacore::Bool> flag;
+    /// @brief empty if the input has no SIGMA_SPECTRUM column
+    casacore::Cube<casacore::Float> sigmaSpectrum;
+};
+
+namespace {
+
+/// @brief select rows (the last axis) of an array
+/// @param[in] in input array
+/// @param[in] rows row indices to select
+/// @return array with the selected rows, a reference to the input if all rows are selected
+template<typename T>
+casacore::Array<T> selectRows(const casacore::Array<T>& in, const std::vector<casacore::uInt>& rows)
+{
+    const casacore::uInt lastAxis = in.ndim() - 1;
+    if (rows.size() == casacore::uInt(in.shape()(lastAxis))) {
+        return in;
+    }
+    casacore::IPosition outShape = in.shape();
+    outShape(lastAxis) = rows.size();
+    casacore::Array<T> out(outShape);
+    casacore::IPosition inStart(in.ndim(), 0);
+    casacore::IPosition inEnd = in.shape() - 1;
+    casacore::IPosition outStart(in.ndim(), 0);
+    casacore::IPosition outEnd = outShape - 1;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        inStart(lastAxis) = inEnd(lastAxis) = rows[i];
+        outStart(lastAxis) = outEnd(lastAxis) = i;
+        out(outStart, outEnd) = in(inStart, inEnd);
+    }
+    return out;
+}
+
+} // anonymous namespace
+
+void MSSplitter::writeBlock(const SourceBlock& block, const SplitTarget& target,
+                            casacore::MeasurementSet& dest, const uint32_t firstChan) const
+{
+    std::vector<casacore::uInt> rows;
+    rows.reserve(block.time.nelements());
+    for (casacore::uInt row = 0; row < block.time.nelements(); ++row) {
+        if (!rowIsFiltered(block.scanNumber(row), block.fieldId(row), block.feed1(row),
+                           block.feed2(row), block.time(row), target.beams)) {
+            rows.push_back(row);
+        }
+    }
+    if (rows.size() == 0) {
+        return;
+    }
+
+    MSColumns dc(dest);
+    const uInt dstRow = dest.nrow();
+    const uInt nRowsOut = rows.size();
+    dest.addRow(nRowsOut);
+    const Slicer dstrowslicer(IPosition(1, dstRow), IPosition(1, nRowsOut), Slicer::endIsLength);
+
+    // Copy over the simple cells (i.e. those not needing averaging/merging)
+    dc.scanNumber().putColumnRange(dstrowslicer, selectRows(block.scanNumber, rows));
+    dc.fieldId().putColumnRange(dstrowslicer, selectRows(block.fieldId, rows));
+    dc.dataDescId().putColumnRange(dstrowslicer, selectRows(block.dataDescId, rows));
+    dc.time().putColumnRange(dstrowslicer, selectRows(block.time, rows));
+    dc.timeCentroid().putColumnRange(dstrowslicer, selectRows(block.timeCentroid, rows));
+    dc.arrayId().putColumnRange(dstrowslicer, selectRows(block.arrayId, rows));
+    dc.processorId().putColumnRange(dstrowslicer, selectRows(block.processorId, rows));
+    dc.exposure().putColumnRange(dstrowslicer, selectRows(block.exposure, rows));
+    dc.interval().putColumnRange(dstrowslicer, selectRows(block.interval, rows));
+    dc.observationId().putColumnRange(dstrowslicer, selectRows(block.observationId, rows));
+    dc.antenna1().putColumnRange(dstrowslicer, selectRows(block.antenna1, rows));
+    dc.antenna2().putColumnRange(dstrowslicer, selectRows(block.antenna2, rows));
+    dc.feed1().putColumnRange(dstrowslicer, selectRows(block.feed1, rows));
+    dc.feed2().putColumnRange(dstrowslicer, selectRows(block.feed2, rows));
+    dc.uvw().putColumnRange(dstrowslicer, selectRows(block.uvw, rows));
+    dc.flagRow().putColumnRange(dstrowslicer, selectRows(block.flagRow, rows));
+    dc.weight().putColumnRange(dstrowslicer, selectRows(block.weight, rows));
+    const casacore::Array<casacore::Float> sigma = selectRows(block.sigma, rows);
+    dc.sigma().putColumnRange(dstrowslicer, sigma / casacore::Float(sqrt(target.width)));
+
+    // Set the shape of the destination arrays
+    const uInt nPol = block.data.nrow();
+    const uInt nChanIn = target.endChan - target.startChan + 1;
+    const uInt nChanOut = nChanIn / target.width;
+    const casacore::Bool haveInSigmaSpec = block.sigmaSpectrum.nelements() > 0;
+    const casacore::Bool haveOutSigmaSpec = dest.isColumn(MS::SIGMA_SPECTRUM);
+    for (uInt i = dstRow; i < dstRow + nRowsOut; ++i) {
+        dc.data().setShape(i, IPosition(2, nPol, nChanOut));
+        dc.flag().setShape(i, IPosition(2, nPol, nChanOut));
+        if (haveOutSigmaSpec) {
+            dc.sigmaSpectrum().setShape(i, IPosition(2, nPol, nChanOut));
+        }
+    }
+
+    // Select the channels of this output, this is a reference to the block
+    const casacore::Slice chanSlice(target.startChan - firstChan, nChanIn);
+    const casacore::Cube<casacore::Complex> indata =
+          selectRows<casacore::Complex>(block.data(Slice(), chanSlice, Slice()), rows);
+    const casacore::Cube<casacore::Bool> inflag =
+          selectRows<casacore::Bool>(block.flag(Slice(), chanSlice, Slice()), rows);
+    const Slicer destarrslicer(IPosition(2, 0, 0), IPosition(2, nPol, nChanOut), Slicer::endIsLength);
+
+    if (target.width == 1) {
+        dc.data().putColumnRange(dstrowslicer, destarrslicer, indata);
+        dc.flag().putColumnRange(dstrowslicer, destarrslicer, inflag);
+        if (haveInSigmaSpec && haveOutSigmaSpec) {
+            dc.sigmaSpectrum().putColumnRange(dstrowslicer, destarrslicer,
+                selectRows<casacore::Float>(block.sigmaSpectrum(Slice(), chanSlice, Slice()), rows));
+        }
+    } else {
+        casacore::Cube<casacore::Float> insigma;
+        if (haveInSigmaSpec) {
+            insigma = selectRows<casacore::Float>(block.sigmaSpectrum(Slice(), chanSlice, Slice()), rows);
+        } else {
+            // There's only 1 sigma per pol & row, so spread over channels
+            insigma.resize(indata.shape());
+            const casacore::Matrix<casacore::Float> sigmaMatrix(sigma);
+            for (uInt r = 0; r < nRowsOut; ++r) {
+                for (uInt chan = 0; chan < nChanIn; ++chan) {
+                    for (uInt pol = 0; pol < nPol; ++pol) {
+                        insigma(pol, chan, r) = sigmaMatrix(pol, r);
+                    }
+                }
+            }
+        }
+
+        casacore::Cube<casacore::Complex> outdata;
+        casacore::Cube<casacore::Bool> outflag;
+        casacore::Cube<casacore::Float> outsigma;
+        averageChannels(indata, inflag, insigma, target.width, outdata, outflag, outsigma);
+
+        dc.data().putColumnRange(dstrowslicer, destarrslicer, outdata);
+        dc.flag().putColumnRange(dstrowslicer, destarrslicer, outflag);
+        if (haveOutSigmaSpec) {
+            dc.sigmaSpectrum().putColumnRange(dstrowslicer, destarrslicer, outsigma);
+        }
+    }
+}
+
+int MSSplitter::split(const std::string& invis, const std::vector<SplitTarget>& targets,
+                      const LOFAR::ParameterSet& parset)
+{
+    ASKAPCHECK(targets.size() > 0, "At least one output is required");
+    ASKAPLOG_DEBUG_STR(logger,  "Splitting " << invis << " into " << targets.size() <<
+                       " outputs in a single pass");
+
+    // Open the input measurement set
+    const casacore::MeasurementSet in(invis);
+    const casacore::uInt totChanIn = ROScalarColumn<casacore::Int>(in.spectralWindow(),"NUM_CHAN")(0);
+
+    // Verify split parameters and work out the channel range to read
+    uint32_t firstChan = totChanIn;
+    uint32_t lastChan = 1;
+    for (size_t t = 0; t < targets.size(); ++t) {
+        const SplitTarget& target = targets[t];
+        const uInt nChanIn = target.endChan - target.startChan + 1;
+        if ((target.width < 1) || (target.endChan < target.startChan) || (nChanIn % target.width != 0)) {
+            ASKAPLOG_ERROR_STR(logger, "Width must equally divide the channel range for "<<target.outvis);
+            return 1;
+        }
+        if ((target.startChan < 1) || (target.endChan > totChanIn)) {
+            ASKAPLOG_ERROR_STR(logger,
+                "Input channel range is inconsistent with input spectra: ["<<
+                target.startChan<<","<<target.endChan<<"] is outside [1,"<<totChanIn<<"]");
+            return 1;
+        }
+        if (casacore::File(target.outvis).exists()) {
+            ASKAPLOG_ERROR_STR(logger, "File or table " << target.outvis << " already exists!");
+            return 1;
+        }
+        firstChan = std::min(firstChan, target.startChan);
+        lastChan = std::max(lastChan, target.endChan);
+    }
+    const uInt nChanRead = lastChan - firstChan + 1;
+
+    // Create all outputs upfront, only the writer threads touch them afterwards
+    std::vector<boost::shared_ptr<casacore::MeasurementSet> > outputs(targets.size());
+    for (size_t t = 0; t < targets.size(); ++t) {
+        outputs[t] = createAndCopySubtables(in, targets[t], parset);
+    }
 
+    const ROMSColumns sc(in);
+    const casacore::uInt nRows = sc.nrow();
+    const uInt nPol = sc.data()(0).shape()(0);
+    ASKAPDEBUGASSERT(nPol > 0);
+    const casacore::Bool haveInSigmaSpec = in.isColumn(MS::SIGMA_SPECTRUM);
+
+    // Read blocks of about 128MB
+    const std::size_t bytesPerRow = nPol * nChanRead * (sizeof(casacore::Complex) + sizeof(casacore::Bool) +
+                                    (haveInSigmaSpec ? sizeof(casacore::Float) : 0));
+    const uInt rowsPerBlock = std::max(std::size_t(1), (128 * 1024 * 1024) / bytesPerRow);
+    const casacore::uInt cacheSize = 64 * 1024 * 1024;
+    sc.data().setMaximumCacheSize(cacheSize);
+    sc.flag().setMaximumCacheSize(cacheSize);
+    if (haveInSigmaSpec) {
+        sc.sigmaSpectrum().setMaximumCacheSize(cacheSize);
+    }
+
+    // Set up the writers, outputs are distributed round robin
+    const uInt nWriters = std::min(std::max(1u, parset.getUint32("splitter.nwriters", 4)),
+                                   casacore::uInt(targets.size()));
+    const uInt queueSize = std::max(1u, parset.getUint32("splitter.queuesize", 2));
+    ASKAPLOG_DEBUG_STR(logger, "Reading "<<rowsPerBlock<<" rows per block, channels "<<firstChan<<
+                       " to "<<lastChan<<", using "<<nWriters<<" writer thread(s)");
+    typedef utils::BoundedQueue<boost::shared_ptr<const SourceBlock> > BlockQueue;
+    std::vector<boost::shared_ptr<BlockQueue> > queues(targets.size());
+    for (size_t t = 0; t < targets.size(); ++t) {
+        queues[t].reset(new BlockQueue(queueSize));
+    }
+
+    std::mutex errorMutex;
+    std::exception_ptr writerError;
+    std::vector<std::thread> writers;
+    for (uInt w = 0; w < nWriters; ++w) {
+        writers.push_back(std::thread([&, w]() {
+            try {
+                for (bool more = true; more; ) {
+                    more = false;
+                    for (size_t t = w; t < targets.size(); t += nWriters) {
+                        boost::shared_ptr<const SourceBlock> block;
+                        if (queues[t]->pop(block)) {
+                            writeBlock(*block, targets[t], *outputs[t], firstChan);
+                            more = true;
+                        }
+                    }
+                }
+                for (size_t t = w; t < targets.size(); t += nWriters) {
+                    outputs[t]->flush();
+                }
+            } catch (...) {
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!writerError) {
+                        writerError = std::current_exception();
+                    }
+                }
+                for (size_t t = 0; t < queues.size(); ++t) {
+                    queues[t]->abort();
+                }
+            }
+        }));
+    }
+
+    // Read the input once and hand over every block to all outputs
+    try {
+        const Slicer srcarrslicer(IPosition(2, 0, firstChan - 1),
+                                  IPosition(2, nPol, nChanRead), Slicer::endIsLength);
+        uInt progressCounter = 0;
+        const uInt PROGRESS_INTERVAL_IN_ROWS = nRows / 100;
+        for (uInt row = 0; row < nRows; ) {
+            const uInt nRowsThisIteration = min(rowsPerBlock, nRows - row);
+            const Slicer srcrowslicer(IPosition(1, row), IPosition(1, nRowsThisIteration),
+                    Slicer::endIsLength);
+            boost::shared_ptr<SourceBlock> block(new SourceBlock);
+            block->scanNumber = sc.scanNumber().getColumnRange(srcrowslicer);
+            block->fieldId = sc.fieldId().getColumnRange(srcrowslicer);
+            block->dataDescId = sc.dataDescId().getColumnRange(srcrowslicer);
+            block->time = sc.time().getColumnRange(srcrowslicer);
+            block->timeCentroid = sc.timeCentroid().getColumnRange(srcrowslicer);
+            block->arrayId = sc.arrayId().getColumnRange(srcrowslicer);
+            block->processorId = sc.processorId().getColumnRange(srcrowslicer);
+            block->exposure = sc.exposure().getColumnRange(srcrowslicer);
+            block->interval = sc.interval().getColumnRange(srcrowslicer);
+            block->observationId = sc.observationId().getColumnRange(srcrowslicer);
+            block->antenna1 = sc.antenna1().getColumnRange(srcrowslicer);
+            block->antenna2 = sc.antenna2().getColumnRange(srcrowslicer);
+            block->feed1 = sc.feed1().getColumnRange(srcrowslicer);
+            block->feed2 = sc.feed2().getColumnRange(srcrowslicer);
+            block->uvw = sc.uvw().getColumnRange(srcrowslicer);
+            block->flagRow = sc.flagRow().getColumnRange(srcrowslicer);
+            block->weight = sc.weight().getColumnRange(srcrowslicer);
+            block->sigma = sc.sigma().getColumnRange(srcrowslicer);
+            block->data = sc.data().getColumnRange(srcrowslicer, srcarrslicer);
+            block->flag = sc.flag().getColumnRange(srcrowslicer, srcarrslicer);
+            if (haveInSigmaSpec) {
+                block->sigmaSpectrum = sc.sigmaSpectrum().getColumnRange(srcrowslicer, srcarrslicer);
+            }
+            for (size_t t = 0; t < queues.size(); ++t) {
+                if (!queues[t]->push(block)) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (writerError) {
+                        std::rethrow_exception(writerError);
+                    }
+                    ASKAPTHROW(AskapError, "Writer for " << targets[t].outvis << " terminated prematurely");
+                }
+            }
+            row += nRowsThisIteration;
+
+            // Report progress at intervals and on completion
+            progressCounter += nRowsThisIteration;
+            if (progressCounter >= PROGRESS_INTERVAL_IN_ROWS || (row >= nRows)) {
+                ASKAPLOG_DEBUG_STR(logger,  "Read row " << row << " of " << nRows);
+                progressCounter = 0;
+            }
+        }
+        for (size_t t = 0; t < queues.size(); ++t) {
+            queues[t]->close();
+        }
+    } catch (...) {
+        for (size_t t = 0; t < queues.size(); ++t) {
+            queues[t]->abort();
+        }
+        for (std::vector<std::thread>::iterator it = writers.begin(); it != writers.end(); ++it) {
+            it->join();
+        }
+        throw;
+    }
+    for (std::vector<std::thread>::iterator it = writers.begin(); it != writers.end(); ++it) {
+        it->join();
+    }
+    if (writerError) {
+        std::rethrow_exception(writerError);
+    }
     return 0;
 }
 
@@ -31,6 +31,7 @@
 // System includes
 #include <string>
 #include <set>
+#include <vector>
 #include <utility>
 #include <stdint.h>
 
@@ -43,12 +44,35 @@
 #include <boost/optional.hpp>
 #include <Common/ParameterSet.h>
 #include <casacore/casa/aips.h>
+#include <casacore/casa/Arrays/Cube.h>
 #include <casacore/ms/MeasurementSets/MeasurementSet.h>
 
 namespace askap {
 namespace cp {
 
 
+/// @brief description of one output of a single pass split
+/// @details Channels are 1-based and inclusive, like in MSSplitter::split.
+struct SplitTarget {
+    SplitTarget() : startChan(1), endChan(1), width(1) {}
+
+    /// Output measurement set name
+    std::string outvis;
+
+    /// First input channel to include
+    uint32_t startChan;
+
+    /// Last input channel to include
+    uint32_t endChan;
+
+    /// Number of input channels averaged to form one output channel
+    uint32_t width;
+
+    /// Beams to include in this output, or empty if the beam selection
+    /// of the splitter (if any) is to be used
+    std::set<uint32_t> beams;
+};
+
 class MSSplitter {
     public:
         /// Constructor
@@ -60,14 +84,54 @@ class MSSplitter {
               const uint32_t width,
               const LOFAR::ParameterSet& parset);
 
-    
+        /// @brief split into several outputs reading the input once
+        /// @details The input main table is read block by block and every block
+        /// is handed over to a pool of writer threads through bounded queues, each writer
+        /// thread applies the channel and beam selection of its outputs. The following
+        /// parset parameters are recognised in addition to those used by split:
+        ///   - splitter.nwriters  number of writer threads (default: up to 4)
+        ///   - splitter.queuesize number of blocks buffered per output (default: 2)
+        /// @param[in] invis input measurement set
+        /// @param[in] targets description of the outputs
+        /// @param[in] parset parameters
+        /// @return 0 on success, 1 if the split parameters are invalid
+        int split(const std::string& invis, const std::vector<SplitTarget>& targets,
+              const LOFAR::ParameterSet& parset);
 
     private:
 
+        /// @brief block of rows read from the input by a single pass split
+        struct SourceBlock;
+
         static boost::shared_ptr<casacore::MeasurementSet> create(
             const std::string& filename, const casacore::Bool addSigmaSpec,
             casacore::uInt bucketSize, casacore::uInt tileNcorr, casacore::uInt tileNchan);
 
+        /// @brief create output measurement set and copy all subtables
+        /// @return output measurement set
+        static boost::shared_ptr<casacore::MeasurementSet> createAndCopySubtables(
+            const casacore::MeasurementSet& in, const SplitTarget& target,
+            const LOFAR::ParameterSet& parset);
+
+        /// @brief average adjacent channels
+        /// @details Flagged samples are excluded, the output is flagged if all input
+        /// channels are flagged.
+        static void averageChannels(const casacore::Cube<casacore::Complex>& indata,
+                                    const casacore::Cube<casacore::Bool>& inflag,
+                                    const casacore::Cube<casacore::Float>& insigma,
+                                    const uint32_t width,
+                                    casacore::Cube<casacore::Complex>& outdata,
+                                    casacore::Cube<casacore::Bool>& outflag,
+                                    casacore::Cube<casacore::Float>& outsigma);
+
+        /// @brief write the part of a block selected for one output
+        /// @param[in] block input rows
+        /// @param[in] target output description
+        /// @param[in] dest output measurement set
+        /// @param[in] firstChan first (1-based) input channel present in the block
+        void writeBlock(const SourceBlock& block, const SplitTarget& target,
+                        casacore::MeasurementSet& dest, const uint32_t firstChan) const;
+
         static void copyAntenna(const casacore::MeasurementSet& source, casacore::MeasurementSet& dest);
 
         static void copyDataDescription(const casacore::MeasurementSet& source, casacore::MeasurementSet& dest);
@@ -124,6 +188,12 @@ class MSSplitter {
         bool rowIsFiltered(uint32_t scanid, uint32_t fieldid, uint32_t feed1,
                            uint32_t feed2, double time) const;
 
+        // As above, but the beam selection is taken from the given set
+        // unless it is empty
+        bool rowIsFiltered(uint32_t scanid, uint32_t fieldid, uint32_t feed1,
+                           uint32_t feed2, double time,
+                           const std::set<uint32_t>& beams) const;
+
         // Helper method for the configuration of the time range filters.
         // Parses the parset value associated with "key" (using MVTime::read()),
         // sets "var" to MVTime::second(), and logs a message "msg".
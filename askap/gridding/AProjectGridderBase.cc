@@ -62,7 +62,9 @@ AProjectGridderBase::AProjectGridderBase(const int maxFeeds, const int maxFields
           itsLastField(-1), itsCurrentField(0),
           itsDone(maxFeeds, maxFields, false), itsPointings(maxFeeds, maxFields, casacore::MVDirection()),
           itsNumberOfCFGenerations(0), itsNumberOfIterations(0),
-          itsNumberOfCFGenerationsDueToPA(0), itsCFParallacticAngle(0),
+          itsNumberOfCFGenerationsDueToPA(0), itsCFParallacticAngles(maxFeeds, maxFields, 0.),
+          itsCFParallacticAngleBins(maxFeeds, maxFields, 0), itsPACacheSize(0), itsPACacheLimit(0),
+          itsNumberOfCFRestores(0), itsNumberOfPACacheEvictions(0),
           itsNumberOfCFGenerationsDueToFreq(0), itsFrequencyTolerance(freqTol),
           itsCFInvalidDueToPA(false), itsCFInvalidDueToFreq(false), itsSlopes(2, maxFeeds, maxFields,0.)
 {
@@ -84,7 +86,12 @@ AProjectGridderBase::AProjectGridderBase(const AProjectGridderBase &other) :
     itsNumberOfCFGenerations(other.itsNumberOfCFGenerations),
     itsNumberOfIterations(other.itsNumberOfIterations),
     itsNumberOfCFGenerationsDueToPA(other.itsNumberOfCFGenerationsDueToPA),
-    itsCFParallacticAngle(other.itsCFParallacticAngle),
+    itsCFParallacticAngles(other.itsCFParallacticAngles.copy()),
+    itsCFParallacticAngleBins(other.itsCFParallacticAngleBins.copy()),
+    itsPACache(other.itsPACache), itsPACacheLRU(other.itsPACacheLRU),
+    itsPACacheSize(other.itsPACacheSize), itsPACacheLimit(other.itsPACacheLimit),
+    itsNumberOfCFRestores(other.itsNumberOfCFRestores),
+    itsNumberOfPACacheEvictions(other.itsNumberOfPACacheEvictions),
     itsNumberOfCFGenerationsDueToFreq(other.itsNumberOfCFGenerationsDueToFreq),
     itsFrequencyTolerance(other.itsFrequencyTolerance),
     itsCachedFrequencies(other.itsCachedFrequencies),
@@ -127,6 +134,11 @@ AProjectGridderBase::~AProjectGridderBase()
                   double(itsNumberOfCFGenerationsDueToFreq)/double(itsNumberOfCFGenerations)*100<<
                   " %)");
       }
+      if (itsPACacheLimit > 0) {
+          ASKAPLOG_INFO_STR(logger, "   CFs were restored from the parallactic angle cache "<<
+                  itsNumberOfCFRestores<<" times, "<<itsNumberOfPACacheEvictions<<
+                  " entries were dropped to keep it under "<<itsPACacheLimit / 1024 / 1024<<" MB");
+      }
       if (nUsed != 0) {
           // because nUsed is strictly speaking applicable to the last iteration only we need
           // to filter out rediculous values (and warn the user that the result is approximate
@@ -193,9 +205,11 @@ void AProjectGridderBase::indexField(const IConstDataAccessor &acc)
 }
 
 /// @brief check whether CF cache is valid
-/// @details This methods validates CF cache for one particular iteration. If necessary,
-/// all values in itsDone are set to false. This method also sets some internal flags to
-/// update the stats correctly when updateStats is called.
+/// @details This methods validates CF cache for one particular iteration. A change of the
+/// frequency axis invalidates all CFs. For asymmetric illumination patterns, the parallactic
+/// angle is binned with the tolerance as the bin width and only CFs of the feeds which moved
+/// to a different bin in the current field are invalidated. This method also sets some internal
+/// flags to update the stats correctly when updateStats is called.
 /// @param[in] acc input const accessor to analyse
 /// @param[in] symmetric true, if illumination pattern is symmetric, false otherwise
 void AProjectGridderBase::validateCFCache(const IConstDataAccessor &acc, bool symmetric)
@@ -203,28 +217,10 @@ void AProjectGridderBase::validateCFCache(const IConstDataAccessor &acc, bool sy
   ASKAPDEBUGTRACE("AProjectGridderBase::validateCFCache");
   const int nSamples = acc.nRow();
 
-  // flags are used to accumulate CF rebuild statistics
-  itsCFInvalidDueToPA = false;
-
-  if (!symmetric) {
-      // need to check parallactic angles here
-      const casacore::Vector<casacore::Float> &feed1PAs = acc.feed1PA();
-      ASKAPDEBUGASSERT(feed1PAs.nelements() == casacore::uInt(nSamples));
-      for (int row = 0; row<nSamples; ++row) {
-           if (fabs(feed1PAs[row] - itsCFParallacticAngle) > itsParallacticAngleTolerance) {
-               itsCFInvalidDueToPA = true;
-               itsCFParallacticAngle = feed1PAs[row];
-               itsDone.set(false);
-               break;
-           }
-      }
-  }
-
   // the following flag is used to accululate CF rebuild statistics and internal logic
   itsCFInvalidDueToFreq = false;
 
-  // don't bother checking if the cache is rebuilt anyway
-  if (!itsCFInvalidDueToPA && (itsFrequencyTolerance >= 0.)) {
+  if (itsFrequencyTolerance >= 0.) {
       const casacore::Vector<casacore::Double> &freq = acc.frequency();
       if (freq.nelements() != itsCachedFrequencies.nelements()) {
           itsCFInvalidDueToFreq = true;
@@ -240,14 +236,134 @@ void AProjectGridderBase::validateCFCache(const IConstDataAccessor &acc, bool sy
           }
       }
       if (itsCFInvalidDueToFreq) {
-          itsDone.set(false);
+          // CFs cached for other parallactic angles are no longer valid either
+          resetCFCache();
+          itsCachedFrequencies.assign(freq);
+      }
+  }
+
+  // flags are used to accumulate CF rebuild statistics
+  itsCFInvalidDueToPA = false;
+
+  if (!symmetric) {
+      // need to check parallactic angles here, CFs are computed for the first row of each feed
+      const casacore::Vector<casacore::Float> &feed1PAs = acc.feed1PA();
+      const casacore::Vector<casacore::uInt> &feeds = acc.feed1();
+      ASKAPDEBUGASSERT(feed1PAs.nelements() == casacore::uInt(nSamples));
+      const casacore::uInt field = currentField();
+      std::vector<bool> feedSeen(itsDone.nrow(), false);
+      for (int row = 0; row<nSamples; ++row) {
+           const casacore::uInt feed = feeds[row];
+           ASKAPCHECK(feed < itsDone.nrow(), "Too many feeds: increase maxfeeds");
+           if (feedSeen[feed]) {
+               continue;
+           }
+           feedSeen[feed] = true;
+           const int bin = paBin(feed1PAs[row]);
+           // without binning (non-positive tolerance) compare the angles directly as before
+           const bool moved = itsParallacticAngleTolerance > 0. ? bin != itsCFParallacticAngleBins(feed, field) :
+                 fabs(feed1PAs[row] - itsCFParallacticAngles(feed, field)) > itsParallacticAngleTolerance;
+           if (isCFValid(feed, field) && moved) {
+               itsCFInvalidDueToPA = true;
+               itsDone(feed, field) = false;
+           }
+           if (!isCFValid(feed, field)) {
+               itsCFParallacticAngleBins(feed, field) = bin;
+               itsCFParallacticAngles(feed, field) = itsParallacticAngleTolerance > 0. ?
+                     casacore::Float(bin * itsParallacticAngleTolerance) : feed1PAs[row];
+           }
       }
   }
+}
+
+/// @brief bin number for the given parallactic angle
+/// @param[in] pa parallactic angle in radians
+/// @return bin number (only meaningful for a positive tolerance)
+int AProjectGridderBase::paBin(double pa) const
+{
+  return itsParallacticAngleTolerance > 0. ? askap::nint(pa / itsParallacticAngleTolerance) : 0;
+}
+
+/// @brief store CFs for the given feed and field in the parallactic angle cache
+/// @details CFs computed for the current parallactic angle bin are kept by reference (so the
+/// caller should not modify them in situ later on) and can be restored when the same feed
+/// and field get back into this bin. The least recently used entries are dropped if the total
+/// size exceeds the limit. Nothing is done if the cache is switched off.
+/// @param[in] feed feed number
+/// @param[in] field field number
+/// @param[in] cfs cache of CFs of the gridder
+/// @param[in] start index of the first CF of this feed and field in the cache
+/// @param[in] n number of CFs for this feed and field
+/// @param[in] offsets CF offsets for this feed and field (may be empty)
+void AProjectGridderBase::storeCFs(int feed, int field, const std::vector<casacore::Matrix<casacore::Complex> > &cfs,
+                                   size_t start, size_t n, const std::vector<std::pair<int,int> > &offsets)
+{
+  if ((itsPACacheLimit == 0) || (itsParallacticAngleTolerance <= 0.)) {
+      return;
+  }
+  ASKAPDEBUGASSERT(start + n <= cfs.size());
+  const PACacheKey key(std::make_pair(feed, field), itsCFParallacticAngleBins(feed, field));
+  std::map<PACacheKey, PACacheEntry>::iterator it = itsPACache.find(key);
+  if (it != itsPACache.end()) {
+      itsPACacheSize -= it->second.size;
+      itsPACacheLRU.remove(key);
+  } else {
+      it = itsPACache.insert(std::make_pair(key, PACacheEntry())).first;
+  }
+  PACacheEntry &entry = it->second;
+  entry.cfs.resize(n);
+  entry.size = 0;
+  for (size_t i = 0; i < n; ++i) {
+       entry.cfs[i].reference(cfs[start + i]);
+       entry.size += entry.cfs[i].nelements() * sizeof(casacore::Complex);
+  }
+  entry.offsets = offsets;
+  itsPACacheSize += entry.size;
+  itsPACacheLRU.push_front(key);
+  trimPACache();
+}
 
-  // cache the current frequency axis if the cache is going to be built
-  // do nothing if the tolerance is negative
-  if ((itsCFInvalidDueToPA || itsCFInvalidDueToFreq) && (itsFrequencyTolerance >= 0.)) {
-      itsCachedFrequencies.assign(acc.frequency());
+/// @brief restore CFs for the given feed and field from the parallactic angle cache
+/// @param[in] feed feed number
+/// @param[in] field field number
+/// @param[in] cfs cache of CFs of the gridder, elements [start, start+n) are updated by reference
+/// @param[in] start index of the first CF of this feed and field in the cache
+/// @param[in] n number of CFs for this feed and field
+/// @param[out] offsets CF offsets stored for this feed and field
+/// @return true, if the CFs have been found in the cache
+bool AProjectGridderBase::restoreCFs(int feed, int field, std::vector<casacore::Matrix<casacore::Complex> > &cfs,
+                                     size_t start, size_t n, std::vector<std::pair<int,int> > &offsets)
+{
+  if (itsPACache.empty()) {
+      return false;
+  }
+  const PACacheKey key(std::make_pair(feed, field), itsCFParallacticAngleBins(feed, field));
+  const std::map<PACacheKey, PACacheEntry>::const_iterator ci = itsPACache.find(key);
+  if ((ci == itsPACache.end()) || (ci->second.cfs.size() != n)) {
+      return false;
+  }
+  ASKAPDEBUGASSERT(start + n <= cfs.size());
+  for (size_t i = 0; i < n; ++i) {
+       cfs[start + i].reference(ci->second.cfs[i]);
+  }
+  offsets = ci->second.offsets;
+  itsPACacheLRU.remove(key);
+  itsPACacheLRU.push_front(key);
+  ++itsNumberOfCFRestores;
+  return true;
+}
+
+/// @brief drop the least recently used entries of the parallactic angle cache
+/// @details Entries are dropped until the size doesn't exceed the limit.
+void AProjectGridderBase::trimPACache()
+{
+  while ((itsPACacheSize > itsPACacheLimit) && !itsPACacheLRU.empty()) {
+         const std::map<PACacheKey, PACacheEntry>::iterator it = itsPACache.find(itsPACacheLRU.back());
+         ASKAPDEBUGASSERT(it != itsPACache.end());
+         itsPACacheSize -= it->second.size;
+         itsPACache.erase(it);
+         itsPACacheLRU.pop_back();
+         ++itsNumberOfPACacheEvictions;
   }
 }
 
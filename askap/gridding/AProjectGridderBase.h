@@ -39,6 +39,12 @@
 #include <askap/gridding/IVisGridder.h>
 #include <Common/ParameterSet.h>
 #include <askap/measurementequation/SynthesisParamsHelper.h>
+#include <casacore/casa/Arrays/Matrix.h>
+
+#include <list>
+#include <map>
+#include <utility>
+#include <vector>
 
 namespace askap {
 namespace synthesis {
@@ -119,13 +125,60 @@ struct AProjectGridderBase : virtual public IVisGridder
   void indexField(const accessors::IConstDataAccessor &acc);
   
   /// @brief check whether CF cache is valid
-  /// @details This methods validates CF cache for one particular iteration. If necessary, 
-  /// all values in itsDone are set to false. This method also sets some internal flags to
-  /// update the stats correctly when updateStats is called. 
+  /// @details This methods validates CF cache for one particular iteration. A change of the
+  /// frequency axis invalidates all CFs. For asymmetric illumination patterns, the parallactic
+  /// angle is binned with the tolerance as the bin width and only CFs of the feeds which moved
+  /// to a different bin in the current field are invalidated. This method also sets some internal
+  /// flags to update the stats correctly when updateStats is called.
   /// @param[in] acc input const accessor to analyse
   /// @param[in] symmetric true, if illumination pattern is symmetric, false otherwise
   void validateCFCache(const accessors::IConstDataAccessor &acc, bool symmetric);
 
+  /// @brief parallactic angle to compute CFs for
+  /// @details This is the centre of the parallactic angle bin assigned by validateCFCache (or
+  /// the actual angle if the tolerance is not positive). It is only meaningful for asymmetric
+  /// illumination patterns.
+  /// @param[in] feed feed number to query
+  /// @param[in] field field number to query
+  /// @return parallactic angle in radians
+  inline double cfParallacticAngle(int feed, int field) const { return itsCFParallacticAngles(feed,field);}
+
+  /// @brief store CFs for the given feed and field in the parallactic angle cache
+  /// @details CFs computed for the current parallactic angle bin are kept by reference (so the
+  /// caller should not modify them in situ later on) and can be restored when the same feed
+  /// and field get back into this bin. The least recently used entries are dropped if the total
+  /// size exceeds the limit. Nothing is done if the cache is switched off.
+  /// @param[in] feed feed number
+  /// @param[in] field field number
+  /// @param[in] cfs cache of CFs of the gridder
+  /// @param[in] start index of the first CF of this feed and field in the cache
+  /// @param[in] n number of CFs for this feed and field
+  /// @param[in] offsets CF offsets for this feed and field (may be empty)
+  void storeCFs(int feed, int field, const std::vector<casacore::Matrix<casacore::Complex> > &cfs,
+                size_t start, size_t n, const std::vector<std::pair<int,int> > &offsets);
+
+  /// @brief restore CFs for the given feed and field from the parallactic angle cache
+  /// @param[in] feed feed number
+  /// @param[in] field field number
+  /// @param[in] cfs cache of CFs of the gridder, elements [start, start+n) are updated by reference
+  /// @param[in] start index of the first CF of this feed and field in the cache
+  /// @param[in] n number of CFs for this feed and field
+  /// @param[out] offsets CF offsets stored for this feed and field
+  /// @return true, if the CFs have been found in the cache
+  bool restoreCFs(int feed, int field, std::vector<casacore::Matrix<casacore::Complex> > &cfs,
+                  size_t start, size_t n, std::vector<std::pair<int,int> > &offsets);
+
+  /// @brief set the size of the parallactic angle cache
+  /// @param[in] maxBytes maximum total size of CFs kept in the cache (including those currently
+  /// in use, which are shared with the gridder), zero switches the cache off
+  inline void paCacheSize(size_t maxBytes) { itsPACacheLimit = maxBytes; }
+
+  /// @return number of times CFs were restored from the parallactic angle cache
+  inline casacore::uInt numberOfCFRestores() const { return itsNumberOfCFRestores; }
+
+  /// @return number of CFs generated due to a change of parallactic angle bin
+  inline casacore::uInt numberOfCFGenerationsDueToPA() const { return itsNumberOfCFGenerationsDueToPA; }
+
   /// @brief toggle the validity flag for a given CF
   /// @details
   /// @param[in] feed feed number to query
@@ -150,7 +203,7 @@ struct AProjectGridderBase : virtual public IVisGridder
       makeIllumination(const LOFAR::ParameterSet &parset);
 protected:
   /// @brief helper method to reset CF cache
-  inline void resetCFCache() { itsDone.set(false); }
+  inline void resetCFCache() { itsDone.set(false); itsPACache.clear(); itsPACacheLRU.clear(); itsPACacheSize = 0;}
 
   /// @brief actual factory of derived gridders
   /// @details Gridders derived from this class use exactly the same parameters, but doing
@@ -174,6 +227,28 @@ private:
   /// @return reference to itself
   AProjectGridderBase& operator=(const AProjectGridderBase &other);
 
+  /// @brief CFs of one feed and field for one parallactic angle bin
+  struct PACacheEntry {
+     /// @brief convolution functions (reference copies)
+     std::vector<casacore::Matrix<casacore::Complex> > cfs;
+     /// @brief offsets of the convolution functions
+     std::vector<std::pair<int,int> > offsets;
+     /// @brief size in bytes
+     size_t size;
+  };
+
+  /// @brief key of the parallactic angle cache: (feed, field) and the angle bin
+  typedef std::pair<std::pair<int,int>, int> PACacheKey;
+
+  /// @brief bin number for the given parallactic angle
+  /// @param[in] pa parallactic angle in radians
+  /// @return bin number (only meaningful for a positive tolerance)
+  int paBin(double pa) const;
+
+  /// @brief drop the least recently used entries of the parallactic angle cache
+  /// @details Entries are dropped until the size doesn't exceed the limit.
+  void trimPACache();
+
 
   /// Pointing tolerance in radians
   double itsPointingTolerance;
@@ -218,11 +293,31 @@ private:
   /// due to a change in parallactic angle. 
   casacore::uInt itsNumberOfCFGenerationsDueToPA;
       
-  /// @brief parallactic angle for which the cache is valid
+  /// @brief parallactic angles for which the cache is valid (per feed and field)
   /// @details This buffer is only used and filled if the illumination pattern is asymmetric.
-  /// We currently don't account for the VLBI case with notably different parallactic angles.
-  /// Therefore, only one angle is stored here. 
-  casacore::Float itsCFParallacticAngle;
+  /// The angle of the first row of the feed is rounded to the centre of the bin.
+  casacore::Matrix<casacore::Float> itsCFParallacticAngles;
+
+  /// @brief parallactic angle bins for which the cache is valid (per feed and field)
+  casacore::Matrix<int> itsCFParallacticAngleBins;
+
+  /// @brief CFs kept for parallactic angle bins seen so far
+  std::map<PACacheKey, PACacheEntry> itsPACache;
+
+  /// @brief keys of the parallactic angle cache, the most recently used first
+  std::list<PACacheKey> itsPACacheLRU;
+
+  /// @brief total size of CFs in the parallactic angle cache (in bytes)
+  size_t itsPACacheSize;
+
+  /// @brief maximum size of the parallactic angle cache (in bytes), zero means no cache
+  size_t itsPACacheLimit;
+
+  /// @brief number of times CFs were restored from the parallactic angle cache
+  casacore::uInt itsNumberOfCFRestores;
+
+  /// @brief number of entries dropped from the parallactic angle cache
+  casacore::uInt itsNumberOfPACacheEvictions;
       
   /// @brief number of CFs generated due to a change of frequency 
   /// @details This number is incremented each time a CF is recomputed following a change
@@ -106,6 +106,14 @@ boost::shared_ptr<GridderType> AProjectGridderBase::createAProjectGridder(const
                 wmax, nwplanes, cutoff, oversample, maxSupport, limitSupport, maxFeeds, maxFields,
                 pointingTol, paTol, freqTol, freqDep, tablename));
   gridder->configureWSampling(parset);
+  // memory budget (in MB) for CFs kept for parallactic angle bins, zero switches the cache off
+  const double paCacheSize = parset.getDouble("pacachesize", 0.);
+  ASKAPCHECK(paCacheSize >= 0., "pacachesize is supposed to be a non-negative number of MB, you have "<<paCacheSize);
+  if (paCacheSize > 0.) {
+      ASKAPLOG_INFO_STR(logger, "CFs will be cached for up to "<<paCacheSize<<
+                        " MB worth of parallactic angle bins");
+      gridder->paCacheSize(size_t(paCacheSize * 1024. * 1024.));
+  }
   return gridder;              
 }
 
@@ -257,7 +257,6 @@ void AProjectWStackVisGridder::initConvolutionFunction(const accessors::IConstDa
 
         if (!isCFValid(feed, currentField())) {
             makeCFValid(feed, currentField());
-            nDone++;
             casacore::MVDirection offset(acc.pointingDir1()(row).getAngle());
             rwSlopes()(0, feed, currentField()) = isPSFGridder() || isPCFGridder() ? 0. : sin(offset.getLong()
                     -out.getLong()) *cos(offset.getLat());
@@ -265,7 +264,19 @@ void AProjectWStackVisGridder::initConvolutionFunction(const accessors::IConstDa
                 *cos(out.getLat()) - cos(offset.getLat())*sin(out.getLat())
                 *cos(offset.getLong()-out.getLong());
 
-            const double parallacticAngle = hasSymmetricIllumination ? 0. : acc.feed1PA()(row);
+            // CFs of this feed and field occupy a contiguous block of the cache
+            const size_t firstCFPlane = size_t(itsOverSample*itsOverSample*nChan*(feed+itsMaxFeeds*currentField()));
+            const size_t nCFPlanes = size_t(itsOverSample*itsOverSample*nChan);
+            std::vector<std::pair<int,int> > cfOffsets;
+            if (restoreCFs(feed, currentField(), itsConvFunc, firstCFPlane, nCFPlanes, cfOffsets)) {
+                // this parallactic angle bin has been seen before
+                continue;
+            }
+            nDone++;
+
+            // the angle at the centre of the parallactic angle bin
+            const double parallacticAngle = hasSymmetricIllumination ? 0. :
+                                            cfParallacticAngle(feed, currentField());
 
             for (int chan=0; chan<nChan; chan++) {
                 /// Extract illumination pattern for this channel
@@ -339,6 +350,8 @@ void AProjectWStackVisGridder::initConvolutionFunction(const accessors::IConstDa
                     for (int fracv=0; fracv<itsOverSample; fracv++) {
                         int plane=fracu+itsOverSample*(fracv+itsOverSample*zIndex);
                         ASKAPDEBUGASSERT(plane>=0 && plane<int(itsConvFunc.size()));
+                        // detach from the storage which may be shared with the parallactic angle cache
+                        itsConvFunc[plane].resize();
                         itsConvFunc[plane].resize(cSize, cSize);
                         itsConvFunc[plane].set(0.0);
                         // Now cut out the inner part of the convolution function and
@@ -357,6 +370,7 @@ void AProjectWStackVisGridder::initConvolutionFunction(const accessors::IConstDa
                     } // for fracv
                 } // for fracu
             } // for chan
+            storeCFs(feed, currentField(), itsConvFunc, firstCFPlane, nCFPlanes, cfOffsets);
         } // if !isDone
     } // for row
 
@@ -487,7 +501,9 @@ void AProjectWStackVisGridder::correctConvolution(casacore::Array<imtype>& /*gri
 /// @return a shared pointer to the gridder instance
 IVisGridder::ShPtr AProjectWStackVisGridder::createGridder(const LOFAR::ParameterSet& parset)
 {
-  return createAProjectGridder<AProjectWStackVisGridder>(parset);
+  const boost::shared_ptr<AProjectWStackVisGridder> gridder = createAProjectGridder<AProjectWStackVisGridder>(parset);
+  gridder->configureActivePlanes(parset);
+  return gridder;
 }
 
 /// @brief assignment operator (not to be called)
@@ -354,10 +354,26 @@ void AWProjectVisGridder::initConvolutionFunction(const accessors::IConstDataAcc
 
         if (!isCFValid(feed, currentField())) {
             makeCFValid(feed, currentField());
+
+            // CFs of this feed and field occupy a contiguous block of the cache
+            const int firstZIndex = nWPlanes() * nChan * (feed + itsMaxFeeds * currentField());
+            const size_t nCFPlanes = size_t(itsOverSample * itsOverSample * nWPlanes() * nChan);
+            std::vector<std::pair<int,int> > cfOffsets;
+            if (restoreCFs(feed, currentField(), itsConvFunc, size_t(itsOverSample * itsOverSample * firstZIndex),
+                           nCFPlanes, cfOffsets)) {
+                // this parallactic angle bin has been seen before
+                for (size_t i = 0; i < cfOffsets.size(); ++i) {
+                     setConvFuncOffset(firstZIndex + int(i), cfOffsets[i].first, cfOffsets[i].second);
+                }
+                continue;
+            }
+
             nDone++;
             casacore::MVDirection offset(acc.pointingDir1()(row).getAngle());
 
-            const double parallacticAngle = hasSymmetricIllumination ? 0. : acc.feed1PA()(row);
+            // the angle at the centre of the parallactic angle bin
+            const double parallacticAngle = hasSymmetricIllumination ? 0. :
+                                            cfParallacticAngle(feed, currentField());
 
             for (int chan = 0; chan < nChan; ++chan) {
 
@@ -472,6 +488,8 @@ void AWProjectVisGridder::initConvolutionFunction(const accessors::IConstDataAcc
                             const int plane = fracu + itsOverSample * (fracv + itsOverSample
                                               * zIndex);
                             ASKAPDEBUGASSERT(plane >= 0 && plane < int(itsConvFunc.size()));
+                            // detach from the storage which may be shared with the parallactic angle cache
+                            itsConvFunc[plane].resize();
                             if (isPCFGridder()) {
                                 itsConvFunc[plane].resize(3,3);
                                 itsConvFunc[plane].set(0.0);
@@ -516,6 +534,15 @@ void AWProjectVisGridder::initConvolutionFunction(const accessors::IConstDataAcc
                 } // w loop
             } // chan loop
 
+            if (isOffsetSupportAllowed()) {
+                cfOffsets.resize(nWPlanes() * nChan);
+                for (size_t i = 0; i < cfOffsets.size(); ++i) {
+                     cfOffsets[i] = getConvFuncOffset(firstZIndex + int(i));
+                }
+            }
+            storeCFs(feed, currentField(), itsConvFunc, size_t(itsOverSample * itsOverSample * firstZIndex),
+                     nCFPlanes, cfOffsets);
+
             if (isPSFGridder() && itsShareCF) {
                 // All illumination patterns are identical across feeds for the PSF gridder,
                 // so copy CFs across and make valid
@@ -0,0 +1,348 @@
+/// @file
+///
+/// @brief Polarisation conversion with precomputed matrices for the gridding inner loop
+/// @details scimath::PolConverter works with casacore vectors and rebuilds its conversion
+///     matrix every time the parallactic angle is set, which is done for every row when
+///     the parallactic angle rotation is enabled. This class extracts the conversion
+///     matrix from a PolConverter and applies it with kernels specialised at compile
+///     time for the common shapes (e.g. XX,XY,YX,YY to I or to IQUV). The parallactic
+///     angle rotation is a product of one rotation per antenna, so the matrix for any
+///     pair of angles is combined from the rotations of individual angles and four
+///     matrices probed once per polarisation frame. The conventions of PolConverter
+///     are preserved exactly as the matrices are obtained by probing it with unit vectors.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/askap_synthesis.h>
+#include <askap/askap/AskapLogging.h>
+ASKAP_LOGGER(logger, ".gridding.fastpolconverter");
+
+#include <askap/gridding/FastPolConverter.h>
+#include <askap/askap/AskapError.h>
+
+#include <casacore/casa/Arrays/Vector.h>
+#include <casacore/casa/BasicSL/Constants.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace askap;
+using namespace askap::synthesis;
+
+namespace {
+
+/// @brief conversion kernel for a fixed number of polarisations
+/// @param[in] transform conversion matrix, row-major (NOut x NIn)
+/// @param[in] in input vector
+/// @param[out] out output vector
+template<casacore::uInt NIn, casacore::uInt NOut>
+void fixedConvert(const casacore::Complex *transform, const casacore::Complex *in, casacore::Complex *out,
+                  casacore::uInt, casacore::uInt)
+{
+   for (casacore::uInt row = 0; row < NOut; ++row, transform += NIn) {
+        casacore::Complex sum(0., 0.);
+        for (casacore::uInt col = 0; col < NIn; ++col) {
+             sum += transform[col] * in[col];
+        }
+        out[row] = sum;
+   }
+}
+
+/// @brief conversion kernel for an arbitrary number of polarisations
+/// @param[in] transform conversion matrix, row-major (nOut x nIn)
+/// @param[in] in input vector
+/// @param[out] out output vector
+/// @param[in] nIn number of input polarisations
+/// @param[in] nOut number of output polarisations
+void genericConvert(const casacore::Complex *transform, const casacore::Complex *in, casacore::Complex *out,
+                    casacore::uInt nIn, casacore::uInt nOut)
+{
+   for (casacore::uInt row = 0; row < nOut; ++row, transform += nIn) {
+        casacore::Complex sum(0., 0.);
+        for (casacore::uInt col = 0; col < nIn; ++col) {
+             sum += transform[col] * in[col];
+        }
+        out[row] = sum;
+   }
+}
+
+/// @brief propagate noise in quadrature
+/// @param[in] transform conversion matrix, row-major (nOut x nIn)
+/// @param[in] in input noise
+/// @param[out] out output noise
+/// @param[in] nIn number of input polarisations
+/// @param[in] nOut number of output polarisations
+void quadratureNoise(const casacore::Complex *transform, const casacore::Complex *in, casacore::Complex *out,
+                     casacore::uInt nIn, casacore::uInt nOut)
+{
+   for (casacore::uInt row = 0; row < nOut; ++row, transform += nIn) {
+        float re = 0., im = 0.;
+        for (casacore::uInt col = 0; col < nIn; ++col) {
+             const float inRe2 = casacore::square(casacore::real(in[col]));
+             const float inIm2 = casacore::square(casacore::imag(in[col]));
+             const float re2 = casacore::square(casacore::real(transform[col]));
+             const float im2 = casacore::square(casacore::imag(transform[col]));
+             re += re2 * inRe2 + im2 * inIm2;
+             im += im2 * inRe2 + re2 * inIm2;
+        }
+        out[row] = casacore::Complex(std::sqrt(re), std::sqrt(im));
+   }
+}
+
+/// @brief check that two values agree within the given relative tolerance
+bool closeEnough(const casacore::Complex &val1, const casacore::Complex &val2)
+{
+   const float tolerance = 1e-5;
+   return std::abs(val1 - val2) <= tolerance * std::max(1.f, std::abs(val1));
+}
+
+} // anonymous namespace
+
+/// @brief empty converter, init should be called before use
+FastPolConverter::FastPolConverter() : itsNIn(0), itsNOut(0), itsSwapPols(false),
+      itsConvertKernel(genericConvert), itsPATermsReady(false), itsSeparable(false), itsNoiseValid(false),
+      itsCurrentPA(0., 0.), itsCurrentPASet(false), itsConverterPA(0., 0.), itsPASet(false) {}
+
+/// @brief set up the converter
+/// @param[in] conv converter to take conversion matrices from (copied)
+/// @param[in] nIn number of input polarisations
+/// @param[in] nOut number of output polarisations
+/// @param[in] swapPols swap polarisations (passed to PolConverter before setting parallactic angles)
+void FastPolConverter::init(const scimath::PolConverter &conv, casacore::uInt nIn, casacore::uInt nOut,
+                            bool swapPols)
+{
+   ASKAPCHECK(nIn > 0 && nOut > 0, "Polarisation conversion requires non-empty frames, nIn="<<nIn<<
+              " nOut="<<nOut);
+   itsConverter = conv;
+   itsNIn = nIn;
+   itsNOut = nOut;
+   itsSwapPols = swapPols;
+   itsPASet = false;
+   itsCurrentPASet = false;
+   itsPATermsReady = false;
+   itsSeparable = false;
+   itsPATerms.clear();
+   itsRotations.clear();
+
+   if (nIn == 4 && nOut == 1) {
+       itsConvertKernel = fixedConvert<4,1>;
+   } else if (nIn == 4 && nOut == 4) {
+       itsConvertKernel = fixedConvert<4,4>;
+   } else if (nIn == 1 && nOut == 4) {
+       itsConvertKernel = fixedConvert<1,4>;
+   } else if (nIn == 2 && nOut == 1) {
+       itsConvertKernel = fixedConvert<2,1>;
+   } else if (nIn == 1 && nOut == 2) {
+       itsConvertKernel = fixedConvert<1,2>;
+   } else if (nIn == 2 && nOut == 2) {
+       itsConvertKernel = fixedConvert<2,2>;
+   } else if (nIn == 1 && nOut == 1) {
+       itsConvertKernel = fixedConvert<1,1>;
+   } else {
+       itsConvertKernel = genericConvert;
+   }
+   computeTransform(itsDefault);
+   itsTransform = itsDefault;
+   itsNoiseValid = noiseMatches(itsDefault);
+   if (!itsNoiseValid) {
+       ASKAPLOG_DEBUG_STR(logger, "Noise propagation of PolConverter is not reproduced by the conversion "
+                          "matrix, it will be used directly");
+   }
+}
+
+/// @brief set up the conversion matrix for the given parallactic angles
+/// @param[in] pa1 parallactic angle of the first antenna (radians)
+/// @param[in] pa2 parallactic angle of the second antenna (radians)
+void FastPolConverter::setParAngle(double pa1, double pa2)
+{
+   ASKAPDEBUGASSERT(itsDefault.size() == size_t(itsNIn) * itsNOut);
+   const std::pair<double, double> key(pa1, pa2);
+   if (itsCurrentPASet && itsCurrentPA == key) {
+       return;
+   }
+   if (!itsPATermsReady) {
+       initParAngleTerms();
+   }
+   if (itsSeparable) {
+       combineTransform(pa1, pa2, itsTransform);
+   } else {
+       applyParAngle(pa1, pa2);
+       computeTransform(itsTransform);
+   }
+   if (!itsNoiseValid) {
+       applyParAngle(pa1, pa2);
+   }
+   itsCurrentPA = key;
+   itsCurrentPASet = true;
+}
+
+/// @brief probe matrices of the parallactic angle rotation and verify the decomposition
+/// @details Angles of 0 and pi/2 select one of cosine or sine for each antenna, so the four
+/// matrices are obtained directly. The combination is then compared with PolConverter for
+/// angles it was not built from, which also verifies the noise propagation with a rotation.
+void FastPolConverter::initParAngleTerms()
+{
+   const size_t nElements = size_t(itsNIn) * itsNOut;
+   const double halfPi = casacore::C::pi_2;
+   const double probes[4][2] = {{0., 0.}, {0., halfPi}, {halfPi, 0.}, {halfPi, halfPi}};
+   itsPATerms.resize(4 * nElements);
+   std::vector<casacore::Complex> transform;
+   for (size_t term = 0; term < 4; ++term) {
+        applyParAngle(probes[term][0], probes[term][1]);
+        computeTransform(transform);
+        std::copy(transform.begin(), transform.end(), itsPATerms.begin() + term * nElements);
+   }
+   itsPATermsReady = true;
+   itsSeparable = true;
+
+   const double checks[2][2] = {{0.3, -1.1}, {2.5, 0.7}};
+   std::vector<casacore::Complex> combined;
+   for (size_t check = 0; check < 2; ++check) {
+        applyParAngle(checks[check][0], checks[check][1]);
+        computeTransform(transform);
+        combineTransform(checks[check][0], checks[check][1], combined);
+        for (size_t index = 0; index < nElements && itsSeparable; ++index) {
+             itsSeparable = closeEnough(transform[index], combined[index]);
+        }
+        if (itsNoiseValid && !noiseMatches(transform)) {
+            itsNoiseValid = false;
+            ASKAPLOG_DEBUG_STR(logger, "Noise propagation of PolConverter with parallactic angle rotation is "
+                               "not reproduced by the conversion matrix, it will be used directly");
+        }
+   }
+   // the cache of rotations is only used for the combination
+   itsRotations.clear();
+   if (!itsSeparable) {
+       ASKAPLOG_WARN_STR(logger, "Parallactic angle rotation of PolConverter is not a product of per-antenna "
+                         "rotations, conversion matrices will be recomputed for every pair of angles");
+   }
+}
+
+/// @brief combine the conversion matrix from the rotations of both antennas
+/// @param[in] pa1 parallactic angle of the first antenna (radians)
+/// @param[in] pa2 parallactic angle of the second antenna (radians)
+/// @param[out] transform conversion matrix, row-major (nOut x nIn)
+void FastPolConverter::combineTransform(double pa1, double pa2, std::vector<casacore::Complex> &transform)
+{
+   ASKAPDEBUGASSERT(itsPATermsReady);
+   const size_t nElements = size_t(itsNIn) * itsNOut;
+   // copies are required as the second lookup may flush the cache
+   const std::pair<double, double> rot1 = rotation(pa1);
+   const std::pair<double, double> rot2 = rotation(pa2);
+   const float cc = rot1.first * rot2.first;
+   const float cs = rot1.first * rot2.second;
+   const float sc = rot1.second * rot2.first;
+   const float ss = rot1.second * rot2.second;
+   const casacore::Complex *ccTerm = itsPATerms.data();
+   const casacore::Complex *csTerm = ccTerm + nElements;
+   const casacore::Complex *scTerm = csTerm + nElements;
+   const casacore::Complex *ssTerm = scTerm + nElements;
+   transform.resize(nElements);
+   for (size_t index = 0; index < nElements; ++index) {
+        transform[index] = cc * ccTerm[index] + cs * csTerm[index] + sc * scTerm[index] + ss * ssTerm[index];
+   }
+}
+
+/// @brief obtain the rotation for the given angle
+/// @param[in] pa parallactic angle (radians)
+/// @return cosine and sine of the angle
+const std::pair<double, double>& FastPolConverter::rotation(double pa)
+{
+   std::map<double, std::pair<double, double> >::const_iterator ci = itsRotations.find(pa);
+   if (ci == itsRotations.end()) {
+       if (itsRotations.size() >= theirMaxCacheSize) {
+           itsRotations.clear();
+       }
+       ci = itsRotations.insert(std::make_pair(pa, std::make_pair(std::cos(pa), std::sin(pa)))).first;
+   }
+   return ci->second;
+}
+
+/// @brief pass parallactic angles to itsConverter, unless they are already set
+/// @param[in] pa1 parallactic angle of the first antenna (radians)
+/// @param[in] pa2 parallactic angle of the second antenna (radians)
+void FastPolConverter::applyParAngle(double pa1, double pa2)
+{
+   const std::pair<double, double> key(pa1, pa2);
+   if (!itsPASet || itsConverterPA != key) {
+       // swap has to be set before the rotation matrix is calculated
+       itsConverter.setSwapPols(itsSwapPols);
+       itsConverter.setParAngle(pa1, pa2);
+       itsConverterPA = key;
+       itsPASet = true;
+   }
+}
+
+/// @brief propagate noise
+/// @param[out] out output noise (nOut elements)
+/// @param[in] in input noise (nIn elements)
+void FastPolConverter::noise(casacore::Complex *out, const casacore::Complex *in) const
+{
+   if (!itsNoiseValid) {
+       const casacore::Vector<casacore::Complex> inVec(casacore::IPosition(1, itsNIn),
+                                                       const_cast<casacore::Complex*>(in), casacore::SHARE);
+       casacore::Vector<casacore::Complex> outVec(casacore::IPosition(1, itsNOut), out, casacore::SHARE);
+       itsConverter.noise(outVec, inVec);
+       return;
+   }
+   quadratureNoise(itsTransform.data(), in, out, itsNIn, itsNOut);
+}
+
+/// @brief compute conversion matrix for the current state of itsConverter
+/// @details Columns of the conversion matrix are obtained by converting unit vectors.
+/// @param[out] transform conversion matrix, row-major (nOut x nIn)
+void FastPolConverter::computeTransform(std::vector<casacore::Complex> &transform) const
+{
+   transform.resize(size_t(itsNIn) * itsNOut);
+   casacore::Vector<casacore::Complex> in(itsNIn), out(itsNOut);
+   for (casacore::uInt col = 0; col < itsNIn; ++col) {
+        in.set(casacore::Complex(0., 0.));
+        in[col] = casacore::Complex(1., 0.);
+        itsConverter.convert(out, in);
+        for (casacore::uInt row = 0; row < itsNOut; ++row) {
+             transform[row * itsNIn + col] = out[row];
+        }
+   }
+}
+
+/// @brief check that itsConverter propagates noise in quadrature with the given matrix
+/// @details A vector of distinct non-zero values is used, so real and imaginary parts of
+/// the input are weighted differently.
+/// @param[in] transform conversion matrix matching the current state of itsConverter
+/// @return true if the noise of a generic input is reproduced
+bool FastPolConverter::noiseMatches(const std::vector<casacore::Complex> &transform) const
+{
+   casacore::Vector<casacore::Complex> in(itsNIn), expected(itsNOut), result(itsNOut);
+   for (casacore::uInt col = 0; col < itsNIn; ++col) {
+        in[col] = casacore::Complex(1. + 0.37 * col, 0.5 + 0.71 * col);
+   }
+   itsConverter.noise(expected, in);
+   quadratureNoise(transform.data(), in.data(), result.data(), itsNIn, itsNOut);
+   for (casacore::uInt row = 0; row < itsNOut; ++row) {
+        if (!closeEnough(expected[row], result[row])) {
+            return false;
+        }
+   }
+   return true;
+}
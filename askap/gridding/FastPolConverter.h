@@ -0,0 +1,197 @@
+/// @file
+///
+/// @brief Polarisation conversion with precomputed matrices for the gridding inner loop
+/// @details scimath::PolConverter works with casacore vectors and rebuilds its conversion
+///     matrix every time the parallactic angle is set, which is done for every row when
+///     the parallactic angle rotation is enabled. This class extracts the conversion
+///     matrix from a PolConverter and applies it with kernels specialised at compile
+///     time for the common shapes (e.g. XX,XY,YX,YY to I or to IQUV). The parallactic
+///     angle rotation is a product of one rotation per antenna, so the matrix for any
+///     pair of angles is combined from the rotations of individual angles and four
+///     matrices probed once per polarisation frame. The conventions of PolConverter
+///     are preserved exactly as the matrices are obtained by probing it with unit vectors.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#ifndef ASKAP_SYNTHESIS_FAST_POL_CONVERTER_H
+#define ASKAP_SYNTHESIS_FAST_POL_CONVERTER_H
+
+#include <askap/scimath/utils/PolConverter.h>
+#include <casacore/casa/BasicSL/Complex.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace askap {
+
+namespace synthesis {
+
+/// @brief Polarisation conversion with precomputed matrices
+/// @details The converter is set up from a PolConverter and then used with raw pointers
+/// to the input and output polarisation vectors. The parallactic angle rotation of linear
+/// feeds applies a rotation by pa1 to the first antenna and by pa2 to the second one, so every
+/// element of the conversion matrix is a bilinear combination of cos(pa1), sin(pa1) and
+/// cos(pa2), sin(pa2). The four matrices of this combination are probed from PolConverter
+/// when the first parallactic angle is set and the decomposition is verified on angles it was
+/// not built from. Rotations (cosine and sine) are cached per distinct angle, so each row costs
+/// two cache lookups and a weighted sum of four small matrices. If PolConverter does not follow
+/// this model, matrices are probed from it for every new pair of angles.
+/// Noise is propagated in quadrature: the real (imaginary) part of the output noise is the
+/// square root of a weighted sum of squares of the real and imaginary parts of the input noise,
+/// with weights given by the squared real and imaginary parts of the conversion matrix. This is
+/// verified against PolConverter::noise once per polarisation frame; if PolConverter propagates
+/// noise in a different way, the noise method falls back to it.
+/// @ingroup gridding
+class FastPolConverter {
+public:
+   /// @brief empty converter, init should be called before use
+   FastPolConverter();
+
+   /// @brief set up the converter
+   /// @details The cache of rotations is cleared.
+   /// @param[in] conv converter to take conversion matrices from (copied)
+   /// @param[in] nIn number of input polarisations
+   /// @param[in] nOut number of output polarisations
+   /// @param[in] swapPols swap polarisations (passed to PolConverter before setting parallactic angles)
+   void init(const scimath::PolConverter &conv, casacore::uInt nIn, casacore::uInt nOut, bool swapPols = false);
+
+   /// @brief set up the conversion matrix for the given parallactic angles
+   /// @details Without a call to this method, the converter is used with its parallactic
+   /// angles as given to init.
+   /// @param[in] pa1 parallactic angle of the first antenna (radians)
+   /// @param[in] pa2 parallactic angle of the second antenna (radians)
+   void setParAngle(double pa1, double pa2);
+
+   /// @brief convert polarisation vector
+   /// @param[out] out output vector (nOut elements)
+   /// @param[in] in input vector (nIn elements)
+   inline void convert(casacore::Complex *out, const casacore::Complex *in) const
+   { itsConvertKernel(itsTransform.data(), in, out, itsNIn, itsNOut); }
+
+   /// @brief propagate noise
+   /// @param[out] out output noise (nOut elements)
+   /// @param[in] in input noise (nIn elements)
+   void noise(casacore::Complex *out, const casacore::Complex *in) const;
+
+   /// @return number of cached rotations (one per distinct angle)
+   size_t cacheSize() const { return itsRotations.size(); }
+
+   /// @return true if matrices are combined from the rotations of individual antennas
+   /// @note The decomposition is checked when the first parallactic angle is set, false is
+   /// returned before that.
+   bool separable() const { return itsPATermsReady && itsSeparable; }
+
+   /// @return true if the noise is propagated without PolConverter
+   bool fastNoise() const { return itsNoiseValid; }
+
+   /// @brief maximum number of cached rotations
+   static const size_t theirMaxCacheSize = 1024;
+
+private:
+   /// @brief signature of the conversion kernels
+   typedef void (*ConvertKernel)(const casacore::Complex *, const casacore::Complex *, casacore::Complex *,
+                                 casacore::uInt, casacore::uInt);
+
+   /// @brief compute conversion matrix for the current state of itsConverter
+   /// @param[out] transform conversion matrix, row-major (nOut x nIn)
+   void computeTransform(std::vector<casacore::Complex> &transform) const;
+
+   /// @brief check that itsConverter propagates noise in quadrature with the given matrix
+   /// @param[in] transform conversion matrix matching the current state of itsConverter
+   /// @return true if the noise of a generic input is reproduced
+   bool noiseMatches(const std::vector<casacore::Complex> &transform) const;
+
+   /// @brief probe matrices of the parallactic angle rotation and verify the decomposition
+   void initParAngleTerms();
+
+   /// @brief combine the conversion matrix from the rotations of both antennas
+   /// @param[in] pa1 parallactic angle of the first antenna (radians)
+   /// @param[in] pa2 parallactic angle of the second antenna (radians)
+   /// @param[out] transform conversion matrix, row-major (nOut x nIn)
+   void combineTransform(double pa1, double pa2, std::vector<casacore::Complex> &transform);
+
+   /// @brief obtain the rotation for the given angle
+   /// @param[in] pa parallactic angle (radians)
+   /// @return cosine and sine of the angle
+   const std::pair<double, double>& rotation(double pa);
+
+   /// @brief pass parallactic angles to itsConverter, unless they are already set
+   /// @param[in] pa1 parallactic angle of the first antenna (radians)
+   /// @param[in] pa2 parallactic angle of the second antenna (radians)
+   void applyParAngle(double pa1, double pa2);
+
+   /// @brief converter matrices are obtained from
+   mutable scimath::PolConverter itsConverter;
+
+   /// @brief number of input and output polarisations
+   casacore::uInt itsNIn;
+   casacore::uInt itsNOut;
+
+   /// @brief swap polarisations flag passed to itsConverter
+   bool itsSwapPols;
+
+   /// @brief kernel selected for the shape of the conversion
+   ConvertKernel itsConvertKernel;
+
+   /// @brief conversion matrix for the converter as given to init
+   std::vector<casacore::Complex> itsDefault;
+
+   /// @brief current conversion matrix, row-major (nOut x nIn)
+   std::vector<casacore::Complex> itsTransform;
+
+   /// @brief matrices multiplied by cos(pa1)cos(pa2), cos(pa1)sin(pa2), sin(pa1)cos(pa2) and
+   /// sin(pa1)sin(pa2), stored one after another
+   std::vector<casacore::Complex> itsPATerms;
+
+   /// @brief true if itsPATerms have been probed and verified
+   bool itsPATermsReady;
+
+   /// @brief true if the conversion matrix is a bilinear combination of per-antenna rotations
+   bool itsSeparable;
+
+   /// @brief true if noise is propagated in quadrature with the conversion matrix
+   bool itsNoiseValid;
+
+   /// @brief cached rotations (cosine and sine) indexed by angle
+   std::map<double, std::pair<double, double> > itsRotations;
+
+   /// @brief parallactic angles of the current conversion matrix
+   std::pair<double, double> itsCurrentPA;
+
+   /// @brief true if the current conversion matrix corresponds to itsCurrentPA
+   bool itsCurrentPASet;
+
+   /// @brief parallactic angles currently set in itsConverter
+   std::pair<double, double> itsConverterPA;
+
+   /// @brief true if itsConverter has been given parallactic angles
+   bool itsPASet;
+};
+
+} // namespace synthesis
+
+} // namespace askap
+
+#endif // #ifndef ASKAP_SYNTHESIS_FAST_POL_CONVERTER_H
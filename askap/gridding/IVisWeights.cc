@@ -35,5 +35,17 @@ namespace askap
     IVisWeights::~IVisWeights()
     {
     }
+
+    /// @brief Calculate visibility weights for all channels at once
+    /// @param[in] freqs frequencies of all channels
+    /// @param[out] weights weights for all channels (resized as necessary)
+    void IVisWeights::getWeights(const casacore::Vector<casacore::Double> &freqs,
+                                 casacore::Vector<float> &weights)
+    {
+      weights.resize(freqs.nelements());
+      for (casacore::uInt chan = 0; chan < freqs.nelements(); ++chan) {
+           weights[chan] = getWeight(0, freqs[chan], 0);
+      }
+    }
   }
 }
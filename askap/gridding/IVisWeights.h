@@ -76,6 +76,16 @@ namespace askap
 			/// @param pol Polarization index
 			virtual float getWeight(int i, double freq, int pol) = 0;
 
+			/// @brief Calculate visibility weights for all channels at once
+			/// @details Gridders call this method once per accessor instead of calling
+			/// getWeight for every sample. Weights are therefore assumed to depend on
+			/// frequency only. The default implementation calls getWeight for every
+			/// channel with zero sample and polarisation indices.
+			/// @param[in] freqs frequencies of all channels
+			/// @param[out] weights weights for all channels (resized as necessary)
+			virtual void getWeights(const casacore::Vector<casacore::Double> &freqs,
+			                        casacore::Vector<float> &weights);
+
 		};
 	}
 }
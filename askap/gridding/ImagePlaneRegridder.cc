@@ -0,0 +1,242 @@
+/// @file
+///
+/// @brief Regridder of 2D image planes between direction coordinates
+/// @details This class is an alternative to casacore::ImageRegrid for the case
+///     encountered in snap-shot imaging: the input and output planes have the same
+///     shape and direction coordinates differing only by the projection. The pixel
+///     mapping between a pair of coordinates is computed once (exactly, without
+///     decimation) and cached, so repeated regrids between the same planes only cost
+///     the interpolation.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/askap_synthesis.h>
+#include <askap/askap/AskapLogging.h>
+ASKAP_LOGGER(logger, ".gridding.imageplaneregridder");
+
+#include <askap/gridding/ImagePlaneRegridder.h>
+#include <askap/askap/AskapError.h>
+#include <askap/profile/AskapProfiler.h>
+
+#include <casacore/casa/Arrays/Vector.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace askap;
+using namespace askap::synthesis;
+
+namespace {
+
+/// @brief marker of output pixels without a valid input position
+const float invalidPixel = -10.f;
+
+} // anonymous namespace
+
+/// @brief construct the regridder
+/// @param[in] method interpolation method
+/// @param[in] cacheSizeMB memory budget for cached mappings in MB (0 disables caching)
+ImagePlaneRegridder::ImagePlaneRegridder(const casacore::Interpolate2D::Method method,
+                                         const size_t cacheSizeMB) :
+    itsMethod(method), itsCacheSize(cacheSizeMB * 1048576), itsCacheHits(0), itsCacheMisses(0) {}
+
+/// @brief parameters uniquely defining a direction coordinate
+void ImagePlaneRegridder::appendKey(std::vector<double> &key, const casacore::DirectionCoordinate &dc)
+{
+   key.push_back(double(dc.directionType()));
+   key.push_back(double(dc.projection().type()));
+   const casacore::Vector<casacore::Double> params = dc.projection().parameters();
+   key.push_back(double(params.nelements()));
+   key.insert(key.end(), params.begin(), params.end());
+   const casacore::Vector<casacore::Double> refVal = dc.referenceValue();
+   key.insert(key.end(), refVal.begin(), refVal.end());
+   const casacore::Vector<casacore::Double> refPix = dc.referencePixel();
+   key.insert(key.end(), refPix.begin(), refPix.end());
+   const casacore::Vector<casacore::Double> inc = dc.increment();
+   key.insert(key.end(), inc.begin(), inc.end());
+   const casacore::Matrix<casacore::Double> xform = dc.linearTransform();
+   key.insert(key.end(), xform.begin(), xform.end());
+}
+
+/// @brief get the mapping from the cache or compute it
+boost::shared_ptr<ImagePlaneRegridder::Mapping> ImagePlaneRegridder::mapping(
+      const casacore::DirectionCoordinate &dcIn, const casacore::DirectionCoordinate &dcOut,
+      const casacore::IPosition &shape) const
+{
+   std::vector<double> key;
+   appendKey(key, dcIn);
+   appendKey(key, dcOut);
+   for (std::list<boost::shared_ptr<Mapping> >::iterator it = itsCache.begin(); it != itsCache.end(); ++it) {
+        if ((*it)->key == key && (*it)->shape.isEqual(shape)) {
+            // move to the front
+            boost::shared_ptr<Mapping> map = *it;
+            itsCache.erase(it);
+            itsCache.push_front(map);
+            ++itsCacheHits;
+            return map;
+        }
+   }
+   ++itsCacheMisses;
+   boost::shared_ptr<Mapping> map(new Mapping);
+   map->key = key;
+   map->shape = shape;
+   computeMapping(*map, dcIn, dcOut);
+
+   const size_t mapSize = 2 * sizeof(float) * shape.product();
+   if (mapSize <= itsCacheSize) {
+       size_t used = mapSize;
+       for (std::list<boost::shared_ptr<Mapping> >::const_iterator ci = itsCache.begin(); ci != itsCache.end(); ++ci) {
+            used += 2 * sizeof(float) * (*ci)->shape.product();
+       }
+       while (used > itsCacheSize && !itsCache.empty()) {
+            used -= 2 * sizeof(float) * itsCache.back()->shape.product();
+            itsCache.pop_back();
+       }
+       itsCache.push_front(map);
+   }
+   return map;
+}
+
+/// @brief compute the mapping
+void ImagePlaneRegridder::computeMapping(Mapping &map, const casacore::DirectionCoordinate &dcIn,
+                                         const casacore::DirectionCoordinate &dcOut)
+{
+   ASKAPDEBUGTRACE("ImagePlaneRegridder::computeMapping");
+   ASKAPCHECK(dcIn.directionType() == dcOut.directionType(),
+        "ImagePlaneRegridder expects both planes in the same direction frame");
+   ASKAPDEBUGASSERT(map.shape.nelements() == 2);
+   const int nx = map.shape(0);
+   const int ny = map.shape(1);
+   map.x.resize(size_t(nx) * ny);
+   map.y.resize(size_t(nx) * ny);
+
+   #pragma omp parallel default(shared)
+   {
+       // coordinate conversions are not thread-safe, each thread works with its own copy
+       const casacore::DirectionCoordinate in(dcIn);
+       const casacore::DirectionCoordinate out(dcOut);
+       casacore::Vector<casacore::Double> pixel(2);
+       casacore::Vector<casacore::Double> world(2);
+       casacore::Vector<casacore::Double> inPixel(2);
+
+       #pragma omp for schedule(static)
+       for (int j = 0; j < ny; ++j) {
+            const size_t offset = size_t(j) * nx;
+            pixel[1] = j;
+            for (int i = 0; i < nx; ++i) {
+                 pixel[0] = i;
+                 if (out.toWorld(world, pixel) && in.toPixel(inPixel, world)) {
+                     map.x[offset + i] = float(inPixel[0]);
+                     map.y[offset + i] = float(inPixel[1]);
+                 } else {
+                     map.x[offset + i] = invalidPixel;
+                     map.y[offset + i] = invalidPixel;
+                 }
+            }
+       }
+   }
+}
+
+/// @brief regrid a plane
+/// @details Output pixels mapping outside the input plane (or outside the valid
+/// region of the projection) are set to zero, as done by ImageRegrid.
+/// @param[in] in input plane
+/// @param[in] dcIn direction coordinate of the input plane
+/// @param[in] out output plane, should have the same shape as the input
+/// @param[in] dcOut direction coordinate of the output plane
+/// @param[in] add if true, the result is added to the output rather than assigned
+void ImagePlaneRegridder::regrid(const casacore::Matrix<imtype> &in, const casacore::DirectionCoordinate &dcIn,
+               casacore::Matrix<imtype> &out, const casacore::DirectionCoordinate &dcOut,
+               const bool add) const
+{
+   ASKAPTRACE("ImagePlaneRegridder::regrid");
+   ASKAPCHECK(in.shape().isEqual(out.shape()), "Input and output planes should have the same shape, you have "<<
+              in.shape()<<" and "<<out.shape());
+   const boost::shared_ptr<Mapping> map = mapping(dcIn, dcOut, in.shape());
+   ASKAPDEBUGASSERT(map);
+   const int nx = in.nrow();
+   const int ny = in.ncolumn();
+   ASKAPCHECK(nx > 1 && ny > 1, "ImagePlaneRegridder requires at least 2 pixels along each axis");
+
+   bool deleteIn, deleteOut;
+   const imtype *inData = in.getStorage(deleteIn);
+   imtype *outData = out.getStorage(deleteOut);
+   const float *mx = map->x.data();
+   const float *my = map->y.data();
+   const casacore::Interpolate2D::Method method = itsMethod;
+
+   #pragma omp parallel default(shared)
+   {
+       // only used by the generic interpolation methods
+       const casacore::Interpolate2D interpolator(method);
+       casacore::Vector<casacore::Double> where(2);
+
+       #pragma omp for schedule(static)
+       for (int j = 0; j < ny; ++j) {
+            const size_t offset = size_t(j) * nx;
+            const float *rowX = mx + offset;
+            const float *rowY = my + offset;
+            imtype *rowOut = outData + offset;
+            if (method == casacore::Interpolate2D::LINEAR) {
+                for (int i = 0; i < nx; ++i) {
+                     const float x = rowX[i];
+                     const float y = rowY[i];
+                     const bool valid = (x >= 0.f) && (x <= float(nx - 1)) && (y >= 0.f) && (y <= float(ny - 1));
+                     // the last pixel is interpolated from the last pair of pixels
+                     const int ix = valid ? std::min(int(x), nx - 2) : 0;
+                     const int iy = valid ? std::min(int(y), ny - 2) : 0;
+                     const imtype t = x - ix;
+                     const imtype u = y - iy;
+                     const imtype *p = inData + size_t(iy) * nx + ix;
+                     const imtype value = (1 - t) * (1 - u) * p[0] + t * (1 - u) * p[1] +
+                                          t * u * p[nx + 1] + (1 - t) * u * p[nx];
+                     const imtype result = valid ? value : imtype(0);
+                     rowOut[i] = add ? rowOut[i] + result : result;
+                }
+            } else if (method == casacore::Interpolate2D::NEAREST) {
+                for (int i = 0; i < nx; ++i) {
+                     const int ix = int(std::floor(rowX[i] + 0.5f));
+                     const int iy = int(std::floor(rowY[i] + 0.5f));
+                     const bool valid = (rowX[i] != invalidPixel) && (ix >= 0) && (ix < nx) && (iy >= 0) && (iy < ny);
+                     const imtype result = valid ? inData[size_t(iy) * nx + ix] : imtype(0);
+                     rowOut[i] = add ? rowOut[i] + result : result;
+                }
+            } else {
+                for (int i = 0; i < nx; ++i) {
+                     imtype result = 0;
+                     if (rowX[i] != invalidPixel) {
+                         where[0] = rowX[i];
+                         where[1] = rowY[i];
+                         if (!interpolator.interp(result, where, in)) {
+                             result = 0;
+                         }
+                     }
+                     rowOut[i] = add ? rowOut[i] + result : result;
+                }
+            }
+       }
+   }
+   in.freeStorage(inData, deleteIn);
+   out.putStorage(outData, deleteOut);
+}
@@ -0,0 +1,126 @@
+/// @file
+///
+/// @brief Regridder of 2D image planes between direction coordinates
+/// @details This class is an alternative to casacore::ImageRegrid for the case
+///     encountered in snap-shot imaging: the input and output planes have the same
+///     shape and direction coordinates differing only by the projection. The pixel
+///     mapping between a pair of coordinates is computed once (exactly, without
+///     decimation) and cached, so repeated regrids between the same planes only cost
+///     the interpolation. Both the mapping and the interpolation are parallelised over
+///     rows with OpenMP, linear and nearest interpolation are done in tight loops over
+///     the cached coordinates. Cubic interpolation uses casacore::Interpolate2D on the
+///     cached coordinates, so the result matches ImageRegrid without decimation.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#ifndef ASKAP_SYNTHESIS_IMAGE_PLANE_REGRIDDER_H
+#define ASKAP_SYNTHESIS_IMAGE_PLANE_REGRIDDER_H
+
+#include <askap/gridding/IVisGridder.h>
+#include <boost/shared_ptr.hpp>
+#include <casacore/coordinates/Coordinates/DirectionCoordinate.h>
+#include <casacore/scimath/Mathematics/Interpolate2D.h>
+#include <casacore/casa/Arrays/Matrix.h>
+
+#include <list>
+#include <vector>
+
+namespace askap {
+
+namespace synthesis {
+
+/// @brief Regridder of 2D image planes with a cache of coordinate mappings
+/// @details The cache is bounded by the memory budget given at construction; the
+/// least recently used mapping is dropped first. Each cached mapping takes
+/// 2 * sizeof(float) bytes per output pixel.
+/// @ingroup gridding
+class ImagePlaneRegridder {
+public:
+   /// @brief construct the regridder
+   /// @param[in] method interpolation method
+   /// @param[in] cacheSizeMB memory budget for cached mappings in MB (0 disables caching)
+   explicit ImagePlaneRegridder(const casacore::Interpolate2D::Method method,
+                                const size_t cacheSizeMB = 512);
+
+   /// @brief regrid a plane
+   /// @details Output pixels mapping outside the input plane (or outside the valid
+   /// region of the projection) are set to zero, as done by ImageRegrid.
+   /// @param[in] in input plane
+   /// @param[in] dcIn direction coordinate of the input plane
+   /// @param[in] out output plane, should have the same shape as the input
+   /// @param[in] dcOut direction coordinate of the output plane
+   /// @param[in] add if true, the result is added to the output rather than assigned
+   void regrid(const casacore::Matrix<imtype> &in, const casacore::DirectionCoordinate &dcIn,
+               casacore::Matrix<imtype> &out, const casacore::DirectionCoordinate &dcOut,
+               const bool add) const;
+
+   /// @return number of regrids which reused a cached mapping
+   unsigned long cacheHits() const { return itsCacheHits; }
+
+   /// @return number of regrids which had to compute the mapping
+   unsigned long cacheMisses() const { return itsCacheMisses; }
+
+private:
+   /// @brief pixel mapping between two coordinates
+   struct Mapping {
+      /// @brief parameters of both coordinates identifying this mapping
+      std::vector<double> key;
+      /// @brief shape of the planes
+      casacore::IPosition shape;
+      /// @brief input pixel coordinates for each output pixel, negative if invalid
+      std::vector<float> x;
+      std::vector<float> y;
+   };
+
+   /// @brief parameters uniquely defining a direction coordinate
+   static void appendKey(std::vector<double> &key, const casacore::DirectionCoordinate &dc);
+
+   /// @brief get the mapping from the cache or compute it
+   boost::shared_ptr<Mapping> mapping(const casacore::DirectionCoordinate &dcIn,
+                                      const casacore::DirectionCoordinate &dcOut,
+                                      const casacore::IPosition &shape) const;
+
+   /// @brief compute the mapping
+   static void computeMapping(Mapping &map, const casacore::DirectionCoordinate &dcIn,
+                              const casacore::DirectionCoordinate &dcOut);
+
+   /// @brief interpolation method
+   casacore::Interpolate2D::Method itsMethod;
+
+   /// @brief memory budget for the cache in bytes
+   size_t itsCacheSize;
+
+   /// @brief cached mappings, most recently used first
+   mutable std::list<boost::shared_ptr<Mapping> > itsCache;
+
+   /// @brief stats
+   mutable unsigned long itsCacheHits;
+   mutable unsigned long itsCacheMisses;
+};
+
+} // namespace synthesis
+
+} // namespace askap
+
+#endif // #ifndef ASKAP_SYNTHESIS_IMAGE_PLANE_REGRIDDER_H
@@ -80,7 +80,8 @@ SnapShotImagingGridderAdapter::SnapShotImagingGridderAdapter(const boost::shared
      itsNumOfInitialisations(0), itsLastFitTimeStamp(0.), itsShortestIntervalBetweenFits(3e7),
      itsLongestIntervalBetweenFits(-1.), itsModelIsEmpty(false), itsClippingFactor(0.),
      itsWeightsClippingFactor(0.), itsNoPSFReprojection(true),
-     itsDecimationFactor(decimate), itsInterpolationMethod(method), itsPredictWPlane(doPredictWPlane)
+     itsDecimationFactor(decimate), itsInterpolationMethod(method), itsPredictWPlane(doPredictWPlane),
+     itsRegridCacheSize(0)
 {
   ASKAPCHECK(gridder, "SnapShotImagingGridderAdapter should only be initialised with a valid gridder");
   itsGridder = gridder->clone();
@@ -102,14 +103,18 @@ SnapShotImagingGridderAdapter::SnapShotImagingGridderAdapter(const SnapShotImagi
     itsTempInImg(), itsTempOutImg(), itsModelIsEmpty(other.itsModelIsEmpty),
     itsClippingFactor(other.itsClippingFactor), itsWeightsClippingFactor(other.itsWeightsClippingFactor),
     itsNoPSFReprojection(other.itsNoPSFReprojection), itsDecimationFactor(other.itsDecimationFactor),
-    itsInterpolationMethod(other.itsInterpolationMethod), itsPredictWPlane(other.itsPredictWPlane)
+    itsInterpolationMethod(other.itsInterpolationMethod), itsPredictWPlane(other.itsPredictWPlane),
+    itsRegridCacheSize(other.itsRegridCacheSize)
 {
   ASKAPCHECK(other.itsGridder,
        "copy constructor of SnapShotImagingGridderAdapter got an object somehow set up with an empty gridder");
   ASKAPCHECK(!other.itsAccessorAdapter.isAssociated(),
      "An attempt to copy gridder adapter with the accessor adapter associated with some real data accessor. This shouldn't happen.");
   itsGridder = other.itsGridder->clone();
-
+  if (other.itsPlaneRegridder) {
+      // the cache is not shared between copies
+      setFastRegridding(true, other.itsRegridCacheSize);
+  }
 }
 
 /// @brief destructor just to print some stats
@@ -132,6 +137,11 @@ SnapShotImagingGridderAdapter::~SnapShotImagingGridderAdapter()
           ASKAPLOG_INFO_STR(logger, "   Average time spent per image plane regridding is "<<
                       itsTimeImageRegrid/double(itsNumOfImageRegrids)<<" (s)");
       }
+      if (itsPlaneRegridder) {
+          ASKAPLOG_INFO_STR(logger, "   Cached coordinate mappings were reused for "<<
+                      itsPlaneRegridder->cacheHits()<<" planes and computed for "<<
+                      itsPlaneRegridder->cacheMisses()<<" planes");
+      }
       reportAndInitIntervalStats();
   }
 }
@@ -514,6 +524,31 @@ void SnapShotImagingGridderAdapter::imageRegrid(const casacore::Array<imtype> &i
    // form coordinate systems
    const casacore::DirectionCoordinate dcCurrent = currentPlaneDirectionCoordinate();
    const casacore::DirectionCoordinate& dcTarget = itsAxes.directionAxis();
+
+   // iterator over planes
+   scimath::MultiDimArrayPlaneIter planeIter(input.shape());
+
+   if (itsPlaneRegridder && !isPCFGridder()) {
+       // fast path with cached coordinate mapping, the PCF still goes through ImageRegrid
+       const casacore::DirectionCoordinate& dcInput = toTarget ? dcCurrent : dcTarget;
+       const casacore::DirectionCoordinate& dcOutput = toTarget ? dcTarget : dcCurrent;
+       for (; planeIter.hasMore(); planeIter.next()) {
+            const casacore::Matrix<imtype> inPlane(planeIter.getPlane(inRef).nonDegenerate());
+            // the next line does not do any copying (reference semantics)
+            casacore::Array<imtype> outRef(planeIter.getPlane(output).nonDegenerate());
+            casacore::Matrix<imtype> outPlane(outRef);
+            itsPlaneRegridder->regrid(inPlane, dcInput, outPlane, dcOutput, toTarget);
+            // optional clipping
+            if (isWeights and (itsWeightsClippingFactor != 0.)) {
+              imageClip(outRef, itsWeightsClippingFactor);
+            } else {
+              imageClip(outRef, itsClippingFactor);
+            }
+       }
+       itsTimeImageRegrid += timer.real();
+       return;
+   }
+
    casacore::CoordinateSystem csInput;
    casacore::CoordinateSystem csOutput;
    if (toTarget) {
@@ -524,9 +559,6 @@ void SnapShotImagingGridderAdapter::imageRegrid(const casacore::Array<imtype> &i
       csOutput.addCoordinate(dcCurrent);
    }
 
-   // iterator over planes
-   scimath::MultiDimArrayPlaneIter planeIter(input.shape());
-
    // regridder
    casacore::ImageRegrid<imtype> regridder;
    // regridder works with images, so we have to setup temporary 2D images
@@ -687,6 +719,23 @@ void SnapShotImagingGridderAdapter::setWeightsClippingFactor(const float factor)
   itsWeightsClippingFactor = factor;
 }
 
+/// @brief switch fast image plane regridding on or off
+/// @details If switched on, image planes are regridded with ImagePlaneRegridder which caches
+/// the exact pixel mapping for each pair of fit planes and interpolates in parallel instead of
+/// using casacore::ImageRegrid (the coordinate decimation factor is ignored in this case).
+/// The preconditioner function is always regridded with ImageRegrid.
+/// @param[in] fast true to use the fast regridder
+/// @param[in] cacheSizeMB memory budget for cached mappings in MB
+void SnapShotImagingGridderAdapter::setFastRegridding(const bool fast, const size_t cacheSizeMB)
+{
+  itsRegridCacheSize = cacheSizeMB;
+  if (fast) {
+      itsPlaneRegridder.reset(new ImagePlaneRegridder(itsInterpolationMethod, cacheSizeMB));
+  } else {
+      itsPlaneRegridder.reset();
+  }
+}
+
 /// @brief clip image
 /// @details This method clips the image by zeroing the edges according to the
 /// assigned clipping factor.
@@ -42,6 +42,7 @@
 #define SNAP_SHOT_IMAGING_GRIDDER_ADAPTER_H
 
 #include <askap/gridding/IVisGridder.h>
+#include <askap/gridding/ImagePlaneRegridder.h>
 #include <boost/shared_ptr.hpp>
 #include <askap/dataaccess/BestWPlaneDataAccessor.h>
 #include <askap/scimath/fitting/Axes.h>
@@ -159,6 +160,15 @@ public:
    /// @param[in] factor clipping factor
    void setWeightsClippingFactor(const float factor);
 
+   /// @brief switch fast image plane regridding on or off
+   /// @details If switched on, image planes are regridded with ImagePlaneRegridder which caches
+   /// the exact pixel mapping for each pair of fit planes and interpolates in parallel instead of
+   /// using casacore::ImageRegrid (the coordinate decimation factor is ignored in this case).
+   /// The preconditioner function is always regridded with ImageRegrid.
+   /// @param[in] fast true to use the fast regridder
+   /// @param[in] cacheSizeMB memory budget for cached mappings in MB
+   void setFastRegridding(const bool fast, const size_t cacheSizeMB = 512);
+
    /// @brief control whether to do image reprojection for PSF
    /// @details By default we bypass image reprojection for the PSF. It can be changed with this configuration method.
    /// @param[in] doIt if true, image reprojection will be done for PSF the same way dirty image and weight are processed,
@@ -384,6 +394,12 @@ private:
 
    ///@brief Use the predicted W plane ... or not
    bool itsPredictWPlane;
+
+   /// @brief fast regridder, empty if ImageRegrid is used
+   boost::shared_ptr<ImagePlaneRegridder> itsPlaneRegridder;
+
+   /// @brief memory budget for cached coordinate mappings in MB
+   size_t itsRegridCacheSize;
 };
 
 } // namespace synthesis
@@ -45,6 +45,7 @@ ASKAP_LOGGER(logger, ".gridding.tablevisgridder");
 #include <askap/scimath/fitting/ParamsCasaTable.h>
 
 #include <askap/gridding/GridKernel.h>
+#include <askap/utils/MetricsRegistry.h>
 
 #include <askap/scimath/utils/PaddingUtils.h>
 #include <askap/measurementequation/ImageParamsHelper.h>
@@ -59,6 +60,7 @@ using namespace askap;
 #include <ostream>
 #include <sstream>
 #include <iomanip>
+#include <mutex>
 
 #include <casacore/casa/OS/Timer.h>
 
@@ -86,6 +88,11 @@ void deepCopyOfSTDVector(const std::vector<T> &in,
 /// @brief required to mediate thread safety issues of the casa cube
 utility::CasaSyncHelper syncHelper;
 
+/// @brief serialises the set up part of generic for gridders running concurrently
+/// @details Convolution functions may be shared between gridders (or use FFTs) and
+/// the accessor caches rotated uvw and delays for one tangent point only.
+std::mutex setupMutex;
+
 // DDCALTAG -- itsSourceIndex added to all of the constructors
 TableVisGridder::TableVisGridder() : itsSumWeights(),
     itsSupport(-1), itsOverSample(-1),
@@ -97,7 +104,8 @@ TableVisGridder::TableVisGridder() : itsSumWeights(),
     itsMaxPointingSeparation(-1.), itsRowsRejectedDueToMaxPointingSeparation(0),
     itsTrackWeightPerOversamplePlane(false),itsPARotation(false),itsSwapPols(false),
     its2dGrid(),itsVisPols(),itsPolConv(),itsImagePolFrameVis(),itsImagePolFrameNoise(),
-    itsPolVector(),itsImageChan(-1),itsGridIndex(-1),itsSourceIndex(0),itsClearGrid(false)
+    itsPolVector(),itsImageChan(-1),itsGridIndex(-1),itsSourceIndex(0),itsClearGrid(false),
+    itsSubtractModel(false)
 {
 }
 
@@ -112,7 +120,8 @@ TableVisGridder::TableVisGridder(const int overSample, const int support,
     itsMaxPointingSeparation(-1.), itsRowsRejectedDueToMaxPointingSeparation(0),
     itsTrackWeightPerOversamplePlane(false),itsPARotation(false),itsSwapPols(false),
     its2dGrid(),itsVisPols(),itsPolConv(),itsImagePolFrameVis(),itsImagePolFrameNoise(),
-    itsPolVector(),itsImageChan(-1),itsGridIndex(-1),itsSourceIndex(0),itsClearGrid(false)
+    itsPolVector(),itsImageChan(-1),itsGridIndex(-1),itsSourceIndex(0),itsClearGrid(false),
+    itsSubtractModel(false)
 {
    ASKAPCHECK(overSample>0, "Oversampling must be greater than 0");
    ASKAPCHECK(support>=0, "Maximum support must be zero or greater");
@@ -139,6 +148,7 @@ TableVisGridder::TableVisGridder(const TableVisGridder &other) :
      itsTimeConvFunctions(other.itsTimeConvFunctions),
      itsTimeGridded(other.itsTimeGridded),
      itsTimeDegridded(other.itsTimeDegridded),
+     itsPublishedStats(other.itsPublishedStats),
      itsDopsf(other.itsDopsf),
      itsDopcf(other.itsDopcf),
      itsFirstGriddedVis(other.itsFirstGriddedVis),
@@ -153,10 +163,10 @@ TableVisGridder::TableVisGridder(const TableVisGridder &other) :
      itsPARotation(other.itsPARotation), itsPARotAngle(other.itsPARotAngle),
      itsSwapPols(other.itsSwapPols),
      its2dGrid(other.its2dGrid.copy()),itsVisPols(other.itsVisPols.copy()),
-     itsPolConv(other.itsPolConv),itsImagePolFrameVis(other.itsImagePolFrameVis.copy()),
+     itsPolConv(other.itsPolConv),itsFastPolConv(other.itsFastPolConv),itsImagePolFrameVis(other.itsImagePolFrameVis.copy()),
      itsImagePolFrameNoise(other.itsImagePolFrameNoise.copy()),itsPolVector(other.itsPolVector.copy()),
      itsImageChan(other.itsImageChan),itsGridIndex(other.itsGridIndex),itsSourceIndex(other.itsSourceIndex),
-     itsClearGrid(other.itsClearGrid)
+     itsClearGrid(other.itsClearGrid),itsSubtractModel(other.itsSubtractModel)
 {
    deepCopyOfSTDVector(other.itsConvFunc,itsConvFunc);
    deepCopyOfSTDVector(other.itsGrid, itsGrid);
@@ -449,8 +459,19 @@ void TableVisGridder::logCFCacheStats() const
 
 /// This is a generic grid/degrid
 void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
+   generic(acc, forward, std::vector<boost::shared_ptr<TableVisGridder> >());
+}
+
+/// Generic grid/degrid for a number of gridders sharing indices and convolution functions
+void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward,
+                              const std::vector<boost::shared_ptr<TableVisGridder> > &terms) {
    ASKAPDEBUGTRACE("TableVisGridder::generic");
-  if (forward&&itsModelIsEmpty)
+   bool allModelsEmpty = itsModelIsEmpty;
+   for (size_t term = 0; term < terms.size(); ++term) {
+        ASKAPDEBUGASSERT(terms[term]);
+        allModelsEmpty &= terms[term]->itsModelIsEmpty;
+   }
+   if (forward && allModelsEmpty)
         return;
 
    if (forward && isPSFGridder()) {
@@ -467,11 +488,27 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
    // Time CFs and indices
    timer.mark();
 
+   std::unique_lock<std::mutex> setupLock(setupMutex);
    initIndices(acc);
    initConvolutionFunction(acc);
    if (!forward) {
       ASKAPCHECK(itsSumWeights.nelements()>0, "SumWeights not yet initialised");
    }
+   // other terms use indices and convolution functions of this gridder, but their own state
+   // (e.g. the shape of the sum of weights used by finaliseWeights) has to be kept consistent
+   for (size_t term = 0; term < terms.size(); ++term) {
+        TableVisGridder &other = *terms[term];
+        ASKAPCHECK(!isPSFGridder() && !isPCFGridder() && !other.isPSFGridder() && !other.isPCFGridder(),
+                   "Multi-term gridding is not supported for PSF and preconditioner function");
+        ASKAPCHECK((other.itsGrid.size() == itsGrid.size()) && other.itsShape.isEqual(itsShape),
+                   "Gridders processed in one pass are expected to have the same grids");
+        other.initIndices(acc);
+        other.initConvolutionFunction(acc);
+        if (!forward) {
+            ASKAPCHECK(other.itsSumWeights.shape().isEqual(itsSumWeights.shape()),
+                       "Gridders processed in one pass are expected to have the same shape of the sum of weights");
+        }
+   }
 
    itsTimeConvFunctions += timer.real();
 
@@ -481,18 +518,10 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
    const casacore::MVDirection imageCentre = getImageCentre();
    const casacore::MVDirection tangentPoint = getTangentPoint();
 
-   // its fine to work with the reference in the openmp case because all our current use cases
-   // have the same tangent point for all gridders, otherwise we have to move this call
-   // inside the section protected by the lock and make a copy of the returned vector
-   const casacore::Vector<casacore::RigidVector<double, 3> > &outUVW = acc.rotatedUVW(tangentPoint);
-
-   #ifdef _OPENMP_WORKING
-   boost::unique_lock<boost::mutex> lock(itsMutex);
+   // the accessor keeps the result for the last tangent point and image centre only,
+   // so copies are required if other gridders use the same accessor concurrently
+   const casacore::Vector<casacore::RigidVector<double, 3> > outUVW = acc.rotatedUVW(tangentPoint).copy();
    const casa::Vector<double> delay = acc.uvwRotationDelay(tangentPoint, imageCentre).copy();
-   lock.unlock();
-   #else
-   const casa::Vector<double> &delay = acc.uvwRotationDelay(tangentPoint, imageCentre);
-   #endif
 
    itsTimeCoordinates += timer.real();
 
@@ -508,23 +537,37 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
    const casacore::Vector<casacore::Double>& frequencyList = acc.frequency();
    itsFreqMapper.setupMapping(frequencyList);
 
-   // for now setup the converter inside this method, although it would cause a rebuild
-   // of the matrices for every accessor. More intelligent caching is possible with a bit
-   // more effort (i.e. one has to detect whether polarisation frames change from the
-   // previous call). Need to think about parallactic angle dependence.
-   // OPENMP case needs work...
-   #ifdef _OPENMP_WORKING
-   itsPolConv = (forward ? : scimath::PolConverter(getStokes(),syncHelper.copy(acc.stokes()), false)
-                             scimath::PolConverter(syncHelper.copy(acc.stokes()), getStokes()));
-   //scimath::PolConverter degridPolConv(getStokes(),syncHelper.copy(acc.stokes()), false);
-   #else
+   // per-channel weights of this and other terms computed once per accessor
+   casacore::Vector<float> visWeights;
+   if (itsVisWeight) {
+       itsVisWeight->getWeights(frequencyList, visWeights);
+       ASKAPDEBUGASSERT(visWeights.nelements() == nChan);
+   }
+   casacore::Matrix<float> termWeights(nChan, terms.size(), 1.);
+   for (size_t term = 0; term < terms.size(); ++term) {
+        if (terms[term]->itsVisWeight) {
+            casacore::Vector<float> weights;
+            terms[term]->itsVisWeight->getWeights(frequencyList, weights);
+            ASKAPDEBUGASSERT(weights.nelements() == nChan);
+            termWeights.column(term) = weights;
+        }
+   }
+   // references to the current grid plane of other terms and the indices they correspond to
+   std::vector<casacore::Matrix<casacore::Complex> > term2dGrids(terms.size());
+   std::vector<std::pair<int,int> > termGridIndices(terms.size(), std::pair<int,int>(-1,-1));
+
+   // the converter is only rebuilt if polarisation frames change from the previous call.
+   // The fast converter combines conversion matrices from rotations cached per parallactic
+   // angle, so rotation matrices are not recomputed for every row
    if (nPol != itsVisPols.nelements()  || !allEQ(acc.stokes(), itsVisPols)) {
      itsPolConv = (forward ? scimath::PolConverter(getStokes(),acc.stokes(), false) :
                              scimath::PolConverter(acc.stokes(), getStokes()));
+     const casacore::uInt nStokes = getStokes().nelements();
+     itsFastPolConv.init(itsPolConv, forward ? nStokes : nPol, forward ? nPol : nStokes, itsSwapPols);
      itsVisPols.assign(acc.stokes());
      itsPolVector.resize(nPol);
    }
-   #endif
+   setupLock.unlock();
 
 
    ASKAPDEBUGASSERT(itsShape.nelements()>=2);
@@ -534,6 +577,8 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
        // Initialise the 2d reference
        its2dGrid.resize(onePlane);
    }
+   // grids may have been reallocated since the last call (e.g. w planes released between passes)
+   itsGridIndex = -1;
    // number of polarisation planes in the grid
    const casacore::uInt nImagePols = (shape().nelements()<=2) ? 1 : shape()[2];
    if (itsImagePolFrameVis.nelements()!=nImagePols) {
@@ -573,7 +618,10 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
            // need to reject samples, if too far from the image centre
            const casacore::MVDirection thisPointing  = acc.pointingDir1()(i);
            if (imageCentre.separation(thisPointing) > itsMaxPointingSeparation) {
-               ++itsRowsRejectedDueToMaxPointingSeparation;
+               // rows are rejected in every pass, but counted once
+               if (isFirstPass()) {
+                   ++itsRowsRejectedDueToMaxPointingSeparation;
+               }
                continue;
            }
        }
@@ -592,16 +640,17 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
            itsFirstGriddedVis = false;
        }
        if (itsPARotation) {
-           // make sure we set the swap before calculating the rotation matrix,
-           // as we're just swapping rows or columns in the matrix
-           itsPolConv.setSwapPols(itsSwapPols);
-           // set parallactic angle
-           double pa1=acc.feed1PA()(i) + itsPARotAngle;
-           double pa2=acc.feed2PA()(i) + itsPARotAngle;
-           itsPolConv.setParAngle(pa1,pa2);
+           // set parallactic angle, the swap of polarisations is applied by the converter
+           // before the rotation matrix is calculated. Rotations are cached per antenna angle
+           const double pa1=acc.feed1PA()(i) + itsPARotAngle;
+           const double pa2=acc.feed2PA()(i) + itsPARotAngle;
+           itsFastPolConv.setParAngle(pa1,pa2);
        }
 
        for (uint chan=0; chan<nChan; ++chan) {
+           if (!isInCurrentPass(i, chan)) {
+               continue;
+           }
            const double reciprocalToWavelength = frequencyList[chan]/casacore::C::c;
            if (chan == 0) {
               // check for ridiculous frequency to pick up a possible error with input file,
@@ -683,13 +732,13 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
                    if (!isPSFGridder() && !isPCFGridder()) {
                        ASKAPDEBUGASSERT(roVisCube!=0);
                        for (uint pol=0; pol<nPol; pol++) itsPolVector(pol) = (*roVisCube)(i,chan,pol);
-                       itsPolConv.convert(itsImagePolFrameVis,itsPolVector);
+                       itsFastPolConv.convert(itsImagePolFrameVis.data(),itsPolVector.data());
                    }
                    // we just don't need this quantity for the forward gridder, although there would be no
                    // harm to always compute it
                    ASKAPDEBUGASSERT(roVisNoise!=0);
                    for (uint pol=0; pol<nPol; pol++) itsPolVector(pol) = (*roVisNoise)(i,chan,pol);
-                   itsPolConv.noise(itsImagePolFrameNoise,itsPolVector);
+                   itsFastPolConv.noise(itsImagePolFrameNoise.data(),itsPolVector.data());
                }
                // Now loop over all image polarizations
                for (uint pol=0; pol<nImagePols; ++pol) {
@@ -738,8 +787,11 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
                    // It assumes itsGrid is contiguous
                    ASKAPDEBUGASSERT(itsGrid[gInd].contiguousStorage());
                    ipStart(2) = pol;
-                   // Check if we need to update the grid reference
-                   if ( nImagePols>1 || imageChan!=itsImageChan || gInd!=itsGridIndex ) {
+                   // Check if we need to update the grid reference. Grids of empty models
+                   // may have been shrunk (e.g. by WStackVisGridder) and are never read when
+                   // degridding, so they are not referenced in this case
+                   if ((!forward || !itsModelIsEmpty) &&
+                       ( nImagePols>1 || imageChan!=itsImageChan || gInd!=itsGridIndex )) {
                        its2dGrid.takeStorage(onePlane,&itsGrid[gInd](ipStart),casacore::SHARE);
                        itsImageChan = imageChan;
                        itsGridIndex = gInd;
@@ -748,6 +800,17 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
                    const std::pair<int,int> cfOffset = getConvFuncOffset(beforeOversamplePlaneIndex);
                    const int iuOffset = iu + cfOffset.first;
                    const int ivOffset = iv + cfOffset.second;
+                   // same for other terms
+                   for (size_t term = 0; term < terms.size(); ++term) {
+                        if (forward && terms[term]->itsModelIsEmpty) {
+                            continue;
+                        }
+                        if ( nImagePols>1 || termGridIndices[term] != std::pair<int,int>(gInd, imageChan)) {
+                            ASKAPDEBUGASSERT(terms[term]->itsGrid[gInd].contiguousStorage());
+                            term2dGrids[term].takeStorage(onePlane,&(terms[term]->itsGrid[gInd](ipStart)),casacore::SHARE);
+                            termGridIndices[term] = std::pair<int,int>(gInd, imageChan);
+                        }
+                   }
 
                    /*
                    if (isPSFGridder()) {
@@ -764,11 +827,23 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
                        ((iuOffset+support) <itsShape(0))&&((ivOffset+support)<itsShape(1))) {
                        if (forward) {
                            casacore::Complex cVis(0.,0.);
-                           GridKernel::degrid(cVis, convFunc, its2dGrid, iuOffset, ivOffset, support);
-                           itsSamplesDegridded+=1.0;
-                           itsNumberDegridded+=double((2*support+1)*(2*support+1));
-                           if (itsVisWeight) {
-                               cVis *= itsVisWeight->getWeight(i,frequencyList[chan],pol);
+                           if (!itsModelIsEmpty) {
+                               GridKernel::degrid(cVis, convFunc, its2dGrid, iuOffset, ivOffset, support);
+                               itsSamplesDegridded+=1.0;
+                               itsNumberDegridded+=double((2*support+1)*(2*support+1));
+                               if (itsVisWeight) {
+                                   cVis *= visWeights[chan];
+                               }
+                           }
+                           for (size_t term = 0; term < terms.size(); ++term) {
+                                TableVisGridder &other = *terms[term];
+                                if (!other.itsModelIsEmpty) {
+                                    casacore::Complex termVis(0.,0.);
+                                    GridKernel::degrid(termVis, convFunc, term2dGrids[term], iuOffset, ivOffset, support);
+                                    other.itsSamplesDegridded+=1.0;
+                                    other.itsNumberDegridded+=double((2*support+1)*(2*support+1));
+                                    cVis += termVis * termWeights(chan, term);
+                                }
                            }
                            itsImagePolFrameVis[pol] = cVis*phasor;
                        } else {
@@ -794,9 +869,10 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
 
                            if (!isPSFGridder() && !isPCFGridder()) {
                                /// Gridding visibility data onto grid
-                               casacore::Complex rVis = phasor*conj(itsImagePolFrameVis[pol])*visNoiseWt;
+                               const casacore::Complex uwVis = phasor*conj(itsImagePolFrameVis[pol])*visNoiseWt;
+                               casacore::Complex rVis = uwVis;
                                if (itsVisWeight) {
-                                   rVis *= itsVisWeight->getWeight(i,frequencyList[chan],pol);
+                                   rVis *= visWeights[chan];
                                }
                                GridKernel::grid(its2dGrid, convFunc, rVis, iuOffset, ivOffset, support);
 
@@ -804,6 +880,15 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
                                itsNumberGridded+=double((2*support+1)*(2*support+1));
 
                                itsSumWeights(sumWeightsRow, pol, imageChan) += visNoiseWt; //1.0;
+
+                               for (size_t term = 0; term < terms.size(); ++term) {
+                                    TableVisGridder &other = *terms[term];
+                                    GridKernel::grid(term2dGrids[term], convFunc, uwVis * termWeights(chan, term),
+                                                     iuOffset, ivOffset, support);
+                                    other.itsSamplesGridded+=1.0;
+                                    other.itsNumberGridded+=double((2*support+1)*(2*support+1));
+                                    other.itsSumWeights(sumWeightsRow, pol, imageChan) += visNoiseWt;
+                               }
                            }
                            /// Grid the PSF?
                            if (isPSFGridder() &&
@@ -813,7 +898,7 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
                                 casacore::Complex uVis(1.,0.);
                                 uVis *= visNoiseWt;
                                 if (itsVisWeight) {
-                                    uVis *= itsVisWeight->getWeight(i,frequencyList[chan],pol);
+                                    uVis *= visWeights[chan];
                                 }
 
                                 GridKernel::grid(its2dGrid, convFunc, uVis, iuOffset, ivOffset, support);
@@ -857,8 +942,12 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
                if (wGood) {
                    if (forward) {
                        ASKAPDEBUGASSERT(visCube!=0)
-                       itsPolConv.convert(itsPolVector,itsImagePolFrameVis);
-                       for (uint pol=0; pol<nPol; pol++) (*visCube)(iDDOffset+i,chan,pol) += itsPolVector(pol);
+                       itsFastPolConv.convert(itsPolVector.data(),itsImagePolFrameVis.data());
+                       if (itsSubtractModel) {
+                           for (uint pol=0; pol<nPol; pol++) (*visCube)(iDDOffset+i,chan,pol) -= itsPolVector(pol);
+                       } else {
+                           for (uint pol=0; pol<nPol; pol++) (*visCube)(iDDOffset+i,chan,pol) += itsPolVector(pol);
+                       }
                        // visibilities with w out of range are left unchanged during prediction
                        // as long as subsequent imaging uses the same wmax this should work ok
                        // we may want to flag these data to be sure
@@ -881,6 +970,32 @@ void TableVisGridder::generic(accessors::IDataAccessor& acc, bool forward) {
    } else {
        itsTimeGridded+=timer.real();
    }
+   publishMetrics();
+   for (size_t term = 0; term < terms.size(); ++term) {
+        terms[term]->publishMetrics();
+   }
+}
+
+/// @brief publish statistics accumulated since the last call into the metrics registry
+/// @details Metric names start with gridder, psfgridder or pcfgridder depending on the
+/// role of this gridder.
+void TableVisGridder::publishMetrics()
+{
+   const std::string prefix = isPSFGridder() ? "psfgridder." : (isPCFGridder() ? "pcfgridder." : "gridder.");
+   const size_t nStats = 10;
+   const char* names[nStats] = {"grid.samples", "grid.points", "grid.time", "degrid.samples", "degrid.points",
+                                "degrid.time", "cf.time", "coordinates.time", "flagged", "wflagged"};
+   const double stats[nStats] = {itsSamplesGridded, itsNumberGridded, itsTimeGridded, itsSamplesDegridded,
+                                 itsNumberDegridded, itsTimeDegridded, itsTimeConvFunctions, itsTimeCoordinates,
+                                 itsVectorsFlagged, itsVectorsWFlagged};
+   itsPublishedStats.resize(nStats, 0.);
+   utils::MetricsRegistry &registry = utils::MetricsRegistry::instance();
+   for (size_t i = 0; i < nStats; ++i) {
+        if (stats[i] != itsPublishedStats[i]) {
+            registry.add(prefix + names[i], stats[i] - itsPublishedStats[i]);
+            itsPublishedStats[i] = stats[i];
+        }
+   }
 }
 
 /// @brief correct visibilities, if necessary
@@ -912,6 +1027,39 @@ void TableVisGridder::grid(accessors::IConstDataAccessor& acc) {
     generic(bufAcc, false);
 }
 
+/// @brief Degrid the visibility data for a number of Taylor terms in one pass
+/// @param[in] acc non-const data accessor to work with
+/// @param[in] terms gridders for other terms, initialised for degridding with the same shape
+void TableVisGridder::degridMultiTerm(accessors::IDataAccessor& acc,
+                                      const std::vector<boost::shared_ptr<TableVisGridder> > &terms) {
+    ASKAPTRACE("TableVisGridder::degridMultiTerm");
+    generic(acc, true, terms);
+    correctVisibilities(acc, true);
+}
+
+/// @brief Grid the visibility data for a number of Taylor terms in one pass
+/// @param[in] acc const data accessor to work with
+/// @param[in] terms gridders for other terms, initialised for gridding with the same shape
+void TableVisGridder::gridMultiTerm(accessors::IConstDataAccessor& acc,
+                                    const std::vector<boost::shared_ptr<TableVisGridder> > &terms) {
+    ASKAPTRACE("TableVisGridder::gridMultiTerm");
+    accessors::OnDemandBufferDataAccessor bufAcc(acc);
+    correctVisibilities(bufAcc, false);
+    generic(bufAcc, false, terms);
+}
+
+/// @brief check whether this gridder can be used in gridMultiTerm and degridMultiTerm
+/// @return true, if the gridder can process several terms in one pass
+bool TableVisGridder::canProcessTermsTogether() const {
+    return true;
+}
+
+/// @brief check whether this gridder can run concurrently with other gridders
+/// @return true, if the gridder can be used concurrently with other gridders
+bool TableVisGridder::canRunConcurrently() const {
+    return true;
+}
+
 /// @brief obtain the centre of the image
 /// @details This method extracts RA and DEC axes from itsAxes and
 /// forms a direction measure corresponding to the middle of each axis.
@@ -1372,6 +1520,16 @@ int TableVisGridder::gIndex(int /*row*/, int /*pol*/, int /*chan*/) {
     return 0;
 }
 
+/// This is the default implementation
+bool TableVisGridder::isInCurrentPass(int /*row*/, int /*chan*/) const {
+    return true;
+}
+
+/// This is the default implementation
+bool TableVisGridder::isFirstPass() const {
+    return true;
+}
+
 /// @brief Obtain offset for the given convolution function
 /// @details To conserve memory and speed the gridding up, convolution functions stored in the cache
 /// may have an offset (i.e. essentially each CF should be defined on a bigger support and placed at a
@@ -37,9 +37,11 @@
 #include <askap/dataaccess/IDataAccessor.h>
 #include <askap/gridding/FrequencyMapper.h>
 #include <askap/scimath/utils/PolConverter.h>
+#include <askap/gridding/FastPolConverter.h>
 
 // std includes
 #include <string>
+#include <vector>
 
 // casa includes
 #include <casacore/casa/BasicSL/Complex.h>
@@ -147,6 +149,43 @@ namespace askap
       /// @param[in] acc non-const data accessor to work with
       virtual void degrid(accessors::IDataAccessor& acc);
 
+      /// @brief Grid the visibility data for a number of Taylor terms in one pass
+      /// @details This gridder and the gridders given as the parameter should be
+      /// of the same type and setup, and differ only in visibility weights (e.g. gridders
+      /// for different Taylor terms of the same image). Indices, offsets and convolution
+      /// functions are obtained once for each sample and the visibility is added to all
+      /// grids with the per-channel weight of the appropriate term. The result is the same
+      /// as calling grid for each gridder separately.
+      /// @param[in] acc const data accessor to work with
+      /// @param[in] terms gridders for other terms, initialised for gridding with the same shape
+      /// @note The weights of the other terms are assumed to depend on frequency only.
+      void gridMultiTerm(accessors::IConstDataAccessor& acc,
+                         const std::vector<boost::shared_ptr<TableVisGridder> > &terms);
+
+      /// @brief Degrid the visibility data for a number of Taylor terms in one pass
+      /// @details This is the reverse of gridMultiTerm, the weighted sum of model visibilities
+      /// of all terms is added to the accessor. The result is the same as calling degrid
+      /// for each gridder separately.
+      /// @param[in] acc non-const data accessor to work with
+      /// @param[in] terms gridders for other terms, initialised for degridding with the same shape
+      /// @note The weights of the other terms are assumed to depend on frequency only.
+      void degridMultiTerm(accessors::IDataAccessor& acc,
+                           const std::vector<boost::shared_ptr<TableVisGridder> > &terms);
+
+      /// @brief check whether this gridder can be used in gridMultiTerm and degridMultiTerm
+      /// @details Processing several terms in one pass requires all grids to be in memory.
+      /// Derived classes which hold only some of their grids at a time return false.
+      /// @return true, if the gridder can process several terms in one pass
+      virtual bool canProcessTermsTogether() const;
+
+      /// @brief check whether this gridder can run concurrently with other gridders
+      /// @details Different gridders may grid or degrid the same accessor in parallel threads.
+      /// The set up of convolution functions, indices and coordinates is serialised in
+      /// generic, the rest is expected to touch only the state of this gridder. Derived
+      /// classes which do more than that (e.g. FFTs) while gridding return false.
+      /// @return true, if the gridder can be used concurrently with other gridders
+      virtual bool canRunConcurrently() const;
+
       /// @brief Finalise
       virtual void finaliseDegrid();
 
@@ -177,6 +216,13 @@ namespace askap
       /// @param[in] flag new value of the flag
       void inline doClearGrid(const bool flag) { itsClearGrid = flag;}
 
+      /// @brief set or reset flag telling degridder to subtract the model from the accessor
+      /// @details By default, degridded visibilities are added to the accessor. If the accessor
+      /// is filled with the observed visibilities beforehand, subtraction yields residuals
+      /// without extra passes over the visibility cube.
+      /// @param[in] flag new value of the flag
+      void inline doSubtractModel(const bool flag) { itsSubtractModel = flag;}
+
 
       /// @brief set the largest angular separation between the pointing centre and the image centre
       /// @details If the threshold is positive, it is interpreted as the largest allowed angular
@@ -207,6 +253,30 @@ namespace askap
 
       void setSourceIndex(casacore::uInt index) const { itsSourceIndex = index; }
 
+      /// @return number of visibility samples gridded so far
+      inline double samplesGridded() const { return itsSamplesGridded; }
+
+      /// @return number of visibility samples degridded so far
+      inline double samplesDegridded() const { return itsSamplesDegridded; }
+
+      /// @return number of grid points updated by gridding so far (one complex multiply-add each)
+      inline double pointsGridded() const { return itsNumberGridded; }
+
+      /// @return number of grid points used by degridding so far (one complex multiply-add each)
+      inline double pointsDegridded() const { return itsNumberDegridded; }
+
+      /// @return time spent in the gridding kernel so far (in seconds)
+      inline double timeGridded() const { return itsTimeGridded; }
+
+      /// @return time spent in the degridding kernel so far (in seconds)
+      inline double timeDegridded() const { return itsTimeDegridded; }
+
+      /// @return time spent building convolution functions and indices so far (in seconds)
+      inline double timeConvFunctions() const { return itsTimeConvFunctions; }
+
+      /// @return time spent on coordinate conversions so far (in seconds)
+      inline double timeCoordinates() const { return itsTimeCoordinates; }
+
   protected:
       /// @brief helper method to check that the gridder has been unused so far
       /// @details Unused means no visibilities were either gridded or degridded
@@ -397,6 +467,24 @@ protected:
       /// @param chan Channel
       virtual int gIndex(int row, int pol, int chan);
 
+      /// @brief check whether the sample is processed in the current pass
+      /// @details Gridders which go through the same accessor more than once (e.g. to keep
+      /// only some of the grids in memory) override this method. Samples for which it returns
+      /// false are ignored by generic, including the flag statistics. This default
+      /// implementation always returns true.
+      /// @param row Row of accessor
+      /// @param chan Channel
+      /// @return true, if the sample is to be processed
+      virtual bool isInCurrentPass(int row, int chan) const;
+
+      /// @brief check whether the current pass over the accessor is the first one
+      /// @details Row-level statistics (e.g. rows rejected due to the pointing separation)
+      /// are only accumulated in the first pass, so they are counted once for gridders which
+      /// go through the same accessor more than once. This default implementation always
+      /// returns true.
+      /// @return true, if this is the first (or the only) pass
+      virtual bool isFirstPass() const;
+
       /// @brief Initialize the convolution function - this is the key function to override.
       /// @param[in] acc const accessor to work with
       virtual void initConvolutionFunction(const accessors::IConstDataAccessor& acc) = 0;
@@ -504,6 +592,15 @@ protected:
       /// Time for degridding
       double itsTimeDegridded;
 
+      /// @brief statistics at the time of the last publication into the metrics registry
+      /// @details Gridders are reused between major cycles, so only increments are published.
+      std::vector<double> itsPublishedStats;
+
+      /// @brief publish statistics accumulated since the last call into the metrics registry
+      /// @details Metric names start with gridder, psfgridder or pcfgridder depending on the
+      /// role of this gridder.
+      void publishMetrics();
+
       /// @brief is this gridder a PSF gridder?
       bool itsDopsf;
       /// @brief is this gridder a PreConditioner Function gridder?
@@ -519,6 +616,14 @@ protected:
       /// constness properly.
       void generic(accessors::IDataAccessor& acc, bool forward);
 
+      /// Generic grid/degrid for a number of gridders sharing indices and convolution functions
+      /// @param[in] acc non-const data accessor to work with.
+      /// @param[in] forward true for the model to visibility transform (degridding),
+      /// false for the visibility to dirty image transform (gridding)
+      /// @param[in] terms other gridders to process in the same pass (see gridMultiTerm)
+      void generic(accessors::IDataAccessor& acc, bool forward,
+                   const std::vector<boost::shared_ptr<TableVisGridder> > &terms);
+
       /// Visibility Weights
       IVisWeights::ShPtr itsVisWeight;
 
@@ -597,6 +702,10 @@ protected:
       /// @brief the polarization converter
       scimath::PolConverter itsPolConv;
 
+      /// @brief the converter used in the gridding loop
+      /// @details It is set up from itsPolConv and caches matrices per parallactic angle
+      FastPolConverter itsFastPolConv;
+
       /// @brief vectors to store image polarisation values and noise, and visibility values
       casacore::Vector<casacore::Complex> itsImagePolFrameVis, itsImagePolFrameNoise, itsPolVector;
 
@@ -610,6 +719,9 @@ protected:
       /// @brief release grid memory in finalise(De)Grid
       bool itsClearGrid;
 
+      /// @brief subtract degridded visibilities from the accessor instead of adding them
+      bool itsSubtractModel;
+
     };
   }
 }
@@ -266,6 +266,12 @@ IVisGridder::ShPtr VisGridderFactory::make(const LOFAR::ParameterSet &parset) {
         adapter->setWeightsClippingFactor(float(weightsClippingFactor));
         const bool doPSFReprojection = parset.getBool("gridder.snapshotimaging.reprojectpsf", false);
         adapter->setPSFReprojection(doPSFReprojection);
+        if (parset.getBool("gridder.snapshotimaging.fastregrid", false)) {
+            const casacore::uInt cacheSize = parset.getUint("gridder.snapshotimaging.regridcache", 512);
+            ASKAPLOG_INFO_STR(logger, "Image planes will be regridded with cached coordinate mappings, cache size "<<
+                              cacheSize<<" MB");
+            adapter->setFastRegridding(true, cacheSize);
+        }
         // possible additional configuration comes here
         gridder = adapter;
     }
@@ -74,6 +74,25 @@ namespace askap
             const double ratio = (freq-itsRefFreq)/itsRefFreq;
             return pow(ratio,itsOrder);
     }
+
+    void VisWeightsMultiFrequency::getWeights(const casacore::Vector<casacore::Double> &freqs,
+                                              casacore::Vector<float> &weights)
+    {
+            weights.resize(freqs.nelements());
+            if (itsOrder == 0) {
+                weights.set(1.f);
+                return;
+            }
+            ASKAPDEBUGASSERT(itsOrder > 0);
+            for (casacore::uInt chan = 0; chan < freqs.nelements(); ++chan) {
+                 const double ratio = (freqs[chan]-itsRefFreq)/itsRefFreq;
+                 double weight = ratio;
+                 for (int power = 1; power < itsOrder; ++power) {
+                      weight *= ratio;
+                 }
+                 weights[chan] = static_cast<float>(weight);
+            }
+    }
     
   }
 }
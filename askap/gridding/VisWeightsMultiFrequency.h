@@ -74,6 +74,14 @@ namespace askap
       /// @param freq frequency
       /// @param pol Polarization index
       float getWeight(int i, double freq, int pol);
+
+      /// @brief Calculate visibility weights for all channels at once
+      /// @details The weight is ((freq-reffreq)/reffreq)^order, the power is
+      /// computed by repeated multiplication.
+      /// @param[in] freqs frequencies of all channels
+      /// @param[out] weights weights for all channels (resized as necessary)
+      virtual void getWeights(const casacore::Vector<casacore::Double> &freqs,
+                              casacore::Vector<float> &weights);
       
   protected:
 
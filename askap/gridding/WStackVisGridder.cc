@@ -32,14 +32,17 @@ ASKAP_LOGGER(logger, ".gridding.wstackgridder");
 
 #include <casacore/casa/Arrays/Array.h>
 #include <casacore/casa/Arrays/ArrayMath.h>
+#include <casacore/casa/Arrays/ArrayLogical.h>
 
 #include <casacore/casa/BasicSL/Constants.h>
 #include <askap/scimath/fft/FFTWrapper.h>
 #include <askap/scimath/utils/PaddingUtils.h>
 #include <askap/profile/AskapProfiler.h>
+#include <askap/dataaccess/OnDemandBufferDataAccessor.h>
 
 using namespace askap;
 
+#include <algorithm>
 #include <cmath>
 
 namespace askap
@@ -48,7 +51,8 @@ namespace askap
   {
 
     WStackVisGridder::WStackVisGridder(const double wmax, const int nwplanes) :
-           WDependentGridderBase(wmax,nwplanes) {}
+           WDependentGridderBase(wmax,nwplanes), itsMaxActivePlanes(0), itsFirstPass(true),
+           itsEarlyStackedPlanes(0) {}
 
     WStackVisGridder::~WStackVisGridder() {}
 
@@ -57,7 +61,11 @@ namespace askap
     /// input object and the copy
     /// @param[in] other input object
     WStackVisGridder::WStackVisGridder(const WStackVisGridder &other) :
-       IVisGridder(other), WDependentGridderBase(other), itsGMap(other.itsGMap.copy()) {}
+       IVisGridder(other), WDependentGridderBase(other), itsGMap(other.itsGMap.copy()),
+       itsMaxActivePlanes(other.itsMaxActivePlanes), itsActivePlanes(other.itsActivePlanes),
+       itsPlanesInPass(other.itsPlanesInPass), itsFirstPass(other.itsFirstPass),
+       itsStack(other.itsStack.copy()), itsModel(other.itsModel.copy()),
+       itsEarlyStackedPlanes(other.itsEarlyStackedPlanes) {}
 
 
     /// Clone a copy of this Gridder
@@ -66,6 +74,46 @@ namespace askap
       return IVisGridder::ShPtr(new WStackVisGridder(*this));
     }
 
+    /// @brief set the maximum number of w planes held in memory
+    /// @param[in] maxPlanes maximum number of active planes, zero or
+    /// a number not less than the number of w planes means all planes
+    void WStackVisGridder::maxActivePlanes(const int maxPlanes)
+    {
+      ASKAPCHECK(maxPlanes >= 0, "Maximum number of active w-planes should be non-negative, you have "<<maxPlanes);
+      itsMaxActivePlanes = maxPlanes;
+    }
+
+    /// @brief configure the maximum number of active planes from the parset
+    /// @param[in] parset parameter set (gridder name already removed)
+    void WStackVisGridder::configureActivePlanes(const LOFAR::ParameterSet& parset)
+    {
+      maxActivePlanes(parset.getInt32("maxactiveplanes", 0));
+      if (isStreaming()) {
+          ASKAPLOG_INFO_STR(logger, "At most "<<itsMaxActivePlanes<<" out of "<<nWPlanes()<<
+                            " w-planes will be kept in memory");
+      }
+    }
+
+    /// @return true, if only some of the w planes are kept in memory
+    bool WStackVisGridder::isStreaming() const
+    {
+      return (itsMaxActivePlanes > 0) && (itsMaxActivePlanes < nWPlanes());
+    }
+
+    /// @brief check whether this gridder can be used in gridMultiTerm and degridMultiTerm
+    /// @return false, if only some of the w planes are kept in memory
+    bool WStackVisGridder::canProcessTermsTogether() const
+    {
+      return !isStreaming();
+    }
+
+    /// @brief check whether this gridder can run concurrently with other gridders
+    /// @return false, if only some of the w planes are kept in memory
+    bool WStackVisGridder::canRunConcurrently() const
+    {
+      return !isStreaming();
+    }
+
     /// Initialize the convolution function into the cube. If necessary this
     /// could be optimized by using symmetries.
     void WStackVisGridder::initIndices(const accessors::IConstDataAccessor& acc)
@@ -95,6 +143,170 @@ namespace askap
       }
     }
 
+    /// @brief find w planes used by the given accessor
+    /// @details Planes already in memory come first, so they are processed
+    /// before any of them has to give way to a new plane.
+    /// @param[in] acc const accessor to work with
+    /// @param[out] planes numbers of the planes used
+    void WStackVisGridder::planesInUse(const accessors::IConstDataAccessor& acc, std::vector<int>& planes) const
+    {
+      ASKAPDEBUGTRACE("WStackVisGridder::planesInUse");
+      std::vector<bool> used(nWPlanes(), false);
+      const casacore::Vector<casacore::RigidVector<double, 3> > &rotatedUVW = acc.rotatedUVW(getTangentPoint());
+      const casacore::Vector<casacore::Double> &freq = acc.frequency();
+      const casacore::uInt nChan = acc.nChannel();
+      for (casacore::uInt i=0; i<acc.nRow(); ++i) {
+           // the same mapping as in initIndices
+           const double w=(rotatedUVW(i)(2))/(casacore::C::c);
+           for (casacore::uInt chan=0; chan<nChan; ++chan) {
+                const int plane = getWPlane(w*freq[chan]);
+                if (plane >= 0) {
+                    used[plane] = true;
+                }
+           }
+      }
+      planes.clear();
+      for (std::list<int>::const_iterator it = itsActivePlanes.begin(); it != itsActivePlanes.end(); ++it) {
+           if (used[*it]) {
+               planes.push_back(*it);
+               used[*it] = false;
+           }
+      }
+      for (int plane=0; plane<nWPlanes(); ++plane) {
+           if (used[plane]) {
+               planes.push_back(plane);
+           }
+      }
+    }
+
+    /// @brief make the given planes active
+    /// @details The least recently used planes are released if necessary.
+    /// They are stacked when gridding and just dropped when degridding.
+    /// New planes are set to zero for gridding and filled from the model
+    /// for degridding.
+    /// @param[in] planes planes to activate, at most the maximum number of active planes
+    /// @param[in] forward true for degridding
+    void WStackVisGridder::activatePlanes(const std::vector<int>& planes, const bool forward)
+    {
+      ASKAPDEBUGTRACE("WStackVisGridder::activatePlanes");
+      ASKAPDEBUGASSERT(int(planes.size()) <= itsMaxActivePlanes);
+      // planes which are already in memory become the most recently used, so they are not released below
+      for (std::vector<int>::const_iterator ci = planes.begin(); ci != planes.end(); ++ci) {
+           const std::list<int>::iterator it = std::find(itsActivePlanes.begin(), itsActivePlanes.end(), *ci);
+           if (it != itsActivePlanes.end()) {
+               itsActivePlanes.splice(itsActivePlanes.begin(), itsActivePlanes, it);
+           }
+      }
+      for (std::vector<int>::const_iterator ci = planes.begin(); ci != planes.end(); ++ci) {
+           const int plane = *ci;
+           ASKAPDEBUGASSERT((plane >= 0) && (plane < int(itsGrid.size())));
+           if (itsGrid[plane].nelements() > 0) {
+               continue;
+           }
+           while (int(itsActivePlanes.size()) >= itsMaxActivePlanes) {
+                  const int released = itsActivePlanes.back();
+                  itsActivePlanes.pop_back();
+                  if (!forward) {
+                      stackPlane(released);
+                      ++itsEarlyStackedPlanes;
+                  }
+                  itsGrid[released].resize();
+           }
+           if (forward) {
+               fillPlane(plane);
+           } else {
+               itsGrid[plane].resize(itsShape);
+               itsGrid[plane].set(0.0);
+           }
+           itsActivePlanes.push_front(plane);
+      }
+    }
+
+    /// @brief Grid the visibility data.
+    /// @details If only some of the planes are kept in memory, the accessor is
+    /// processed in a number of passes, each for a window of w planes.
+    /// @param acc const data accessor to work with
+    void WStackVisGridder::grid(accessors::IConstDataAccessor& acc)
+    {
+      if (!isStreaming()) {
+          TableVisGridder::grid(acc);
+          return;
+      }
+      ASKAPTRACE("WStackVisGridder::grid");
+      accessors::OnDemandBufferDataAccessor bufAcc(acc);
+      correctVisibilities(bufAcc, false);
+      std::vector<int> planes;
+      planesInUse(acc, planes);
+      itsFirstPass = true;
+      size_t start = 0;
+      do {
+         const size_t end = std::min(start + size_t(itsMaxActivePlanes), planes.size());
+         const std::vector<int> window(planes.begin() + start, planes.begin() + end);
+         activatePlanes(window, false);
+         itsPlanesInPass.assign(nWPlanes(), false);
+         for (std::vector<int>::const_iterator ci = window.begin(); ci != window.end(); ++ci) {
+              itsPlanesInPass[*ci] = true;
+         }
+         generic(bufAcc, false);
+         itsFirstPass = false;
+         start = end;
+      } while (start < planes.size());
+      itsPlanesInPass.clear();
+    }
+
+    /// @brief Degrid the visibility data.
+    /// @details If only some of the planes are kept in memory, the accessor is
+    /// processed in a number of passes, each for a window of w planes.
+    /// @param[in] acc non-const data accessor to work with
+    void WStackVisGridder::degrid(accessors::IDataAccessor& acc)
+    {
+      if (!isStreaming() || itsModelIsEmpty) {
+          TableVisGridder::degrid(acc);
+          return;
+      }
+      ASKAPTRACE("WStackVisGridder::degrid");
+      std::vector<int> planes;
+      planesInUse(acc, planes);
+      itsFirstPass = true;
+      size_t start = 0;
+      do {
+         const size_t end = std::min(start + size_t(itsMaxActivePlanes), planes.size());
+         const std::vector<int> window(planes.begin() + start, planes.begin() + end);
+         activatePlanes(window, true);
+         itsPlanesInPass.assign(nWPlanes(), false);
+         for (std::vector<int>::const_iterator ci = window.begin(); ci != window.end(); ++ci) {
+              itsPlanesInPass[*ci] = true;
+         }
+         generic(acc, true);
+         itsFirstPass = false;
+         start = end;
+      } while (start < planes.size());
+      itsPlanesInPass.clear();
+      correctVisibilities(acc, true);
+    }
+
+    /// @brief check whether the sample is processed in the current pass
+    /// @param row Row of accessor
+    /// @param chan Channel
+    /// @return true, if the w plane of this sample is in the current window
+    bool WStackVisGridder::isInCurrentPass(int row, int chan) const
+    {
+      if (itsPlanesInPass.size() == 0) {
+          return true;
+      }
+      const int plane = itsGMap(row, 0, chan);
+      ASKAPDEBUGASSERT(plane < int(itsPlanesInPass.size()));
+      // samples with w out of range are only counted once
+      return plane < 0 ? itsFirstPass : itsPlanesInPass[plane];
+    }
+
+    /// @brief check whether the current pass over the accessor is the first one
+    /// @return true, if the first window of w planes is processed or there are no windows
+    bool WStackVisGridder::isFirstPass() const
+    {
+      return itsPlanesInPass.size() == 0 || itsFirstPass;
+    }
+
     void WStackVisGridder::initialiseGrid(const scimath::Axes& axes,
         const casacore::IPosition& shape, const bool dopsf, const bool dopcf)
     {
@@ -110,10 +322,20 @@ namespace askap
 
       /// We need one grid for each plane
       itsGrid.resize(nWPlanes());
+      itsActivePlanes.clear();
+      itsPlanesInPass.clear();
+      itsStack.resize();
+      itsModel.resize();
+      itsEarlyStackedPlanes = 0;
       for (int i=0; i<nWPlanes(); ++i)
       {
-        itsGrid[i].resize(itsShape);
-        itsGrid[i].set(0.0);
+        if (isStreaming()) {
+            // planes are allocated when they are used for the first time
+            itsGrid[i].resize();
+        } else {
+            itsGrid[i].resize(itsShape);
+            itsGrid[i].set(0.0);
+        }
       }
       if (isPSFGridder())
       {
@@ -142,30 +364,37 @@ namespace askap
       const int ny=itsShape(1);
 
       const float w=2.0f*casacore::C::pi*getWTerm(i);
+      // x-dependent part of r^2 is the same for all rows and planes
+      std::vector<float> x2(nx);
+      for (int ix=0; ix<nx; ix++)
+      {
+        const float x=float(ix-nx/2)*cellx;
+        x2[ix]=x*x;
+      }
       casacore::ArrayIterator<imtypeComplex> it(scratch, 2);
       while (!it.pastEnd())
       {
         casacore::Matrix<imtypeComplex> mat(it.array());
+        ASKAPDEBUGASSERT((int(mat.nrow()) == nx) && (int(mat.ncolumn()) == ny));
+        bool deleteIt;
+        imtypeComplex *data = mat.getStorage(deleteIt);
 
-        /// @todo Optimise multiply loop
+        #pragma omp parallel for schedule(static) default(shared)
         for (int iy=0; iy<ny; iy++)
         {
           float y2=float(iy-ny/2)*celly;
           y2*=y2;
+          imtypeComplex *row = data + size_t(iy) * nx;
           for (int ix=0; ix<nx; ix++)
           {
-            if (casacore::abs(mat(ix, iy))>0.0)
-            {
-              float x2=float(ix-nx/2)*cellx;
-              x2*=x2;
-              const float r2=x2+y2;
-              if (r2<1.0) {
-                  const float phase=w*(1.0-sqrt(1.0-r2));
-                  mat(ix, iy)*=imtypeComplex(cos(phase), -sin(phase));
-              }
+            const float r2=x2[ix]+y2;
+            if ((r2<1.0) && (row[ix] != imtypeComplex(0.))) {
+                const float phase=w*(1.0-sqrt(1.0-r2));
+                row[ix]*=imtypeComplex(cos(phase), -sin(phase));
             }
           }
         }
+        mat.putStorage(data, deleteIt);
         it.next();
       }
     }
@@ -190,28 +419,74 @@ namespace askap
       const int nx=itsShape(0);
       const int ny=itsShape(1);
 
-      const float w=2.0f*casacore::C::pi*getWTerm(i);
       casacore::ArrayIterator<imtypeComplex> it(scratch, 2);
       while (!it.pastEnd())
       {
         casacore::Matrix<imtypeComplex> mat(it.array());
+        ASKAPDEBUGASSERT((int(mat.nrow()) == nx) && (int(mat.ncolumn()) == ny));
+        bool deleteIt;
+        imtypeComplex *data = mat.getStorage(deleteIt);
 
-        /// @todo Optimise loop
+        #pragma omp parallel for schedule(static) default(shared)
         for (int iy=0; iy<ny; iy++)
         {
+          imtypeComplex *row = data + size_t(iy) * nx;
           for (int ix=0; ix<nx; ix++)
           {
-            if (casacore::abs(mat(ix, iy))>0.0)
-            {
-              // update the imaginary part but not the real part
-              mat(ix, iy) = imtypeComplex(real(mat(ix, iy)), imag(mat(ix, iy)) * wKernelPix);
-            }
+            // update the imaginary part but not the real part (zeros stay zeros)
+            row[ix] = imtypeComplex(real(row[ix]), imag(row[ix]) * wKernelPix);
           }
         }
+        mat.putStorage(data, deleteIt);
         it.next();
       }
     }
 
+    /// @brief Fourier transform a plane and add it to the stack
+    /// @details Empty planes and planes which are not in memory are ignored.
+    /// The preconditioner function is stacked in the uv-domain.
+    /// @param[in] i plane number
+    void WStackVisGridder::stackPlane(const int i)
+    {
+      ASKAPDEBUGTRACE("WStackVisGridder::stackPlane");
+      ASKAPDEBUGASSERT((i >= 0) && (i < int(itsGrid.size())));
+      if ((itsGrid[i].nelements() == 0) || !casacore::anyNE(itsGrid[i], casacore::Complex(0.0))) {
+          return;
+      }
+      casacore::Array<imtypeComplex> scratch(itsGrid[i].shape());
+      casacore::convertArray<imtypeComplex,casacore::Complex>(scratch,itsGrid[i]);
+      if (isPCFGridder()) {
+          // Don't FFT yet. Stack uv grids
+          // the w-support terms stored in the imaginary part of itsGrid do not account for w. Update them.
+          updatew(scratch, i);
+      } else {
+          scimath::fft2d(scratch, false);
+          multiply(scratch, i);
+      }
+      if (itsStack.nelements() == 0) {
+          itsStack.reference(scratch);
+      } else {
+          itsStack += scratch;
+      }
+    }
+
+    /// @brief fill a plane from the model for degridding
+    /// @param[in] i plane number
+    void WStackVisGridder::fillPlane(const int i)
+    {
+      ASKAPDEBUGTRACE("WStackVisGridder::fillPlane");
+      ASKAPDEBUGASSERT((i >= 0) && (i < int(itsGrid.size())));
+      ASKAPDEBUGASSERT(itsModel.shape().isEqual(itsShape));
+      casacore::Array<imtypeComplex> work(itsShape);
+      toComplex(work, itsModel);
+      multiply(work, i);
+      /// Need to conjugate to get sense of w correction correct
+      work = casacore::conj(work);
+      scimath::fft2d(work, true);
+      itsGrid[i].resize(itsShape);
+      casacore::convertArray<casacore::Complex,imtypeComplex>(itsGrid[i],work);
+    }
+
     /// This is the default implementation
     void WStackVisGridder::finaliseGrid(casacore::Array<imtype>& out)
     {
@@ -228,70 +503,41 @@ namespace askap
       }
       ASKAPDEBUGASSERT(itsGrid.size()>0);
 
-      if (isPCFGridder()) {
-
-        // buffer for the result as doubles
-        casacore::Array<imtypeComplex> cBuffer(itsGrid[0].shape());
-        ASKAPDEBUGASSERT(cBuffer.shape().nelements()>=2);
-       
-        /// Loop over all grids Fourier transforming and accumulating
-        bool first=true;
-        for (unsigned int i=0; i<itsGrid.size(); i++)
-        {
-          if (casacore::max(casacore::amplitude(itsGrid[i]))>0.0)
+      /// Loop over all grids still in memory Fourier transforming and accumulating
+      for (unsigned int i=0; i<itsGrid.size(); i++)
+      {
+        stackPlane(i);
+      }
+      if (isStreaming()) {
+          ASKAPLOG_INFO_STR(logger, itsEarlyStackedPlanes << " planes had to be stacked before the end of gridding to keep at most "
+                            << itsMaxActivePlanes << " planes in memory");
+          for (unsigned int i=0; i<itsGrid.size(); i++)
           {
-            casacore::Array<imtypeComplex> scratch(itsGrid[i].shape());
-            casacore::convertArray<imtypeComplex,casacore::Complex>(scratch,itsGrid[i]);
-            // Don't FFT yet. Stack uv grids
-            // the w-support terms stored in the imaginary part of itsGrid do not account for w. Update them.
-            updatew(scratch, i);
-
-            if (first)  {
-              first=false;
-              cBuffer = scratch;
-            } else {
-              cBuffer += scratch;
-            }
+            itsGrid[i].resize();
           }
-        }
-        // Now FFT
-        scimath::fft2d(cBuffer, false);
-        casacore::Array<imtype> dBuffer(itsGrid[0].shape());
-        dBuffer = real(cBuffer);
-        out = scimath::PaddingUtils::extract(dBuffer, paddingFactor());
+          itsActivePlanes.clear();
+      }
+      if (itsStack.nelements() == 0) {
+          // no data have been gridded
+          itsStack.resize(itsShape);
+          itsStack.set(0.0);
+      }
+      ASKAPDEBUGASSERT(itsStack.shape().nelements()>=2);
 
+      // buffer for the result as doubles
+      casacore::Array<imtype> dBuffer(itsStack.shape());
+      if (isPCFGridder()) {
+        // Now FFT
+        scimath::fft2d(itsStack, false);
+        dBuffer = real(itsStack);
       } else {
-
-        // buffer for the result as doubles
-        casacore::Array<imtype> dBuffer(itsGrid[0].shape());
-        ASKAPDEBUGASSERT(dBuffer.shape().nelements()>=2);
-       
-        /// Loop over all grids Fourier transforming and accumulating
-        bool first=true;
-        for (unsigned int i=0; i<itsGrid.size(); i++)
-        {
-          if (casacore::max(casacore::amplitude(itsGrid[i]))>0.0)
-          {
-            casacore::Array<imtypeComplex> scratch(itsGrid[i].shape());
-            casacore::convertArray<imtypeComplex,casacore::Complex>(scratch,itsGrid[i]);
-            scimath::fft2d(scratch, false);
-            multiply(scratch, i);
-       
-            if (first)  {
-              first=false;
-              dBuffer = real(scratch);
-            } else {
-              dBuffer += real(scratch);
-            }
-          }
-        }
+        dBuffer = real(itsStack);
         // Now we can do the convolution correction
         correctConvolution(dBuffer);
         dBuffer *= static_cast<imtype>(dBuffer.shape()(0)*dBuffer.shape()(1));
-        out = scimath::PaddingUtils::extract(dBuffer, paddingFactor());
-
       }
-
+      out = scimath::PaddingUtils::extract(dBuffer, paddingFactor());
+      itsStack.resize();
     }
 
     void WStackVisGridder::initialiseDegrid(const scimath::Axes& axes,
@@ -308,23 +554,29 @@ namespace askap
       initialiseFreqMapping();
 
       itsGrid.resize(nWPlanes());
+      itsActivePlanes.clear();
+      itsPlanesInPass.clear();
+      itsModel.resize();
       if (casacore::max(casacore::abs(in))>0.0) {
         itsModelIsEmpty=false;
-        ASKAPLOG_INFO_STR(logger, "Filling " << nWPlanes()
-                           << " planes of W stack with model");
         casacore::Array<imtype> scratch(itsShape,0.);
         scimath::PaddingUtils::extract(scratch, paddingFactor()) = in;
         correctConvolution(scratch);
-        for (int i=0; i<nWPlanes(); ++i)
-        {
-          casacore::Array<imtypeComplex> work(itsShape);
-          toComplex(work, scratch);
-          multiply(work, i);
-          /// Need to conjugate to get sense of w correction correct
-          work = casacore::conj(work);
-          scimath::fft2d(work, true);
-          itsGrid[i].resize(itsShape);
-          casacore::convertArray<casacore::Complex,imtypeComplex>(itsGrid[i],work);
+        itsModel.reference(scratch);
+        if (isStreaming()) {
+            ASKAPLOG_INFO_STR(logger, "Planes of W stack will be filled with model on demand, at most "
+                              << itsMaxActivePlanes << " out of " << nWPlanes() << " at a time");
+            for (int i=0; i<nWPlanes(); ++i) {
+                 itsGrid[i].resize();
+            }
+        } else {
+            ASKAPLOG_INFO_STR(logger, "Filling " << nWPlanes()
+                               << " planes of W stack with model");
+            for (int i=0; i<nWPlanes(); ++i)
+            {
+              fillPlane(i);
+            }
+            itsModel.resize();
         }
       } else {
         itsModelIsEmpty=true;
@@ -336,10 +588,25 @@ namespace askap
       }
     }
 
+    /// @brief Finalise the degridding
+    /// @details The model and the planes filled on demand are released.
+    void WStackVisGridder::finaliseDegrid()
+    {
+      TableVisGridder::finaliseDegrid();
+      if (isStreaming()) {
+          itsModel.resize();
+          for (unsigned int i=0; i<itsGrid.size(); i++) {
+               itsGrid[i].resize();
+          }
+          itsActivePlanes.clear();
+      }
+    }
+
     int WStackVisGridder::gIndex(int row, int pol, int chan)
     {
       const int plane = itsGMap(row, pol, chan);
       if (plane >=0) notifyOfWPlaneUse(plane);
+      ASKAPDEBUGASSERT((plane < 0) || (itsGrid[plane].nelements() > 0));
       return plane;
     }
 
@@ -358,6 +625,7 @@ namespace askap
       ASKAPLOG_INFO_STR(logger, "Gridding using W stacking with "<<nwplanes<<" w-planes in the stack");
       boost::shared_ptr<WStackVisGridder> gridder(new WStackVisGridder(wmax, nwplanes));
       gridder->configureWSampling(parset);
+      gridder->configureActivePlanes(parset);
       return gridder;
     }
 
@@ -32,6 +32,9 @@
 #include <askap/gridding/WDependentGridderBase.h>
 #include <askap/dataaccess/IConstDataAccessor.h>
 
+#include <list>
+#include <vector>
+
 namespace askap
 {
 	namespace synthesis
@@ -46,6 +49,16 @@ namespace askap
 		///
 		/// The scaling is fast in data points, slow in w planes.
 		///
+		/// By default all w planes are held in memory until finaliseGrid. If the
+		/// maximum number of active planes is set, only that many planes are kept.
+		/// The samples of each accessor are then processed in a number of passes,
+		/// one for each window of w planes they fall into, and a plane which has to
+		/// give way to another one is Fourier transformed and added to the stack
+		/// straight away (the stacking is linear, so the result is the same). Planes
+		/// for degridding are filled from the model on demand in the same way. This
+		/// trades memory for extra FFTs, which are few if consecutive accessors
+		/// cover similar ranges of w.
+		///
 		/// @ingroup gridding
 		class WStackVisGridder : public WDependentGridderBase
 		{
@@ -82,6 +95,35 @@ namespace askap
 				virtual void initialiseDegrid(const scimath::Axes& axes,
 				    const casacore::Array<imtype>& image);
 
+				/// @brief Grid the visibility data.
+				/// @param acc const data accessor to work with
+				virtual void grid(accessors::IConstDataAccessor& acc);
+
+				/// @brief Degrid the visibility data.
+				/// @param[in] acc non-const data accessor to work with
+				virtual void degrid(accessors::IDataAccessor& acc);
+
+				/// @brief Finalise the degridding
+				virtual void finaliseDegrid();
+
+				/// @brief check whether this gridder can be used in gridMultiTerm and degridMultiTerm
+				/// @return false, if only some of the w planes are kept in memory
+				virtual bool canProcessTermsTogether() const;
+
+				/// @brief check whether this gridder can run concurrently with other gridders
+				/// @return false, if only some of the w planes are kept in memory (planes
+				/// are transformed while gridding)
+				virtual bool canRunConcurrently() const;
+
+				/// @brief set the maximum number of w planes held in memory
+				/// @param[in] maxPlanes maximum number of active planes, zero or
+				/// a number not less than the number of w planes means all planes
+				void maxActivePlanes(const int maxPlanes);
+
+				/// @brief configure the maximum number of active planes from the parset
+				/// @param[in] parset parameter set (gridder name already removed)
+				void configureActivePlanes(const LOFAR::ParameterSet& parset);
+
 				/// Clone a copy of this Gridder
 				virtual IVisGridder::ShPtr clone();
 
@@ -112,6 +154,16 @@ namespace askap
 				/// @param chan Channel number
 				virtual int gIndex(int row, int pol, int chan);
 
+				/// @brief check whether the sample is processed in the current pass
+				/// @param row Row of accessor
+				/// @param chan Channel
+				/// @return true, if the w plane of this sample is in the current window
+				virtual bool isInCurrentPass(int row, int chan) const;
+
+				/// @brief check whether the current pass over the accessor is the first one
+				/// @return true, if the first window of w planes is processed or there are no windows
+				virtual bool isFirstPass() const;
+
 				/// Multiply by the phase screen
 				/// @param scratch To be multiplied
 				/// @param i Index
@@ -125,6 +177,56 @@ namespace askap
 				/// Mapping from row, pol, and channel to planes of grid
 				casacore::Cube<int> itsGMap;
             private:
+				/// @return true, if only some of the w planes are kept in memory
+				bool isStreaming() const;
+
+				/// @brief find w planes used by the given accessor
+				/// @details Planes already in memory come first, so they are processed
+				/// before any of them has to give way to a new plane.
+				/// @param[in] acc const accessor to work with
+				/// @param[out] planes numbers of the planes used
+				void planesInUse(const accessors::IConstDataAccessor& acc, std::vector<int>& planes) const;
+
+				/// @brief make the given planes active
+				/// @details The least recently used planes are released if necessary.
+				/// They are stacked when gridding and just dropped when degridding.
+				/// New planes are set to zero for gridding and filled from the model
+				/// for degridding.
+				/// @param[in] planes planes to activate, at most the maximum number of active planes
+				/// @param[in] forward true for degridding
+				void activatePlanes(const std::vector<int>& planes, const bool forward);
+
+				/// @brief Fourier transform a plane and add it to the stack
+				/// @param[in] i plane number
+				void stackPlane(const int i);
+
+				/// @brief fill a plane from the model for degridding
+				/// @param[in] i plane number
+				void fillPlane(const int i);
+
+				/// @brief maximum number of planes in memory, zero means all planes
+				int itsMaxActivePlanes;
+
+				/// @brief planes in memory, the most recently used first
+				std::list<int> itsActivePlanes;
+
+				/// @brief flags for planes processed in the current pass, empty if all are processed
+				std::vector<bool> itsPlanesInPass;
+
+				/// @brief true for the first pass over an accessor
+				/// @details Samples with w out of range are processed in this pass only.
+				bool itsFirstPass;
+
+				/// @brief sum of the Fourier transformed planes (or uv planes for the preconditioner)
+				casacore::Array<imtypeComplex> itsStack;
+
+				/// @brief padded model corrected for the convolution function
+				/// @details Only used for degridding, if planes are filled on demand.
+				casacore::Array<imtype> itsModel;
+
+				/// @brief number of planes stacked before finaliseGrid
+				int itsEarlyStackedPlanes;
+
     	        /// @brief assignment operator
 				/// @details It is required as private to avoid being called
 				/// @param[in] other input object
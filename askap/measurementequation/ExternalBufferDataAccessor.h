@@ -0,0 +1,76 @@
+/// @file
+///
+/// @brief Data accessor with the visibility buffer held outside the accessor
+/// @details Similar to MemBufferDataAccessor, this adapter keeps all metadata of the
+/// original accessor and supplies its own visibility cube. However, the storage of
+/// the cube is provided by the caller, so it can be reused for every chunk of data
+/// instead of allocating a new buffer for each accessor. The buffer is only resized
+/// if the shape of the visibility cube changes.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#ifndef ASKAP_SYNTHESIS_EXTERNAL_BUFFER_DATA_ACCESSOR_H
+#define ASKAP_SYNTHESIS_EXTERNAL_BUFFER_DATA_ACCESSOR_H
+
+// casa includes
+#include <casacore/casa/Arrays/Cube.h>
+#include <casacore/casa/BasicSL/Complex.h>
+
+// own includes
+#include <askap/dataaccess/MemBufferDataAccessor.h>
+
+namespace askap {
+
+namespace synthesis {
+
+/// @brief Data accessor with the visibility buffer held outside the accessor
+/// @details The buffer is resized to match the original accessor in the constructor,
+/// its content is undefined until written to (it holds whatever the previous chunk left).
+/// @ingroup measurementequation
+class ExternalBufferDataAccessor : public accessors::MemBufferDataAccessor {
+public:
+  /// @brief construct an adapter
+  /// @param[in] acc accessor to take the metadata from
+  /// @param[in] buffer cube to use as the visibility buffer, it has to outlive this object
+  ExternalBufferDataAccessor(const accessors::IConstDataAccessor &acc,
+                             casacore::Cube<casacore::Complex> &buffer);
+
+  /// @brief read-only visibilities
+  /// @return reference to the external buffer
+  virtual const casacore::Cube<casacore::Complex>& visibility() const;
+
+  /// @brief read-write access to visibilities
+  /// @return reference to the external buffer
+  virtual casacore::Cube<casacore::Complex>& rwVisibility();
+
+private:
+  /// @brief external buffer
+  casacore::Cube<casacore::Complex> &itsBuffer;
+};
+
+} // namespace synthesis
+
+} // namespace askap
+
+#endif // #ifndef ASKAP_SYNTHESIS_EXTERNAL_BUFFER_DATA_ACCESSOR_H
@@ -38,6 +38,7 @@ ASKAP_LOGGER(logger, ".measurementequation.imageamsmfsolver");
 #include <askap/measurementequation/SynthesisParamsHelper.h>
 #include <askap/measurementequation/ImageParamsHelper.h>
 #include <askap/scimath/utils/MultiDimArrayPlaneIter.h>
+#include <askap/utils/MetricsRegistry.h>
 
 #include <askap/deconvolution/DeconvolverMultiTermBasisFunction.h>
 
@@ -497,7 +498,12 @@ namespace askap
 	  {
          ASKAPTRACE("ImageAMSMFSolver::solveNormalEquations._calldeconvolver");
          ASKAPLOG_INFO_STR(logger, "Starting Minor Cycles ("<<imageTag<<").");
-         itsCleaners[imageTag]->deconvolve();
+         {
+            utils::MetricsTimer metricsTimer("deconvolver.time");
+            itsCleaners[imageTag]->deconvolve();
+         }
+         utils::MetricsRegistry::instance().add("deconvolver.iterations",
+                                                itsCleaners[imageTag]->state()->currentIter());
          ASKAPLOG_INFO_STR(logger, "Finished Minor Cycles ("<<imageTag<<").");
       }
 
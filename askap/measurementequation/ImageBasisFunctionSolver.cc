@@ -33,6 +33,7 @@ ASKAP_LOGGER(logger, ".measurementequation.imagebasisfunctionsolver");
 #include <askap/askap/AskapUtil.h>
 
 #include <askap/scimath/utils/MultiDimArrayPlaneIter.h>
+#include <askap/utils/MetricsRegistry.h>
 #include <askap/profile/AskapProfiler.h>
 
 #include <casacore/casa/aips.h>
@@ -242,7 +243,12 @@ namespace askap
 	    basisFunctionDec->control()->setFractionalThreshold(fractionalThreshold());
 
 	    ASKAPLOG_INFO_STR(logger, "Starting basis function deconvolution");
-	    basisFunctionDec->deconvolve();
+	    {
+	      utils::MetricsTimer metricsTimer("deconvolver.time");
+	      basisFunctionDec->deconvolve();
+	    }
+	    utils::MetricsRegistry::instance().add("deconvolver.iterations",
+	                                           basisFunctionDec->state()->currentIter());
 	    ASKAPLOG_INFO_STR(logger, "Peak flux of the Basis function image "
 			      << max(basisFunctionDec->model()));
 	    ASKAPLOG_INFO_STR(logger, "Peak residual of Basis function image "
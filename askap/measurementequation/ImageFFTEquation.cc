@@ -34,6 +34,8 @@ ASKAP_LOGGER(logger, ".measurementequation.imagefftequation");
 #include <askap/scimath/fitting/Params.h>
 #include <askap/measurementequation/ImageFFTEquation.h>
 #include <askap/measurementequation/SynthesisParamsHelper.h>
+#include <askap/measurementequation/ImageParamsHelper.h>
+#include <askap/measurementequation/ExternalBufferDataAccessor.h>
 #include <askap/gridding/BoxVisGridder.h>
 #include <askap/gridding/SphFuncVisGridder.h>
 #include <askap/scimath/fitting/ImagingNormalEquations.h>
@@ -49,7 +51,14 @@ ASKAP_LOGGER(logger, ".measurementequation.imagefftequation");
 #include <casacore/casa/Arrays/Matrix.h>
 #include <casacore/casa/Arrays/ArrayMath.h>
 
+#include <algorithm>
+#include <exception>
 #include <stdexcept>
+#include <set>
+#include <typeinfo>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 
 using askap::scimath::Params;
 using askap::scimath::Axes;
@@ -57,6 +66,88 @@ using askap::scimath::ImagingNormalEquations;
 using askap::scimath::DesignMatrix;
 using namespace askap::accessors;
 
+namespace {
+
+/// @brief grid or degrid the data with one gridder
+/// @param[in] gridder gridder to use
+/// @param[in] terms gridders of other Taylor terms processed in the same pass or zero pointer
+/// @param[in] acc accessor to work with
+/// @param[in] forward true for degridding, false for gridding
+void runGridder(const askap::synthesis::IVisGridder::ShPtr &gridder,
+                const std::vector<boost::shared_ptr<askap::synthesis::TableVisGridder> > *terms,
+                IDataAccessor &acc, bool forward)
+{
+  ASKAPDEBUGASSERT(gridder);
+  if (terms) {
+      const boost::shared_ptr<askap::synthesis::TableVisGridder> lead =
+            boost::dynamic_pointer_cast<askap::synthesis::TableVisGridder>(gridder);
+      ASKAPDEBUGASSERT(lead);
+      if (forward) {
+          lead->degridMultiTerm(acc, *terms);
+      } else {
+          lead->gridMultiTerm(acc, *terms);
+      }
+  } else if (forward) {
+      gridder->degrid(acc);
+  } else {
+      gridder->grid(acc);
+  }
+}
+
+/// @brief read all fields of the accessor used by gridders
+/// @details Accessors read and cache the data on demand, which is not thread safe.
+/// @param[in] acc accessor to read
+void prefetchAccessor(const IConstDataAccessor &acc)
+{
+  acc.visibility();
+  acc.flag();
+  acc.noise();
+  acc.uvw();
+  acc.frequency();
+  acc.time();
+  acc.stokes();
+  acc.antenna1();
+  acc.antenna2();
+  acc.feed1();
+  acc.feed2();
+  acc.feed1PA();
+  acc.feed2PA();
+  acc.pointingDir1();
+  acc.pointingDir2();
+  acc.dishPointing1();
+  acc.dishPointing2();
+}
+
+/// @brief switch degridders to subtraction of the model for the lifetime of this object
+/// @details The default (addition) is restored on exit, including exceptions, as the same
+/// gridders are used for prediction.
+class ModelSubtraction : public boost::noncopyable {
+public:
+  /// @brief set up degridders to subtract the model
+  /// @param[in] gridders degridders to switch
+  explicit ModelSubtraction(const std::vector<boost::shared_ptr<askap::synthesis::TableVisGridder> > &gridders) :
+           itsGridders(gridders)
+  {
+    for (size_t i = 0; i < itsGridders.size(); ++i) {
+         itsGridders[i]->doSubtractModel(true);
+    }
+  }
+
+  /// @brief restore the default
+  ~ModelSubtraction()
+  {
+    for (size_t i = 0; i < itsGridders.size(); ++i) {
+         itsGridders[i]->doSubtractModel(false);
+    }
+  }
+
+private:
+  /// @brief degridders to switch
+  const std::vector<boost::shared_ptr<askap::synthesis::TableVisGridder> > itsGridders;
+};
+
+} // anonymous namespace
+
 namespace askap
 {
   namespace synthesis
@@ -66,7 +157,7 @@ namespace askap
         IDataSharedIter& idi) : scimath::Equation(ip),
       askap::scimath::ImagingEquation(ip), itsIdi(idi),
       itsSphFuncPSFGridder(false), itsBoxPSFGridder(false),
-      itsUsePreconGridder(false), itsNDir(1)
+      itsUsePreconGridder(false), itsCachePSF(false), itsFuseTaylorTerms(false), itsGridderThreads(1), itsNDir(1)
     {
       itsGridder = IVisGridder::ShPtr(new SphFuncVisGridder());
       init();
@@ -75,7 +166,7 @@ namespace askap
 
     ImageFFTEquation::ImageFFTEquation(IDataSharedIter& idi) :
       itsIdi(idi), itsSphFuncPSFGridder(false), itsBoxPSFGridder(false),
-      itsUsePreconGridder(false), itsNDir(1)
+      itsUsePreconGridder(false), itsCachePSF(false), itsFuseTaylorTerms(false), itsGridderThreads(1), itsNDir(1)
     {
       itsGridder = IVisGridder::ShPtr(new SphFuncVisGridder());
       reference(defaultParameters().clone());
@@ -86,7 +177,7 @@ namespace askap
         IDataSharedIter& idi, IVisGridder::ShPtr gridder) :
       scimath::Equation(ip), askap::scimath::ImagingEquation(ip),
       itsGridder(gridder), itsIdi(idi), itsSphFuncPSFGridder(false),
-      itsBoxPSFGridder(false), itsUsePreconGridder(false), itsNDir(1)
+      itsBoxPSFGridder(false), itsUsePreconGridder(false), itsCachePSF(false), itsFuseTaylorTerms(false), itsGridderThreads(1), itsNDir(1)
     {
       init();
     }
@@ -97,7 +188,7 @@ namespace askap
         const LOFAR::ParameterSet& parset) : scimath::Equation(ip),
       askap::scimath::ImagingEquation(ip), itsGridder(gridder), itsIdi(idi),
       itsSphFuncPSFGridder(false), itsBoxPSFGridder(false),
-      itsUsePreconGridder(false), itsNDir(1)
+      itsUsePreconGridder(false), itsCachePSF(false), itsFuseTaylorTerms(false), itsGridderThreads(1), itsNDir(1)
     {
       useAlternativePSF(parset);
       init();
@@ -106,7 +197,7 @@ namespace askap
     ImageFFTEquation::ImageFFTEquation(IDataSharedIter& idi,
         IVisGridder::ShPtr gridder) :
       itsGridder(gridder), itsIdi(idi), itsSphFuncPSFGridder(false),
-      itsBoxPSFGridder(false), itsUsePreconGridder(false), itsNDir(1)
+      itsBoxPSFGridder(false), itsUsePreconGridder(false), itsCachePSF(false), itsFuseTaylorTerms(false), itsGridderThreads(1), itsNDir(1)
     {
       reference(defaultParameters().clone());
       init();
@@ -123,6 +214,12 @@ namespace askap
       const bool useGentlePCF = parset.getBool("preconditioner.preservecf", false);
       const bool useBoxPSF = parset.getBool("boxforpsf", false);
       const bool useSphPSF = parset.getBool("sphfuncforpsf", false);
+      cachePSF(parset.getBool("cachepsf", false));
+      fuseTaylorTerms(parset.getBool("fusetaylorterms", false));
+      if (itsFuseTaylorTerms) {
+          ASKAPLOG_INFO_STR(logger, "Taylor terms will be gridded and degridded in one pass");
+      }
+      gridderThreads(parset.getInt32("gridderthreads", 1));
 
       if (useGentlePCF) {
          itsUsePreconGridder = true;
@@ -148,6 +245,31 @@ namespace askap
       }
     }
 
+    /// @brief switch caching of the PSF and preconditioner function on or off
+    /// @param[in] flag true to cache the PSF and preconditioner function
+    void ImageFFTEquation::cachePSF(bool flag)
+    {
+      itsCachePSF = flag;
+      if (flag) {
+          ASKAPLOG_INFO_STR(logger,
+              "The PSF and preconditioner function will be gridded once and reused in subsequent major cycles");
+      } else {
+          itsPSFCache.clear();
+          itsPCFCache.clear();
+      }
+    }
+
+    /// @brief set the number of threads used to run gridders of different images
+    /// @param[in] nThreads maximum number of threads, 1 means serial processing
+    void ImageFFTEquation::gridderThreads(int nThreads)
+    {
+      ASKAPCHECK(nThreads > 0, "Number of gridder threads is supposed to be positive, you have "<<nThreads);
+      itsGridderThreads = nThreads;
+      if (nThreads > 1) {
+          ASKAPLOG_INFO_STR(logger, "Gridders of different images will be run in up to "<<nThreads<<" threads");
+      }
+    }
+
     askap::scimath::Params ImageFFTEquation::defaultParameters()
     {
       Params ip(true);
@@ -171,6 +293,9 @@ namespace askap
         itsSphFuncPSFGridder = other.itsSphFuncPSFGridder;
         itsBoxPSFGridder = other.itsBoxPSFGridder;
         itsUsePreconGridder = other.itsUsePreconGridder;
+        itsCachePSF = other.itsCachePSF;
+        itsFuseTaylorTerms = other.itsFuseTaylorTerms;
+        itsGridderThreads = other.itsGridderThreads;
         itsVisUpdateObject = other.itsVisUpdateObject;
       }
       return *this;
@@ -300,6 +425,17 @@ namespace askap
       unsigned long current_rows = 0;
       #endif // #ifdef ASKAP_DEBUG
 
+      // Taylor terms degridded in one pass
+      TaylorTermGroups degridGroups;
+      std::set<std::string> fusedTerms;
+      if (itsFuseTaylorTerms) {
+          std::vector<std::string> names;
+          for (std::vector<std::string>::const_iterator it=completions.begin();it!=completions.end();++it) {
+               names.push_back("image"+(*it));
+          }
+          groupTaylorTerms(names, itsModelGridders, degridGroups, fusedTerms);
+      }
+
       for (itsIdi.init();itsIdi.hasMore();itsIdi.next())
       {
         itsIdi->rwVisibility().set(0.0);
@@ -312,7 +448,15 @@ namespace askap
         for (std::vector<std::string>::const_iterator it=completions.begin();it!=completions.end();it++)
         {
             string imageName("image"+(*it));
-            itsModelGridders[imageName]->degrid(*itsIdi);
+            const TaylorTermGroups::const_iterator group = degridGroups.find(imageName);
+            if (group != degridGroups.end()) {
+                const boost::shared_ptr<TableVisGridder> lead =
+                      boost::dynamic_pointer_cast<TableVisGridder>(itsModelGridders[imageName]);
+                ASKAPDEBUGASSERT(lead);
+                lead->degridMultiTerm(*itsIdi, group->second);
+            } else if (fusedTerms.count(imageName) == 0) {
+                itsModelGridders[imageName]->degrid(*itsIdi);
+            }
         }
         #ifdef ASKAP_DEBUG
         const casacore::uInt nRow = itsIdi->nRow();
@@ -327,6 +471,148 @@ namespace askap
       ASKAPLOG_DEBUG_STR(logger, "Finished degridding model" );
     };
 
+    /// @brief number of threads to run the given gridders
+    /// @param[in] tasks gridders to run for each chunk of data
+    /// @return number of threads, 1 if gridders have to be run in a serial fashion
+    int ImageFFTEquation::numberOfThreads(const std::vector<GridderTask> &tasks) const
+    {
+      if ((itsGridderThreads < 2) || (tasks.size() < 2)) {
+          return 1;
+      }
+      for (std::vector<GridderTask>::const_iterator ci = tasks.begin(); ci != tasks.end(); ++ci) {
+           const boost::shared_ptr<TableVisGridder> tvg = boost::dynamic_pointer_cast<TableVisGridder>(ci->gridder);
+           if (!tvg || !tvg->canRunConcurrently()) {
+               return 1;
+           }
+           if (ci->terms) {
+               for (size_t term = 0; term < ci->terms->size(); ++term) {
+                    if (!(*ci->terms)[term]->canRunConcurrently()) {
+                        return 1;
+                    }
+               }
+           }
+      }
+      return std::min(itsGridderThreads, int(tasks.size()));
+    }
+
+    /// @brief grid or degrid a chunk of data with a number of gridders
+    /// @details Degridded visibilities are added to the accessor (or subtracted, if degridders
+    /// are set up to subtract the model).
+    /// @param[in] tasks gridders to run
+    /// @param[in] acc accessor to work with
+    /// @param[in] forward true for degridding, false for gridding
+    /// @param[in] nThreads number of threads to use
+    void ImageFFTEquation::runGridders(const std::vector<GridderTask> &tasks, accessors::IDataAccessor &acc,
+                                       bool forward, int nThreads)
+    {
+      if (nThreads < 2) {
+          for (size_t i = 0; i < tasks.size(); ++i) {
+               runGridder(tasks[i].gridder, tasks[i].terms, acc, forward);
+          }
+          return;
+      }
+      // accessors read the data on demand, this has to be done before the gridders share the accessor
+      prefetchAccessor(acc);
+      // exceptions can't leave the parallel region, the first one is rethrown afterwards
+      std::exception_ptr error;
+      #pragma omp parallel num_threads(nThreads)
+      {
+          // degridded visibilities are accumulated in a buffer per thread
+          boost::scoped_ptr<MemBufferDataAccessor> buffer;
+          if (forward) {
+              buffer.reset(new MemBufferDataAccessor(acc));
+              buffer->rwVisibility().set(0.);
+          }
+          #pragma omp for schedule(dynamic)
+          for (int i = 0; i < int(tasks.size()); ++i) {
+               try {
+                   if (forward) {
+                       runGridder(tasks[i].gridder, tasks[i].terms, *buffer, true);
+                   } else {
+                       runGridder(tasks[i].gridder, tasks[i].terms, acc, false);
+                   }
+               }
+               catch (...) {
+                   #pragma omp critical
+                   {
+                       if (!error) {
+                           error = std::current_exception();
+                       }
+                   }
+               }
+          }
+          if (forward) {
+              #pragma omp critical
+              {
+                  acc.rwVisibility() += buffer->visibility();
+              }
+          }
+      }
+      if (error) {
+          std::rethrow_exception(error);
+      }
+    }
+
+    /// @brief find Taylor terms which can be processed in one pass
+    /// @details For each image with at least two Taylor terms handled by gridders of the
+    /// same type derived from TableVisGridder, the 0th order term is mapped to the gridders of
+    /// other terms.
+    /// @param[in] names image parameters to consider
+    /// @param[in] gridders gridders used for these parameters
+    /// @param[out] groups map of the 0th order term to the gridders of other terms
+    /// @param[out] others names of the parameters processed together with the 0th order term
+    void ImageFFTEquation::groupTaylorTerms(const std::vector<std::string> &names,
+                                            const std::map<std::string, IVisGridder::ShPtr> &gridders,
+                                            TaylorTermGroups &groups, std::set<std::string> &others)
+    {
+      groups.clear();
+      others.clear();
+      // image name without the Taylor suffix -> order -> full name
+      std::map<std::string, std::map<int, std::string> > terms;
+      for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); ++it) {
+           const ImageParamsHelper iph(*it);
+           if (iph.isTaylorTerm()) {
+               terms[iph.facetName()][iph.order()] = *it;
+           }
+      }
+      for (std::map<std::string, std::map<int, std::string> >::const_iterator ci = terms.begin();
+           ci != terms.end(); ++ci) {
+           const std::map<int, std::string>::const_iterator zeroOrder = ci->second.find(0);
+           if ((zeroOrder == ci->second.end()) || (ci->second.size() < 2)) {
+               continue;
+           }
+           const std::map<std::string, IVisGridder::ShPtr>::const_iterator leadIt = gridders.find(zeroOrder->second);
+           ASKAPDEBUGASSERT(leadIt != gridders.end());
+           const boost::shared_ptr<TableVisGridder> lead =
+                 boost::dynamic_pointer_cast<TableVisGridder>(leadIt->second);
+           if (!lead || !lead->canProcessTermsTogether()) {
+               continue;
+           }
+           std::vector<boost::shared_ptr<TableVisGridder> > group;
+           for (std::map<int, std::string>::const_iterator term = ci->second.begin(); term != ci->second.end(); ++term) {
+                if (term != zeroOrder) {
+                    const std::map<std::string, IVisGridder::ShPtr>::const_iterator grdIt = gridders.find(term->second);
+                    ASKAPDEBUGASSERT(grdIt != gridders.end());
+                    const boost::shared_ptr<TableVisGridder> gridder =
+                          boost::dynamic_pointer_cast<TableVisGridder>(grdIt->second);
+                    if (!gridder || (typeid(*gridder) != typeid(*lead)) || !gridder->canProcessTermsTogether()) {
+                        group.clear();
+                        break;
+                    }
+                    group.push_back(gridder);
+                }
+           }
+           if (group.size() > 0) {
+               groups[zeroOrder->second] = group;
+               for (std::map<int, std::string>::const_iterator term = ci->second.begin(); term != ci->second.end(); ++term) {
+                    if (term != zeroOrder) {
+                        others.insert(term->second);
+                    }
+               }
+           }
+      }
+    }
+
     /// @brief assign a different iterator
     /// @details This is a temporary method to assign a different iterator.
     /// All this business is a bit ugly, but should go away when all
@@ -335,6 +621,9 @@ namespace askap
     void ImageFFTEquation::setIterator(IDataSharedIter& idi)
     {
       itsIdi = idi;
+      // cached PSFs correspond to the old data
+      itsPSFCache.clear();
+      itsPCFCache.clear();
     }
 
 
@@ -397,11 +686,20 @@ namespace askap
               "Found no free image parameters, this rank will not contribute usefully to normal equations");
       }
       bool somethingHasToBeDegridded = false;
+      // images for which the PSF (and preconditioner function) from the previous call can be reused
+      std::set<std::string> psfCached;
       for (std::vector<std::string>::const_iterator it=completions.begin();it!=completions.end();it++)
       {
         string imageName("image"+(*it));
         ASKAPLOG_DEBUG_STR(logger, "Initialising for " << imageName);
         const Axes axes(parameters().axes(imageName));
+        if (itsCachePSF) {
+            const std::map<std::string, casacore::Array<imtype> >::const_iterator ci = itsPSFCache.find(imageName);
+            if ((ci != itsPSFCache.end()) && ci->second.shape().isEqual(parameters().shape(imageName)) &&
+                (itsPCFCache.count(imageName) > 0 || itsPreconGridders.count(imageName) == 0)) {
+                psfCached.insert(imageName);
+            }
+        }
         casacore::Array<imtype> imagePixels;
         #ifdef ASKAP_FLOAT_IMAGE_PARAMS
             imagePixels = parameters().valueF(imageName);
@@ -418,6 +716,10 @@ namespace askap
         /// Now the residual images, dopsf=false, dopcf=false
         itsResidualGridders[imageName]->customiseForContext(*it);
         itsResidualGridders[imageName]->initialiseGrid(axes, imageShape, false);
+        if (psfCached.count(imageName) > 0) {
+            ASKAPLOG_DEBUG_STR(logger, "Reusing cached PSF for " << imageName);
+            continue;
+        }
         // and PSF gridders, dopsf=true, dopcf=false
         itsPSFGridders[imageName]->customiseForContext(*it);
         itsPSFGridders[imageName]->initialiseGrid(axes, imageShape, true);
@@ -431,52 +733,121 @@ namespace askap
       if (itsVisUpdateObject) {
           itsVisUpdateObject->aggregateFlag(somethingHasToBeDegridded);
       }
+      // Taylor terms processed in one pass
+      TaylorTermGroups degridGroups, gridGroups;
+      std::set<std::string> fusedDegridTerms, fusedGridTerms;
+      if (itsFuseTaylorTerms) {
+          std::vector<std::string> names, freeNames;
+          for (std::vector<std::string>::const_iterator it=completions.begin();it!=completions.end();++it) {
+               const std::string imageName("image"+(*it));
+               names.push_back(imageName);
+               if (parameters().isFree(imageName)) {
+                   freeNames.push_back(imageName);
+               }
+          }
+          groupTaylorTerms(names, itsModelGridders, degridGroups, fusedDegridTerms);
+          groupTaylorTerms(freeNames, itsResidualGridders, gridGroups, fusedGridTerms);
+          ASKAPLOG_DEBUG_STR(logger, "Number of Taylor term groups processed in one pass is "<<degridGroups.size()<<
+                            " (degridding) and "<<gridGroups.size()<<" (gridding)");
+      }
+      // gridders (together with Taylor terms processed in the same pass) going through each chunk of data
+      std::vector<GridderTask> degridTasks, gridTasks;
+      size_t nFreeImages = 0;
+      for (size_t i = 0; i<completions.size(); ++i) {
+           const std::string imageName("image"+completions[i]);
+           const std::map<std::string, IVisGridder::ShPtr>::iterator grdIt = itsModelGridders.find(imageName);
+           ASKAPDEBUGASSERT(grdIt != itsModelGridders.end());
+           const IVisGridder::ShPtr degridder = grdIt->second;
+           ASKAPDEBUGASSERT(degridder);
+           const TaylorTermGroups::const_iterator group = degridGroups.find(imageName);
+           if (group != degridGroups.end()) {
+               bool empty = degridder->isModelEmpty();
+               for (size_t term = 0; term < group->second.size(); ++term) {
+                    empty &= group->second[term]->isModelEmpty();
+               }
+               if (!empty) {
+                   const GridderTask task = {degridder, &group->second};
+                   degridTasks.push_back(task);
+               }
+           } else if (!degridder->isModelEmpty() && (fusedDegridTerms.count(imageName) == 0)) {
+               const GridderTask task = {degridder, 0};
+               degridTasks.push_back(task);
+           }
+      }
+      for (size_t i = 0; i<completions.size(); ++i) {
+           const std::string imageName("image"+completions[i]);
+           if (parameters().isFree(imageName)) {
+               ++nFreeImages;
+               const TaylorTermGroups::const_iterator group = gridGroups.find(imageName);
+               if (group != gridGroups.end()) {
+                   const GridderTask task = {itsResidualGridders[imageName], &group->second};
+                   gridTasks.push_back(task);
+               } else if (fusedGridTerms.count(imageName) == 0) {
+                   const GridderTask task = {itsResidualGridders[imageName], 0};
+                   gridTasks.push_back(task);
+               }
+               if (psfCached.count(imageName) == 0) {
+                   const GridderTask psfTask = {itsPSFGridders[imageName], 0};
+                   gridTasks.push_back(psfTask);
+                   if (itsUsePreconGridder && (itsPreconGridders.count(imageName)>0)) {
+                       const GridderTask pcfTask = {itsPreconGridders[imageName], 0};
+                       gridTasks.push_back(pcfTask);
+                   }
+               }
+           }
+      }
+      const int nDegridThreads = numberOfThreads(degridTasks);
+      const int nGridThreads = numberOfThreads(gridTasks);
+      ASKAPLOG_DEBUG_STR(logger, "Number of threads running "<<degridTasks.size()<<" degridders is "<<nDegridThreads<<
+                        ", "<<gridTasks.size()<<" gridders is "<<nGridThreads);
+
+      // Degridders derived from TableVisGridder can subtract the model straight from the observed
+      // visibilities. This is not possible if model visibilities have to be aggregated across ranks
+      std::vector<boost::shared_ptr<TableVisGridder> > subtractingDegridders;
+      bool subtractInDegridder = !itsVisUpdateObject;
+      for (std::vector<GridderTask>::const_iterator ci = degridTasks.begin();
+           subtractInDegridder && (ci != degridTasks.end()); ++ci) {
+           const boost::shared_ptr<TableVisGridder> tvg = boost::dynamic_pointer_cast<TableVisGridder>(ci->gridder);
+           subtractInDegridder = static_cast<bool>(tvg);
+           subtractingDegridders.push_back(tvg);
+      }
+      if (!subtractInDegridder) {
+          subtractingDegridders.clear();
+      }
+      const ModelSubtraction modelSubtraction(subtractingDegridders);
+
       // Now we loop through all the data
       ASKAPLOG_DEBUG_STR(logger, "Starting degridding model and gridding residuals" );
       size_t counterGrid = 0, counterDegrid = 0;
       for (itsIdi.init();itsIdi.hasMore();itsIdi.next())
       {
         // buffer-accessor, used as a replacement for proper buffers held in the subtable
-        // effectively, an array with the same shape as the visibility cube is held by this class
-        MemBufferDataAccessor accBuffer(*itsIdi);
-
-        // Accumulate model visibility for all models
-        accBuffer.rwVisibility().set(0.0);
-        if (somethingHasToBeDegridded) {
-            for (std::vector<std::string>::const_iterator it=completions.begin();it!=completions.end();++it) {
-                 const std::string imageName("image"+(*it));
-                 const std::map<std::string, IVisGridder::ShPtr>::iterator grdIt = itsModelGridders.find(imageName);
-                 ASKAPDEBUGASSERT(grdIt != itsModelGridders.end());
-                 const IVisGridder::ShPtr degridder = grdIt->second;
-                 ASKAPDEBUGASSERT(degridder);
-                 if (!degridder->isModelEmpty()) {
-                     degridder->degrid(accBuffer);
-                     counterDegrid+=accBuffer.nRow();
-                 }
+        // the storage is recycled across chunks and only reallocated if the shape changes
+        ExternalBufferDataAccessor accBuffer(*itsIdi, itsResidualBuffer);
+
+        if (subtractInDegridder || !somethingHasToBeDegridded) {
+            // residuals are formed in a single pass, degridders subtract the model from the data
+            accBuffer.rwVisibility() = itsIdi->visibility();
+            if (somethingHasToBeDegridded) {
+                runGridders(degridTasks, accBuffer, true, nDegridThreads);
+                counterDegrid += accBuffer.nRow() * degridTasks.size();
             }
+        } else {
+            // Accumulate model visibility for all models
+            accBuffer.rwVisibility().set(0.0);
+            runGridders(degridTasks, accBuffer, true, nDegridThreads);
+            counterDegrid += accBuffer.nRow() * degridTasks.size();
             // optional aggregation of visibilities in the case of distributed model
             // somethingHasToBeDegridded is supposed to have consistent value across all participating ranks
             if (itsVisUpdateObject) {
                 itsVisUpdateObject->update(accBuffer.rwVisibility());
             }
-            //
+            accBuffer.rwVisibility() -= itsIdi->visibility();
+            accBuffer.rwVisibility() *= float(-1.);
         }
-        accBuffer.rwVisibility() -= itsIdi->visibility();
-        accBuffer.rwVisibility() *= float(-1.);
         /// Now we can calculate the residual visibility and image
-        size_t tempCounter = 0;
-        for (size_t i = 0; i<completions.size(); ++i) {
-            const string imageName("image"+completions[i]);
-            if (parameters().isFree(imageName)) {
-                itsResidualGridders[imageName]->grid(accBuffer);
-                itsPSFGridders[imageName]->grid(accBuffer);
-                if (itsUsePreconGridder && (itsPreconGridders.count(imageName)>0)) {
-                    itsPreconGridders[imageName]->grid(accBuffer);
-                }
-                tempCounter += accBuffer.nRow();
-            }
-        }
-        counterGrid += tempCounter;
+        runGridders(gridTasks, accBuffer, false, nGridThreads);
+        counterGrid += accBuffer.nRow() * nFreeImages;
       }
       ASKAPLOG_DEBUG_STR(logger, "Finished degridding model and gridding residuals" );
       ASKAPLOG_DEBUG_STR(logger, "Number of accessor rows iterated through is "<<counterGrid<<" (gridding) and "<<
@@ -509,7 +880,15 @@ namespace askap
         //}
         // end debugging code
 
-        itsPSFGridders[imageName]->finaliseGrid(imagePSF);
+        const bool usePSFCache = (psfCached.count(imageName) > 0);
+        if (usePSFCache) {
+            imagePSF = itsPSFCache[imageName];
+        } else {
+            itsPSFGridders[imageName]->finaliseGrid(imagePSF);
+            if (itsCachePSF) {
+                itsPSFCache[imageName] = imagePSF.copy();
+            }
+        }
         itsResidualGridders[imageName]->finaliseWeights(imageWeight);
 
         // just to deallocate the grid memory
@@ -539,7 +918,14 @@ namespace askap
         casacore::Vector<imtype> imagePreconVec;
         if (itsUsePreconGridder && (itsPreconGridders.count(imageName)>0)) {
           casacore::Array<imtype> imagePrecon(imageShape);
-          itsPreconGridders[imageName]->finaliseGrid(imagePrecon);
+          if (usePSFCache) {
+              imagePrecon = itsPCFCache[imageName];
+          } else {
+              itsPreconGridders[imageName]->finaliseGrid(imagePrecon);
+              if (itsCachePSF) {
+                  itsPCFCache[imageName] = imagePrecon.copy();
+              }
+          }
           imagePreconVec.reference(imagePrecon.reform(vecShape));
         }
 
@@ -35,6 +35,7 @@
 #include <askap/scimath/utils/ChangeMonitor.h>
 
 #include <askap/gridding/IVisGridder.h>
+#include <askap/gridding/TableVisGridder.h>
 #include <askap/dataaccess/SharedIter.h>
 #include <askap/dataaccess/IDataIterator.h>
 #include <askap/measurementequation/IVisCubeUpdate.h>
@@ -47,6 +48,9 @@
 #include <casacore/coordinates/Coordinates/CoordinateSystem.h>
 
 #include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 #include <boost/shared_ptr.hpp>
 
@@ -139,9 +143,44 @@ namespace askap
         /// kernels during preconditioning when robustness approaches uniform
         /// weighting. A separate preconditioner function can also be selected.
         /// @param[in] parset imager parameter set to check for PSF options.
-        /// Current options: sphfuncforpsf, boxforpsf and preconditioner.preservecf.
+        /// Current options: sphfuncforpsf, boxforpsf, preconditioner.preservecf, cachepsf,
+        /// fusetaylorterms and gridderthreads.
         void useAlternativePSF(const LOFAR::ParameterSet& parset);
 
+        /// @brief switch caching of the PSF and preconditioner function on or off
+        /// @details The PSF and the preconditioner function depend only on the sampling
+        /// and weights, which don't change between major cycles. If caching is on, they
+        /// are gridded on the first call of calcImagingEquations only, and the finalised
+        /// images are kept in memory and reused on subsequent calls. The cache is dropped
+        /// if the iterator is replaced or the image shape changes, but not if the data it
+        /// yields change, so it must not be used with a calibration iterator (the imagers
+        /// refuse this combination). Caching only helps if the equation object lives
+        /// across major cycles, i.e. in the parallel imager and the distributed imager;
+        /// the serial ImagerParallel path creates a new equation for every dataset.
+        /// @param[in] flag true to cache the PSF and preconditioner function
+        void cachePSF(bool flag);
+
+        /// @brief switch fused processing of Taylor terms on or off
+        /// @details In the multi-frequency synthesis case each Taylor term has its own
+        /// gridder which goes through the same data and differs only by visibility weights.
+        /// If this option is on, all terms of the same image are gridded (and degridded) in
+        /// a single pass sharing indices and convolution functions (see
+        /// TableVisGridder::gridMultiTerm). Gridders which are not derived from TableVisGridder
+        /// are always processed separately.
+        /// @param[in] flag true to process Taylor terms in one pass
+        void fuseTaylorTerms(bool flag) { itsFuseTaylorTerms = flag; }
+
+        /// @brief set the number of threads used to run gridders of different images
+        /// @details Gridders of different image parameters (facets, Taylor terms, polarisation
+        /// images), as well as PSF and preconditioner gridders, are independent clones. If more
+        /// than one thread is allowed, each chunk of data is read once and gridded (or degridded)
+        /// by these gridders concurrently. Degridded visibilities are accumulated in a buffer
+        /// per thread. Only gridders derived from TableVisGridder which declare themselves safe
+        /// to run concurrently are processed in parallel, otherwise the data are processed in
+        /// a serial fashion as before.
+        /// @param[in] nThreads maximum number of threads, 1 means serial processing
+        void gridderThreads(int nThreads);
+
         /// @brief setup object function to update degridded visibilities
         /// @details For the parallel implementation of the measurement equation we need
         /// inter-rank communication. To avoid introducing cross-dependency of the measurement
@@ -214,6 +253,44 @@ namespace askap
 
         void init();
 
+        /// @brief type of the map from the 0th order term to the gridders of other terms
+        typedef std::map<std::string, std::vector<boost::shared_ptr<TableVisGridder> > > TaylorTermGroups;
+
+        /// @brief find Taylor terms which can be processed in one pass
+        /// @details For each image with at least two Taylor terms handled by gridders of the
+        /// same type derived from TableVisGridder, the 0th order term is mapped to the gridders of
+        /// other terms.
+        /// @param[in] names image parameters to consider
+        /// @param[in] gridders gridders used for these parameters
+        /// @param[out] groups map of the 0th order term to the gridders of other terms
+        /// @param[out] others names of the parameters processed together with the 0th order term
+        static void groupTaylorTerms(const std::vector<std::string> &names,
+                                     const std::map<std::string, IVisGridder::ShPtr> &gridders,
+                                     TaylorTermGroups &groups, std::set<std::string> &others);
+
+        /// @brief gridder which goes through each chunk of data
+        struct GridderTask {
+           /// @brief gridder (the 0th order term if other terms are processed in the same pass)
+           IVisGridder::ShPtr gridder;
+           /// @brief gridders of other Taylor terms processed in the same pass or zero pointer
+           const std::vector<boost::shared_ptr<TableVisGridder> > *terms;
+        };
+
+        /// @brief number of threads to run the given gridders
+        /// @param[in] tasks gridders to run for each chunk of data
+        /// @return number of threads, 1 if gridders have to be run in a serial fashion
+        int numberOfThreads(const std::vector<GridderTask> &tasks) const;
+
+        /// @brief grid or degrid a chunk of data with a number of gridders
+        /// @details Degridded visibilities are added to the accessor (or subtracted, if degridders
+        /// are set up to subtract the model).
+        /// @param[in] tasks gridders to run
+        /// @param[in] acc accessor to work with
+        /// @param[in] forward true for degridding, false for gridding
+        /// @param[in] nThreads number of threads to use
+        static void runGridders(const std::vector<GridderTask> &tasks, accessors::IDataAccessor &acc,
+                                bool forward, int nThreads);
+
         /// @brief true, if the PSF is built using the default spheroidal function gridder
         /// @details We have an option to build PSF using the default spheriodal function
         /// gridder, i.e. no w-term and no primary beam is simulated. Apart from speed,
@@ -231,6 +308,24 @@ namespace askap
 
         bool itsUsePreconGridder;
 
+        /// @brief true, if the PSF and preconditioner function are gridded once and cached
+        bool itsCachePSF;
+
+        /// @brief true, if Taylor terms are gridded and degridded in one pass
+        bool itsFuseTaylorTerms;
+
+        /// @brief maximum number of threads used to run gridders of different images
+        int itsGridderThreads;
+
+        /// @brief finalised PSFs kept between calls of calcImagingEquations (per image parameter)
+        mutable std::map<std::string, casacore::Array<imtype> > itsPSFCache;
+
+        /// @brief finalised preconditioner functions kept between calls of calcImagingEquations
+        mutable std::map<std::string, casacore::Array<imtype> > itsPCFCache;
+
+        /// @brief storage for residual visibilities reused for every chunk of data
+        mutable casacore::Cube<casacore::Complex> itsResidualBuffer;
+
         /// @brief if set, visibility cube will be passed through this object function
         /// @details For the parallel implementation of the measurement equation we need
         /// inter-rank communication. To avoid introducing cross-dependency of the measurement
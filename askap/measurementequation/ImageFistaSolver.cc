@@ -33,6 +33,7 @@ ASKAP_LOGGER(logger, ".measurementequation.imagefistasolver");
 #include <askap/askap/AskapUtil.h>
 
 #include <askap/scimath/utils/MultiDimArrayPlaneIter.h>
+#include <askap/utils/MetricsRegistry.h>
 
 #include <casacore/casa/aips.h>
 #include <casacore/casa/Arrays/Array.h>
@@ -238,7 +239,11 @@ namespace askap
 	    // FISTA is not incremental so we need to set the
 	    // background image which remains fixed during one
 	    // deconvolve step
-	    fistaDec->deconvolve();
+	    {
+	      utils::MetricsTimer metricsTimer("deconvolver.time");
+	      fistaDec->deconvolve();
+	    }
+	    utils::MetricsRegistry::instance().add("deconvolver.iterations", fistaDec->state()->currentIter());
 	    ASKAPLOG_INFO_STR(logger, "Peak flux of the FISTA image "
 			      << max(fistaDec->model()));
 	    ASKAPLOG_INFO_STR(logger, "Peak residual of FISTA image "
@@ -35,6 +35,7 @@ ASKAP_LOGGER(logger, ".measurementequation.imagemultiscalesolver");
 #include <askap/askap/AskapUtil.h>
 
 #include <askap/scimath/utils/MultiDimArrayPlaneIter.h>
+#include <askap/utils/MetricsRegistry.h>
 #include <askap/profile/AskapProfiler.h>
 
 #include <casacore/casa/aips.h>
@@ -237,7 +238,11 @@ namespace askap
 	      } // if algorithm == Hogbom, else case (other algorithm)
 	      lc->ignoreCenterBox(true);
 	    } // if cleaner found in the cache, else case - new cleaner needed
-	    lc->clean(clean);
+	    {
+	      utils::MetricsTimer metricsTimer("deconvolver.time");
+	      lc->clean(clean);
+	    }
+	    utils::MetricsRegistry::instance().add("deconvolver.iterations", lc->numberIterations());
 	    ASKAPLOG_INFO_STR(logger, "Peak flux of the clean image "<<max(cleanArray));
 
 	    const std::string peakResParam = std::string("peak_residual.") + cleanerKey;
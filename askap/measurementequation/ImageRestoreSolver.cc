@@ -70,7 +70,8 @@ namespace askap
   namespace synthesis
   {
     ImageRestoreSolver::ImageRestoreSolver(const RestoringBeamHelper &beamHelper) :
-	    itsBeamHelper(beamHelper), itsEqualiseNoise(false), itsModelNeedsConvolving(true), itsResidualNeedsUpdating(true)
+	    itsBeamHelper(beamHelper), itsEqualiseNoise(false), itsModelNeedsConvolving(true), itsResidualNeedsUpdating(true),
+        itsSaveRawPsf(false), itsFFTConvolution(true)
     {
         setIsRestoreSolver();
     }
@@ -521,14 +522,21 @@ namespace askap
                         restoringBeam = itsBeamHelper.value();
                     }
                     ASKAPLOG_INFO_STR(logger, "Convolving the model image to the resolution of the synthesised beam");
-	                // Create a temporary image
-                    boost::shared_ptr<casa::TempImage<float> >
-                        image(SynthesisParamsHelper::tempImage(ip, imagename));
-                    askap::synthesis::Image2DConvolver<float> convolver;
-                    const casa::IPosition pixelAxes(2, 0, 1);
-                    convolver.convolve(*image, *image, casa::VectorKernel::GAUSSIAN,
-                                       pixelAxes, restoringBeam, true, 1.0, false);
-                    SynthesisParamsHelper::update(ip, imagename, *image);
+                    if (itsFFTConvolution) {
+                        // the transfer function is cached and reused for all planes and Taylor terms
+                        casa::Array<imtype> model = ip.valueT(imagename).copy();
+                        itsConvolver.convolve(model, ip.axes(imagename).directionAxis().increment(), restoringBeam);
+                        ip.update(imagename, model);
+                    } else {
+	                    // Create a temporary image
+                        boost::shared_ptr<casa::TempImage<float> >
+                            image(SynthesisParamsHelper::tempImage(ip, imagename));
+                        askap::synthesis::Image2DConvolver<float> convolver;
+                        const casa::IPosition pixelAxes(2, 0, 1);
+                        convolver.convolve(*image, *image, casa::VectorKernel::GAUSSIAN,
+                                           pixelAxes, restoringBeam, true, 1.0, false);
+                        SynthesisParamsHelper::update(ip, imagename, *image);
+                    }
                     // for some reason update makes the parameter free as well
                     ip.fix(imagename);
                 }
@@ -624,6 +632,8 @@ namespace askap
        result->updateResiduals(update);
        const bool saverawpsf = parset.getBool("saverawpsf",false);
        result->saveRawPsf(saverawpsf);
+       const bool fftconvolution = parset.getBool("fftconvolution",true);
+       result->fftConvolution(fftconvolution);
 
        return result;
     }
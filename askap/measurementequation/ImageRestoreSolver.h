@@ -37,6 +37,7 @@
 #include <casacore/lattices/Lattices/ArrayLattice.h>
 #include <Common/ParameterSet.h>
 #include <askap/measurementequation/RestoringBeamHelper.h>
+#include <askap/measurementequation/RestoringBeamConvolver.h>
 
 
 namespace askap
@@ -107,6 +108,11 @@ namespace askap
         /// @param[in] flag true, to save the raw psf
         inline void saveRawPsf(bool flag) { itsSaveRawPsf = flag;}
 
+        /// @brief set the engine used to convolve the model with the restoring beam
+        /// @param[in] flag true, to convolve in the Fourier domain with a cached transfer
+        /// function (RestoringBeamConvolver), false to use Image2DConvolver
+        inline void fftConvolution(bool flag) { itsFFTConvolution = flag;}
+
         /// @brief solves for and adds residuals
         /// @details Restore solver convolves the current model with the beam and adds the
         /// residual image. The latter has to be "solved for" with a proper preconditioning and
@@ -151,6 +157,12 @@ namespace askap
 
         bool itsSaveRawPsf;
 
+        /// @brief true if the model is convolved in the Fourier domain
+        bool itsFFTConvolution;
+
+        /// @brief Fourier-domain convolver, keeps FFT plans and transfer functions between calls
+        RestoringBeamConvolver itsConvolver;
+
     };
 
   }
@@ -24,6 +24,7 @@
 #include <askap/measurementequation/ImageSolver.h>
 #include <askap/scimath/utils/PaddingUtils.h>
 #include <askap/profile/AskapProfiler.h>
+#include <askap/utils/MetricsRegistry.h>
 
 #include <askap/askap_synthesis.h>
 #include <askap/askap/AskapLogging.h>
@@ -196,6 +197,7 @@ namespace askap
     {
         ASKAPTRACE("ImageSolver::doPreconditioning");
 
+        utils::MetricsTimer metricsTimer("solver.preconditioning.time");
         //casacore::Array<float> oldPSF(psf.copy());
 	    bool status=false;
 	    for(std::map<int, IImagePreconditioner::ShPtr>::const_iterator pciter=itsPreconditioners.begin(); pciter!=itsPreconditioners.end(); pciter++)
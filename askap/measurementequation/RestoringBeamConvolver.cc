@@ -0,0 +1,235 @@
+/// @file
+///
+/// @brief Convolution of model images with the restoring beam in the Fourier domain
+/// @details The restore solver convolves each plane of the model with an elliptical
+/// Gaussian. Rather than building an image-plane kernel and convolving every plane
+/// separately (as Image2DConvolver does), this class multiplies the Fourier transform
+/// of the zero-padded plane by the analytic transfer function of the Gaussian. The
+/// transfer function depends only on the padded shape, the cell size and the beam, so
+/// it is cached and reused for all Taylor terms and channels sharing the same beam.
+/// The FFT server (and its plans) is kept between calls as well.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/askap_synthesis.h>
+#include <askap/askap/AskapLogging.h>
+ASKAP_LOGGER(logger, ".measurementequation.restoringbeamconvolver");
+
+#include <askap/measurementequation/RestoringBeamConvolver.h>
+#include <askap/askap/AskapError.h>
+#include <askap/profile/AskapProfiler.h>
+
+#include <casacore/casa/BasicSL/Constants.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace askap;
+using namespace askap::synthesis;
+
+namespace {
+
+/// @brief padding in units of the beam major axis required to make wrap-around negligible
+/// @details The gaussian with unit peak drops to 3e-8 at this distance
+const double beamPadding = 2.5;
+
+} // anonymous namespace
+
+/// @brief construct the convolver
+/// @param[in] cacheSize maximum number of cached transfer functions
+RestoringBeamConvolver::RestoringBeamConvolver(const size_t cacheSize) :
+    itsCacheSize(cacheSize), itsCacheHits(0), itsCacheMisses(0), itsSkippedPlanes(0) {}
+
+/// @brief padded size with small prime factors
+/// @param[in] size minimum size
+/// @return smallest even number not less than size, which has no prime factors other than 2, 3 and 5
+int RestoringBeamConvolver::goodSize(const int size)
+{
+   ASKAPDEBUGASSERT(size > 0);
+   for (int result = size + size % 2; ; result += 2) {
+        int remainder = result;
+        for (int factor = 2; factor <= 5; ++factor) {
+             while (remainder % factor == 0) {
+                 remainder /= factor;
+             }
+        }
+        if (remainder == 1) {
+            return result;
+        }
+   }
+}
+
+/// @brief get the transfer function from the cache or compute it
+boost::shared_ptr<RestoringBeamConvolver::TransferFunction>
+RestoringBeamConvolver::transferFunction(const std::vector<double> &key) const
+{
+   for (std::list<boost::shared_ptr<TransferFunction> >::iterator it = itsCache.begin(); it != itsCache.end(); ++it) {
+        if ((*it)->key == key) {
+            // move to the front
+            boost::shared_ptr<TransferFunction> tf = *it;
+            itsCache.erase(it);
+            itsCache.push_front(tf);
+            ++itsCacheHits;
+            return tf;
+        }
+   }
+   ++itsCacheMisses;
+   boost::shared_ptr<TransferFunction> tf(new TransferFunction);
+   tf->key = key;
+   computeTransferFunction(*tf);
+   if (itsCacheSize > 0) {
+       while (itsCache.size() >= itsCacheSize) {
+            itsCache.pop_back();
+       }
+       itsCache.push_front(tf);
+   }
+   return tf;
+}
+
+/// @brief compute the transfer function
+/// @details The gaussian with unit peak, g(r) = exp(-4 ln2 ((r.a/bmaj)^2 + (r.b/bmin)^2)), where a and b are
+/// unit vectors along the major and minor axes, has the Fourier transform
+/// pi bmaj bmin / (4 ln2) exp(-pi^2 / (4 ln2) ((k.a bmaj)^2 + (k.b bmin)^2)). Dividing by the pixel area gives
+/// the discrete transform of the sampled kernel (aliasing is negligible for beams of a few pixels). Offsets are
+/// measured in the direction coordinate (i.e. increments include the sign), so the major axis is along
+/// (sin pa, cos pa) for the position angle measured from north through east. The function is real and even,
+/// so the sign convention of the FFT doesn't matter.
+void RestoringBeamConvolver::computeTransferFunction(TransferFunction &tf)
+{
+   ASKAPDEBUGTRACE("RestoringBeamConvolver::computeTransferFunction");
+   ASKAPDEBUGASSERT(tf.key.size() == 7);
+   const int nx = static_cast<int>(tf.key[0]);
+   const int ny = static_cast<int>(tf.key[1]);
+   const double dx = tf.key[2];
+   const double dy = tf.key[3];
+   const double bmaj = tf.key[4];
+   const double bmin = tf.key[5];
+   const double pa = tf.key[6];
+   const double sinPA = sin(pa);
+   const double cosPA = cos(pa);
+   const double norm = casacore::C::pi * bmaj * bmin / (4. * log(2.) * std::abs(dx * dy));
+   const double scale = casacore::C::pi * casacore::C::pi / (4. * log(2.));
+
+   const int nu = nx / 2 + 1;
+   tf.values.resize(nu, ny);
+   for (int q = 0; q < ny; ++q) {
+        const double v = double(q <= ny / 2 ? q : q - ny) / (ny * dy);
+        for (int p = 0; p < nu; ++p) {
+             const double u = double(p) / (nx * dx);
+             const double alongMajor = (u * sinPA + v * cosPA) * bmaj;
+             const double alongMinor = (u * cosPA - v * sinPA) * bmin;
+             tf.values(p, q) = static_cast<float>(norm *
+                      exp(-scale * (alongMajor * alongMajor + alongMinor * alongMinor)));
+        }
+   }
+}
+
+/// @brief convolve all planes of an image in situ
+/// @details The first two axes of the array are assumed to be the direction axes,
+/// all other axes are iterated over.
+/// @param[in,out] image image to convolve
+/// @param[in] increments cell sizes along the first two axes in radians (as given by
+/// the direction coordinate, the sign is taken into account for the position angle)
+/// @param[in] beam major axis, minor axis and position angle of the restoring beam
+void RestoringBeamConvolver::convolve(casacore::Array<imtype> &image, const casacore::Vector<double> &increments,
+                                      const casacore::Vector<casacore::Quantum<double> > &beam) const
+{
+   ASKAPTRACE("RestoringBeamConvolver::convolve");
+   ASKAPCHECK(image.ndim() >= 2, "Expect at least two axes in the image to convolve, you have "<<image.shape());
+   ASKAPCHECK(increments.nelements() == 2, "Expect two cell sizes, you have "<<increments);
+   ASKAPCHECK(increments[0] != 0. && increments[1] != 0., "Cell sizes should be non-zero, you have "<<increments);
+   ASKAPCHECK(beam.nelements() == 3, "Expect three beam parameters, you have "<<beam);
+   const double bmaj = beam[0].getValue("rad");
+   const double bmin = beam[1].getValue("rad");
+   const double pa = beam[2].getValue("rad");
+   ASKAPCHECK(bmaj > 0. && bmin > 0., "Restoring beam should have a positive size, you have "<<beam);
+
+   const int nx = image.shape()[0];
+   const int ny = image.shape()[1];
+   const size_t planeSize = size_t(nx) * ny;
+   if (planeSize == 0) {
+       return;
+   }
+   const size_t nPlanes = image.nelements() / planeSize;
+
+   // zero padding sufficient for a linear convolution, there is no point to pad by more than the image size
+   const int marginX = std::min(nx, static_cast<int>(std::ceil(beamPadding * bmaj / std::abs(increments[0]))));
+   const int marginY = std::min(ny, static_cast<int>(std::ceil(beamPadding * bmaj / std::abs(increments[1]))));
+   const int paddedX = goodSize(nx + marginX);
+   const int paddedY = goodSize(ny + marginY);
+
+   std::vector<double> key(7);
+   key[0] = paddedX;
+   key[1] = paddedY;
+   key[2] = increments[0];
+   key[3] = increments[1];
+   key[4] = bmaj;
+   key[5] = bmin;
+   key[6] = pa;
+
+   bool deleteIt;
+   imtype *data = image.getStorage(deleteIt);
+   casacore::Matrix<casacore::Float> padded;
+   casacore::Matrix<casacore::Complex> transform;
+   boost::shared_ptr<TransferFunction> tf;
+   for (size_t plane = 0; plane < nPlanes; ++plane) {
+        imtype *planeData = data + plane * planeSize;
+        if (std::find_if(planeData, planeData + planeSize, [](imtype val) { return val != 0; }) ==
+            planeData + planeSize) {
+            // convolution of an empty plane is also empty
+            ++itsSkippedPlanes;
+            continue;
+        }
+        if (!tf) {
+            tf = transferFunction(key);
+            padded.resize(paddedX, paddedY);
+        } else {
+            ++itsCacheHits;
+        }
+        ASKAPDEBUGASSERT(tf);
+        padded.set(0.f);
+        for (int y = 0; y < ny; ++y) {
+             const imtype *row = planeData + size_t(y) * nx;
+             for (int x = 0; x < nx; ++x) {
+                  padded(x, y) = static_cast<float>(row[x]);
+             }
+        }
+        itsFFTServer.fft0(transform, padded, true);
+        ASKAPDEBUGASSERT(transform.shape().isEqual(tf->values.shape()));
+        const casacore::Matrix<float> &values = tf->values;
+        for (casacore::uInt q = 0; q < transform.ncolumn(); ++q) {
+             for (casacore::uInt p = 0; p < transform.nrow(); ++p) {
+                  transform(p, q) *= values(p, q);
+             }
+        }
+        itsFFTServer.fft0(padded, transform, false);
+        for (int y = 0; y < ny; ++y) {
+             imtype *row = planeData + size_t(y) * nx;
+             for (int x = 0; x < nx; ++x) {
+                  row[x] = static_cast<imtype>(padded(x, y));
+             }
+        }
+   }
+   image.putStorage(data, deleteIt);
+}
@@ -0,0 +1,125 @@
+/// @file
+///
+/// @brief Convolution of model images with the restoring beam in the Fourier domain
+/// @details The restore solver convolves each plane of the model with an elliptical
+/// Gaussian. Rather than building an image-plane kernel and convolving every plane
+/// separately (as Image2DConvolver does), this class multiplies the Fourier transform
+/// of the zero-padded plane by the analytic transfer function of the Gaussian. The
+/// transfer function depends only on the padded shape, the cell size and the beam, so
+/// it is cached and reused for all Taylor terms and channels sharing the same beam.
+/// The FFT server (and its plans) is kept between calls as well.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#ifndef ASKAP_SYNTHESIS_RESTORING_BEAM_CONVOLVER_H
+#define ASKAP_SYNTHESIS_RESTORING_BEAM_CONVOLVER_H
+
+#include <askap/askap_synthesis.h>
+#include <boost/shared_ptr.hpp>
+#include <casacore/casa/Arrays/Array.h>
+#include <casacore/casa/Arrays/Matrix.h>
+#include <casacore/casa/Arrays/Vector.h>
+#include <casacore/casa/Quanta/Quantum.h>
+#include <casacore/scimath/Mathematics/FFTServer.h>
+
+#include <list>
+#include <vector>
+
+namespace askap {
+
+namespace synthesis {
+
+/// @brief Fourier-domain convolution of image planes with the restoring beam
+/// @details The result is the same as that of Image2DConvolver with a Gaussian kernel
+/// of unit peak (i.e. a Jy/pixel model becomes Jy/beam). Planes are zero-padded by about
+/// 2.5 beam widths to avoid wrap-around, so the convolution is linear. Planes which are
+/// identically zero are left untouched without doing any FFT, hence restoring an empty
+/// model (residual-only restore) costs nothing. A small number of transfer functions
+/// is cached, the least recently used is dropped first.
+/// @ingroup measurementequation
+class RestoringBeamConvolver {
+public:
+   /// @brief construct the convolver
+   /// @param[in] cacheSize maximum number of cached transfer functions
+   explicit RestoringBeamConvolver(const size_t cacheSize = 8);
+
+   /// @brief convolve all planes of an image in situ
+   /// @details The first two axes of the array are assumed to be the direction axes,
+   /// all other axes are iterated over.
+   /// @param[in,out] image image to convolve
+   /// @param[in] increments cell sizes along the first two axes in radians (as given by
+   /// the direction coordinate, the sign is taken into account for the position angle)
+   /// @param[in] beam major axis, minor axis and position angle of the restoring beam
+   void convolve(casacore::Array<imtype> &image, const casacore::Vector<double> &increments,
+                 const casacore::Vector<casacore::Quantum<double> > &beam) const;
+
+   /// @return number of planes which reused a cached transfer function
+   unsigned long cacheHits() const { return itsCacheHits; }
+
+   /// @return number of planes which required a new transfer function
+   unsigned long cacheMisses() const { return itsCacheMisses; }
+
+   /// @return number of planes skipped because they were empty
+   unsigned long skippedPlanes() const { return itsSkippedPlanes; }
+
+   /// @brief padded size with small prime factors
+   /// @param[in] size minimum size
+   /// @return smallest even number not less than size, which has no prime factors other than 2, 3 and 5
+   static int goodSize(const int size);
+
+private:
+   /// @brief transfer function for the given padded shape, cell size and beam
+   struct TransferFunction {
+      /// @brief padded shape, cell sizes and beam parameters identifying this function
+      std::vector<double> key;
+      /// @brief values for the half plane produced by the real to complex transform
+      casacore::Matrix<float> values;
+   };
+
+   /// @brief get the transfer function from the cache or compute it
+   boost::shared_ptr<TransferFunction> transferFunction(const std::vector<double> &key) const;
+
+   /// @brief compute the transfer function
+   static void computeTransferFunction(TransferFunction &tf);
+
+   /// @brief maximum number of cached transfer functions
+   size_t itsCacheSize;
+
+   /// @brief cached transfer functions, most recently used first
+   mutable std::list<boost::shared_ptr<TransferFunction> > itsCache;
+
+   /// @brief FFT server, kept to reuse plans between planes and calls
+   mutable casacore::FFTServer<casacore::Float, casacore::Complex> itsFFTServer;
+
+   /// @brief stats
+   mutable unsigned long itsCacheHits;
+   mutable unsigned long itsCacheMisses;
+   mutable unsigned long itsSkippedPlanes;
+};
+
+} // namespace synthesis
+
+} // namespace askap
+
+#endif // #ifndef ASKAP_SYNTHESIS_RESTORING_BEAM_CONVOLVER_H
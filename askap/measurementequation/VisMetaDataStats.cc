@@ -38,10 +38,12 @@
 
 #include <askap/askap_synthesis.h>
 #include <askap/askap/AskapLogging.h>
-#include <casacore/casa/Arrays/ArrayLogical.h>
 
 ASKAP_LOGGER(logger, ".measurementequation.vismetadatastats");
 #include <iomanip>
+#include <algorithm>
+#include <limits>
+#include <vector>
 
 namespace askap {
 
@@ -271,117 +273,120 @@ std::pair<double,double> VisMetaDataStats::getOffsets(const casacore::MVDirectio
 /// @param[in] acc read-only accessor with data
 void VisMetaDataStats::process(const accessors::IConstDataAccessor &acc)
 {
-  if (acc.nRow() == 0) {
+  const casacore::uInt nRow = acc.nRow();
+  if (nRow == 0) {
       return; // no data - nothing to do
   }
-  // for now ignore flagging. Technically, some metadata may be ignored if all corresponding data are flagged, but
-  // it seems to be too much of the complication now.
-
-  // well the time to use the flags may have come...
-  // Note that this is a lot slower, but nearly all the extra time is spent in the acc.flag() call, not here
-  const casacore::Cube<casacore::Bool> flag(itsUseFlagged ? casacore::Cube<casacore::Bool>(0,0,0) : acc.flag());
-  casacore::Vector<casacore::Bool> rowFlag(acc.nRow(),casacore::False);
-
-  // fill row flags - accessor doesn't provide MS row flag, so create them
-  int unflaggedRows = 0;
-  if (!itsUseFlagged) {
-        for (casacore::uInt row = 0; row < acc.nRow(); row++) {
-            if (casacore::allEQ(flag(row,casacore::Slice(),casacore::Slice()),casacore::True)) {
-                rowFlag(row) = casacore::True;
-            } else {
-                unflaggedRows++;
-            }
-        }
-        if (casacore::allEQ(rowFlag,casacore::True)) {
-            // no unflagged data
-            return;
-        }
-  }
-
-  // fill channel flags
-  casacore::uInt nChan = acc.nChannel();
-  casacore::Vector<casacore::Bool> chanFlag(nChan, casacore::False);
-  int unflaggedChannels = 0;
+  const casacore::uInt nChan = acc.nChannel();
+
+  // row and channel flag summaries: a row (or channel) is flagged if all corresponding samples are flagged.
+  // The accessor doesn't provide MS row flag, so create them with a single pass over the flag cube in its
+  // native storage order (row index varies fastest) rather than with a slice per row and per channel.
+  // Channels are distributed between threads, each thread accumulates its own row mask.
+  std::vector<unsigned char> rowHasData(nRow, itsUseFlagged ? 1 : 0);
+  std::vector<unsigned char> chanHasData(nChan, itsUseFlagged ? 1 : 0);
   if (!itsUseFlagged) {
-      for (casacore::uInt chan = 0; chan < nChan; chan++) {
-          if (casacore::allEQ(flag(casacore::Slice(),chan,casacore::Slice()),casacore::True)) {
-              chanFlag(chan) = casacore::True;
-          } else {
-              unflaggedChannels++;
+      const casacore::Cube<casacore::Bool> &flag = acc.flag();
+      ASKAPDEBUGASSERT(flag.nrow() == nRow);
+      ASKAPDEBUGASSERT(flag.ncolumn() == nChan);
+      const casacore::uInt nPol = flag.nplane();
+      bool deleteIt;
+      const casacore::Bool *flagData = flag.getStorage(deleteIt);
+      #pragma omp parallel default(shared)
+      {
+          std::vector<unsigned char> rowMask(nRow, 0);
+          #pragma omp for schedule(static)
+          for (int chan = 0; chan < static_cast<int>(nChan); ++chan) {
+               unsigned char chanMask = 0;
+               for (casacore::uInt pol = 0; pol < nPol; ++pol) {
+                    const casacore::Bool *rowFlags = flagData + size_t(nRow) * (chan + size_t(nChan) * pol);
+                    for (casacore::uInt row = 0; row < nRow; ++row) {
+                         const unsigned char unflagged = rowFlags[row] ? 0 : 1;
+                         rowMask[row] |= unflagged;
+                         chanMask |= unflagged;
+                    }
+               }
+               chanHasData[chan] = chanMask;
+          }
+          #pragma omp critical
+          {
+              for (casacore::uInt row = 0; row < nRow; ++row) {
+                   rowHasData[row] |= rowMask[row];
+              }
           }
       }
+      flag.freeStorage(flagData, deleteIt);
+  }
+  const unsigned long unflaggedRows = std::count(rowHasData.begin(), rowHasData.end(), 1);
+  if (unflaggedRows == 0) {
+      // no unflagged data
+      return;
   }
+  const unsigned long unflaggedChannels = std::count(chanHasData.begin(), chanHasData.end(), 1);
 
   if (!itsRefDirValid) {
       // estimate reference direction as the first encountered dish pointing
-      int i = 0;
-      if (!itsUseFlagged) {
-          for (casacore::uInt row = 0; row < acc.nRow(); row++) {
-              if (!rowFlag(row)) {
-                  i = row;
-                  break;
-              }
-          }
-      }
+      const casacore::uInt i = std::find(rowHasData.begin(), rowHasData.end(), 1) - rowHasData.begin();
       itsReferenceDir = acc.dishPointing1()[i];
       itsRefDirValid = true;
   }
 
+  // field extent, offsets are independent for each row
   const casacore::Vector<casacore::MVDirection> &pointingDir = acc.pointingDir1();
-  //ASKAPLOG_DEBUG_STR(logger, "referenceDir = "<<printDirection(itsReferenceDir));
-  bool first = true;
-  for (casacore::uInt row=0; row < acc.nRow(); ++row) {
-      if (!itsUseFlagged && rowFlag(row)) {
-          continue;
-      }
-       const std::pair<double,double> offsets = getOffsets(pointingDir[row]);
-       if ( (itsNVis == 0ul) && first ) {
-            itsFieldBLC = itsFieldTRC = offsets;
-            first = false;
-       } else {
-            if (itsFieldBLC.first > offsets.first) {
-                itsFieldBLC.first = offsets.first;
-            }
-            if (itsFieldTRC.first < offsets.first) {
-                itsFieldTRC.first = offsets.first;
-            }
-            if (itsFieldBLC.second > offsets.second) {
-                itsFieldBLC.second = offsets.second;
-            }
-            if (itsFieldTRC.second < offsets.second) {
-                itsFieldTRC.second = offsets.second;
-            }
+  double minOffset1 = std::numeric_limits<double>::max();
+  double minOffset2 = std::numeric_limits<double>::max();
+  double maxOffset1 = -std::numeric_limits<double>::max();
+  double maxOffset2 = -std::numeric_limits<double>::max();
+  #pragma omp parallel for schedule(static) reduction(min:minOffset1,minOffset2) reduction(max:maxOffset1,maxOffset2)
+  for (int row = 0; row < static_cast<int>(nRow); ++row) {
+       if (rowHasData[row]) {
+           const std::pair<double,double> offsets = getOffsets(pointingDir[row]);
+           minOffset1 = std::min(minOffset1, offsets.first);
+           maxOffset1 = std::max(maxOffset1, offsets.first);
+           minOffset2 = std::min(minOffset2, offsets.second);
+           maxOffset2 = std::max(maxOffset2, offsets.second);
        }
   }
+  if (itsNVis == 0ul) {
+      itsFieldBLC = std::pair<double,double>(minOffset1, minOffset2);
+      itsFieldTRC = std::pair<double,double>(maxOffset1, maxOffset2);
+  } else {
+      itsFieldBLC.first = std::min(itsFieldBLC.first, minOffset1);
+      itsFieldBLC.second = std::min(itsFieldBLC.second, minOffset2);
+      itsFieldTRC.first = std::max(itsFieldTRC.first, maxOffset1);
+      itsFieldTRC.second = std::max(itsFieldTRC.second, maxOffset2);
+  }
   //ASKAPLOG_DEBUG_STR(logger, "after iteration over "<<acc.nRow()<<" rows blc: "<<std::setprecision(15)<<itsFieldBLC.first<<" "<<itsFieldBLC.second<<" trc: "<<itsFieldTRC.first<<" "<<itsFieldTRC.second);
+
+  // reciprocal wavelengths of unflagged channels
+  const casacore::Vector<casacore::Double> &freq = acc.frequency();
+  std::vector<double> reciprocalWavelengths;
+  reciprocalWavelengths.reserve(unflaggedChannels);
   double currentMaxFreq = 0;
   double currentMinFreq = -1;
   for (casacore::uInt chan = 0; chan < nChan; chan++) {
-      if (!itsUseFlagged && chanFlag(chan)) {
+      if (!chanHasData[chan]) {
           continue;
       }
-      const double freq = acc.frequency()(chan);
-      if (freq > currentMaxFreq) {
-          currentMaxFreq = freq;
+      if (freq(chan) > currentMaxFreq) {
+          currentMaxFreq = freq(chan);
       }
-      if (currentMinFreq < 0 || freq < currentMinFreq ) {
-          currentMinFreq = freq;
+      if (currentMinFreq < 0 || freq(chan) < currentMinFreq ) {
+          currentMinFreq = freq(chan);
       }
+      reciprocalWavelengths.push_back(freq(chan) / casacore::C::c);
   }
 
+  const casacore::Vector<casacore::uInt> &antenna1 = acc.antenna1();
+  const casacore::Vector<casacore::uInt> &antenna2 = acc.antenna2();
+  const casacore::Vector<casacore::uInt> &feed1 = acc.feed1();
+  const casacore::Vector<casacore::uInt> &feed2 = acc.feed2();
   casacore::uInt currentMaxAntennaIndex = 0;
   casacore::uInt currentMaxBeamIndex = 0;
-  for (casacore::uInt row = 0; row < acc.nRow(); row++) {
-      if (!itsUseFlagged && rowFlag(row)) {
-          continue;
-      }
-      const casacore::uInt ant = casacore::max(acc.antenna1()(row),acc.antenna2()(row));
-      if (ant > currentMaxAntennaIndex) {
-          currentMaxAntennaIndex = ant;
-      }
-      const casacore::uInt beam = casacore::max(acc.feed1()(row),acc.feed2()(row));
-      if (beam > currentMaxBeamIndex) {
-          currentMaxBeamIndex = beam;
+  for (casacore::uInt row = 0; row < nRow; row++) {
+      if (rowHasData[row]) {
+          currentMaxAntennaIndex = std::max(currentMaxAntennaIndex, std::max(antenna1[row], antenna2[row]));
+          currentMaxBeamIndex = std::max(currentMaxBeamIndex, std::max(feed1[row], feed2[row]));
       }
   }
 
@@ -405,157 +410,63 @@ void VisMetaDataStats::process(const accessors::IConstDataAccessor &acc)
       }
   }
 
+  // all frequencies are positive, so the largest projected baseline of each row in wavelengths
+  // corresponds to the highest unflagged frequency and no loop over channels is required for maxima
   const double reciprocalToShortestWavelength = currentMaxFreq / casacore::C::c;
 
   if (itsAccessorAdapter.tolerance() >=0.) {
       ASKAPCHECK(itsTangentSet, "wtolerance has to be set together with the tangent point!")
   }
-  unsigned long nvis = 0;
+  // maxima are non-negative and members are initialised with zeros, so they can just be updated
+  const casacore::Vector<casacore::RigidVector<casacore::Double, 3> > &uvw =
+        itsTangentSet ? acc.rotatedUVW(itsTangent) : acc.uvw();
+  double maxU = itsMaxU;
+  double maxV = itsMaxV;
+  double maxW = itsMaxW;
+  #pragma omp parallel for schedule(static) reduction(max:maxU,maxV,maxW)
+  for (int row = 0; row < static_cast<int>(nRow); ++row) {
+       if (rowHasData[row]) {
+           maxU = std::max(maxU, casacore::abs(uvw[row](0)) * reciprocalToShortestWavelength);
+           maxV = std::max(maxV, casacore::abs(uvw[row](1)) * reciprocalToShortestWavelength);
+           maxW = std::max(maxW, casacore::abs(uvw[row](2)) * reciprocalToShortestWavelength);
+       }
+  }
+  itsMaxU = maxU;
+  itsMaxV = maxV;
+  itsMaxW = maxW;
+
   if (itsTangentSet) {
-      const casacore::Vector<casacore::RigidVector<casacore::Double, 3> > &origUVW = acc.rotatedUVW(itsTangent);
+      // W distribution needs all unflagged samples, the running percentile estimate depends on
+      // the order of the data, so this loop is kept serial
+      for (casacore::uInt row = 0; row < nRow; ++row) {
+           if (rowHasData[row]) {
+               const double absW = casacore::abs(uvw[row](2));
+               for (std::vector<double>::const_iterator ci = reciprocalWavelengths.begin();
+                    ci != reciprocalWavelengths.end(); ++ci) {
+                    itsWPercentileCalculator.add(absW * *ci);
+               }
+           }
+      }
 
       if (itsAccessorAdapter.tolerance() >= 0.) {
           itsAccessorAdapter.associate(acc);
-          ASKAPDEBUGASSERT(acc.nRow() == itsAccessorAdapter.nRow());
-      }
-
-      const casacore::Vector<casacore::Double> & freq = acc.frequency();
-      if (itsUseFlagged) {
-          for (casacore::uInt row=0; row < acc.nRow(); ++row) {
-              const double currentU = casacore::abs(origUVW[row](0)) * reciprocalToShortestWavelength;
-              const double currentV = casacore::abs(origUVW[row](1)) * reciprocalToShortestWavelength;
-              const double currentW = casacore::abs(origUVW[row](2)) * reciprocalToShortestWavelength;
-
-              if ((itsNVis == 0ul) && (row == 0)) {
-                  itsMaxU = currentU;
-                  itsMaxV = currentV;
-                  itsMaxW = currentW;
-              } else {
-                  if (itsMaxU < currentU) {
-                      itsMaxU = currentU;
-                  }
-                  if (itsMaxV < currentV) {
-                      itsMaxV = currentV;
-                  }
-                  if (itsMaxW < currentW) {
-                      itsMaxW = currentW;
-                  }
-              }
-              // Have to do this channel by channel to get distribution of W
-              for (casacore::uInt chan=0; chan<nChan; chan++) {
-                  const double reciprocalWavelength = freq(chan) / casacore::C::c;
-                  itsWPercentileCalculator.add(casacore::abs(origUVW[row](2)) * reciprocalWavelength);
-              }
-          }
-          if (itsAccessorAdapter.tolerance() >= 0.) {
-              const casacore::Vector<casacore::RigidVector<casacore::Double, 3> > &uvw = itsAccessorAdapter.rotatedUVW(itsTangent);
-              for (casacore::uInt row=0; row < itsAccessorAdapter.nRow(); ++row) {
-                   const double currentResidualW = casacore::abs(uvw[row](2)) * reciprocalToShortestWavelength;
-                   if ((itsNVis == 0ul) && (row == 0)) {
-                       itsMaxResidualW = currentResidualW;
-                   } else {
-                       if (itsMaxResidualW < currentResidualW) {
-                           itsMaxResidualW = currentResidualW;
-                       }
-                   }
-              }
-              itsAccessorAdapter.detach();
-          }
-      } else {
-          for (casacore::uInt row=0; row < acc.nRow(); ++row) {
-              if (rowFlag(row)) {
-                  continue;
-              }
-              for (casacore::uInt chan=0; chan<nChan; chan++) {
-                  if (chanFlag(chan)) {
-                      continue;
-                  }
-                  nvis++;
-                  const double reciprocalWavelength = freq(chan) / casacore::C::c;
-                  const double currentU = casacore::abs(origUVW[row](0)) * reciprocalWavelength;
-                  const double currentV = casacore::abs(origUVW[row](1)) * reciprocalWavelength;
-                  const double currentW = casacore::abs(origUVW[row](2)) * reciprocalWavelength;
-
-                  if ((itsNVis == 0ul) && first) {
-                      itsMaxU = currentU;
-                      itsMaxV = currentV;
-                      itsMaxW = currentW;
-                      first = false;
-                  } else {
-                      if (itsMaxU < currentU) {
-                          itsMaxU = currentU;
-                      }
-                      if (itsMaxV < currentV) {
-                          itsMaxV = currentV;
-                      }
-                      if (itsMaxW < currentW) {
-                          itsMaxW = currentW;
-                      }
-                  }
-                  itsWPercentileCalculator.add(currentW);
-              }
-          }
-          if (itsAccessorAdapter.tolerance() >= 0.) {
-              const casacore::Vector<casacore::RigidVector<casacore::Double, 3> > &uvw = itsAccessorAdapter.rotatedUVW(itsTangent);
-              bool first = true;
-              for (casacore::uInt row=0; row < itsAccessorAdapter.nRow(); ++row) {
-                  if (rowFlag(row)) {
-                      continue;
-                  }
-                  for (casacore::uInt chan=0; chan<nChan; chan++) {
-                      if (chanFlag(chan)) {
-                          continue;
-                      }
-                      const double reciprocalWavelength = freq(chan) / casacore::C::c;
-                      const double currentResidualW = casacore::abs(uvw[row](2)) * reciprocalWavelength;
-                       if ((itsNVis == 0ul) && first) {
-                           itsMaxResidualW = currentResidualW;
-                           first = false;
-                       } else {
-                           if (itsMaxResidualW < currentResidualW) {
-                               itsMaxResidualW = currentResidualW;
-                           }
-                       }
-                   }
-              }
-              itsAccessorAdapter.detach();
-          }
-      }
-  } else {
-      // this is the first pass, do the best effort job as exact tangent point is unknown
-      const casacore::Vector<casacore::RigidVector<casacore::Double, 3> > &uvw = acc.uvw();
-      bool first = true;
-      for (casacore::uInt row=0; row < acc.nRow(); ++row) {
-           if (!itsUseFlagged && rowFlag(row)) {
-               continue;
-           }
-           nvis += unflaggedChannels;
-           const double currentU = casacore::abs(uvw[row](0)) * reciprocalToShortestWavelength;
-           const double currentV = casacore::abs(uvw[row](1)) * reciprocalToShortestWavelength;
-           const double currentW = casacore::abs(uvw[row](2)) * reciprocalToShortestWavelength;
-           if ((itsNVis == 0ul) && first) {
-               itsMaxU = currentU;
-               itsMaxV = currentV;
-               itsMaxW = currentW;
-               first = false;
-           } else {
-               if (itsMaxU < currentU) {
-                   itsMaxU = currentU;
-               }
-               if (itsMaxV < currentV) {
-                   itsMaxV = currentV;
-               }
-               if (itsMaxW < currentW) {
-                   itsMaxW = currentW;
+          ASKAPDEBUGASSERT(nRow == itsAccessorAdapter.nRow());
+          const casacore::Vector<casacore::RigidVector<casacore::Double, 3> > &residualUVW =
+                itsAccessorAdapter.rotatedUVW(itsTangent);
+          for (casacore::uInt row = 0; row < nRow; ++row) {
+               if (rowHasData[row]) {
+                   itsMaxResidualW = std::max(itsMaxResidualW,
+                            casacore::abs(residualUVW[row](2)) * reciprocalToShortestWavelength);
                }
-           }
+          }
+          itsAccessorAdapter.detach();
       }
   }
 
   if (!itsUseFlagged) {
-      itsNVis += nvis;
+      itsNVis += unflaggedRows * unflaggedChannels;
   } else {
-      itsNVis += acc.nRow() * acc.nChannel();
+      itsNVis += static_cast<unsigned long>(nRow) * nChan;
   }
 }
 
@@ -119,6 +119,9 @@ public:
    /// @param[in] acc read-only accessor with data
    void process(const accessors::IConstDataAccessor &acc);
 
+   /// @return true if flagged data are taken into account in the stats
+   inline bool includesFlagged() const { return itsUseFlagged;}
+
    // access to the data
 
    /// @brief total number of visibility points processed
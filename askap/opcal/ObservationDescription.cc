@@ -268,6 +268,23 @@ void ObservationDescription::processBaselineFlags(casacore::uInt ant1, casacore:
    }
 }
 
+/// @brief check whether the flags of the given baseline can change anything
+/// @details Baseline flags only matter if at least one of the antennas hasn't been seen with
+/// valid data for some polarisation.
+/// @param[in] ant1 first antenna of the baseline
+/// @param[in] ant2 second antenna of the baseline
+/// @return true if both antennas have valid data for all polarisations
+bool ObservationDescription::hasValidData(casacore::uInt ant1, casacore::uInt ant2) const
+{
+   for (size_t pol = 0; pol < itsAntennasWithValidData.size(); ++pol) {
+        const std::set<casacore::uInt> &validAntennas = itsAntennasWithValidData[pol];
+        if ((validAntennas.find(ant1) == validAntennas.end()) || (validAntennas.find(ant2) == validAntennas.end())) {
+            return false;
+        }
+   }
+   return itsAntennasWithValidData.size() > 0;
+}
+
 // access to the valid antenna information - we can add other methods if necessary
   
 /// @brief obtain a set of flagged antennas
@@ -182,6 +182,14 @@ struct ObservationDescription {
   ///       the structure is populated
   void processBaselineFlags(casacore::uInt ant1, casacore::uInt ant2, const casacore::Vector<casacore::Bool> &flags);
 
+  /// @brief check whether the flags of the given baseline can change anything
+  /// @details Baseline flags only matter if at least one of the antennas hasn't been seen with
+  /// valid data for some polarisation.
+  /// @param[in] ant1 first antenna of the baseline
+  /// @param[in] ant2 second antenna of the baseline
+  /// @return true if both antennas have valid data for all polarisations
+  bool hasValidData(casacore::uInt ant1, casacore::uInt ant2) const;
+
   // access to the valid antenna information - we can add other methods if necessary
   
   /// @brief obtain a set of flagged antennas
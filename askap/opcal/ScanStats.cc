@@ -71,7 +71,10 @@ private:
 ScanStats::ScanStats(double timeLimit, int cycleLimit) : itsTimeLimit(timeLimit), itsCycleLimit(cycleLimit) {} 
 
 /// @brief inspect data referred by a given iterator
-/// @details
+/// @details Only metadata are used. Flags are only needed to find antennas with valid data, so the
+/// flag cube is only accessed for baselines with antennas which haven't been seen unflagged in the
+/// same scan yet. As the accessor reads the data on demand, for a typical observation the flags are
+/// read for the first integration of each scan only and visibilities are not read at all.
 /// @param[in] name string key identifying the data (e.g. file name)
 /// @param[in] iter iterator to work with (note, it is changed in process)
 void ScanStats::inspect(const std::string &name, const accessors::IConstDataSharedIter &iter)
@@ -84,7 +87,6 @@ void ScanStats::inspect(const std::string &name, const accessors::IConstDataShar
   }
   
   const double dirTolerance = 1e-7;
-  const double freqTolerance = 1.;
   casacore::uInt cycle = 0;
   for (accessors::IConstDataSharedIter it = iter; it!=it.end(); ++it,++cycle) {
        const casacore::Vector<casacore::uInt>& beam1 = it->feed1();
@@ -94,16 +96,20 @@ void ScanStats::inspect(const std::string &name, const accessors::IConstDataShar
        
        // buffer for observations of the current integration, one per beam
        std::map<casacore::uInt, ObservationDescription> currentObs;
+       // index of the scan in itsObs which will be extended by the observation of the current integration
+       // for the given beam, or itsObs.size() at the start of this integration if a new scan is started
+       std::map<casacore::uInt, size_t> scanToExtend;
+       const size_t nObs = itsObs.size();
        
        ASKAPDEBUGASSERT(it->nRow() == beam1.nelements());
        ASKAPDEBUGASSERT(it->nRow() == beam2.nelements());
        const casacore::uInt centreChan = it->nChannel() / 2;
        ASKAPDEBUGASSERT(it->frequency().nelements() > centreChan);
        const double freq = it->frequency()[centreChan];
-       const casacore::Matrix<casacore::Bool> flags = allChannelsFlagged(it->flag());
        const casacore::Vector<casacore::Stokes::StokesTypes> stokes = it->stokes();
-       ASKAPDEBUGASSERT(flags.ncolumn() == stokes.nelements());
-       ASKAPDEBUGASSERT(flags.nrow() == it->nRow());
+       // flags are obtained on demand
+       casacore::Cube<casacore::Bool> flags;
+       casacore::Vector<casacore::Bool> rowFlags(stokes.nelements());
        // go through all rows and aggregate baselines
        for (casacore::uInt row=0; row<it->nRow(); ++row) {
             const casacore::uInt beam = beam1[row];
@@ -122,10 +128,10 @@ void ScanStats::inspect(const std::string &name, const accessors::IConstDataShar
                 ASKAPCHECK(obs.direction().separation(it->pointingDir2()[row]) < dirTolerance, 
                           "Pointing direction is different for two antennas, unsupported scenario");                
 
-                const casacore::Vector<casacore::Stokes::StokesTypes>& stokes = obs.stokes();
-                ASKAPCHECK(stokes.nelements() == it->nPol(), "Number of polarisations appears to have changed");
-                for (casacore::uInt pol = 0; pol < stokes.nelements(); ++pol) {
-                     ASKAPCHECK(stokes[pol] == it->stokes()[pol], "Polarisation product "<<pol+1<<" appears to have changed type");
+                const casacore::Vector<casacore::Stokes::StokesTypes>& obsStokes = obs.stokes();
+                ASKAPCHECK(obsStokes.nelements() == stokes.nelements(), "Number of polarisations appears to have changed");
+                for (casacore::uInt pol = 0; pol < obsStokes.nelements(); ++pol) {
+                     ASKAPCHECK(obsStokes[pol] == stokes[pol], "Polarisation product "<<pol+1<<" appears to have changed type");
                 }
             } else {
                 // brand new element in the map
@@ -136,37 +142,30 @@ void ScanStats::inspect(const std::string &name, const accessors::IConstDataShar
                     // fill implementation-specific fields (scan and field IDs)
                     obs.setScanAndFieldIDs(tableIt->currentScanID(), tableIt->currentFieldID());
                 }          
-                obs.setStokes(it->stokes());
+                obs.setStokes(stokes);
+                // whether this observation continues an existing scan doesn't depend on flags
+                scanToExtend[beam] = findScanToExtend(obs);
             }        
-            // now process flagging information for the given row
-            obs.processBaselineFlags(antenna1[row], antenna2[row], flags.row(row));
+            // now process flagging information for the given row, unless it can't change the result
+            const size_t scan = scanToExtend[beam];
+            if (obs.hasValidData(antenna1[row], antenna2[row]) ||
+                ((scan < nObs) && itsObs[scan].hasValidData(antenna1[row], antenna2[row]))) {
+                continue;
+            }
+            if (flags.nelements() == 0) {
+                flags.reference(it->flag());
+                ASKAPDEBUGASSERT(flags.nplane() == stokes.nelements());
+                ASKAPDEBUGASSERT(flags.nrow() == it->nRow());
+            }
+            allChannelsFlagged(flags, row, rowFlags);
+            obs.processBaselineFlags(antenna1[row], antenna2[row], rowFlags);
        } // loop over row
        // aggregate the map into the final buffer
        for (std::map<casacore::uInt, ObservationDescription>::const_iterator ci = currentObs.begin(); ci != currentObs.end(); ++ci) {
-            std::vector<ObservationDescription>::reverse_iterator lastObsThisBeam = 
-                  std::find_if(itsObs.rbegin(), itsObs.rend(), BeamCheckHelper(ci->first));
-            bool sameScan = (lastObsThisBeam != itsObs.rend());
-            if (sameScan) {            
-                sameScan = (lastObsThisBeam->endCycle() + 1 == ci->second.startCycle());
-                sameScan &= (lastObsThisBeam->name() == name);
-                if (sameScan && (itsCycleLimit >= 0)) {
-                    sameScan = (ci->second.endCycle() - lastObsThisBeam->startCycle() < static_cast<casacore::uInt>(itsCycleLimit));
-                } 
-                if (sameScan && (itsTimeLimit >= 0.)) {
-                    sameScan = (ci->second.endTime() - lastObsThisBeam->startTime() < itsTimeLimit);
-                } 
-                if (sameScan) {
-                    sameScan = (fabs(ci->second.frequency() - freq) < freqTolerance);
-                }
-                sameScan &= (lastObsThisBeam->scanID() == ci->second.scanID());
-                sameScan &= (lastObsThisBeam->fieldID() == ci->second.fieldID());                
-                sameScan &= (lastObsThisBeam->direction().separation(ci->second.direction()) < dirTolerance);
-            }
-            if (sameScan) {
+            const size_t scan = scanToExtend[ci->first];
+            if (scan < nObs) {
                 // continuing the same scan
-                ASKAPDEBUGASSERT(lastObsThisBeam != itsObs.rend());
-                //lastObsThisBeam->update(ci->second.endCycle(), ci->second.endTime());
-                lastObsThisBeam->merge(ci->second);
+                itsObs[scan].merge(ci->second);
             } else {
                 // start a new scan
                 itsObs.push_back(ci->second);
@@ -176,26 +175,58 @@ void ScanStats::inspect(const std::string &name, const accessors::IConstDataShar
   }
 }
 
-/// @brief helper method to compact flags across frequency axis
-/// @details Each row each polarisation is considered flagged if all corresponding frequency channels
+/// @brief find the scan continued by the given observation
+/// @details The observation continues the last scan with the same beam if it is the next cycle of
+/// the same dataset with the same scan, field, direction and frequency, and the limits on the scan
+/// duration are not exceeded.
+/// @param[in] obs observation of one integration
+/// @return index of the scan in itsObs or itsObs.size() if a new scan has to be started
+size_t ScanStats::findScanToExtend(const ObservationDescription &obs) const
+{
+  const double dirTolerance = 1e-7;
+  const double freqTolerance = 1.;
+  std::vector<ObservationDescription>::const_reverse_iterator lastObsThisBeam = 
+        std::find_if(itsObs.rbegin(), itsObs.rend(), BeamCheckHelper(obs.beam()));
+  bool sameScan = (lastObsThisBeam != itsObs.rend());
+  if (sameScan) {            
+      sameScan = (lastObsThisBeam->endCycle() + 1 == obs.startCycle());
+      sameScan &= (lastObsThisBeam->name() == obs.name());
+      if (sameScan && (itsCycleLimit >= 0)) {
+          sameScan = (obs.endCycle() - lastObsThisBeam->startCycle() < static_cast<casacore::uInt>(itsCycleLimit));
+      } 
+      if (sameScan && (itsTimeLimit >= 0.)) {
+          sameScan = (obs.endTime() - lastObsThisBeam->startTime() < itsTimeLimit);
+      } 
+      if (sameScan) {
+          sameScan = (fabs(lastObsThisBeam->frequency() - obs.frequency()) < freqTolerance);
+      }
+      sameScan &= (lastObsThisBeam->scanID() == obs.scanID());
+      sameScan &= (lastObsThisBeam->fieldID() == obs.fieldID());                
+      sameScan &= (lastObsThisBeam->direction().separation(obs.direction()) < dirTolerance);
+  }
+  return sameScan ? static_cast<size_t>(itsObs.rend() - lastObsThisBeam) - 1 : itsObs.size();
+}
+
+/// @brief helper method to compact flags across frequency axis for one row
+/// @details Each polarisation is considered flagged if all corresponding frequency channels
 /// are flagged
 /// @param[in] flags nRow x nChan x nPol cube as provided by the accessor
-/// @return nRow x nPol matrix with aggregated flags 
-casacore::Matrix<casacore::Bool> ScanStats::allChannelsFlagged(const casacore::Cube<casacore::Bool> &flags)
+/// @param[in] row row of interest
+/// @param[out] result vector with aggregated flags for each polarisation (should be nPol long)
+void ScanStats::allChannelsFlagged(const casacore::Cube<casacore::Bool> &flags, casacore::uInt row,
+                                   casacore::Vector<casacore::Bool> &result)
 {
-   ASKAPDEBUGASSERT(flags.nelements() > 0);
-   casacore::Matrix<casacore::Bool> result(flags.nrow(), flags.nplane(), true);
-   for (casacore::uInt row = 0; row < flags.nrow(); ++row) {
-        for (casacore::uInt pol = 0; pol < flags.nplane(); ++pol) {
-             for (casacore::uInt chan = 0; chan < flags.ncolumn(); ++chan) {
-                  if (!flags(row,chan,pol)) {
-                      result(row,pol) = false;
-                      break;
-                  }
+   ASKAPDEBUGASSERT(row < flags.nrow());
+   ASKAPDEBUGASSERT(result.nelements() == flags.nplane());
+   for (casacore::uInt pol = 0; pol < flags.nplane(); ++pol) {
+        result[pol] = true;
+        for (casacore::uInt chan = 0; chan < flags.ncolumn(); ++chan) {
+             if (!flags(row,chan,pol)) {
+                 result[pol] = false;
+                 break;
              }
         }
    }
-   return result;
 }
 
 /// @brief access to the selected scan
@@ -110,12 +110,22 @@ public:
    inline int cycleLimit() const { return itsCycleLimit; }
    
 protected:
-   /// @brief helper method to compact flags across frequency axis
-   /// @details Each row each polarisation is considered flagged if all corresponding frequency channels
+   /// @brief helper method to compact flags across frequency axis for one row
+   /// @details Each polarisation is considered flagged if all corresponding frequency channels
    /// are flagged
    /// @param[in] flags nRow x nChan x nPol cube as provided by the accessor
-   /// @return nRow x nPol matrix with aggregated flags 
-   static casacore::Matrix<casacore::Bool> allChannelsFlagged(const casacore::Cube<casacore::Bool> &flags);
+   /// @param[in] row row of interest
+   /// @param[out] result vector with aggregated flags for each polarisation (should be nPol long)
+   static void allChannelsFlagged(const casacore::Cube<casacore::Bool> &flags, casacore::uInt row,
+                                  casacore::Vector<casacore::Bool> &result);
+
+   /// @brief find the scan continued by the given observation
+   /// @details The observation continues the last scan with the same beam if it is the next cycle of
+   /// the same dataset with the same scan, field, direction and frequency, and the limits on the scan
+   /// duration are not exceeded.
+   /// @param[in] obs observation of one integration
+   /// @return index of the scan in itsObs or itsObs.size() if a new scan has to be started
+   size_t findScanToExtend(const ObservationDescription &obs) const;
    
 private:
    /// collection of individual observations
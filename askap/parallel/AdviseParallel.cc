@@ -54,6 +54,15 @@ ASKAP_LOGGER(logger, ".parallel");
 
 #include <vector>
 #include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <functional>
+#include <algorithm>
+#include <cstdio>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include <boost/shared_ptr.hpp>
 
@@ -156,7 +165,7 @@ private:
 /// @param comms communication object
 /// @param parset ParameterSet for inputs
 AdviseParallel::AdviseParallel(askap::askapparallel::AskapParallel& comms, const LOFAR::ParameterSet& parset) :
-    MEParallelApp(comms, addMissingFields(parset),true), itsTangentDefined(false)
+    MEParallelApp(comms, addMissingFields(parset),true), itsTangentDefined(false), itsStatsCache(false)
 {
    init(parset);
 }
@@ -182,6 +191,11 @@ void AdviseParallel::init(const LOFAR::ParameterSet& parset)
    // set w percentile if present
    itsWPercentile = parset.getDouble("wpercentile",99.9)/100.0;
    ASKAPCHECK(itsWPercentile>0 && itsWPercentile<1,"wpercentile value needs to be between 0 and 100");
+   // statistics of each dataset can be kept next to it and reused by subsequent jobs
+   itsStatsCache = parset.getBool("statscache",false);
+   if (itsStatsCache) {
+       ASKAPLOG_INFO_STR(logger, "Metadata statistics will be cached next to each measurement set");
+   }
    itsNe.reset();
 }
 
@@ -280,9 +294,38 @@ void AdviseParallel::calcOne(const std::string &ms)
 {
    casacore::Timer timer;
    timer.mark();
-   ASKAPLOG_INFO_STR(logger, "Performing iteration to accumulate metadata statistics for " << ms);
    ASKAPDEBUGASSERT(itsEstimator);
+   if (itsStatsCache) {
+       // statistics of this dataset alone, they're merged with the statistics of other datasets
+       VisMetaDataStats stats(*itsEstimator);
+       stats.reset();
+       const std::string key = statsCacheKey(ms, stats);
+       std::ostringstream os;
+       os << ms.substr(0, ms.find_last_not_of('/') + 1) << ".advise." << std::hex << std::hash<std::string>()(key);
+       const std::string fileName = os.str();
+       if (loadCachedStats(fileName, key, stats)) {
+           ASKAPLOG_INFO_STR(logger, "Loaded metadata statistics for " << ms << " from " << fileName);
+       } else {
+           ASKAPLOG_INFO_STR(logger, "Performing iteration to accumulate metadata statistics for " << ms);
+           accumulate(ms, stats);
+           saveCachedStats(fileName, key, stats);
+       }
+       itsEstimator->merge(stats);
+   } else {
+       ASKAPLOG_INFO_STR(logger, "Performing iteration to accumulate metadata statistics for " << ms);
+       accumulate(ms, *itsEstimator);
+   }
 
+   ASKAPLOG_INFO_STR(logger, "Finished iteration for "<< ms << " in "<< timer.real()
+                   << " seconds");
+}
+
+/// @brief accumulate statistics for the given dataset
+/// @details This method iterates over the given dataset and passes every accessor to the estimator.
+/// @param[in] ms measurement set name
+/// @param[in] stats estimator to update
+void AdviseParallel::accumulate(const std::string &ms, VisMetaDataStats &stats) const
+{
    accessors::TableDataSource ds(ms, accessors::TableDataSource::MEMORY_BUFFERS, dataColumn());
 
    ASKAPLOG_DEBUG_STR(logger, "Initialised accessor");
@@ -305,12 +348,188 @@ void AdviseParallel::calcOne(const std::string &ms)
    ASKAPLOG_DEBUG_STR(logger, "Initialised iterator");
    for (; it.hasMore(); it.next()) {
         // iteration over the dataset
-        itsEstimator->process(*it);
+        stats.process(*it);
+   }
+}
 
+/// @brief key describing the statistics of the given dataset
+/// @details Cached statistics are valid as long as the dataset is not modified and the same data column,
+/// selection and estimator configuration are used. All of these are encoded in the key.
+/// @param[in] ms measurement set name
+/// @param[in] stats estimator (only configuration is used)
+/// @return string key
+std::string AdviseParallel::statsCacheKey(const std::string &ms, const VisMetaDataStats &stats) const
+{
+   ASKAPDEBUGASSERT(stats.nVis() == 0ul);
+   std::ostringstream os;
+   os << std::setprecision(17) << "ms=" << ms << ";mtime=" << tableModificationTime(ms) << ";column=" << dataColumn() <<
+         ";freqframe=" << getFreqRefFrame().getType() << ";uvwtolerance=" << uvwMachineCacheTolerance() <<
+         ";flagged=" << stats.includesFlagged() << ";selection=" << selectionKey(parset());
+   // the serialised pristine estimator encodes tangent point, w-tolerance and percentile settings
+   LOFAR::BlobString bs;
+   bs.resize(0);
+   LOFAR::BlobOBufString bob(bs);
+   LOFAR::BlobOStream out(bob);
+   stats.writeToBlob(out);
+   os << ";estimator=" << std::hex << std::setfill('0');
+   const unsigned char *data = reinterpret_cast<const unsigned char*>(bs.data());
+   for (size_t i = 0; i < bs.size(); ++i) {
+        os << std::setw(2) << static_cast<unsigned int>(data[i]);
    }
+   return os.str();
+}
 
-   ASKAPLOG_INFO_STR(logger, "Finished iteration for "<< ms << " in "<< timer.real()
-                   << " seconds");
+/// @brief latest modification time of the files of a table
+/// @details Files of the table directory and of its subtables (one level down) are examined.
+/// Lock files are rewritten every time a table is opened, so they are ignored.
+/// @param[in] name table name
+/// @return modification time in seconds and nanoseconds, empty string if the table doesn't exist
+std::string AdviseParallel::tableModificationTime(const std::string &name)
+{
+   struct stat buf;
+   if (stat(name.c_str(), &buf) != 0) {
+       return std::string();
+   }
+   std::pair<time_t, long> latest(buf.st_mtim.tv_sec, buf.st_mtim.tv_nsec);
+   if (S_ISDIR(buf.st_mode)) {
+       DIR *dir = opendir(name.c_str());
+       if (dir != NULL) {
+           for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+                const std::string fileName(entry->d_name);
+                if (fileName == "." || fileName == ".." || fileName == "table.lock") {
+                    continue;
+                }
+                const std::string path = name + "/" + fileName;
+                if (stat(path.c_str(), &buf) != 0) {
+                    continue;
+                }
+                latest = std::max(latest, std::pair<time_t, long>(buf.st_mtim.tv_sec, buf.st_mtim.tv_nsec));
+                if (S_ISDIR(buf.st_mode)) {
+                    // subtable, its directory time doesn't change when the files are rewritten
+                    DIR *subdir = opendir(path.c_str());
+                    if (subdir != NULL) {
+                        for (struct dirent *subentry = readdir(subdir); subentry != NULL; subentry = readdir(subdir)) {
+                             const std::string subName(subentry->d_name);
+                             if (subName == "." || subName == ".." || subName == "table.lock") {
+                                 continue;
+                             }
+                             if (stat((path + "/" + subName).c_str(), &buf) == 0) {
+                                 latest = std::max(latest, std::pair<time_t, long>(buf.st_mtim.tv_sec,
+                                                   buf.st_mtim.tv_nsec));
+                             }
+                        }
+                        closedir(subdir);
+                    }
+                }
+           }
+           closedir(dir);
+       }
+   }
+   std::ostringstream os;
+   os << latest.first << "." << std::setw(9) << std::setfill('0') << latest.second;
+   return os.str();
+}
+
+/// @brief data selection part of the cache key
+/// @details The selector is filled from the whole parset, so all parameters except the list of datasets
+/// are encoded. This is conservative, but new selection keywords can't be missed.
+/// @param[in] parset parset used to set up data selection
+/// @return string key
+std::string AdviseParallel::selectionKey(const LOFAR::ParameterSet &parset)
+{
+   LOFAR::ParameterSet selection(parset);
+   if (selection.isDefined("dataset")) {
+       selection.remove("dataset");
+   }
+   std::ostringstream os;
+   os << selection;
+   return os.str();
+}
+
+/// @brief load statistics from the cache
+/// @param[in] fileName name of the cache file
+/// @param[in] key key describing the dataset, selection and estimator configuration
+/// @param[in] stats estimator to fill
+/// @return true if the cache file exists and matches the key
+bool AdviseParallel::loadCachedStats(const std::string &fileName, const std::string &key, VisMetaDataStats &stats)
+{
+   std::ifstream is(fileName.c_str(), std::ios::binary);
+   if (!is) {
+       return false;
+   }
+   is.seekg(0, std::ios::end);
+   const std::streamoff size = is.tellg();
+   is.seekg(0, std::ios::beg);
+   if (size <= 0) {
+       return false;
+   }
+   LOFAR::BlobString bs;
+   bs.resize(size);
+   if (!is.read(reinterpret_cast<char*>(bs.data()), size)) {
+       ASKAPLOG_WARN_STR(logger, "Unable to read cached statistics from " << fileName);
+       return false;
+   }
+   const int currentVersion = 1;
+   try {
+       LOFAR::BlobIBufString bib(bs);
+       LOFAR::BlobIStream in(bib);
+       const int version = in.getStart("cachedstatistics");
+       if (version != currentVersion) {
+           return false;
+       }
+       std::string cachedKey;
+       in >> cachedKey;
+       if (cachedKey != key) {
+           // hash collision or a stale file for different data or selection
+           return false;
+       }
+       stats.readFromBlob(in);
+       in.getEnd();
+   }
+   catch (const std::exception &ex) {
+       ASKAPLOG_WARN_STR(logger, "Ignoring corrupted statistics cache " << fileName << ": " << ex.what());
+       stats.reset();
+       return false;
+   }
+   return true;
+}
+
+/// @brief save statistics into the cache
+/// @details Errors are reported as warnings, the cache is not essential.
+/// @param[in] fileName name of the cache file
+/// @param[in] key key describing the dataset, selection and estimator configuration
+/// @param[in] stats estimator to save
+void AdviseParallel::saveCachedStats(const std::string &fileName, const std::string &key, const VisMetaDataStats &stats)
+{
+   LOFAR::BlobString bs;
+   bs.resize(0);
+   LOFAR::BlobOBufString bob(bs);
+   LOFAR::BlobOStream out(bob);
+   const int currentVersion = 1;
+   out.putStart("cachedstatistics", currentVersion);
+   out << key;
+   stats.writeToBlob(out);
+   out.putEnd();
+
+   // several jobs may work with the same dataset, write a temporary file and rename it, so that the
+   // cache file is always complete
+   std::ostringstream tmpName;
+   tmpName << fileName << ".tmp" << getpid();
+   {
+       std::ofstream os(tmpName.str().c_str(), std::ios::binary | std::ios::trunc);
+       os.write(reinterpret_cast<const char*>(bs.data()), bs.size());
+       if (!os) {
+           ASKAPLOG_WARN_STR(logger, "Unable to write statistics cache " << tmpName.str());
+           std::remove(tmpName.str().c_str());
+           return;
+       }
+   }
+   if (std::rename(tmpName.str().c_str(), fileName.c_str()) != 0) {
+       ASKAPLOG_WARN_STR(logger, "Unable to create statistics cache " << fileName);
+       std::remove(tmpName.str().c_str());
+       return;
+   }
+   ASKAPLOG_INFO_STR(logger, "Cached metadata statistics in " << fileName);
 }
 
 /// @brief calculate "normal equations", i.e. statistics for this dataset
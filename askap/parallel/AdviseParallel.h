@@ -108,6 +108,48 @@ public:
 
 protected:
 
+   /// @brief accumulate statistics for the given dataset
+   /// @details This method iterates over the given dataset and passes every accessor to the estimator.
+   /// @param[in] ms measurement set name
+   /// @param[in] stats estimator to update
+   void accumulate(const std::string &ms, VisMetaDataStats &stats) const;
+
+   /// @brief key describing the statistics of the given dataset
+   /// @details Cached statistics are valid as long as the dataset is not modified and the same data column,
+   /// selection and estimator configuration are used. All of these are encoded in the key.
+   /// @param[in] ms measurement set name
+   /// @param[in] stats estimator (only configuration is used)
+   /// @return string key
+   std::string statsCacheKey(const std::string &ms, const VisMetaDataStats &stats) const;
+
+   /// @brief latest modification time of the files of a table
+   /// @details Files of the table directory and of its subtables (one level down) are examined.
+   /// Lock files are rewritten every time a table is opened, so they are ignored.
+   /// @param[in] name table name
+   /// @return modification time in seconds and nanoseconds, empty string if the table doesn't exist
+   static std::string tableModificationTime(const std::string &name);
+
+   /// @brief data selection part of the cache key
+   /// @details The selector is filled from the whole parset, so all parameters except the list of datasets
+   /// are encoded. This is conservative, but new selection keywords can't be missed.
+   /// @param[in] parset parset used to set up data selection
+   /// @return string key
+   static std::string selectionKey(const LOFAR::ParameterSet &parset);
+
+   /// @brief load statistics from the cache
+   /// @param[in] fileName name of the cache file
+   /// @param[in] key key describing the dataset, selection and estimator configuration
+   /// @param[in] stats estimator to fill
+   /// @return true if the cache file exists and matches the key
+   static bool loadCachedStats(const std::string &fileName, const std::string &key, VisMetaDataStats &stats);
+
+   /// @brief save statistics into the cache
+   /// @details Errors are reported as warnings, the cache is not essential.
+   /// @param[in] fileName name of the cache file
+   /// @param[in] key key describing the dataset, selection and estimator configuration
+   /// @param[in] stats estimator to save
+   static void saveCachedStats(const std::string &fileName, const std::string &key, const VisMetaDataStats &stats);
+
    /// @brief a hopefully temporary method to define missing fields in parset
    /// @details We reuse some code for general synthesis application, but it requires some
    /// parameters (like gridder) to be defined. This method fills the parset with stubbed fields.
@@ -151,6 +193,9 @@ private:
    /// @brief w percentile value to calculate (between 0 and 100)
    double itsWPercentile;
 
+   /// @brief true if statistics of every dataset are cached next to it
+   bool itsStatsCache;
+
    /// @brief statistics estimator
   boost::shared_ptr<VisMetaDataStats> itsEstimator;
 };
@@ -29,6 +29,7 @@
 
 #include <askap/parallel/ContSubtractParallel.h>
 #include <askap/parallel/SimParallel.h>
+#include <askap/parallel/ParallelAccessor.h>
 #include <askap/scimath/fitting/NormalEquationsStub.h>
 #include <askap/dataaccess/TableDataSource.h>
 #include <askap/dataaccess/ParsetInterface.h>
@@ -41,7 +42,7 @@
 #include <askap/measurementequation/ImagingEquationAdapter.h>
 #include <askap/askap/AskapError.h>
 #include <askap/measurementequation/SynthesisParamsHelper.h>
-#include <casacore/scimath/Fitting/LinearFitSVD.h>
+#include <askap/utils/BoundedQueue.h>
 
 
 // logging stuff
@@ -51,6 +52,16 @@ ASKAP_LOGGER(logger, ".parallel");
 
 #include <casacore/casa/OS/Timer.h>
 
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
 
 using namespace askap;
 using namespace askap::synthesis;
@@ -71,18 +82,76 @@ ContSubtractParallel::ContSubtractParallel(askap::askapparallel::AskapParallel&
   itsNe.reset(new scimath::NormalEquationsStub);
 
   itsModelReadByMaster = parset.getBool("modelReadByMaster", true);
-  itsDoUVlin = parset.getBool("doUVlin", false);
-  itsOrder = parset.getInt("order", 1);
-  itsHarmonic = parset.getInt("harmonic", 1);
-  itsWidth = parset.getInt("width",0); // 0 = whole spectrum
-  itsOffset = min(max(0,parset.getInt("offset",0)),itsWidth);
-  itsThreshold = max(0.0f,parset.getFloat("threshold",2.5));
-  if (itsWidth > 0) ASKAPCHECK(itsOffset < itsWidth,"The offset needs to be less than the width");
-  if (itsDoUVlin) ASKAPLOG_INFO_STR(logger, "Doing uvlin operation with order = "
-    << itsOrder<<", harmonic = "<<itsHarmonic<< ", width = "<< itsWidth
-    <<" channels, offset = "<< itsOffset << " and threshold = "<< itsThreshold);
+  if (parset.getBool("doUVlin", false)) {
+      const int order = parset.getInt("order", 1);
+      const int harmonic = parset.getInt("harmonic", 1);
+      const int width = parset.getInt("width",0); // 0 = whole spectrum
+      const int offset = min(max(0,parset.getInt("offset",0)),width);
+      const float threshold = max(0.0f,parset.getFloat("threshold",2.5));
+      if (width > 0) ASKAPCHECK(offset < width,"The offset needs to be less than the width");
+      ASKAPLOG_INFO_STR(logger, "Doing uvlin operation with order = "
+        << order<<", harmonic = "<<harmonic<< ", width = "<< width
+        <<" channels, offset = "<< offset << " and threshold = "<< threshold);
+      itsUVLinFitter.reset(new UVLinFitter(order, harmonic, width, offset, threshold));
+  }
+  itsPredictThreads = parset.getUint32("predictthreads", 0);
+  itsQueueSize = std::max(1u, parset.getUint32("queuesize", 2 * itsPredictThreads));
+  if (itsPredictThreads > 0) {
+      ASKAPLOG_INFO_STR(logger, "Data I/O will be overlapped with prediction in "<<itsPredictThreads<<
+                        " thread(s), up to "<<itsQueueSize<<" chunk(s) will be queued");
+  }
 }
 
+namespace {
+
+/// @brief chunk of data passed through the prediction pipeline
+struct ContSubtractChunk {
+   /// @brief sequence number of the chunk
+   size_t index;
+   /// @brief copy of the chunk metadata, visibilities are replaced by the model
+   /// @details This accessor keeps its own uvw machine cache, so rotated uvw's and
+   /// delays can be obtained without touching the table.
+   boost::shared_ptr<ParallelAccessor> acc;
+   /// @brief original visibilities, model is subtracted from them by the prediction thread
+   casacore::Cube<casacore::Complex> vis;
+};
+
+/// @brief make a self-contained copy of the current chunk
+/// @param[in] acc accessor to copy
+/// @param[in] index sequence number of the chunk
+/// @param[in] cacheSize uvw-machine cache size
+/// @param[in] tolerance pointing direction tolerance in radians for the uvw-machine cache
+/// @return shared pointer to the new chunk
+boost::shared_ptr<ContSubtractChunk> copyChunk(const IConstDataAccessor &acc, size_t index,
+                                               size_t cacheSize, double tolerance)
+{
+   boost::shared_ptr<ContSubtractChunk> chunk(new ContSubtractChunk);
+   chunk->index = index;
+   chunk->vis.reference(acc.visibility().copy());
+   chunk->acc.reset(new ParallelAccessor(cacheSize, tolerance));
+   ParallelAccessor &buf = *chunk->acc;
+   buf.itsAntenna1.reference(acc.antenna1().copy());
+   buf.itsAntenna2.reference(acc.antenna2().copy());
+   buf.itsFeed1.reference(acc.feed1().copy());
+   buf.itsFeed2.reference(acc.feed2().copy());
+   buf.itsFeed1PA.reference(acc.feed1PA().copy());
+   buf.itsFeed2PA.reference(acc.feed2PA().copy());
+   buf.itsPointingDir1.reference(acc.pointingDir1().copy());
+   buf.itsPointingDir2.reference(acc.pointingDir2().copy());
+   buf.itsDishPointing1.reference(acc.dishPointing1().copy());
+   buf.itsDishPointing2.reference(acc.dishPointing2().copy());
+   buf.itsUVW.reference(acc.uvw().copy());
+   buf.itsTime = acc.time();
+   buf.itsStokes.reference(acc.stokes().copy());
+   buf.itsFlag.reference(acc.flag().copy());
+   buf.itsNoise.reference(acc.noise().copy());
+   buf.itsFrequency.reference(acc.frequency().copy());
+   buf.itsVisibility.resize(chunk->vis.shape());
+   return chunk;
+}
+
+} // anonymous namespace
+
 /// @brief Initialise continuum subtractor
 /// @details The parameters are taken from the parset file supplied in the constructor.
 /// This method does initialisation which may involve communications in the parallel case
@@ -108,6 +177,17 @@ void ContSubtractParallel::init()
 /// @brief initialise measurement equation
 /// @details This method initialises measurement equation
 void ContSubtractParallel::initMeasurementEquation()
+{
+   itsEquation = createMeasurementEquation();
+   itsThreadEquations.clear();
+}
+
+/// @brief create measurement equation
+/// @details This method builds a new accessor-based measurement equation for the current model.
+/// It is used to set up the main equation as well as independent equations for
+/// each prediction thread.
+/// @return shared pointer to the new equation
+scimath::Equation::ShPtr ContSubtractParallel::createMeasurementEquation() const
 {
    ASKAPLOG_INFO_STR(logger, "Creating measurement equation" );
 
@@ -138,16 +218,17 @@ void ContSubtractParallel::initMeasurementEquation()
        compEquation.reset(new ComponentEquation(*itsModel, stubIter));
    }
 
+   scimath::Equation::ShPtr equation;
    if (imgEquation && !compEquation) {
        ASKAPLOG_INFO_STR(logger, "Pure image-based model (no components defined)");
-       itsEquation = imgEquation;
+       equation = imgEquation;
    } else if (compEquation && !imgEquation) {
        ASKAPLOG_INFO_STR(logger, "Pure component-based model (no images defined)");
-       itsEquation = compEquation;
+       equation = compEquation;
    } else if (imgEquation && compEquation) {
        ASKAPLOG_INFO_STR(logger, "Making a sum of image-based and component-based equations");
-       itsEquation = imgEquation;
-       SimParallel::addEquation(itsEquation, compEquation, stubIter);
+       equation = imgEquation;
+       SimParallel::addEquation(equation, compEquation, stubIter);
    } else {
        ASKAPTHROW(AskapError, "No sky models are defined");
    }
@@ -157,212 +238,157 @@ void ContSubtractParallel::initMeasurementEquation()
    // additional fiddling  is needed
 
    boost::shared_ptr<IMeasurementEquation> accessorBasedEquation =
-        boost::dynamic_pointer_cast<IMeasurementEquation>(itsEquation);
+        boost::dynamic_pointer_cast<IMeasurementEquation>(equation);
 
    if (!accessorBasedEquation) {
         // form a replacement equation first
         const boost::shared_ptr<ImagingEquationAdapter> new_equation(new ImagingEquationAdapter);
-        // the actual equation (from itsEquation) will be locked inside ImagingEquationAdapter
-        // in a shared pointer. We can change itsEquation after the following line
-        new_equation->assign(itsEquation);
+        // the actual equation will be locked inside ImagingEquationAdapter
+        // in a shared pointer. We can change equation after the following line
+        new_equation->assign(equation);
         // replacing the original equation with an accessor-based adapter
-        itsEquation = new_equation;
+        equation = new_equation;
    }
+   return equation;
+}
 
+/// @brief predict and subtract the model for one chunk
+/// @param[in] equation measurement equation to use
+/// @param[in] acc accessor with the chunk metadata, its visibilities are overwritten with the model
+/// @param[in,out] vis visibilities to subtract the model from
+void ContSubtractParallel::subtractModel(const IMeasurementEquation &equation, IDataAccessor &acc,
+                                         casacore::Cube<casacore::Complex> &vis) const
+{
+   acc.rwVisibility().set(0.);
+   equation.predict(acc);
+   const casacore::Cube<casacore::Complex>& model = acc.visibility();
+   ASKAPDEBUGASSERT(model.nrow() == vis.nrow());
+   ASKAPDEBUGASSERT(model.ncolumn() == vis.ncolumn());
+   ASKAPDEBUGASSERT(model.nplane() == vis.nplane());
+   vis -= model;
+   if (itsUVLinFitter) {
+       itsUVLinFitter->subtractContFit(vis,acc.flag());
+   }
 }
 
-void ContSubtractParallel::modelSpectrum(casa::Vector<casa::Float> & model,
-        const casacore::Vector<casa::Float>& spec, const casa::Vector<casa::Bool>& mask)
+/// @brief pipelined subtraction
+/// @details The calling thread reads chunks with the first iterator and hands over their
+/// copies to the prediction threads, which predict the model and subtract it (together
+/// with the uvlin-like fit, if requested). The results are written back in order with the
+/// second iterator, which follows the first one over the same selection. All table access
+/// happens in the calling thread.
+/// @param[in] readIt iterator used to read the data
+/// @param[in] writeIt iterator used to write the results back
+void ContSubtractParallel::subtractPipelined(const IDataSharedIter &readIt, const IDataSharedIter &writeIt)
 {
-    int nChan= spec.size();
-    int nParams = itsOrder+1+itsHarmonic*2;
-    casa::LSQaips fitter(nParams);
-    casa::Vector<casa::Double> xx(nParams);
-    casa::Vector<casa::Double> solution(nParams);
-    casa::VectorSTLIterator<casa::Double> it(xx);
-    casa::Vector<casa::Bool> tmask(nChan);
-
-    // If we are doing outlier rejection against the model iterate a few times
-    const int niter = (itsThreshold > 0 ? 3 : 1);
-    // initial mask is the data flags
-    tmask = mask;
-    // initial model is zero
-    model = 0;
-
-    // we are doing the fitting in channel bins
-    if (itsWidth == 0) itsWidth = nChan;
-    casa::Vector<casa::Float> y(itsWidth);
-    casa::Block<casa::Float> tmp;
-    uint lastDof = nParams;
-    for (int binStart=-itsOffset; binStart<nChan; binStart+=itsWidth) {
-        int start = max(0,binStart);
-        int end = min(binStart+itsWidth,nChan);
-        int binWidth = end - start;
-        for (int iter = 0; iter<niter; iter++) {
-            // do thresholding of values before fitting?
-            if (itsThreshold > 0) {
-                // count how many valid values
-                int n = 0;
-                // collect valid values
-                for (int i=start; i < end; i++) {
-                    if (tmask(i)) {
-                        y(n++) = spec(i) - model(i);
-                    }
-                }
-                // work out robust sigma and median
-                if (n>0) {
-                    casa::Float q25 = casa::fractile(y(casa::Slice(0,n)), tmp, 0.25f, casa::False, casa::True);
-                    casa::Float q50 = casa::fractile(y(casa::Slice(0,n)), tmp, 0.50f, casa::False, casa::True);
-                    casa::Float q75 = casa::fractile(y(casa::Slice(0,n)), tmp, 0.75f, casa::False, casa::True);
-                    // if (tmp.nelements()>0) casa::cerr<<"tmp was used!"<<casa::endl;
-                    casa::Float sigma = (q75-q25)/1.35; // robust sigma estimate
-                    int count = 0;
-                    // flag outliers
-                    for (int i=start; i < end; i++) {
-                        if (mask(i) && (abs((spec(i)-model(i)) - q50) > itsThreshold * sigma)) {
-                            tmask(i) = false;
-                            count++;
-                        } else {
-                            tmask(i) = mask(i);
-                        }
-                    }
-                    // extend the mask by a few channels - disabled for now
-                    const int nextend = 0;
-                    if (nextend > 0) {
-                        bool clip = false;
-                        int first = end, last = 0;
-                        int i = start;
-                        while (i < end) {
-                            if (mask(i) && !tmask(i)) {
-                                if (!clip) first = i;
-                                clip = true;
-                                i++;
-                            } else {
-                                if (clip) last = i - 1;
-                                clip = false;
-                                if (last - first > 2) {
-                                    for (int k=0; k<nextend; k++) {
-                                        if (first-1-k >= start) tmask(first-1-k) = false;
-                                        if (i+k < end) tmask(i+k) = false;
-                                    }
-                                    i+=nextend;
-                                    first = end;
-                                } else {
-                                    i++;
-                                }
-                            }
-                        }
-                    }
-
-                    int count2 = 0;
-                    for (int i=start; i<end; i++) if (mask(i) && !tmask(i)) count2++;
-                    //casa::cerr<<"iter="<<iter<<", n="<<n<<", start="<<start<<", median="<<q50<<", rsigma="<<sigma<<", outliers flagged: "<<count<<", extended to "<<count2<<casa::endl;
-                    //casa::cerr<<"model("<<start<<")="<<model(start)<<", model("<<end-1<<")="<<model(end-1)<<
-                    //    ", y(0)="<<y(0)<<", y("<<n-1<<")="<<y(n-1)<<casa::endl;
-                    if (iter > 0 && count2 == 0) break; // no further change expected
-                }
-            }
+   ASKAPDEBUGASSERT(itsEquation);
+   // each thread needs its own equation as gridders and their caches are not thread-safe
+   if (itsThreadEquations.empty()) {
+       itsThreadEquations.push_back(itsEquation);
+   }
+   while (itsThreadEquations.size() < itsPredictThreads) {
+       itsThreadEquations.push_back(createMeasurementEquation());
+   }
 
-            // apply external mask - would need to read this from file
-            //for (int i=start; i<end; i++) if (i > 40 && i < 60)  tmask(i) = false;
-
-            // We may need to limit #degrees of freedom (like miriad uvlin) if there are large gaps.
-            // Higher orders blow up quicker for given gap size; order<=1 is safest with large gaps.
-            // If valid channels < 60% -> reduce #dof, if valid channels < 5*(#dof) -> reduce dof
-            int valid = 0;
-            for (int i=start; i< end; i++) if (tmask(i)) valid++;
-            int order = itsOrder;
-            int harm = itsHarmonic;
-            if (float(valid) < 0.6*binWidth) {
-                if (order > harm) {
-                    order=max(0,order-1);
-                } else {
-                    harm=max(0,harm-1);
+   typedef boost::shared_ptr<ContSubtractChunk> ChunkPtr;
+   // chunks in flight: queued for prediction, being predicted or waiting to be written
+   const size_t maxInFlight = itsPredictThreads + itsQueueSize;
+   utils::BoundedQueue<ChunkPtr> toPredict(itsQueueSize);
+   // never blocks as the number of chunks in flight is limited
+   utils::BoundedQueue<ChunkPtr> predicted(maxInFlight);
+
+   std::mutex errorMutex;
+   std::exception_ptr predictError;
+   // the first prediction initialises the model gridders (including FFTs), do it one thread at a time.
+   // Convolution functions recomputed for later chunks (e.g. AWProject with a new parallactic angle or
+   // the CF cache shared with sharecf) are set up under the lock TableVisGridder::generic holds for
+   // the set up part, so the rest of the prediction can run concurrently
+   std::mutex firstPredictMutex;
+   std::vector<std::thread> threads;
+   for (unsigned int t = 0; t < itsPredictThreads; ++t) {
+        const boost::shared_ptr<IMeasurementEquation> equation =
+              boost::dynamic_pointer_cast<IMeasurementEquation>(itsThreadEquations[t]);
+        ASKAPDEBUGASSERT(equation);
+        threads.push_back(std::thread([&, equation]() {
+            try {
+                bool first = true;
+                ChunkPtr chunk;
+                while (toPredict.pop(chunk)) {
+                       if (first) {
+                           std::lock_guard<std::mutex> lock(firstPredictMutex);
+                           subtractModel(*equation, *chunk->acc, chunk->vis);
+                           first = false;
+                       } else {
+                           subtractModel(*equation, *chunk->acc, chunk->vis);
+                       }
+                       // metadata are no longer needed, release them before the chunk is written
+                       chunk->acc.reset();
+                       if (!predicted.push(chunk)) {
+                           break;
+                       }
                 }
-            }
-            uint dof = order + 1 + 2 * harm;
-            while (valid < 5 * dof) {
-                if (order > harm) {
-                    order=max(0,order-1);
-                } else {
-                    harm=max(0,harm-1);
-                }
-                dof = order + 1 + 2 * harm;
-                if (dof == 1) break;
-            }
-            // make sure fitter is ready for new fit
-            if (lastDof != dof) {
-                fitter.set(dof);
-                lastDof = dof;
-            } else {
-                fitter.reset();
-            }
-            // set the basis functions: polynomial and sin, cos terms
-            for (int i=start; i < end; i++) {
-                // we could use itsWidth instead of binWidth to keep 'frequency' the same for sine
-                float x = (i-start) / float(binWidth);
-                if (tmask(i)) {
-                    xx(0) = 1;
-                    for (int j=1; j<order+1; j++) {
-                        xx(j) = xx(j-1) * x;
-                    }
-                    for (int j=0; j<harm; j++) {
-                        xx(order+1+2*j)   = sin((j+1)*casa::C::pi*x);
-                        xx(order+1+2*j+1) = cos((j+1)*casa::C::pi*x);
-                    }
-                    fitter.makeNorm(it,1.0,casa::Double(spec(i)));
-                }
-            }
-
-            casa::uInt nr1;
-            casa::Bool ok = fitter.invert(nr1);
-            if (ok) {
-                fitter.solve(solution.data());
-                //casa::Float chisq = fitter.getChi();
-                //casa::Float sd1 = fitter.getSD();
-                //casa::cerr << "Fit="<< ok <<", rank="<<nr1<<", chisq="<<chisq<<", sd="<<sd1<<", sol"<<solution<<casa::endl;
-
-                // evaluate the solution to generate the model
-                for (int i=start; i < end; i++) {
-                    float x = (i-start) / float(binWidth);
-                    model(i) = solution(order);
-                    for (int j=order-1; j>=0; j--) {
-                        model(i) = x * model(i) + solution(j);
-                    }
-                    for (int j=0; j<harm; j++) {
-                        model(i) += solution(order+1+2*j)   * sin((j+1)*casa::C::pi*x);
-                        model(i) += solution(order+1+2*j+1) * cos((j+1)*casa::C::pi*x);
-                    }
+            } catch (...) {
+                {
+                   std::lock_guard<std::mutex> lock(errorMutex);
+                   if (!predictError) {
+                       predictError = std::current_exception();
+                   }
                 }
-            } else {
-                break; // no point iterating if the fit failed, keep last model or zero
+                toPredict.abort();
+                predicted.abort();
             }
-        }
-    }
-}
+        }));
+   }
 
-void ContSubtractParallel::subtractContFit(casacore::Cube<casacore::Complex>& vis,
-        const casacore::Cube<casacore::Bool>& flag) {
-    int nPol = vis.shape()(0);
-    int nChan = vis.shape()(1);
-    int nRow = vis.shape()(2);
-    casa::Vector<casa::Float> visreal(nChan), visimag(nChan), modelreal(nChan), modelimag(nChan);
-    casa::Vector<casa::Bool> mask(nChan);
-    for (int row=0; row<nRow; row++) {
-        for (int pol=0; pol<nPol; pol++) {
-            for (int chan=0; chan<nChan; chan++) {
-                casa::Complex v = vis(pol,chan,row);
-                visreal(chan) = casa::real(v);
-                visimag(chan) = casa::imag(v);
-                mask(chan) = !flag(pol,chan,row);
-            }
-            modelSpectrum(modelreal,visreal,mask);
-            modelSpectrum(modelimag,visimag,mask);
-            for (int chan=0; chan<nChan; chan++) {
-                vis(pol,chan,row) -= casa::Complex(modelreal(chan),modelimag(chan));
-            }
-        }
-    }
+   size_t nRead = 0;
+   size_t nWritten = 0;
+   try {
+       // chunks which have been predicted out of order
+       std::map<size_t, ChunkPtr> ready;
+       while (readIt.hasMore() || nWritten < nRead) {
+              if (readIt.hasMore() && nRead - nWritten < maxInFlight) {
+                  const ChunkPtr chunk = copyChunk(*readIt, nRead++, uvwMachineCacheSize(),
+                                                   uvwMachineCacheTolerance());
+                  readIt.next();
+                  if (!toPredict.push(chunk)) {
+                      break;
+                  }
+                  continue;
+              }
+              ChunkPtr chunk;
+              if (!predicted.pop(chunk)) {
+                  break;
+              }
+              ready[chunk->index] = chunk;
+              for (std::map<size_t, ChunkPtr>::iterator ci = ready.find(nWritten); ci != ready.end();
+                   ci = ready.find(nWritten)) {
+                   ASKAPCHECK(writeIt.hasMore(), "Write iterator has reached the end of the data prematurely");
+                   casacore::Cube<casacore::Complex> &vis = writeIt->rwVisibility();
+                   ASKAPCHECK(vis.shape().isEqual(ci->second->vis.shape()), "Chunk "<<nWritten<<
+                              " has changed its shape from "<<ci->second->vis.shape()<<" to "<<vis.shape());
+                   vis = ci->second->vis;
+                   writeIt.next();
+                   ready.erase(ci);
+                   ++nWritten;
+              }
+       }
+       toPredict.close();
+   } catch (...) {
+       toPredict.abort();
+       predicted.abort();
+       for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it) {
+            it->join();
+       }
+       throw;
+   }
+   for (std::vector<std::thread>::iterator it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+   }
+   if (predictError) {
+       std::rethrow_exception(predictError);
+   }
+   ASKAPCHECK(nWritten == nRead, "Only "<<nWritten<<" chunks out of "<<nRead<<" have been processed");
+   ASKAPLOG_DEBUG_STR(logger, "Processed "<<nRead<<" chunks in "<<itsPredictThreads<<" prediction thread(s)");
 }
 
 /// @brief perform the subtraction for the given dataset
@@ -396,20 +422,15 @@ void ContSubtractParallel::calcOne(const std::string &ms)
    conv->setFrequencyFrame(getFreqRefFrame(), "Hz");
    conv->setDirectionFrame(casacore::MDirection::Ref(casacore::MDirection::J2000));
    IDataSharedIter it=ds.createIterator(sel, conv);
-   for (; it.hasMore(); it.next()) {
-        // iteration over the dataset
-        MemBufferDataAccessor acc(*it);
-        acc.rwVisibility().set(0.);
-        accessorBasedEquation->predict(acc);
-        const casacore::Cube<casacore::Complex>& model = acc.visibility();
-        casacore::Cube<casacore::Complex>& vis = it->rwVisibility();
-        ASKAPDEBUGASSERT(model.nrow() == vis.nrow());
-        ASKAPDEBUGASSERT(model.ncolumn() == vis.ncolumn());
-        ASKAPDEBUGASSERT(model.nplane() == vis.nplane());
-        vis -= model;
-        if (itsDoUVlin) {
-            subtractContFit(vis,acc.flag());
-        }
+   if (itsPredictThreads > 0) {
+       // the second iterator goes over the same selection and lags behind the first one
+       subtractPipelined(it, ds.createIterator(sel, conv));
+   } else {
+       for (; it.hasMore(); it.next()) {
+            // iteration over the dataset
+            MemBufferDataAccessor acc(*it);
+            subtractModel(*accessorBasedEquation, acc, it->rwVisibility());
+       }
    }
 
    ASKAPLOG_INFO_STR(logger, "Finished continuum subtraction for "<< ms << " in "<< timer.real()
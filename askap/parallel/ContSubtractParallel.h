@@ -33,6 +33,17 @@
 // ASKAPsoft includes
 #include <Common/ParameterSet.h>
 #include <askap/parallel/MEParallelApp.h>
+#include <askap/parallel/UVLinFitter.h>
+#include <askap/measurementequation/IMeasurementEquation.h>
+#include <askap/dataaccess/SharedIter.h>
+#include <askap/dataaccess/IDataIterator.h>
+#include <askap/scimath/fitting/Equation.h>
+
+// boost includes
+#include <boost/shared_ptr.hpp>
+
+// std includes
+#include <vector>
 
 namespace askap {
 
@@ -40,7 +51,12 @@ namespace synthesis {
 
 /// @brief parallel helper for continuum subtraction
 /// @details This class does the core operation to subtract continuum by doing visibility
-/// prediction from the given model in parallel.
+/// prediction from the given model in parallel. Within each worker, reading and writing of
+/// the data can be overlapped with prediction, which runs in a number of threads
+/// (parset parameters predictthreads and queuesize). The default, predictthreads=0,
+/// gives the original synchronous loop. Prediction threads rely on TableVisGridder
+/// serialising the set up of convolution functions, which may use FFTs and the
+/// static CF cache.
 /// @ingroup parallel
 class ContSubtractParallel : public MEParallelApp
 {
@@ -75,6 +91,13 @@ public:
    /// @details This method initialises measurement equation
    void initMeasurementEquation();
 
+   /// @brief create measurement equation
+   /// @details This method builds a new accessor-based measurement equation for the current model.
+   /// It is used to set up the main equation as well as independent equations for
+   /// each prediction thread.
+   /// @return shared pointer to the new equation
+   scimath::Equation::ShPtr createMeasurementEquation() const;
+
    /// @brief perform the subtraction for the given dataset
    /// @details This method iterates over the given dataset, predicts visibilities according to the
    /// model and subtracts these model visibilities from the original visibilities in the dataset.
@@ -83,6 +106,23 @@ public:
    /// @param[in] ms measurement set name
    void calcOne(const std::string &ms);
 
+   /// @brief pipelined subtraction
+   /// @details The calling thread reads chunks with the first iterator and hands over their
+   /// copies to the prediction threads, which predict the model and subtract it (together
+   /// with the uvlin-like fit, if requested). The results are written back in order with the
+   /// second iterator, which follows the first one over the same selection. All table access
+   /// happens in the calling thread.
+   /// @param[in] readIt iterator used to read the data
+   /// @param[in] writeIt iterator used to write the results back
+   void subtractPipelined(const accessors::IDataSharedIter &readIt, const accessors::IDataSharedIter &writeIt);
+
+   /// @brief predict and subtract the model for one chunk
+   /// @param[in] equation measurement equation to use
+   /// @param[in] acc accessor with the chunk metadata, its visibilities are overwritten with the model
+   /// @param[in,out] vis visibilities to subtract the model from
+   void subtractModel(const IMeasurementEquation &equation, accessors::IDataAccessor &acc,
+                      casacore::Cube<casacore::Complex> &vis) const;
+
    // stubs for pure virtual methods which we don't use
    /// @brief calculate normal equations
    inline void calcNE() {}
@@ -94,42 +134,24 @@ public:
    inline void writeModel(const std::string&) {}
 
  private:
-   /// @brief generate a model spectrum by fitting the input spectrum where mask is true
-   /// @details Use polynomial fitting to derive a model spectrum from the input spectrum
-   /// @param[in] spec input spectrum
-   /// @param[in] mask input mask
-   /// @param[out] model output model spectrum
-   void modelSpectrum(casa::Vector<casa::Float> & model,
-            const casacore::Vector<casa::Float>& spec, const casa::Vector<casa::Bool>& mask);
-
-   /// @brief subtract continuum fit from the input visibilities
-   /// @details process input visibilities spectrum by spectrum, fitting and subtracting continuum
-   /// @param[in/out] vis the visibilities, will be modified on output
-   /// @param[in] flag the associated flags
-   void subtractContFit(casacore::Cube<casacore::Complex>& vis,
-            const casacore::Cube<casacore::Bool>& flag);
-
    /// @brief model is read by the master and distributed?
    /// @details Depending on the model file name (containing %w or not), the model
    /// can either be read in the master and distributed across the workers or read
    /// by workers directly. This data member is true, if the model is read by the master
    bool itsModelReadByMaster;
 
-   /// @brief do 'uvlin' like fit and subtract of residual continuum emission
-   bool itsDoUVlin;
-   /// @brief order of 'uvlin' like fit and subtract of residual continuum emission
-   int itsOrder;
-   /// @brief number of 'harmonic', i.e., sin and cos terms used in the fit
-   int itsHarmonic;
-   /// @brief number of channels to use for the fit, 0 means all
-   int itsWidth;
-   /// @brief offset of channel bins, first bin will have (width-offset) channels
-   /// @details the askap beamforming intervals can be a multiple of the basic 1 MHz
-   /// interval, but they don't necessarily start at channel 0 in the recorded spectrum
-   int itsOffset;
-   /// @brief threshold for rejection of channel from the fit, 0 mean no rejection
-   /// @details reject channels if |value - median|>threshold*sigma_IQR (robust sigma estimate)
-   float itsThreshold;
+   /// @brief 'uvlin' like fit and subtract of residual continuum emission, empty if not done
+   boost::shared_ptr<UVLinFitter> itsUVLinFitter;
+
+   /// @brief number of prediction threads, 0 means no pipelining
+   unsigned int itsPredictThreads;
+
+   /// @brief maximum number of chunks waiting for prediction
+   unsigned int itsQueueSize;
+
+   /// @brief measurement equations for each prediction thread
+   /// @details The first one is the same as itsEquation, others are created on demand
+   std::vector<scimath::Equation::ShPtr> itsThreadEquations;
 };
 
 } // namespace synthesis
@@ -44,8 +44,12 @@ namespace synthesis {
 
 /// @brief constructor, sets up communication class
 /// @param[in] comms communication object
-GroupVisAggregator::GroupVisAggregator(askap::askapparallel::AskapParallel& comms) : itsComms(comms), itsCommIndex(0)
+/// @param[in] method summation method, either "sumandbroadcast" or "ring"
+GroupVisAggregator::GroupVisAggregator(askap::askapparallel::AskapParallel& comms, const std::string &method) :
+     itsComms(comms), itsCommIndex(0), itsUseRing(method == "ring")
 {
+  ASKAPCHECK(method == "ring" || method == "sumandbroadcast", "Unknown visibility aggregation method "<<method<<
+             ", only sumandbroadcast and ring are supported");
   // we implicitly assume that casacore::Complex just has two float data members and nothing else
   ASKAPDEBUGASSERT(sizeof(casacore::Complex) == 2*sizeof(float));
   
@@ -53,7 +57,7 @@ GroupVisAggregator::GroupVisAggregator(askap::askapparallel::AskapParallel& comm
   const size_t group = itsComms.group();
   itsCommIndex = itsComms.interGroupCommIndex();
   ASKAPLOG_DEBUG_STR(logger, "  Worker group number "<<group<<" out of "<<itsComms.nGroups()<<
-  " groups, intergroup communicator index: "<<itsCommIndex);
+  " groups, intergroup communicator index: "<<itsCommIndex<<", summation method: "<<method);
 
 }  
   
@@ -65,10 +69,70 @@ void GroupVisAggregator::update(casacore::Cube<casacore::Complex> &cube) const
   ASKAPASSERT(cube.contiguousStorage());
   // not a very safe way of doing it, but this way we could benefit from MPI reduce/broadcast 
   ASKAPLOG_DEBUG_STR(logger, "about to sum over the data using comm index: "<<itsCommIndex<<" shape: "<<cube.shape()<<" (0,0,0): "<<cube(0,0,0));
-  itsComms.sumAndBroadcast((float *)cube.data(), 2 * cube.nelements(), itsCommIndex);
+  if (itsUseRing) {
+      ringAllReduce((float *)cube.data(), 2 * cube.nelements());
+  } else {
+      itsComms.sumAndBroadcast((float *)cube.data(), 2 * cube.nelements(), itsCommIndex);
+  }
   ASKAPLOG_DEBUG_STR(logger, "after mpi call, shape: "<<cube.shape()<<" (0,0,0): "<<cube(0,0,0));
 }
 
+/// @brief sum the buffer across groups with the ring all-reduce
+/// @details The buffer is split into nGroups slabs. In the reduce-scatter phase each
+/// rank passes partial sums of one slab to the next group and adds the slab received
+/// from the previous group, so after nGroups-1 steps every rank holds the full sum of one
+/// slab. In the all-gather phase the summed slabs are passed around the ring. Every slab is
+/// summed by one rank only, so all ranks end up with bitwise identical results.
+/// @param[in,out] buf buffer to sum
+/// @param[in] size number of elements in the buffer
+void GroupVisAggregator::ringAllReduce(float *buf, size_t size) const
+{
+  // ranks of the intergroup communicator follow the group numbers
+  const int nRanks = static_cast<int>(itsComms.nGroups());
+  const int rank = static_cast<int>(itsComms.group());
+  ASKAPDEBUGASSERT(rank < nRanks);
+  if (nRanks < 2) {
+      return;
+  }
+  const int next = (rank + 1) % nRanks;
+  const int prev = (rank + nRanks - 1) % nRanks;
+  // slab boundaries, the first size % nRanks slabs get an extra element
+  std::vector<size_t> offsets(nRanks + 1, 0);
+  for (int slab = 0; slab < nRanks; ++slab) {
+       offsets[slab + 1] = offsets[slab] + size / nRanks + (static_cast<size_t>(slab) < size % nRanks ? 1 : 0);
+  }
+  itsBuffer.resize(size / nRanks + 1);
+  const int tag = 0;
+  // send and receive are blocking, odd ranks receive first to break the cycle of the ring
+  const bool receiveFirst = (rank % 2 == 1);
+
+  for (int phase = 0; phase < 2; ++phase) {
+       for (int step = 0; step < nRanks - 1; ++step) {
+            // reduce-scatter: send partial sum of slab rank-step, accumulate slab rank-step-1
+            // all-gather: send complete slab rank+1-step, receive complete slab rank-step
+            const int sendSlab = (rank - step + (phase == 0 ? 0 : 1) + 2 * nRanks) % nRanks;
+            const int recvSlab = (rank - step - (phase == 0 ? 1 : 0) + 2 * nRanks) % nRanks;
+            float *sendBuf = buf + offsets[sendSlab];
+            const size_t sendSize = offsets[sendSlab + 1] - offsets[sendSlab];
+            const size_t recvSize = offsets[recvSlab + 1] - offsets[recvSlab];
+            float *recvBuf = (phase == 0 ? itsBuffer.data() : buf + offsets[recvSlab]);
+            if (receiveFirst) {
+                itsComms.receive(recvBuf, recvSize * sizeof(float), prev, tag, itsCommIndex);
+                itsComms.send(sendBuf, sendSize * sizeof(float), next, tag, itsCommIndex);
+            } else {
+                itsComms.send(sendBuf, sendSize * sizeof(float), next, tag, itsCommIndex);
+                itsComms.receive(recvBuf, recvSize * sizeof(float), prev, tag, itsCommIndex);
+            }
+            if (phase == 0) {
+                float *slab = buf + offsets[recvSlab];
+                for (size_t i = 0; i < recvSize; ++i) {
+                     slab[i] += itsBuffer[i];
+                }
+            }
+       }
+  }
+}
+
 /// @brief aggregate flag with the logical or operation
 /// @param[in,out] flag flag to reduce
 void GroupVisAggregator::aggregateFlag(bool &flag) const
@@ -83,11 +147,13 @@ void GroupVisAggregator::aggregateFlag(bool &flag) const
 /// and if yes, creates an instance of this class. Otherwise, an empty shared pointer
 /// is returned (and therefore inter-rank communication is not done)
 /// @param[in] comms communication object
+/// @param[in] method summation method, either "sumandbroadcast" or "ring"
 /// @return shared pointer to an instance of this class  
-boost::shared_ptr<GroupVisAggregator> GroupVisAggregator::create(askap::askapparallel::AskapParallel& comms)
+boost::shared_ptr<GroupVisAggregator> GroupVisAggregator::create(askap::askapparallel::AskapParallel& comms,
+                                                                 const std::string &method)
 {
   if (comms.nGroups() > 1) {
-      boost::shared_ptr<GroupVisAggregator> result(new GroupVisAggregator(comms));
+      boost::shared_ptr<GroupVisAggregator> result(new GroupVisAggregator(comms, method));
       return result;
   }
   ASKAPLOG_DEBUG_STR(logger, "There are no groupping of workers, inter-rank summation of degridded visibilities is not necessary");
@@ -37,6 +37,9 @@
 
 #include <boost/shared_ptr.hpp>
 
+#include <string>
+#include <vector>
+
 namespace askap {
 
 namespace synthesis {
@@ -45,13 +48,20 @@ namespace synthesis {
 /// @details If we distribute the model across multiple ranks we need to
 /// sum up the results of degridding before calculation of the residual.
 /// This object function can be used together with ImageFFTEquation to achieve this. 
+/// Two methods of summation are supported: reduction to the root followed by broadcast
+/// (default, "sumandbroadcast") and a ring all-reduce ("ring"), which does the reduce-scatter 
+/// step so each group owns a slab of the cube and then circulates the summed slabs. The latter 
+/// moves 2(n-1)/n of the cube through each rank (n is the number of groups) regardless of n,
+/// rather than the whole cube at each level of the reduction and broadcast trees.
 /// @ingroup parallel
 class GroupVisAggregator : public IVisCubeUpdate {
 public:
 
   /// @brief constructor, sets up communication class
   /// @param[in] comms communication object
-  explicit GroupVisAggregator(askap::askapparallel::AskapParallel& comms);
+  /// @param[in] method summation method, either "sumandbroadcast" or "ring"
+  explicit GroupVisAggregator(askap::askapparallel::AskapParallel& comms,
+                              const std::string &method = "sumandbroadcast");
   
   /// @brief update visibility cube
   /// @param[in,out] cube reference to visiblity cube to update 
@@ -66,16 +76,34 @@ public:
   /// and if yes, creates an instance of this class. Otherwise, an empty shared pointer
   /// is returned (and therefore inter-rank communication is not done)
   /// @param[in] comms communication object
+  /// @param[in] method summation method, either "sumandbroadcast" or "ring"
   /// @return shared pointer to an instance of this class  
-  static boost::shared_ptr<GroupVisAggregator> create(askap::askapparallel::AskapParallel& comms);
+  static boost::shared_ptr<GroupVisAggregator> create(askap::askapparallel::AskapParallel& comms,
+                                                      const std::string &method = "sumandbroadcast");
   
 private:
+
+  /// @brief sum the buffer across groups with the ring all-reduce
+  /// @details The buffer is split into nGroups slabs. In the reduce-scatter phase each
+  /// rank passes partial sums of one slab to the next group and adds the slab received
+  /// from the previous group, so after nGroups-1 steps every rank holds the full sum of one
+  /// slab. In the all-gather phase the summed slabs are passed around the ring. Every slab is
+  /// summed by one rank only, so all ranks end up with bitwise identical results.
+  /// @param[in,out] buf buffer to sum
+  /// @param[in] size number of elements in the buffer
+  void ringAllReduce(float *buf, size_t size) const;
   
   /// @brief class for communications
   askap::askapparallel::AskapParallel& itsComms;  
   
   /// @brief communicator index
   size_t itsCommIndex;
+
+  /// @brief true if the ring all-reduce is used instead of sum and broadcast
+  bool itsUseRing;
+
+  /// @brief receive buffer for the ring all-reduce
+  mutable std::vector<float> itsBuffer;
 };
 
 } // namespace synthesis
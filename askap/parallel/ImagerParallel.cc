@@ -477,6 +477,9 @@ namespace askap
       if ((!itsEquation)||discard)
       {
         ASKAPLOG_INFO_STR(logger, "Creating measurement equation" );
+        if (discard && parset().getBool("cachepsf", false)) {
+            ASKAPLOG_WARN_STR(logger, "cachepsf has no effect as the measurement equation is recreated for every dataset");
+        }
 
         // MEMORY_BUFFERS mode opens the MS readonly
         TableDataSource ds(ms, TableDataSource::MEMORY_BUFFERS, dataColumn());
@@ -498,10 +501,13 @@ namespace askap
             boost::shared_ptr<ImageFFTEquation> fftEquation(new ImageFFTEquation (*itsModel, it, gridder()));
             ASKAPDEBUGASSERT(fftEquation);
             fftEquation->useAlternativePSF(parset());
-            fftEquation->setVisUpdateObject(GroupVisAggregator::create(itsComms));
+            fftEquation->setVisUpdateObject(GroupVisAggregator::create(itsComms,
+                       parset().getString("visaggregation", "sumandbroadcast")));
             itsEquation = fftEquation;
         } else {
             ASKAPLOG_INFO_STR(logger, "Calibration will be performed using solution source");
+            // the PSF depends on the calibration solution which is not tracked by the cache
+            ASKAPCHECK(!parset().getBool("cachepsf", false), "cachepsf can not be used when calibration is applied");
             boost::shared_ptr<ICalibrationApplicator> calME(new CalibrationApplicatorME(itsSolutionSource));
             // fine tune parameters
             ASKAPDEBUGASSERT(calME);
@@ -514,7 +520,8 @@ namespace askap
                           new ImageFFTEquation (*itsModel, calIter, gridder()));
             ASKAPDEBUGASSERT(fftEquation);
             fftEquation->useAlternativePSF(parset());
-            fftEquation->setVisUpdateObject(GroupVisAggregator::create(itsComms));
+            fftEquation->setVisUpdateObject(GroupVisAggregator::create(itsComms,
+                       parset().getString("visaggregation", "sumandbroadcast")));
             itsEquation = fftEquation;
         }
       }
@@ -39,6 +39,7 @@
 
 // System includes
 #include <cmath>
+#include <fstream>
 
 // Askapsoft includes
 #include <askap/askap/AskapLogging.h>
@@ -55,6 +56,8 @@
 #include <askap/scimath/fitting/ImagingNormalEquations.h>
 #include <askap/scimath/fitting/GenericNormalEquations.h>
 #include <askap/profile/AskapProfiler.h>
+#include <askap/utils/MetricsRegistry.h>
+#include <askap/askap/AskapUtil.h>
 #include <casacore/casa/OS/Timer.h>
 
 ASKAP_LOGGER(logger, ".parallel");
@@ -67,7 +70,7 @@ namespace askap {
 namespace synthesis {
 
 MEParallel::MEParallel(askap::askapparallel::AskapParallel& comms, const LOFAR::ParameterSet& parset, bool useFloat) :
-        SynParallel(comms, parset, useFloat)
+        SynParallel(comms, parset, useFloat), itsMetricsWritten(false)
 {
     itsSolver = Solver::ShPtr(new Solver);
     itsNe = ImagingNormalEquations::ShPtr(new ImagingNormalEquations(*itsModel));
@@ -168,6 +171,7 @@ void MEParallel::receiveNE()
  */
 void MEParallel::reduceNE(askap::scimath::INormalEquations::ShPtr ne)
 {
+    utils::MetricsTimer metricsTimer("reduce.time");
     // I have changed this tree to have nGroup branches. In other words this is
     // nGroup binary trees
 
@@ -277,6 +281,7 @@ void MEParallel::sendNormalEquations(const askap::scimath::INormalEquations::ShP
     out << itsComms.rank() << *ne;
     out.putEnd();
     bobmw.flush();
+    utils::MetricsRegistry::instance().add("reduce.send.time", timer.real());
     ASKAPLOG_INFO_STR(logger, "Sent normal equations to rank " << dest << " in "
             << timer.real() << " seconds ");
 }
@@ -314,6 +319,7 @@ askap::scimath::INormalEquations::ShPtr MEParallel::receiveNormalEquations(int s
     in >> rank >> *ne;
     in.getEnd();
     ASKAPCHECK(rank == source, "Received normal equations are from an unexpected source");
+    utils::MetricsRegistry::instance().add("reduce.receive.time", timer.real());
     ASKAPLOG_INFO_STR(logger, "Received normal equations from rank " << source
             << " after " << timer.real() << " seconds");
 
@@ -324,5 +330,107 @@ void MEParallel::writeModel(const std::string &)
 {
 }
 
+/// @details Metrics accumulated by this rank since the previous call are taken from the
+/// registry and appended to <metrics.file>.rank<N>.json (or .csv). In the parallel case workers
+/// send their metrics to the master, which writes the cluster-wide summary to
+/// <metrics.file>.summary.json (or .csv). For each metric the summary has the total over all
+/// ranks and, as separate entries with the .rankmax and .rankmaxid suffixes, the largest
+/// per-rank total and the rank which has it. Nothing is done unless metrics.file is defined.
+/// This method has to be called by all ranks.
+void MEParallel::writeMetrics(int cycle)
+{
+    ASKAPTRACE("MEParallel::writeMetrics");
+    if (!parset().isDefined("metrics.file")) {
+        return;
+    }
+    const std::string fileName = parset().getString("metrics.file");
+    const std::string format = parset().getString("metrics.format", "json");
+    ASKAPCHECK(format == "json" || format == "csv", "metrics.format is supposed to be either json or csv, you have "<<
+               format);
+    const bool firstCall = !itsMetricsWritten;
+    itsMetricsWritten = true;
+
+    const utils::MetricsRegistry::MetricMap metrics = utils::MetricsRegistry::instance().take();
+    const int rank = itsComms.rank();
+    writeMetricsFile(fileName + ".rank" + utility::toString(rank) + "." + format, format, metrics, rank, cycle,
+                     firstCall);
+
+    if (itsComms.isParallel() && itsComms.isWorker()) {
+        BlobOBufMW bobmw(itsComms, 0);
+        LOFAR::BlobOStream out(bobmw);
+        out.putStart("metrics", 1);
+        out << rank << static_cast<LOFAR::uint32>(metrics.size());
+        for (utils::MetricsRegistry::MetricMap::const_iterator ci = metrics.begin(); ci != metrics.end(); ++ci) {
+             out << ci->first << ci->second.total << static_cast<double>(ci->second.count) <<
+                    ci->second.min << ci->second.max;
+        }
+        out.putEnd();
+        bobmw.flush();
+        return;
+    }
+    if (!itsComms.isMaster()) {
+        return;
+    }
+    // master: aggregate metrics from all ranks
+    utils::MetricsRegistry::MetricMap summary = metrics;
+    std::map<std::string, std::pair<double, int> > rankMax;
+    for (utils::MetricsRegistry::MetricMap::const_iterator ci = metrics.begin(); ci != metrics.end(); ++ci) {
+         rankMax[ci->first] = std::make_pair(ci->second.total, rank);
+    }
+    for (int source = 1; itsComms.isParallel() && source < itsComms.nProcs(); ++source) {
+         BlobIBufMW bibmw(itsComms, source);
+         LOFAR::BlobIStream in(bibmw);
+         const int version = in.getStart("metrics");
+         ASKAPASSERT(version == 1);
+         int sourceRank;
+         LOFAR::uint32 nMetrics;
+         in >> sourceRank >> nMetrics;
+         ASKAPCHECK(sourceRank == source, "Received metrics are from an unexpected source");
+         utils::MetricsRegistry::MetricMap received;
+         for (LOFAR::uint32 i = 0; i < nMetrics; ++i) {
+              std::string name;
+              utils::MetricsRegistry::Metric metric;
+              double count;
+              in >> name >> metric.total >> count >> metric.min >> metric.max;
+              metric.count = static_cast<unsigned long>(count);
+              received[name] = metric;
+              std::map<std::string, std::pair<double, int> >::iterator it = rankMax.find(name);
+              if (it == rankMax.end() || metric.total > it->second.first) {
+                  rankMax[name] = std::make_pair(metric.total, source);
+              }
+         }
+         in.getEnd();
+         utils::MetricsRegistry::merge(summary, received);
+    }
+    utils::MetricsRegistry::MetricMap result = summary;
+    for (std::map<std::string, std::pair<double, int> >::const_iterator ci = rankMax.begin();
+         ci != rankMax.end(); ++ci) {
+         result[ci->first + ".rankmax"].add(ci->second.first);
+         result[ci->first + ".rankmaxid"].add(ci->second.second);
+         ASKAPLOG_INFO_STR(logger, "Metric "<<ci->first<<" for cycle "<<cycle<<": total = "<<summary[ci->first].total<<
+                           ", largest on rank "<<ci->second.second<<" ("<<ci->second.first<<")");
+    }
+    writeMetricsFile(fileName + ".summary." + format, format, result, -1, cycle, firstCall);
+}
+
+/// @brief helper method to write metrics into a file
+/// @param[in] name file name
+/// @param[in] format either json or csv
+/// @param[in] metrics metrics to write
+/// @param[in] rank rank (negative value for the summary)
+/// @param[in] cycle major cycle
+/// @param[in] overwrite if true, the file is overwritten (and a header is written for csv)
+void MEParallel::writeMetricsFile(const std::string &name, const std::string &format,
+                                  const utils::MetricsRegistry::MetricMap &metrics, int rank, int cycle, bool overwrite)
+{
+    std::ofstream os(name.c_str(), overwrite ? std::ios::out : std::ios::app);
+    ASKAPCHECK(os, "Unable to open "<<name<<" to write metrics");
+    if (format == "json") {
+        utils::MetricsRegistry::writeJSON(os, metrics, rank, cycle);
+    } else {
+        utils::MetricsRegistry::writeCSV(os, metrics, rank, cycle, overwrite);
+    }
+}
+
 }
 }
@@ -38,6 +38,7 @@
 #include <askap/scimath/fitting/INormalEquations.h>
 #include <askap/scimath/fitting/Equation.h>
 #include <askap/scimath/fitting/Solver.h>
+#include <askap/utils/MetricsRegistry.h>
 
 // Loacl package includes
 #include <askap/parallel/SynParallel.h>
@@ -131,6 +132,13 @@ namespace askap
                 /// workers to the master.
                 void reduceNE(askap::scimath::INormalEquations::ShPtr ne);
 
+                /// @brief write metrics accumulated since the previous call
+                /// @details Per-rank metrics are written by every rank, the cluster-wide
+                /// summary by the master. The output is controlled by the metrics.file
+                /// and metrics.format (json or csv) parameters.
+                /// @param[in] cycle major cycle these metrics correspond to
+                void writeMetrics(int cycle);
+
 			protected:
 
                 // Point-to-point send normal equations
@@ -152,6 +160,21 @@ namespace askap
 
 				/// Holder for the equation
 				askap::scimath::Equation::ShPtr itsEquation;
+
+			private:
+                /// @brief helper method to write metrics into a file
+                /// @param[in] name file name
+                /// @param[in] format either json or csv
+                /// @param[in] metrics metrics to write
+                /// @param[in] rank rank (negative value for the summary)
+                /// @param[in] cycle major cycle
+                /// @param[in] overwrite if true, the file is overwritten (and a header is written for csv)
+                static void writeMetricsFile(const std::string &name, const std::string &format,
+                                             const utils::MetricsRegistry::MetricMap &metrics, int rank, int cycle,
+                                             bool overwrite);
+
+                /// @brief true if metrics have been written (files are overwritten on the first call)
+                bool itsMetricsWritten;
 		};
 
 	}
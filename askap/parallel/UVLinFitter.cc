@@ -0,0 +1,355 @@
+/// @file
+///
+/// UVLinFitter: 'uvlin' like fit and subtraction of residual continuum emission
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+/// @author Max Voronkov <maxim.voronkov@csiro.au>
+///
+
+#include <askap/parallel/UVLinFitter.h>
+#include <askap/askap/AskapError.h>
+
+// casa includes
+#include <casacore/casa/Arrays/ArrayMath.h>
+#include <casacore/casa/Arrays/Vector.h>
+#include <casacore/casa/BasicSL/Constants.h>
+#include <casacore/casa/Containers/Block.h>
+
+// std includes
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace askap;
+using namespace askap::synthesis;
+
+/// @brief set up the fitter
+/// @param[in] order order of the polynomial
+/// @param[in] harmonic number of 'harmonic', i.e., sin and cos terms used in the fit
+/// @param[in] width number of channels to use for the fit, 0 means all
+/// @param[in] offset offset of channel bins, first bin will have (width-offset) channels
+/// @param[in] threshold threshold for rejection of channels from the fit, 0 means no rejection
+UVLinFitter::UVLinFitter(int order, int harmonic, int width, int offset, float threshold) :
+      itsOrder(order), itsHarmonic(harmonic), itsWidth(width), itsOffset(offset), itsThreshold(threshold)
+{
+   ASKAPCHECK(order >= 0 && harmonic >= 0, "Order and number of harmonics of the continuum fit should be "
+              "non-negative, you have order="<<order<<" harmonic="<<harmonic);
+   ASKAPCHECK(width >= 0, "Width of the channel bins should be non-negative, you have "<<width);
+}
+
+/// @brief fit the continuum to a batch of spectra
+/// @details This is a batched version of the 'uvlin' like fit. For each channel bin and iteration,
+/// spectra which have the same mask (and therefore the same number of degrees of freedom) share
+/// the design matrix and its factorisation, so the least-squares problem for the whole group is
+/// solved as a single multiple right-hand side problem.
+/// @param[out] models model spectra, one row per spectrum
+/// @param[in] spectra input spectra, one row per spectrum (i.e. channel axis is the second axis)
+/// @param[in] masks input masks, true for channels to be used in the fit
+void UVLinFitter::modelSpectra(casacore::Matrix<casacore::Float> &models,
+        const casacore::Matrix<casacore::Float> &spectra, const casacore::Matrix<casacore::Bool> &masks) const
+{
+    const int nSpec = spectra.nrow();
+    const int nChan = spectra.ncolumn();
+    ASKAPDEBUGASSERT(masks.shape().isEqual(spectra.shape()));
+    models.resize(spectra.shape());
+    models = 0.f;
+    const int nParams = itsOrder + 1 + itsHarmonic * 2;
+
+    // If we are doing outlier rejection against the model iterate a few times
+    const int niter = (itsThreshold > 0 ? 3 : 1);
+    // initial mask is the data flags
+    casacore::Matrix<casacore::Bool> tmask(masks.copy());
+
+    // we are doing the fitting in channel bins
+    const int width = (itsWidth == 0 ? nChan : itsWidth);
+    casacore::Vector<casacore::Float> y(width);
+    casacore::Block<casacore::Float> tmp;
+    for (int binStart = -itsOffset; binStart < nChan; binStart += width) {
+        const int start = std::max(0, binStart);
+        const int end = std::min(binStart + width, nChan);
+        const int binWidth = end - start;
+
+        // basis functions for all parameters: polynomial and sin, cos terms
+        casacore::Matrix<casacore::Double> basis(binWidth, nParams);
+        for (int i = 0; i < binWidth; ++i) {
+             const float x = i / float(binWidth);
+             basis(i, 0) = 1;
+             for (int j = 1; j < itsOrder + 1; ++j) {
+                  basis(i, j) = basis(i, j - 1) * x;
+             }
+             for (int j = 0; j < itsHarmonic; ++j) {
+                  basis(i, itsOrder + 1 + 2 * j) = std::sin((j + 1) * casacore::C::pi * x);
+                  basis(i, itsOrder + 1 + 2 * j + 1) = std::cos((j + 1) * casacore::C::pi * x);
+             }
+        }
+
+        // spectra which still need fitting in this bin
+        std::vector<bool> active(nSpec, true);
+        for (int iter = 0; iter < niter; ++iter) {
+             // spectra grouped by the mask in this bin and the reduced order and number of harmonics
+             std::map<std::string, std::vector<int> > groups;
+             for (int s = 0; s < nSpec; ++s) {
+                  if (!active[s]) {
+                      continue;
+                  }
+                  // do thresholding of values before fitting?
+                  if (itsThreshold > 0) {
+                      // collect valid values
+                      int n = 0;
+                      for (int i = start; i < end; ++i) {
+                           if (tmask(s, i)) {
+                               y(n++) = spectra(s, i) - models(s, i);
+                           }
+                      }
+                      // work out robust sigma and median
+                      if (n > 0) {
+                          const casacore::Float q25 = casacore::fractile(y(casacore::Slice(0, n)), tmp, 0.25f, casacore::False, casacore::True);
+                          const casacore::Float q50 = casacore::fractile(y(casacore::Slice(0, n)), tmp, 0.50f, casacore::False, casacore::True);
+                          const casacore::Float q75 = casacore::fractile(y(casacore::Slice(0, n)), tmp, 0.75f, casacore::False, casacore::True);
+                          const casacore::Float sigma = (q75 - q25) / 1.35; // robust sigma estimate
+                          // flag outliers
+                          int count = 0;
+                          for (int i = start; i < end; ++i) {
+                               tmask(s, i) = masks(s, i) &&
+                                      !(std::abs((spectra(s, i) - models(s, i)) - q50) > itsThreshold * sigma);
+                               if (masks(s, i) && !tmask(s, i)) {
+                                   ++count;
+                               }
+                          }
+                          if (iter > 0 && count == 0) {
+                              // no further change expected
+                              active[s] = false;
+                              continue;
+                          }
+                      }
+                  }
+
+                  // We may need to limit #degrees of freedom (like miriad uvlin) if there are large gaps.
+                  // Higher orders blow up quicker for given gap size; order<=1 is safest with large gaps.
+                  // If valid channels < 60% -> reduce #dof, if valid channels < 5*(#dof) -> reduce dof
+                  int valid = 0;
+                  for (int i = start; i < end; ++i) {
+                       if (tmask(s, i)) {
+                           ++valid;
+                       }
+                  }
+                  int order = itsOrder;
+                  int harm = itsHarmonic;
+                  if (float(valid) < 0.6 * binWidth) {
+                      if (order > harm) {
+                          order = std::max(0, order - 1);
+                      } else {
+                          harm = std::max(0, harm - 1);
+                      }
+                  }
+                  int dof = order + 1 + 2 * harm;
+                  while (valid < 5 * dof) {
+                      if (order > harm) {
+                          order = std::max(0, order - 1);
+                      } else {
+                          harm = std::max(0, harm - 1);
+                      }
+                      dof = order + 1 + 2 * harm;
+                      if (dof == 1) break;
+                  }
+                  std::string key(2 + binWidth, '0');
+                  key[0] = char(order);
+                  key[1] = char(harm);
+                  for (int i = start; i < end; ++i) {
+                       if (tmask(s, i)) {
+                           key[2 + i - start] = '1';
+                       }
+                  }
+                  groups[key].push_back(s);
+             }
+             if (groups.empty()) {
+                 break;
+             }
+
+             for (std::map<std::string, std::vector<int> >::const_iterator ci = groups.begin();
+                  ci != groups.end(); ++ci) {
+                  const std::string &key = ci->first;
+                  const std::vector<int> &members = ci->second;
+                  const int order = key[0];
+                  const int harm = key[1];
+                  // columns of the basis used for this group
+                  std::vector<int> cols;
+                  for (int j = 0; j < order + 1; ++j) {
+                       cols.push_back(j);
+                  }
+                  for (int j = 0; j < harm; ++j) {
+                       cols.push_back(itsOrder + 1 + 2 * j);
+                       cols.push_back(itsOrder + 1 + 2 * j + 1);
+                  }
+                  const int dof = cols.size();
+                  const int m = members.size();
+
+                  // normal matrix shared by all spectra of the group and the right-hand sides
+                  std::vector<double> normal(dof * dof, 0.);
+                  std::vector<double> rhs(dof * m, 0.);
+                  std::vector<double> a(dof);
+                  std::vector<double> yy(m);
+                  for (int i = 0; i < binWidth; ++i) {
+                       if (key[2 + i] != '1') {
+                           continue;
+                       }
+                       for (int k = 0; k < dof; ++k) {
+                            a[k] = basis(i, cols[k]);
+                       }
+                       for (int g = 0; g < m; ++g) {
+                            yy[g] = spectra(members[g], start + i);
+                       }
+                       for (int k = 0; k < dof; ++k) {
+                            for (int l = 0; l <= k; ++l) {
+                                 normal[k * dof + l] += a[k] * a[l];
+                            }
+                            double *r = &rhs[k * m];
+                            for (int g = 0; g < m; ++g) {
+                                 r[g] += a[k] * yy[g];
+                            }
+                       }
+                  }
+
+                  // Cholesky factorisation (lower triangle), fails for rank-deficient problems
+                  bool ok = true;
+                  for (int k = 0; k < dof && ok; ++k) {
+                       const double diag = normal[k * dof + k];
+                       double sum = diag;
+                       for (int l = 0; l < k; ++l) {
+                            sum -= normal[k * dof + l] * normal[k * dof + l];
+                       }
+                       if (!(sum > 1e-8 * diag)) {
+                           ok = false;
+                           break;
+                       }
+                       normal[k * dof + k] = std::sqrt(sum);
+                       for (int r = k + 1; r < dof; ++r) {
+                            double val = normal[r * dof + k];
+                            for (int l = 0; l < k; ++l) {
+                                 val -= normal[r * dof + l] * normal[k * dof + l];
+                            }
+                            normal[r * dof + k] = val / normal[k * dof + k];
+                       }
+                  }
+                  if (!ok) {
+                      // no point iterating if the fit failed, keep last model or zero
+                      for (int g = 0; g < m; ++g) {
+                           active[members[g]] = false;
+                      }
+                      continue;
+                  }
+
+                  // forward and back substitution for all right-hand sides at once
+                  for (int k = 0; k < dof; ++k) {
+                       double *r = &rhs[k * m];
+                       for (int l = 0; l < k; ++l) {
+                            const double f = normal[k * dof + l];
+                            const double *rl = &rhs[l * m];
+                            for (int g = 0; g < m; ++g) {
+                                 r[g] -= f * rl[g];
+                            }
+                       }
+                       const double d = normal[k * dof + k];
+                       for (int g = 0; g < m; ++g) {
+                            r[g] /= d;
+                       }
+                  }
+                  for (int k = dof - 1; k >= 0; --k) {
+                       double *r = &rhs[k * m];
+                       for (int l = k + 1; l < dof; ++l) {
+                            const double f = normal[l * dof + k];
+                            const double *rl = &rhs[l * m];
+                            for (int g = 0; g < m; ++g) {
+                                 r[g] -= f * rl[g];
+                            }
+                       }
+                       const double d = normal[k * dof + k];
+                       for (int g = 0; g < m; ++g) {
+                            r[g] /= d;
+                       }
+                  }
+
+                  // evaluate the solution to generate the model
+                  for (int i = 0; i < binWidth; ++i) {
+                       for (int k = 0; k < dof; ++k) {
+                            a[k] = basis(i, cols[k]);
+                       }
+                       for (int g = 0; g < m; ++g) {
+                            double value = 0.;
+                            for (int k = 0; k < dof; ++k) {
+                                 value += a[k] * rhs[k * m + g];
+                            }
+                            models(members[g], start + i) = value;
+                       }
+                  }
+             }
+        }
+    }
+}
+
+/// @brief subtract continuum fit from the input visibilities
+/// @details Real and imaginary parts of all polarisations of a batch of rows are fitted together.
+/// @param[in,out] vis the visibilities, will be modified on output
+/// @param[in] flag the associated flags
+void UVLinFitter::subtractContFit(casacore::Cube<casacore::Complex>& vis,
+        const casacore::Cube<casacore::Bool>& flag) const {
+    const int nPol = vis.shape()(0);
+    const int nChan = vis.shape()(1);
+    const int nRow = vis.shape()(2);
+    // rows fitted together, real and imaginary parts of all polarisations are separate spectra
+    const int rowsPerBatch = 16;
+    const int nBatch = (nRow + rowsPerBatch - 1) / rowsPerBatch;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int batch = 0; batch < nBatch; ++batch) {
+         const int firstRow = batch * rowsPerBatch;
+         const int nBatchRows = std::min(rowsPerBatch, nRow - firstRow);
+         const int nSpec = 2 * nPol * nBatchRows;
+         casacore::Matrix<casacore::Float> spectra(nSpec, nChan);
+         casacore::Matrix<casacore::Bool> masks(nSpec, nChan);
+         for (int chan = 0; chan < nChan; ++chan) {
+              for (int row = 0; row < nBatchRows; ++row) {
+                   for (int pol = 0; pol < nPol; ++pol) {
+                        const int s = 2 * (row * nPol + pol);
+                        const casacore::Complex v = vis(pol, chan, firstRow + row);
+                        spectra(s, chan) = casacore::real(v);
+                        spectra(s + 1, chan) = casacore::imag(v);
+                        masks(s, chan) = masks(s + 1, chan) = !flag(pol, chan, firstRow + row);
+                   }
+              }
+         }
+         casacore::Matrix<casacore::Float> models;
+         modelSpectra(models, spectra, masks);
+         for (int chan = 0; chan < nChan; ++chan) {
+              for (int row = 0; row < nBatchRows; ++row) {
+                   for (int pol = 0; pol < nPol; ++pol) {
+                        const int s = 2 * (row * nPol + pol);
+                        vis(pol, chan, firstRow + row) -= casacore::Complex(models(s, chan), models(s + 1, chan));
+                   }
+              }
+         }
+    }
+}
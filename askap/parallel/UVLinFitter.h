@@ -0,0 +1,97 @@
+/// @file
+///
+/// UVLinFitter: 'uvlin' like fit and subtraction of residual continuum emission
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+/// @author Max Voronkov <maxim.voronkov@csiro.au>
+///
+
+#ifndef ASKAP_SYNTHESIS_UVLIN_FITTER_H
+#define ASKAP_SYNTHESIS_UVLIN_FITTER_H
+
+// casa includes
+#include <casacore/casa/Arrays/Matrix.h>
+#include <casacore/casa/Arrays/Cube.h>
+#include <casacore/casa/BasicSL/Complex.h>
+
+namespace askap {
+
+namespace synthesis {
+
+/// @brief 'uvlin' like fit and subtraction of residual continuum emission
+/// @details Each spectrum is fitted in channel bins by a polynomial and a number of sine and cosine
+/// terms, the number of degrees of freedom is reduced if the mask has large gaps (like miriad
+/// uvlin). Outliers can be rejected against the model in a few iterations. Spectra with the same
+/// mask are solved for together via a shared Cholesky factorisation of the normal matrix. This
+/// class is used by ContSubtractParallel and has no other state than the fit parameters.
+/// @ingroup parallel
+class UVLinFitter
+{
+public:
+   /// @brief set up the fitter
+   /// @param[in] order order of the polynomial
+   /// @param[in] harmonic number of 'harmonic', i.e., sin and cos terms used in the fit
+   /// @param[in] width number of channels to use for the fit, 0 means all
+   /// @param[in] offset offset of channel bins, first bin will have (width-offset) channels
+   /// @param[in] threshold threshold for rejection of channels from the fit, 0 means no rejection
+   UVLinFitter(int order, int harmonic, int width, int offset, float threshold);
+
+   /// @brief generate model spectra by fitting the input spectra where mask is true
+   /// @details Use polynomial fitting to derive model spectra from the input spectra. Spectra with
+   /// the same mask share the design matrix and are solved for together.
+   /// @param[out] models output model spectra, one row per spectrum
+   /// @param[in] spectra input spectra, one row per spectrum
+   /// @param[in] masks input masks, true for channels used in the fit
+   void modelSpectra(casacore::Matrix<casacore::Float> &models,
+            const casacore::Matrix<casacore::Float> &spectra, const casacore::Matrix<casacore::Bool> &masks) const;
+
+   /// @brief subtract continuum fit from the input visibilities
+   /// @details process input visibilities in batches of rows (in parallel if OpenMP is enabled),
+   /// fitting and subtracting continuum
+   /// @param[in,out] vis the visibilities, will be modified on output
+   /// @param[in] flag the associated flags
+   void subtractContFit(casacore::Cube<casacore::Complex>& vis,
+            const casacore::Cube<casacore::Bool>& flag) const;
+
+private:
+   /// @brief order of 'uvlin' like fit and subtract of residual continuum emission
+   int itsOrder;
+   /// @brief number of 'harmonic', i.e., sin and cos terms used in the fit
+   int itsHarmonic;
+   /// @brief number of channels to use for the fit, 0 means all
+   int itsWidth;
+   /// @brief offset of channel bins, first bin will have (width-offset) channels
+   /// @details the askap beamforming intervals can be a multiple of the basic 1 MHz
+   /// interval, but they don't necessarily start at channel 0 in the recorded spectrum
+   int itsOffset;
+   /// @brief threshold for rejection of channel from the fit, 0 mean no rejection
+   /// @details reject channels if |value - median|>threshold*sigma_IQR (robust sigma estimate)
+   float itsThreshold;
+};
+
+} // namespace synthesis
+
+} // namespace askap
+
+#endif // #ifndef ASKAP_SYNTHESIS_UVLIN_FITTER_H
@@ -89,6 +89,10 @@ ASKAP_LOGGER(logger, ".parallel");
 #include <casacore/ms/MeasurementSets/MSIter.h>
 //
 
+// std includes
+#include <vector>
+#include <algorithm>
+
 using namespace casa;
 
 namespace askap {
@@ -861,11 +865,76 @@ void Simulator::observe(const casacore::String& sourceName,
     ASKAPLOG_INFO_STR(logger, "Adding " << nNewRows << " rows");
     ms_p->addRow(nNewRows);
 
-    Matrix<Complex> data(nCorr, nChan);
-    data.set(Complex(0.0));
+    // Baselines in the order they are written for every feed and integration
+    std::vector<Int> blAnt1;
+    std::vector<Int> blAnt2;
+    blAnt1.reserve(nBaselines);
+    blAnt2.reserve(nBaselines);
+    for (Int ant1 = 0; ant1 < nAnt; ant1++) {
+        const Int startAnt2 = autoCorrelationWt_p > 0.0 ? ant1 : ant1 + 1;
+        for (Int ant2 = startAnt2; ant2 < nAnt; ant2++) {
+            blAnt1.push_back(ant1);
+            blAnt2.push_back(ant2);
+        }
+    }
+    ASKAPDEBUGASSERT(Int(blAnt1.size()) == nBaselines);
+
+    // Weights and sigmas only depend on the baseline
+    if (itsRelAntennaWeight.nelements() > 0) {
+        ASKAPCHECK(nAnt <= casacore::Int(itsRelAntennaWeight.nelements()), "encountered antenna index "<<nAnt - 1<<
+                   " which is beyond the array of Tsys and/or efficiencies (variable efficiency case)");
+    }
+    const double diamMax2 = square(max(antDiam));
+    Vector<Float> blWeight(nBaselines);
+    Vector<Float> blSigma(nBaselines);
+    for (Int bl = 0; bl < nBaselines; bl++) {
+        const Int ant1 = blAnt1[bl];
+        const Int ant2 = blAnt2[bl];
+        // case with variable Tsys/efficiency
+        double noiseRMS = itsNoiseRMS;
+        if (itsRelAntennaWeight.nelements() > 0) {
+            noiseRMS *= sqrt(itsRelAntennaWeight[ant1]*itsRelAntennaWeight[ant2]);
+        }
+
+        // Deal with differing diameter case
+        const Float sigma1 = diamMax2 / (antDiam(ant1) * antDiam(ant2)) * noiseRMS;
+        Float wt = 1 / square(sigma1);
+
+        if (ant1 == ant2) {
+            wt *= autoCorrelationWt_p;
+        }
+        blWeight(bl) = wt;
+        blSigma(bl) = sigma1;
+    }
+
+    // Whole integrations are assembled in these buffers and written with
+    // putColumnRange. DATA and FLAG are written in chunks of rows to bound
+    // the memory footprint for large numbers of channels.
+    const Int nIntRows = nBaselines * nFeed;
+    Vector<Int> antenna1(nIntRows);
+    Vector<Int> antenna2(nIntRows);
+    Vector<Int> feedId(nIntRows);
+    for (Int feed = 0; feed < nFeed; feed++) {
+        for (Int bl = 0; bl < nBaselines; bl++) {
+            antenna1(feed * nBaselines + bl) = blAnt1[bl];
+            antenna2(feed * nBaselines + bl) = blAnt2[bl];
+            feedId(feed * nBaselines + bl) = feed;
+        }
+    }
+    Matrix<Float> weight(nCorr, nIntRows);
+    Matrix<Float> sigma(nCorr, nIntRows);
+    for (Int r = 0; r < nIntRows; r++) {
+        weight.column(r) = blWeight(r % nBaselines);
+        sigma.column(r) = blSigma(r % nBaselines);
+    }
+    Matrix<double> uvw(3, nIntRows);
+    Vector<Bool> flagRow(nIntRows);
 
-    Matrix<Bool> flag(nCorr, nChan);
-    flag = False;
+    const size_t bytesPerRow = size_t(nCorr) * size_t(nChan) * (sizeof(Complex) + sizeof(Bool));
+    const Int chunkRows = std::max(Int(1), std::min(nIntRows, Int((64u << 20) / std::max(bytesPerRow, size_t(1)))));
+    Cube<Complex> data(nCorr, nChan, chunkRows);
+    data.set(Complex(0.0));
+    Cube<Bool> flag(nCorr, nChan, chunkRows);
 
     ASKAPLOG_INFO_STR(logger, "Calculating uvw coordinates for " << nIntegrations << " integrations");
 
@@ -889,14 +958,12 @@ void Simulator::observe(const casacore::String& sourceName,
         const MDirection fc = msc.field().phaseDirMeas(baseFieldID);
         msd.setFieldCenter(fc);
         msd.setAntenna(0); // assume for now that all par. angles are the same
+        const double pa = msd.parAngle();
 
-        Vector<Bool> isShadowed(nAnt); isShadowed.set(False);
-        Vector<Bool> isTooLow(nAnt); isTooLow.set(False);
-        double fractionBlocked1 = 0.0, fractionBlocked2 = 0.0;
-        Int startingRow = row;
-        const double diamMax2 = square(max(antDiam));
-
-        // Start of loop over feed
+        // Phase centres of all feeds (MSDerivedValues is not thread-safe, so this
+        // is done before the parallel section)
+        Vector<double> feedRA(nFeed);
+        Vector<double> feedDec(nFeed);
         for (Int feed = 0; feed < nFeed; feed++) {
             // for now assume that all feeds have the same offsets w.r.t.
             // antenna frame for all antennas
@@ -905,28 +972,12 @@ void Simulator::observe(const casacore::String& sourceName,
             // fringe stopping center could be different for different feeds
             MDirection feed_phc = fc;
 
-            // Do the first row outside the loop
-            msc.scanNumber().put(row + 1, scan);
-            msc.fieldId().put(row + 1, baseFieldID);
-            msc.dataDescId().put(row + 1, baseSpWID);
-            msc.time().put(row + 1, timeCentroid);
-            msc.timeCentroid().put(row + 1, timeCentroid);
-            msc.arrayId().put(row + 1, maxArrayId);
-            msc.processorId().put(row + 1, 0);
-            msc.exposure().put(row + 1, Tint);
-            msc.interval().put(row + 1, Tint);
-            msc.observationId().put(row + 1, maxObsId + 1);
-            msc.stateId().put(row + 1, -1);
-
             // assume also that all mounts are the same and posit. angle is the same
             if (antenna_mounts[0] == "ALT-AZ" || antenna_mounts[0] == "alt-az") {
                 // parallactic angle rotation is necessary
                 SquareMatrix<double, 2> xform(SquareMatrix<double, 2>::General);
                 // SquareMatrix' default constructor is a bit strange, we probably
                 // need to change it in the future
-
-
-                const double pa = msd.parAngle();
                 const double cpa = cos(pa);
                 const double spa = sin(pa);
                 xform(0, 0) = cpa;
@@ -938,16 +989,21 @@ void Simulator::observe(const casacore::String& sourceName,
 
             // x direction is flipped to convert az-el type frame to ra-dec
             feed_phc.shift(-beamOffset(0), beamOffset(1), True);
-            //            ASKAPLOG_DEBUG_STR(logger, "pointing/phase centre for beam="<<feed<<" is "<<
-            //                               printDirection(feed_phc.getValue())<<" offsets: "<<beamOffset(0)/casacore::C::pi*180<<" "<<
-            //                               beamOffset(1)/casacore::C::pi*180<<" mount="<<antenna_mounts[0]);
 
             // current phase center
-            const double ra = feed_phc.getAngle().getValue()(0);
-            const double dec = feed_phc.getAngle().getValue()(1);
+            feedRA(feed) = feed_phc.getAngle().getValue()(0);
+            feedDec(feed) = feed_phc.getAngle().getValue()(1);
+        }
 
+        // uvw and shadowing for all feeds and baselines
+        Matrix<Bool> shadowedPerFeed(nAnt, nFeed, False);
+        #ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+        #endif
+        for (Int feed = 0; feed < nFeed; feed++) {
             // Transformation from antenna position difference (ant2-ant1) to uvw
-            double H0 = gmst - ra, sH0 = sin(H0), cH0 = cos(H0), sd = sin(dec), cd = cos(dec);
+            const double H0 = gmst - feedRA(feed), sH0 = sin(H0), cH0 = cos(H0);
+            const double sd = sin(feedDec(feed)), cd = cos(feedDec(feed));
             Matrix<double> trans(3, 3, 0);
             trans(0, 0) = -sH0; trans(0, 1) = -cH0;
             trans(1, 0) = sd * cH0; trans(1, 1) = -sd * sH0; trans(1, 2) = -cd;
@@ -956,140 +1012,129 @@ void Simulator::observe(const casacore::String& sourceName,
             // Rotate antennas to correct frame
             Matrix<double> antUVW(3, nAnt);
 
-            for (Int ant1 = 0; ant1 < nAnt; ant1++)
-                antUVW.column(ant1) = product(trans, antXYZ.column(ant1));
-
-            for (Int ant1 = 0; ant1 < nAnt; ant1++) {
-                const double x1 = antUVW(0, ant1), y1 = antUVW(1, ant1), z1 = antUVW(2, ant1);
-                Int startAnt2 = ant1 + 1;
-
-                if (autoCorrelationWt_p > 0.0) startAnt2 = ant1;
-
-                for (Int ant2 = startAnt2; ant2 < nAnt; ant2++) {
-                    row++;
-
-                    msc.antenna1().put(row, ant1);
-                    msc.antenna2().put(row, ant2);
-                    msc.feed1().put(row, feed);
-                    msc.feed2().put(row, feed);
-
-                    const double x2 = antUVW(0, ant2), y2 = antUVW(1, ant2), z2 = antUVW(2, ant2);
-                    Vector<double> uvwvec(3);
-                    uvwvec(0) = x2 - x1;
-                    uvwvec(1) = y2 - y1;
-                    uvwvec(2) = z2 - z1;
-                    msc.uvw().put(row, uvwvec);
-
-                    data.set(Complex(0., 0.));
-                    msc.data().put(row, data);
-                    msc.flag().put(row, flag);
-                    msc.flagRow().put(row, False);
+            for (Int ant = 0; ant < nAnt; ant++) {
+                for (Int i = 0; i < 3; i++) {
+                    antUVW(i, ant) = trans(i, 0) * antXYZ(0, ant) + trans(i, 1) * antXYZ(1, ant) +
+                                     trans(i, 2) * antXYZ(2, ant);
+                }
+            }
 
-                    if (ant1 != ant2) {
-                        blockage(fractionBlocked1, fractionBlocked2,
-                                 uvwvec, antDiam(ant1), antDiam(ant2));
+            Vector<double> uvwvec(3);
+            double fractionBlocked1 = 0.0, fractionBlocked2 = 0.0;
+            for (Int bl = 0; bl < nBaselines; bl++) {
+                const Int ant1 = blAnt1[bl];
+                const Int ant2 = blAnt2[bl];
+                const Int r = feed * nBaselines + bl;
+                for (Int i = 0; i < 3; i++) {
+                    uvw(i, r) = uvwvec(i) = antUVW(i, ant2) - antUVW(i, ant1);
+                }
 
-                        if (fractionBlocked1 > fractionBlockageLimit_p) {
-                            isShadowed(ant1) = True;
-                        }
+                if (ant1 != ant2) {
+                    blockage(fractionBlocked1, fractionBlocked2,
+                             uvwvec, antDiam(ant1), antDiam(ant2));
 
-                        if (fractionBlocked2 > fractionBlockageLimit_p) {
-                            isShadowed(ant2) = True;
-                        }
-                    }
-                    // case with variable Tsys/efficiency
-                    double noiseRMS = itsNoiseRMS;
-                    if (itsRelAntennaWeight.nelements() > 0) {
-                        ASKAPCHECK(ant1 < casacore::Int(itsRelAntennaWeight.nelements()), "encountered antenna index "<<ant1<<
-                                   " which is beyond the array of Tsys and/or efficiencies (variable efficiency case)");
-                        ASKAPCHECK(ant2 < casacore::Int(itsRelAntennaWeight.nelements()), "encountered antenna index "<<ant2<<
-                                   " which is beyond the array of Tsys and/or efficiencies (variable efficiency case)");
-                        noiseRMS *= sqrt(itsRelAntennaWeight[ant1]*itsRelAntennaWeight[ant2]);
+                    if (fractionBlocked1 > fractionBlockageLimit_p) {
+                        shadowedPerFeed(ant1, feed) = True;
                     }
 
-                    // Deal with differing diameter case
-                    const Float sigma1 = diamMax2 / (antDiam(ant1) * antDiam(ant2)) * noiseRMS;
-                    Float wt = 1 / square(sigma1);
-
-                    if (ant1 == ant2) {
-                        wt *= autoCorrelationWt_p;
+                    if (fractionBlocked2 > fractionBlockageLimit_p) {
+                        shadowedPerFeed(ant2, feed) = True;
                     }
-
-                    Vector<Float> tmp(nCorr); tmp = wt;
-                    msc.weight().put(row, tmp);
-                    tmp = sigma1;
-                    msc.sigma().put(row, tmp);
                 }
             }
+        }
 
-            // go back and flag weights based on shadowing
-            // Future option: we could increase sigma based on
-            // fraction shadowed.
-            Matrix<Bool> trueFlag(nCorr, nChan);
-            trueFlag = True;
-
-            Int reRow = startingRow;
-
-            for (Int ant1 = 0; ant1 < nAnt; ant1++) {
-                Int startAnt2 = ant1 + 1;
+        // Find antennas pointing below the elevation limit
+        Vector<Bool> isTooLow(nAnt); isTooLow.set(False);
+        Vector<double> azel(2);
 
-                if (autoCorrelationWt_p > 0.0) startAnt2 = ant1;
+        for (Int ant1 = 0; ant1 < nAnt; ant1++) {
 
-                for (Int ant2 = startAnt2; ant2 < nAnt; ant2++) {
-                    reRow++;
+            // We want to find elevation for each antenna separately (for VLBI)
+            msd.setAntenna(ant1);
+            azel = msd.azel().getAngle("rad").getValue("rad");
 
-                    if (isShadowed(ant1) || isShadowed(ant2)) {
-                        msc.flag().put(reRow, trueFlag);
-                        msc.flagRow().put(reRow, True);
-                        nShadowed++;
-                    }
-                }
+            if (azel(1) < elevationLimit_p.getValue("rad")) {
+                isTooLow(ant1) = True;
             }
 
-            // Find antennas pointing below the elevation limit
-            Vector<double> azel(2);
-
-            for (Int ant1 = 0; ant1 < nAnt; ant1++) {
-
-                // We want to find elevation for each antenna separately (for VLBI)
-                msd.setAntenna(ant1);
-                azel = msd.azel().getAngle("rad").getValue("rad");
+            if (firstTime) {
+                firstTime = False;
+                double ha1 = msd.hourAngle() * 180.0 / C::pi / 15.0;
+                ASKAPLOG_INFO_STR(logger, "Starting conditions for antenna 1: ");
+                ASKAPLOG_INFO_STR(logger, "     time = " << formatTime(Time));
+                ASKAPLOG_INFO_STR(logger, "     scan = " << scan + 1);
+                ASKAPLOG_INFO_STR(logger, "     az   = " << azel(0) * 180.0 / C::pi << " deg");
+                ASKAPLOG_INFO_STR(logger, "     el   = " << azel(1) * 180.0 / C::pi << " deg");
+                ASKAPLOG_INFO_STR(logger, "     ha   = " << ha1 << " hours");
+            }
+        }
 
-                if (azel(1) < elevationLimit_p.getValue("rad")) {
-                    isTooLow(ant1) = True;
+        // Flag baselines based on shadowing and elevation. As before, the shadowing
+        // found for a feed also applies to all later feeds of the same integration.
+        // Future option: we could increase sigma based on fraction shadowed.
+        Vector<Bool> isShadowed(nAnt); isShadowed.set(False);
+        for (Int feed = 0; feed < nFeed; feed++) {
+            for (Int ant = 0; ant < nAnt; ant++) {
+                isShadowed(ant) = isShadowed(ant) || shadowedPerFeed(ant, feed);
+            }
+            for (Int bl = 0; bl < nBaselines; bl++) {
+                const Int ant1 = blAnt1[bl];
+                const Int ant2 = blAnt2[bl];
+                const bool shadowed = isShadowed(ant1) || isShadowed(ant2);
+                const bool tooLow = isTooLow(ant1) || isTooLow(ant2);
+                if (shadowed) {
+                    nShadowed++;
                 }
-
-                if (firstTime) {
-                    firstTime = False;
-                    double ha1 = msd.hourAngle() * 180.0 / C::pi / 15.0;
-                    ASKAPLOG_INFO_STR(logger, "Starting conditions for antenna 1: ");
-                    ASKAPLOG_INFO_STR(logger, "     time = " << formatTime(Time));
-                    ASKAPLOG_INFO_STR(logger, "     scan = " << scan + 1);
-                    ASKAPLOG_INFO_STR(logger, "     az   = " << azel(0) * 180.0 / C::pi << " deg");
-                    ASKAPLOG_INFO_STR(logger, "     el   = " << azel(1) * 180.0 / C::pi << " deg");
-                    ASKAPLOG_INFO_STR(logger, "     ha   = " << ha1 << " hours");
+                if (tooLow) {
+                    nSubElevation++;
                 }
+                flagRow(feed * nBaselines + bl) = shadowed || tooLow;
             }
+        }
 
-            // Now flag all antennas pointing below the elevation limit
-            reRow = startingRow;
-
-            for (Int ant1 = 0; ant1 < nAnt; ant1++) {
-                Int startAnt2 = ant1 + 1;
-
-                if (autoCorrelationWt_p > 0.0) startAnt2 = ant1;
-
-                for (Int ant2 = startAnt2; ant2 < nAnt; ant2++) {
-                    reRow++;
-
-                    if (isTooLow(ant1) || isTooLow(ant2)) {
-                        msc.flag().put(reRow, trueFlag);
-                        msc.flagRow().put(reRow, True);
-                        nSubElevation++;
-                    }
-                }
+        // Write the whole integration
+        const Int startRow = row + 1;
+        const Slicer rows(IPosition(1, startRow), IPosition(1, nIntRows));
+        msc.scanNumber().putColumnRange(rows, Vector<Int>(nIntRows, scan));
+        msc.fieldId().putColumnRange(rows, Vector<Int>(nIntRows, baseFieldID));
+        msc.dataDescId().putColumnRange(rows, Vector<Int>(nIntRows, baseSpWID));
+        msc.time().putColumnRange(rows, Vector<double>(nIntRows, timeCentroid));
+        msc.timeCentroid().putColumnRange(rows, Vector<double>(nIntRows, timeCentroid));
+        msc.arrayId().putColumnRange(rows, Vector<Int>(nIntRows, maxArrayId));
+        msc.processorId().putColumnRange(rows, Vector<Int>(nIntRows, 0));
+        msc.exposure().putColumnRange(rows, Vector<double>(nIntRows, Tint));
+        msc.interval().putColumnRange(rows, Vector<double>(nIntRows, Tint));
+        msc.observationId().putColumnRange(rows, Vector<Int>(nIntRows, maxObsId + 1));
+        msc.stateId().putColumnRange(rows, Vector<Int>(nIntRows, -1));
+        msc.antenna1().putColumnRange(rows, antenna1);
+        msc.antenna2().putColumnRange(rows, antenna2);
+        msc.feed1().putColumnRange(rows, feedId);
+        msc.feed2().putColumnRange(rows, feedId);
+        msc.uvw().putColumnRange(rows, uvw);
+        msc.weight().putColumnRange(rows, weight);
+        msc.sigma().putColumnRange(rows, sigma);
+        msc.flagRow().putColumnRange(rows, flagRow);
+
+        for (Int chunkStart = 0; chunkStart < nIntRows; chunkStart += chunkRows) {
+            const Int nChunk = std::min(chunkRows, nIntRows - chunkStart);
+            const Slicer chunk(IPosition(1, startRow + chunkStart), IPosition(1, nChunk));
+            for (Int r = 0; r < nChunk; r++) {
+                flag.xyPlane(r) = flagRow(chunkStart + r);
             }
+            if (nChunk == chunkRows) {
+                msc.data().putColumnRange(chunk, data);
+                msc.flag().putColumnRange(chunk, flag);
+            } else {
+                const IPosition blc(3, 0, 0, 0);
+                const IPosition trc(3, nCorr - 1, nChan - 1, nChunk - 1);
+                msc.data().putColumnRange(chunk, data(blc, trc));
+                msc.flag().putColumnRange(chunk, flag(blc, trc));
+            }
+        }
+        row += nIntRows;
 
+        for (Int feed = 0; feed < nFeed; feed++) {
             Int numpointrows = nAnt;
             MSPointingColumns& pointingc = msc.pointing();
             Int numPointing = pointingc.nrow();
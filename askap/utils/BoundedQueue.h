@@ -0,0 +1,170 @@
+/// @file
+///
+/// @brief thread-safe queue with a limited capacity
+/// @details This is a simple producer/consumer queue used to build I/O pipelines
+/// where one or more threads prefetch data while another thread consumes it.
+/// The capacity bound keeps the memory footprint under control: producers block
+/// when the queue is full and consumers block when it is empty. Either side can
+/// abort the pipeline, which wakes up all waiting threads.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#ifndef ASKAP_UTILITIES_BOUNDED_QUEUE_H
+#define ASKAP_UTILITIES_BOUNDED_QUEUE_H
+
+// std
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+// boost
+#include <boost/noncopyable.hpp>
+
+// own
+#include <askap/askap/AskapError.h>
+
+namespace askap {
+
+namespace utils {
+
+/// @brief thread-safe queue with a limited capacity
+/// @details Items are passed by value, so the type is expected to be cheap to
+/// move or copy (e.g. casacore arrays which share storage on copy, or shared pointers).
+/// The queue can be closed by the producer (no more items will come, consumers
+/// drain what is left) or aborted by either side (all blocked calls return
+/// immediately with false).
+/// @ingroup utils
+template<typename T>
+class BoundedQueue : public boost::noncopyable {
+public:
+   /// @brief constructor
+   /// @param[in] capacity maximum number of items held by the queue
+   explicit BoundedQueue(size_t capacity) : itsCapacity(capacity), itsClosed(false), itsAborted(false)
+   {
+      ASKAPCHECK(capacity > 0, "Capacity of the bounded queue should be positive");
+   }
+
+   /// @brief add an item to the queue
+   /// @details Blocks while the queue is full.
+   /// @param[in] item item to add
+   /// @return false if the queue has been aborted, true otherwise
+   bool push(const T &item) {
+      std::unique_lock<std::mutex> lock(itsMutex);
+      itsNotFull.wait(lock, [this]{ return itsAborted || itsQueue.size() < itsCapacity; });
+      if (itsAborted) {
+          return false;
+      }
+      ASKAPCHECK(!itsClosed, "Attempt to push an item into a closed queue");
+      itsQueue.push_back(item);
+      lock.unlock();
+      itsNotEmpty.notify_one();
+      return true;
+   }
+
+   /// @brief extract an item from the queue
+   /// @details Blocks while the queue is empty and has not been closed.
+   /// @param[out] item extracted item
+   /// @return false if the queue has been aborted or closed and fully drained
+   bool pop(T &item) {
+      std::unique_lock<std::mutex> lock(itsMutex);
+      itsNotEmpty.wait(lock, [this]{ return itsAborted || itsClosed || !itsQueue.empty(); });
+      if (itsAborted || itsQueue.empty()) {
+          return false;
+      }
+      item = itsQueue.front();
+      itsQueue.pop_front();
+      lock.unlock();
+      itsNotFull.notify_one();
+      return true;
+   }
+
+   /// @brief signal that no more items will be pushed
+   /// @details Consumers will get the remaining items and then pop returns false
+   void close() {
+      {
+         std::lock_guard<std::mutex> lock(itsMutex);
+         itsClosed = true;
+      }
+      itsNotEmpty.notify_all();
+   }
+
+   /// @brief abort the pipeline
+   /// @details All blocked and subsequent push/pop calls return false. Any items
+   /// still in the queue are discarded.
+   void abort() {
+      {
+         std::lock_guard<std::mutex> lock(itsMutex);
+         itsAborted = true;
+         itsQueue.clear();
+      }
+      itsNotEmpty.notify_all();
+      itsNotFull.notify_all();
+   }
+
+   /// @return true if the queue has been aborted
+   bool aborted() const {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      return itsAborted;
+   }
+
+   /// @return current number of items in the queue
+   /// @note This is only a snapshot, intended for monitoring
+   size_t size() const {
+      std::lock_guard<std::mutex> lock(itsMutex);
+      return itsQueue.size();
+   }
+
+   /// @return maximum number of items the queue can hold
+   size_t capacity() const { return itsCapacity; }
+
+private:
+   /// @brief maximum number of items
+   const size_t itsCapacity;
+
+   /// @brief true if the producer has finished
+   bool itsClosed;
+
+   /// @brief true if the pipeline has been aborted
+   bool itsAborted;
+
+   /// @brief items
+   std::deque<T> itsQueue;
+
+   /// @brief synchronisation
+   mutable std::mutex itsMutex;
+
+   /// @brief condition signalled when an item is removed
+   std::condition_variable itsNotFull;
+
+   /// @brief condition signalled when an item is added or the queue is closed
+   std::condition_variable itsNotEmpty;
+};
+
+} // namespace utils
+
+} // namespace askap
+
+#endif // #ifndef ASKAP_UTILITIES_BOUNDED_QUEUE_H
+
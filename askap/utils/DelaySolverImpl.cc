@@ -42,6 +42,9 @@ ASKAP_LOGGER(logger, ".DelaySolverImpl");
 #include <set>
 #include <fstream>
 #include <iomanip>
+#include <vector>
+#include <cmath>
+#include <algorithm>
 
 using namespace askap;
 using namespace askap::utils;
@@ -54,7 +57,7 @@ using namespace askap::utils;
 /// @param[in] refAnt reference antenna index   
 DelaySolverImpl::DelaySolverImpl(double targetRes, casa::Stokes::StokesTypes pol, float ampCutoff, casa::uInt refAnt) :
    itsTargetRes(targetRes), itsPol(pol), itsAmpCutoff(ampCutoff), itsRefAnt(refAnt), itsNAvg(0u), itsDelayEstimator(targetRes),
-   itsChanToAverage(1u), itsVerbose(true)
+   itsResolution(targetRes), itsChanToAverage(1u), itsVerbose(true)
 {
   ASKAPCHECK(itsTargetRes > 0, "Target spectral resolution should be positive, you have "<<itsTargetRes<<" Hz");
 } 
@@ -129,7 +132,8 @@ void DelaySolverImpl::process(const accessors::IConstDataAccessor &acc)
        } 
        ASKAPLOG_DEBUG_STR(logger, "Averaging "<<itsChanToAverage<<" consecutive spectral channels");
        ASKAPDEBUGASSERT(itsChanToAverage > 0);
-       itsDelayEstimator.setResolution(actualRes * itsChanToAverage);
+       itsResolution = actualRes * itsChanToAverage;
+       itsDelayEstimator.setResolution(itsResolution);
        const casa::uInt targetNChan = acc.nChannel() / itsChanToAverage;
        ASKAPCHECK(targetNChan > 1, "Too few spectral channels remain after averaging: in="<<acc.nChannel()<<" out="<<targetNChan);
        itsSpcBuffer.resize(acc.nRow(), targetNChan);
@@ -182,15 +186,22 @@ void DelaySolverImpl::process(const accessors::IConstDataAccessor &acc)
    }
    
    const casa::Matrix<casa::Complex> vis = acc.visibility().xyPlane(pol2use);   
-   for (casa::uInt row = 0; row < acc.nRow(); ++row) {
+   ASKAPDEBUGASSERT(itsSpcBuffer.nrow() == acc.nRow());
+   ASKAPDEBUGASSERT(itsAvgCounts.nrow() == acc.nRow());        
+   // get approximate delays up front, rows are then accumulated independently
+   const int nRow = static_cast<int>(acc.nRow());
+   std::vector<double> approxDelays(nRow);
+   for (int row = 0; row < nRow; ++row) {
+        approxDelays[row] = delayApproximation(row);
+   }
+   #pragma omp parallel for schedule(static)
+   for (int row = 0; row < nRow; ++row) {
         const casa::Vector<casa::Complex> thisRowVis = vis.row(row);
         const casa::Vector<bool> thisRowFlags = flags.row(row);
-        ASKAPDEBUGASSERT(itsSpcBuffer.nrow() == acc.nRow());
-        ASKAPDEBUGASSERT(itsAvgCounts.nrow() == acc.nRow());        
         casa::Vector<casa::Complex> thisBufRowVis = itsSpcBuffer.row(row);
         casa::Vector<casa::uInt> thisRowCounts = itsAvgCounts.row(row);
         
-        const double thisRowApproxDelay = delayApproximation(row);        
+        const double thisRowApproxDelay = approxDelays[row];
         
         ASKAPDEBUGASSERT(thisRowVis.nelements() == thisRowFlags.nelements());
         for (casa::uInt chan = 0, index = 0; chan < thisBufRowVis.nelements(); ++chan) {
@@ -238,6 +249,66 @@ double DelaySolverImpl::delayApproximation(casa::uInt row) const
   return itsDelayApproximation[ant1] - itsDelayApproximation[ant2];
 }
 
+/// @brief estimate delay from the peak of the lag spectrum
+/// @details The spectrum is zero padded by fftPadding() times, transformed and the peak
+/// of the amplitude is interpolated with a parabola to get sub-channel precision. The sign
+/// of the delay is chosen to maximise the coherent sum of the phase-corrected spectrum, so
+/// the result doesn't depend on the sign convention of the transform. Unlike
+/// scimath::DelayEstimator, this method doesn't change the state of the object and can
+/// be called from several threads for different spectra.
+/// @param[in] spectrum averaged spectrum
+/// @param[in] resolution spectral resolution in Hz
+/// @param[in,out] server FFT server to use (one per thread)
+/// @param[out] quality quality of the estimate (amplitude of the coherent sum relative to the sum of amplitudes)
+/// @return delay in seconds
+double DelaySolverImpl::fftDelay(const casa::Vector<casa::Complex> &spectrum, double resolution,
+                                 casa::FFTServer<casa::Float, casa::Complex> &server, double &quality)
+{
+  const casa::uInt nChan = spectrum.nelements();
+  ASKAPDEBUGASSERT(nChan > 1);
+  ASKAPDEBUGASSERT(resolution != 0.);
+  const casa::uInt size = nChan * fftPadding();
+  casa::Vector<casa::Complex> lags(size, casa::Complex(0.,0.));
+  lags(casa::Slice(0, nChan)) = spectrum;
+  server.fft0(lags, true);
+
+  // peak of the amplitude
+  casa::uInt peak = 0;
+  float peakAmp = -1.;
+  for (casa::uInt i = 0; i < size; ++i) {
+       const float amp = abs(lags[i]);
+       if (amp > peakAmp) {
+           peakAmp = amp;
+           peak = i;
+       }
+  }
+  // sub-bin position of the peak
+  const double left = abs(lags[(peak + size - 1) % size]);
+  const double right = abs(lags[(peak + 1) % size]);
+  const double denom = left - 2. * peakAmp + right;
+  const double offset = (denom < 0.) ? 0.5 * (left - right) / denom : 0.;
+  double lag = double(peak) + offset;
+  if (lag > size / 2.) {
+      lag -= size;
+  }
+  const double absDelay = std::abs(lag / (double(size) * resolution));
+
+  // choose the sign which gives the largest coherent sum
+  double sumAmp = 0.;
+  casa::DComplex sumPlus(0., 0.), sumMinus(0., 0.);
+  for (casa::uInt chan = 0; chan < nChan; ++chan) {
+       const double phase = casa::C::_2pi * resolution * chan * absDelay;
+       const casa::DComplex phasor(cos(phase), sin(phase));
+       const casa::DComplex value(spectrum[chan]);
+       sumPlus += value * conj(phasor);
+       sumMinus += value * phasor;
+       sumAmp += abs(value);
+  }
+  const double best = std::max(abs(sumPlus), abs(sumMinus));
+  quality = sumAmp > 0. ? best / sumAmp : 0.;
+  return abs(sumPlus) >= abs(sumMinus) ? absDelay : -absDelay;
+}
+
 /// @brief set target resolution
 /// @details
 /// @param[in] targetRes target spectral resolution in Hz, data are averaged to match the desired resolution 
@@ -352,10 +423,15 @@ casa::Vector<double> DelaySolverImpl::solve(bool useFFT) const
   casa::Vector<double> delays(itsSpcBuffer.nrow()+1,0.);
   casa::Vector<double> quality(itsSpcBuffer.nrow(),0.);
   casa::Matrix<double> dm(delays.nelements(),nAnt,0.);
+  // average spectra of all baselines to be used
   std::ofstream os("avgspectrum.dat");
+  std::vector<int> rows2use;
+  casa::Matrix<casa::Complex> avgSpectra(itsSpcBuffer.shape());
   for (casa::uInt bsln = 0; bsln < itsSpcBuffer.nrow(); ++bsln) {
        if (rows2exclude.find(bsln) == rows2exclude.end()) {
-           casa::Vector<casa::Complex> buf = itsSpcBuffer.row(bsln).copy();
+           rows2use.push_back(bsln);
+           casa::Vector<casa::Complex> buf = avgSpectra.row(bsln);
+           buf = itsSpcBuffer.row(bsln);
            const casa::Vector<casa::uInt> thisRowCounts = itsAvgCounts.row(bsln);
            ASKAPDEBUGASSERT(buf.nelements() == thisRowCounts.nelements());           
            for (casa::uInt chan=0; chan < buf.nelements(); ++chan) {
@@ -371,23 +447,46 @@ casa::Vector<double> DelaySolverImpl::solve(bool useFFT) const
                 }
                 os<<itsAnt1IDs[bsln]<<" "<<itsAnt2IDs[bsln]<<" "<<chan<<" "<<arg(buf[chan])/casa::C::pi*180.<<std::endl;
            }
-           
-           delays[bsln] = useFFT ? itsDelayEstimator.getDelayWithFFT(buf) : itsDelayEstimator.getDelay(buf);
-           quality[bsln] = itsDelayEstimator.quality();
-           
-           // now fill the design matrix
-           const casa::uInt ant1 = itsAnt1IDs[bsln];
-           ASKAPDEBUGASSERT(ant1 < dm.ncolumn()); 
-           const casa::uInt ant2 = itsAnt2IDs[bsln];
-           ASKAPDEBUGASSERT(ant2 < dm.ncolumn());
-           ASKAPDEBUGASSERT(bsln < dm.nrow()); 
-           if (ant1 != itsRefAnt) {               
-               dm(bsln,ant1) = 1.;
+       }
+  }
+
+  // estimate delays for all baselines at once
+  const int nUsed = static_cast<int>(rows2use.size());
+  const scimath::DelayEstimator &estimator = itsDelayEstimator;
+  const double resolution = itsResolution;
+  #pragma omp parallel default(shared)
+  {
+      // FFT server and delay estimator keep state, each thread has its own copy
+      casa::FFTServer<casa::Float, casa::Complex> server;
+      scimath::DelayEstimator threadEstimator(estimator);
+
+      #pragma omp for schedule(dynamic)
+      for (int i = 0; i < nUsed; ++i) {
+           const casa::uInt bsln = rows2use[i];
+           const casa::Vector<casa::Complex> buf = avgSpectra.row(bsln);
+           if (useFFT) {
+               delays[bsln] = fftDelay(buf, resolution, server, quality[bsln]);
+           } else {
+               delays[bsln] = threadEstimator.getDelay(buf);
+               quality[bsln] = threadEstimator.quality();
            }
-           if (ant2 != itsRefAnt) {
-               dm(bsln,ant2) = -1.;
-           }              
+      }
+  }
+
+  // now fill the design matrix
+  for (std::vector<int>::const_iterator ci = rows2use.begin(); ci != rows2use.end(); ++ci) {
+       const casa::uInt bsln = *ci;
+       const casa::uInt ant1 = itsAnt1IDs[bsln];
+       ASKAPDEBUGASSERT(ant1 < dm.ncolumn()); 
+       const casa::uInt ant2 = itsAnt2IDs[bsln];
+       ASKAPDEBUGASSERT(ant2 < dm.ncolumn());
+       ASKAPDEBUGASSERT(bsln < dm.nrow()); 
+       if (ant1 != itsRefAnt) {               
+           dm(bsln,ant1) = 1.;
        }
+       if (ant2 != itsRefAnt) {
+           dm(bsln,ant2) = -1.;
+       }              
   }
   ASKAPLOG_DEBUG_STR(logger, "Delays (ns) per baseline: "<<std::setprecision(9)<<delays*1e9);
   ASKAPLOG_DEBUG_STR(logger, "Quality of delay estimate: "<<std::setprecision(3)<<quality);
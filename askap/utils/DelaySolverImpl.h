@@ -41,6 +41,7 @@
 #include <casacore/casa/Arrays/Vector.h>
 #include <casacore/casa/Arrays/Matrix.h>
 #include <casacore/casa/BasicSL/Complex.h>
+#include <casacore/scimath/Mathematics/FFTServer.h>
 
 // own
 #include <askap/dataaccess/IConstDataAccessor.h>
@@ -78,7 +79,9 @@ public:
     /// @details This method estimates delays for all baselines and then solves for
     /// antenna-based delays honouring baselines to be excluded.
     /// @param[in] useFFT if true, FFT-based delay estimator is used. It is less accurate but
-    /// is more robust for large delays and less sensitive to flagged data. 
+    /// is more robust for large delays and less sensitive to flagged data. The lag spectra
+    /// are zero padded to get sub-channel precision. Baselines are processed in parallel
+    /// if OpenMP is enabled.
     /// @return a vector with one delay per antenna (antennas are in the index-increasing order).
     casa::Vector<double> solve(bool useFFT) const; 
     
@@ -141,6 +144,24 @@ protected:
     /// @param[in] row row of interest
     double delayApproximation(casa::uInt row) const;
 
+    /// @brief estimate delay from the peak of the lag spectrum
+    /// @details The spectrum is zero padded by fftPadding() times, transformed and the peak
+    /// of the amplitude is interpolated with a parabola to get sub-channel precision. The sign
+    /// of the delay is chosen to maximise the coherent sum of the phase-corrected spectrum, so
+    /// the result doesn't depend on the sign convention of the transform. Unlike
+    /// scimath::DelayEstimator, this method doesn't change the state of the object and can
+    /// be called from several threads for different spectra.
+    /// @param[in] spectrum averaged spectrum
+    /// @param[in] resolution spectral resolution in Hz
+    /// @param[in,out] server FFT server to use (one per thread)
+    /// @param[out] quality quality of the estimate (amplitude of the coherent sum relative to the sum of amplitudes)
+    /// @return delay in seconds
+    static double fftDelay(const casa::Vector<casa::Complex> &spectrum, double resolution,
+                           casa::FFTServer<casa::Float, casa::Complex> &server, double &quality);
+
+    /// @return zero padding factor used by the FFT-based delay estimate
+    static casa::uInt fftPadding() { return 8u; }
+
         
 private:
 
@@ -180,6 +201,9 @@ private:
     
     /// @brief delay estimator
     scimath::DelayEstimator itsDelayEstimator;
+
+    /// @brief spectral resolution of the averaged spectra in Hz
+    double itsResolution;
     
     /// @brief number of spectral channels to average
     casa::uInt itsChanToAverage;
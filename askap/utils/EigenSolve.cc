@@ -40,13 +40,45 @@
 
 #include <gsl/gsl_matrix.h>
 #include <gsl/gsl_vector.h>
-#include <gsl/gsl_linalg.h>
+#include <gsl/gsl_complex_math.h>
+#include <gsl/gsl_eigen.h>
 
 using namespace casa;
 using namespace std;
 
 using namespace askap;
 
+// buffers and workspace of the Hermitian eigensolver for the given matrix size
+struct EigenSolver::Workspace {
+  explicit Workspace(size_t size) : matrix(gsl_matrix_complex_alloc(size,size)),
+        evec(gsl_matrix_complex_alloc(size,size)), eval(gsl_vector_alloc(size)),
+        work(gsl_eigen_hermv_alloc(size)), nelements(size)
+  {
+    if (matrix == NULL || evec == NULL || eval == NULL || work == NULL) {
+        release();
+        ASKAPTHROW(AskapError, "Unable to allocate eigensolver workspace for "<<size<<"x"<<size<<" matrix");
+    }
+  }
+
+  ~Workspace() { release(); }
+
+  void release() throw() {
+    if (work != NULL) gsl_eigen_hermv_free(work);
+    if (eval != NULL) gsl_vector_free(eval);
+    if (evec != NULL) gsl_matrix_complex_free(evec);
+    if (matrix != NULL) gsl_matrix_complex_free(matrix);
+    work = NULL; eval = NULL; evec = NULL; matrix = NULL;
+  }
+
+  gsl_matrix_complex *matrix;
+  gsl_matrix_complex *evec;
+  gsl_vector *eval;
+  gsl_eigen_hermv_workspace *work;
+  size_t nelements;
+};
+
+EigenSolver::EigenSolver() throw() {}
+
 // return results
 const casa::Matrix<casa::Complex>& EigenSolver::getEigenVectors() const throw()
 {
@@ -64,49 +96,43 @@ const casa::Matrix<casa::Complex>& EigenSolver::getV() const throw()
 }
 
 // solve eigenproblem and fill vec and val data members
+// The matrix is decomposed with the Hermitian eigensolver (reduction to the tridiagonal
+// form followed by the QR iterations, as in LAPACK's zheev). For a Hermitian
+// matrix with non-negative eigenvalues (e.g. the VP matrix) this is also its SVD
+// with U = V, so vecV is a copy of the eigenvectors.
 void EigenSolver::solveEigen(const casa::Matrix<casa::Complex> &in)
                                throw(casa::AipsError)
 {
-  // temporary code which works for real matrices only
-  // extra copying is happening here
   ASKAPASSERT(in.nrow() == in.ncolumn());
-  casa::uInt size = in.nrow();
-  gsl_matrix *V = gsl_matrix_alloc(size,size);
-  ASKAPDEBUGASSERT(V!=NULL);
-  
-  gsl_vector *S = gsl_vector_alloc(size);
-  gsl_matrix *A = gsl_matrix_alloc(size,size);
-  
-  for (size_t row=0; row<in.nrow();++row) {
-       for (size_t column=0; column<in.ncolumn();++column) {
-            gsl_matrix_set(A,row,column,real(in(row,column)));
-       }
+  const casa::uInt size = in.nrow();
+  ASKAPCHECK(size > 0, "Unable to solve eigenproblem for an empty matrix");
+  if (!workspace || workspace->nelements != size) {
+      workspace.reset();
+      workspace.reset(new Workspace(size));
   }
-  try {
-    ASKAPTHROW(AskapError, "scimath::SVDecomp not implemented");
-    // NOTE: The GSLSVDReplacement class was removed in this same changeset. If this
-    // code is ever to be used an alternative should be found.
-    //scimath::SVDecomp(A,V,S);
-  
-    vec.resize(in.nrow(),in.ncolumn());
-    vecV.resize(in.nrow(),in.ncolumn());
-    val.resize(size);
-     for (size_t row=0; row<in.nrow();++row) {
-          for (size_t column=0; column<in.ncolumn();++column) {
-               vec(row,column) = gsl_matrix_get(A,row,column);
-               vecV(row,column) = gsl_matrix_get(V,row,column);
-          }
-          val[row] = gsl_vector_get(S,row);
-     }
+  ASKAPDEBUGASSERT(workspace);
+
+  for (size_t row=0; row<size; ++row) {
+       for (size_t column=0; column<=row; ++column) {
+            const casa::Complex &value = in(row,column);
+            gsl_matrix_complex_set(workspace->matrix, row, column,
+                                   gsl_complex_rect(real(value), imag(value)));
+       }
   }
-  catch (...) {
-    gsl_vector_free(S);
-    gsl_matrix_free(V);
-    gsl_matrix_free(A);
-     throw;
+  const int status = gsl_eigen_hermv(workspace->matrix, workspace->eval, workspace->evec,
+                                     workspace->work);
+  ASKAPCHECK(status == 0, "Hermitian eigensolver failed, status = "<<status);
+  gsl_eigen_hermv_sort(workspace->eval, workspace->evec, GSL_EIGEN_SORT_VAL_DESC);
+
+  vec.resize(size,size);
+  val.resize(size);
+  for (size_t row=0; row<size; ++row) {
+       for (size_t column=0; column<size; ++column) {
+            const gsl_complex value = gsl_matrix_complex_get(workspace->evec, row, column);
+            vec(row,column) = casa::Complex(GSL_REAL(value), GSL_IMAG(value));
+       }
+       val[row] = gsl_vector_get(workspace->eval, row);
   }
-  
-  gsl_vector_free(S);
-  gsl_matrix_free(V);
-  gsl_matrix_free(A);
+  vecV.resize(size,size);
+  vecV = vec;
 }
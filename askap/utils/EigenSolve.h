@@ -39,17 +39,32 @@
 #include <casacore/casa/Exceptions/Error.h>
 #include <casacore/casa/BasicSL/Complex.h>
 
+#include <boost/shared_ptr.hpp>
+
 /// @brief interface to eigen problem solver
 /// @details
 ///
 /// An interface module for low-level routines to solve eigenproblem or
-/// a singular value decomposition problem
+/// a singular value decomposition problem. The input matrix is assumed to be
+/// Hermitian (only the lower triangle is used). The buffers and the workspace of the
+/// underlying solver are kept between calls, so solving a sequence of problems of the same
+/// size (e.g. a number of frequency channels) does not reallocate anything.
 class EigenSolver {
    casa::Matrix<casa::Complex> vec; // eigenvectors
    casa::Vector<casa::Double> val;  // eigenvalues
    casa::Matrix<casa::Complex> vecV; // SVD's vector V. (not V^t)
+
+   // buffers and workspace of the solver, reused if the size doesn't change
+   struct Workspace;
+   boost::shared_ptr<Workspace> workspace;
+
+   // copying would share the workspace, not supported
+   EigenSolver(const EigenSolver &);
+   EigenSolver& operator=(const EigenSolver &);
 public:
+   EigenSolver() throw();
    // solve eigenproblem and fill vec and val data members
+   // eigenvalues are sorted in the descending order, eigenvectors are in columns
    void solveEigen(const casa::Matrix<casa::Complex> &in) throw(casa::AipsError);
    // return results
    const casa::Matrix<casa::Complex>& getEigenVectors() const throw();
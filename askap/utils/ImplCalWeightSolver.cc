@@ -42,6 +42,7 @@
 #include <casacore/measures/Measures/MeasConvert.h>
 #include <casacore/casa/OS/Path.h>
 #include <casacore/casa/BasicMath/Math.h>
+#include <casacore/casa/Arrays/ArrayMath.h>
 #include <casacore/casa/Utilities/Assert.h>
 #include <askap/utils/EigenSolve.h>
 #include <askap/utils/SkyCatalogTabWriter.h>
@@ -86,6 +87,24 @@ void ImplCalWeightSolver::setVP(const casa::String &namer,
       throw AipsError("The shape of real and imagingary parts should be identical");
   if (vp_real->shape().nelements()<2) 
       throw AipsError("VP image should have at least 2 directional axes");
+
+  // keep the plane used for lookups in memory, the image is accessed once rather
+  // than for every source and feed. All other axes are taken at the first pixel.
+  const IPosition shape=vp_real->shape();
+  IPosition blc(shape.nelements(),0);
+  IPosition sliceShape(shape.nelements(),1);
+  sliceShape[0]=shape[0];
+  sliceShape[1]=shape[1];
+  const Array<Float> re=vp_real->getSlice(blc,sliceShape).reform(IPosition(2,shape[0],shape[1]));
+  const Array<Float> im=vp_imag->getSlice(blc,sliceShape).reform(IPosition(2,shape[0],shape[1]));
+  vp_plane.resize(shape[0],shape[1]);
+  makeComplex(vp_plane,re,im);
+
+  // world coordinates of the image centre, offsets are added to this position
+  IPosition cntr(shape.nelements(),0);
+  cntr[0]=shape[0]/2;
+  cntr[1]=shape[1]/2;
+  vp_real->coordinates().toWorld(vp_centre,cntr);
 }
 
 /// @brief make synthetic beam
@@ -126,7 +145,13 @@ void ImplCalWeightSolver::formVisMatrix(const Matrix<Double> &feed_offsets,
   vismatrix.resize(feed_offsets.nrow(),feed_offsets.nrow());
   vismatrix=0.;
 
-  for (uInt comp=0;comp<cl.nelements();++comp) {
+  const uInt nfeeds=vismatrix.ncolumn();
+  const uInt ncomps=cl.nelements();
+  // offsets of all sources w.r.t. all feeds (source-major), the voltage pattern
+  // is evaluated for all of them at once
+  Vector<Double> l(ncomps*nfeeds), m(ncomps*nfeeds);
+  Vector<Double> fluxes(ncomps);
+  for (uInt comp=0;comp<ncomps;++comp) {
        const SkyComponent &skc=cl.component(comp);
        if (skc.spectrum().type()!=ComponentType::CONSTANT_SPECTRUM)
 	   throw AipsError("Non-constant spectrum sources are not supported");
@@ -147,17 +172,23 @@ void ImplCalWeightSolver::formVisMatrix(const Matrix<Double> &feed_offsets,
        Flux<Double> flux=skc.flux();
        flux.convertPol(ComponentType::STOKES);
        flux.convertUnit("Jy");
-	   
-       for (uInt feed=0;feed<vismatrix.ncolumn();++feed) {
-	    Complex visbuf(1.,0.);
+       fluxes[comp]=real(flux.value()[0]);
+
+       for (uInt feed=0;feed<nfeeds;++feed) {
 	    // following formulae are approximate. We need to replace 
 	    // them with exact formulae for the angular offset of 
 	    // the source w.r.t. the appropriate feed centre
-	    Double l=l0-feed_offsets(feed,0);
-	    Double m=m0-feed_offsets(feed,1);
-	    if (!getVPValue(visbuf,l,m)) continue;
+	    l[comp*nfeeds+feed]=l0-feed_offsets(feed,0);
+	    m[comp*nfeeds+feed]=m0-feed_offsets(feed,1);
+       }
+  }
+  // sources outside the model get zero values, i.e. they don't contribute
+  Vector<Complex> vp;
+  getVPValues(vp,l,m);
 
-            
+  for (uInt feed=0;feed<nfeeds;++feed) {
+       Complex visbuf(0.,0.);
+       for (uInt comp=0;comp<ncomps;++comp) {
 	    /*  // Full interferometric visibility
 	    Double phasor=2*M_PI*(uvw[0]*l+uvw[1]*m+
 		   uvw[2]*(sqrt(1.-square(l)-square(m))-1.));
@@ -168,12 +199,11 @@ void ImplCalWeightSolver::formVisMatrix(const Matrix<Double> &feed_offsets,
 	    // assume that phase terms will be cancelled (with the help of
 	    // the dish + A^hA multiplies to the conjugate. We still need
 	    // to prove it theoretically).
-	    visbuf*=casa::Double(real(flux.value()[0]));
-
-	    for (uInt measurement=0;measurement<vismatrix.nrow();
-	         ++measurement) 
-		    vismatrix(measurement,feed)+=visbuf;
+	    visbuf+=vp[comp*nfeeds+feed]*Float(fluxes[comp]);
        }
+       for (uInt measurement=0;measurement<vismatrix.nrow();
+	    ++measurement) 
+	    vismatrix(measurement,feed)+=visbuf;
   }
 }
 
@@ -207,8 +237,15 @@ void ImplCalWeightSolver::formVPMatrix(const casa::Matrix<casa::Double> &feed_of
   vismatrix.resize(feed_offsets.nrow(),feed_offsets.nrow());
   vismatrix=0.;
 
+  const uInt nfeeds=vismatrix.nrow();
+  const uInt ncomps=cl.nelements();
+  // offsets of all sources w.r.t. all feeds (source-major), the voltage pattern
+  // is evaluated for all of them at once rather than for each pair of feeds
+  Vector<Double> l(ncomps*nfeeds), m(ncomps*nfeeds);
+  Vector<Double> fluxes(ncomps);
+
   ofstream os("comps.dat");
-  for (uInt comp=0;comp<cl.nelements();++comp) {
+  for (uInt comp=0;comp<ncomps;++comp) {
        const SkyComponent &skc=cl.component(comp);
        if (skc.spectrum().type()!=ComponentType::CONSTANT_SPECTRUM)
 	   throw AipsError("Non-constant spectrum sources are not supported");
@@ -247,29 +284,37 @@ void ImplCalWeightSolver::formVPMatrix(const casa::Matrix<casa::Double> &feed_of
        flux.convertPol(ComponentType::STOKES);
        flux.convertUnit("Jy");
        os<<setw(10)<<l0/M_PI*180*3600<<" "<<m0/M_PI*180*3600<<" "<<real(flux.value()[0])<<endl;
+       fluxes[comp]=real(flux.value()[0]);
 
        if (psctwr.get()!=NULL && real(flux.value()[0])>0.3)
            psctwr->addComponent(l0/M_PI*180.,m0/M_PI*180.,
 	                      real(flux.value()[0]),"AzEl");
-			      
-       for (uInt feed1=0;feed1<vismatrix.nrow();++feed1) {
-	    Complex visbuf1(1.,0.);
+
+       for (uInt feed=0;feed<nfeeds;++feed) {
 	    // following formulae are approximate. We need to replace 
 	    // them with exact formulae for the angular offset of 
 	    // the source w.r.t. the appropriate feed centre
-	    Double l1=l0-feed_offsets(feed1,0);
-	    Double m1=m0-feed_offsets(feed1,1);
-	    if (!getVPValue(visbuf1,l1,m1)) continue;
-	    for (uInt feed2=0;feed2<vismatrix.ncolumn();++feed2) {
-	         Complex visbuf2(1.,0.);
-                 Double l2=l0-feed_offsets(feed2,0);
-	         Double m2=m0-feed_offsets(feed2,1);
-	         if (!getVPValue(visbuf2,l2,m2)) continue;
-		 vismatrix(feed1,feed2)+=visbuf1*conj(visbuf2)*
-		                 casa::Double(real(flux.value()[0]));
+	    l[comp*nfeeds+feed]=l0-feed_offsets(feed,0);
+	    m[comp*nfeeds+feed]=m0-feed_offsets(feed,1);
+       }
+  }
+
+  // sources outside the model get zero values, i.e. they don't contribute
+  Vector<Complex> vp;
+  getVPValues(vp,l,m);
+
+  // each thread accumulates its own columns of the matrix
+  #pragma omp parallel for schedule(dynamic)
+  for (Int feed2=0;feed2<Int(nfeeds);++feed2) {
+       for (uInt comp=0;comp<ncomps;++comp) {
+	    const Complex visbuf2=conj(vp[comp*nfeeds+feed2])*Float(fluxes[comp]);
+	    if (visbuf2==Complex(0.,0.)) continue;
+	    const Complex *visbuf1=vp.data()+comp*nfeeds;
+	    for (uInt feed1=0;feed1<nfeeds;++feed1) {
+		 vismatrix(feed1,feed2)+=visbuf1[feed1]*visbuf2;
 	    }
        }
-  }  
+  }
 }
 
 // solve for a basis in the space of weights, which is best for calibration
@@ -346,26 +391,57 @@ ImplCalWeightSolver::eigenWeights(const casa::Matrix<casa::Double>
 Bool ImplCalWeightSolver::getVPValue(Complex &val, Double l, Double m) const
 	               throw(AipsError)
 {
-  Vector<Double> world(vp_real->shape().nelements()); // world coordinate
-  // centre of the vp image in pixels
-  IPosition cntr=vp_real->shape();
-  for (uInt i=0;i<cntr.nelements();++i)
-       if (i<2) cntr[i]/=2;
-       else cntr[i]=0;
-
-  // just to have something useful for degenerate axes
-  vp_real->coordinates().toWorld(world,cntr);
-  world[0]+=l; world[1]+=m;
-  Vector<Double> pixel; // offset in pixels
-  if (!vp_real->coordinates().toPixel(pixel,world))
+  Vector<Complex> buf;
+  if (!getVPValues(buf,Vector<Double>(1,l),Vector<Double>(1,m))) return False;
+  val*=buf[0];
+  return True;
+}
+
+// a batch version of getVPValue. Fills vals with the values of the Voltage
+// Pattern at the offsets (l[i],m[i]) (in radians). Offsets outside the model
+// get zero values. The coordinates are converted in one go and the lookup is
+// done in parallel in the in-memory copy of the pattern. Returns the number
+// of offsets which are within the model
+uInt ImplCalWeightSolver::getVPValues(Vector<Complex> &vals,
+          const Vector<Double> &l, const Vector<Double> &m) const
+                       throw(AipsError)
+{
+  if (vp_real==NULL || vp_imag==NULL)
+      throw AipsError("A vp image should be set before calling getVPValues");
+  ASKAPCHECK(l.nelements()==m.nelements(), "Offset vectors should have the same length, you have "<<
+             l.nelements()<<" and "<<m.nelements());
+  const uInt npoints=l.nelements();
+  vals.resize(npoints);
+  if (!npoints) return 0;
+
+  // world coordinates for all offsets, degenerate axes are at the image centre
+  Matrix<Double> world(vp_centre.nelements(),npoints);
+  for (uInt i=0;i<npoints;++i) {
+       world.column(i)=vp_centre;
+       world(0,i)+=l[i];
+       world(1,i)+=m[i];
+  }
+  Matrix<Double> pixel; // offsets in pixels
+  Vector<Bool> failures;
+  if (!vp_real->coordinates().toPixelMany(pixel,world,failures))
       throw AipsError(String("access to the real image: ")+
 		      vp_real->coordinates().errorMessage());
-  cntr[0]=Int(pixel[0]);
-  cntr[1]=Int(pixel[1]);
-  if (cntr[0]>=vp_real->shape()[0] || cntr[0]<0 ||
-      cntr[1]>=vp_real->shape()[1] || cntr[1]<0) return False;
-  val*=Complex((*vp_real)(cntr),(*vp_imag)(cntr));    
-  return True;
+
+  const Int nx=vp_plane.nrow();
+  const Int ny=vp_plane.ncolumn();
+  uInt nvalid=0;
+  #pragma omp parallel for schedule(static) reduction(+:nvalid)
+  for (Int i=0;i<Int(npoints);++i) {
+       const Int x=Int(pixel(0,i));
+       const Int y=Int(pixel(1,i));
+       if (x>=nx || x<0 || y>=ny || y<0) {
+           vals[i]=Complex(0.,0.);
+       } else {
+           vals[i]=vp_plane(x,y);
+           ++nvalid;
+       }
+  }
+  return nvalid;
 }
 
 casa::Matrix<casa::Complex>
@@ -52,6 +52,8 @@ class ImplCalWeightSolver {
                                            // and measurement (row)
     casa::ImageInterface<casa::Float> *vp_real; // voltage pattern of a single element
     casa::ImageInterface<casa::Float> *vp_imag; // voltage pattern of a single element
+    casa::Matrix<casa::Complex> vp_plane; // in-memory copy of the VP plane used by getVPValues
+    casa::Vector<casa::Double> vp_centre; // world coordinates of the VP image centre
        
 public:
     //static const double lambda=0.2;   // wavelength in metres
@@ -127,6 +129,15 @@ protected:
     // False if the requested offset lies outside the model
     casa::Bool getVPValue(casa::Complex &val, casa::Double l, casa::Double m)
                             const throw(casa::AipsError);
+
+    // a batch version of getVPValue. Fills vals with the values of the Voltage
+    // Pattern at the offsets (l[i],m[i]) (in radians). Offsets outside the model
+    // get zero values. The coordinates are converted in one go and the lookup is
+    // done in parallel in the in-memory copy of the pattern. Returns the number
+    // of offsets which are within the model
+    casa::uInt getVPValues(casa::Vector<casa::Complex> &vals,
+                const casa::Vector<casa::Double> &l,
+                const casa::Vector<casa::Double> &m) const throw(casa::AipsError);
 private:
     boost::shared_ptr<askap::synthesis::IBasicIllumination> itsIllumination;
 };
@@ -0,0 +1,165 @@
+/// @file
+///
+/// @brief process-wide registry of timers and counters
+/// @details Hot-path classes (gridders, preconditioners, deconvolvers, the reduction of
+/// normal equations) accumulate statistics like time spent or number of samples processed.
+/// Rather than writing them to the log, they publish increments into this registry under
+/// a hierarchical name (e.g. gridder.grid.time). The application takes a snapshot at the
+/// end of each major cycle, writes it as JSON or CSV and aggregates it across ranks
+/// (see MEParallel::writeMetrics).
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/utils/MetricsRegistry.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace askap {
+
+namespace utils {
+
+/// @brief empty metric
+MetricsRegistry::Metric::Metric() : total(0.), count(0), min(std::numeric_limits<double>::max()),
+      max(-std::numeric_limits<double>::max()) {}
+
+/// @brief account for a published value
+/// @param[in] value value to add
+void MetricsRegistry::Metric::add(double value)
+{
+   total += value;
+   ++count;
+   min = std::min(min, value);
+   max = std::max(max, value);
+}
+
+/// @brief merge another metric into this one
+/// @param[in] other metric to merge
+void MetricsRegistry::Metric::merge(const Metric &other)
+{
+   total += other.total;
+   count += other.count;
+   min = std::min(min, other.min);
+   max = std::max(max, other.max);
+}
+
+/// @brief access the single instance of the registry
+/// @return reference to the registry
+MetricsRegistry& MetricsRegistry::instance()
+{
+   static MetricsRegistry registry;
+   return registry;
+}
+
+/// @brief publish a value
+/// @param[in] name metric name
+/// @param[in] value time in seconds or counter increment
+void MetricsRegistry::add(const std::string &name, double value)
+{
+   std::lock_guard<std::mutex> lock(itsMutex);
+   itsMetrics[name].add(value);
+}
+
+/// @brief obtain all metrics accumulated so far
+/// @return copy of the metrics
+MetricsRegistry::MetricMap MetricsRegistry::snapshot() const
+{
+   std::lock_guard<std::mutex> lock(itsMutex);
+   return itsMetrics;
+}
+
+/// @brief obtain all metrics accumulated so far and start from scratch
+/// @return metrics accumulated since the previous call
+MetricsRegistry::MetricMap MetricsRegistry::take()
+{
+   MetricMap result;
+   std::lock_guard<std::mutex> lock(itsMutex);
+   result.swap(itsMetrics);
+   return result;
+}
+
+/// @brief remove all metrics
+void MetricsRegistry::clear()
+{
+   std::lock_guard<std::mutex> lock(itsMutex);
+   itsMetrics.clear();
+}
+
+/// @brief merge one set of metrics into another
+/// @param[in,out] to metrics to update
+/// @param[in] from metrics to merge
+void MetricsRegistry::merge(MetricMap &to, const MetricMap &from)
+{
+   for (MetricMap::const_iterator ci = from.begin(); ci != from.end(); ++ci) {
+        to[ci->first].merge(ci->second);
+   }
+}
+
+/// @brief write metrics as a single line JSON record
+/// @param[in] os output stream
+/// @param[in] metrics metrics to write
+/// @param[in] rank rank these metrics belong to (negative value means aggregated metrics)
+/// @param[in] cycle major cycle
+void MetricsRegistry::writeJSON(std::ostream &os, const MetricMap &metrics, int rank, int cycle)
+{
+   os << "{\"rank\": ";
+   if (rank < 0) {
+       os << "\"all\"";
+   } else {
+       os << rank;
+   }
+   os << ", \"cycle\": " << cycle << ", \"metrics\": {";
+   for (MetricMap::const_iterator ci = metrics.begin(); ci != metrics.end(); ++ci) {
+        os << (ci == metrics.begin() ? "" : ", ") << "\"" << ci->first << "\": {\"total\": " <<
+              ci->second.total << ", \"count\": " << ci->second.count << ", \"min\": " << ci->second.min <<
+              ", \"max\": " << ci->second.max << "}";
+   }
+   os << "}}" << std::endl;
+}
+
+/// @brief write metrics as CSV, one line per metric
+/// @param[in] os output stream
+/// @param[in] metrics metrics to write
+/// @param[in] rank rank these metrics belong to (negative value means aggregated metrics)
+/// @param[in] cycle major cycle
+/// @param[in] header if true, the header line is written first
+void MetricsRegistry::writeCSV(std::ostream &os, const MetricMap &metrics, int rank, int cycle, bool header)
+{
+   if (header) {
+       os << "rank,cycle,name,total,count,min,max" << std::endl;
+   }
+   for (MetricMap::const_iterator ci = metrics.begin(); ci != metrics.end(); ++ci) {
+        if (rank < 0) {
+            os << "all";
+        } else {
+            os << rank;
+        }
+        os << "," << cycle << "," << ci->first << "," << ci->second.total << "," << ci->second.count << "," <<
+              ci->second.min << "," << ci->second.max << std::endl;
+   }
+}
+
+} // namespace utils
+
+} // namespace askap
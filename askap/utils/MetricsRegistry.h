@@ -0,0 +1,167 @@
+/// @file
+///
+/// @brief process-wide registry of timers and counters
+/// @details Hot-path classes (gridders, preconditioners, deconvolvers, the reduction of
+/// normal equations) accumulate statistics like time spent or number of samples processed.
+/// Rather than writing them to the log, they publish increments into this registry under
+/// a hierarchical name (e.g. gridder.grid.time). The application takes a snapshot at the
+/// end of each major cycle, writes it as JSON or CSV and aggregates it across ranks
+/// (see MEParallel::writeMetrics).
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#ifndef ASKAP_UTILITIES_METRICS_REGISTRY_H
+#define ASKAP_UTILITIES_METRICS_REGISTRY_H
+
+// std
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+// boost
+#include <boost/noncopyable.hpp>
+
+// casa
+#include <casacore/casa/OS/Timer.h>
+
+namespace askap {
+
+namespace utils {
+
+/// @brief process-wide registry of timers and counters
+/// @details Each metric is identified by name and accumulates published values: the total,
+/// the number of publications and the smallest and largest published value. Timers publish
+/// elapsed time in seconds, counters publish increments. All methods are thread-safe, but
+/// publication involves a lock, so it is expected to happen once per chunk of data or per call
+/// of a heavy method rather than per sample.
+/// @ingroup utils
+class MetricsRegistry : public boost::noncopyable {
+public:
+   /// @brief accumulated value of a single metric
+   struct Metric {
+      /// @brief empty metric
+      Metric();
+
+      /// @brief account for a published value
+      /// @param[in] value value to add
+      void add(double value);
+
+      /// @brief merge another metric into this one
+      /// @param[in] other metric to merge
+      void merge(const Metric &other);
+
+      /// @brief sum of all published values
+      double total;
+
+      /// @brief number of publications
+      unsigned long count;
+
+      /// @brief smallest published value
+      double min;
+
+      /// @brief largest published value
+      double max;
+   };
+
+   /// @brief metrics indexed by name
+   typedef std::map<std::string, Metric> MetricMap;
+
+   /// @brief access the single instance of the registry
+   /// @return reference to the registry
+   static MetricsRegistry& instance();
+
+   /// @brief publish a value
+   /// @param[in] name metric name
+   /// @param[in] value time in seconds or counter increment
+   void add(const std::string &name, double value);
+
+   /// @brief obtain all metrics accumulated so far
+   /// @return copy of the metrics
+   MetricMap snapshot() const;
+
+   /// @brief obtain all metrics accumulated so far and start from scratch
+   /// @details This is used for per-cycle reports
+   /// @return metrics accumulated since the previous call
+   MetricMap take();
+
+   /// @brief remove all metrics
+   void clear();
+
+   /// @brief merge one set of metrics into another
+   /// @param[in,out] to metrics to update
+   /// @param[in] from metrics to merge
+   static void merge(MetricMap &to, const MetricMap &from);
+
+   /// @brief write metrics as a single line JSON record
+   /// @param[in] os output stream
+   /// @param[in] metrics metrics to write
+   /// @param[in] rank rank these metrics belong to (negative value means aggregated metrics)
+   /// @param[in] cycle major cycle
+   static void writeJSON(std::ostream &os, const MetricMap &metrics, int rank, int cycle);
+
+   /// @brief write metrics as CSV, one line per metric
+   /// @param[in] os output stream
+   /// @param[in] metrics metrics to write
+   /// @param[in] rank rank these metrics belong to (negative value means aggregated metrics)
+   /// @param[in] cycle major cycle
+   /// @param[in] header if true, the header line is written first
+   static void writeCSV(std::ostream &os, const MetricMap &metrics, int rank, int cycle, bool header);
+
+private:
+   /// @brief the registry is only accessed via instance
+   MetricsRegistry() {}
+
+   /// @brief accumulated metrics
+   MetricMap itsMetrics;
+
+   /// @brief synchronisation of publications
+   mutable std::mutex itsMutex;
+};
+
+/// @brief helper to time a block of code
+/// @details Elapsed wall time is published into the registry when the object goes out of scope
+/// @ingroup utils
+class MetricsTimer : public boost::noncopyable {
+public:
+   /// @brief start the timer
+   /// @param[in] name metric name
+   explicit MetricsTimer(const std::string &name) : itsName(name) { itsTimer.mark(); }
+
+   /// @brief publish the elapsed time
+   ~MetricsTimer() { MetricsRegistry::instance().add(itsName, itsTimer.real()); }
+
+private:
+   /// @brief metric name
+   const std::string itsName;
+
+   /// @brief timer
+   casacore::Timer itsTimer;
+};
+
+} // namespace utils
+
+} // namespace askap
+
+#endif // #ifndef ASKAP_UTILITIES_METRICS_REGISTRY_H
@@ -0,0 +1,64 @@
+/// @file
+///
+/// @brief helpers to choose the tiling of merged measurement sets
+/// @details Tiles of the output of a merge should not cut across tiles of the inputs
+/// or straddle the boundary between two inputs, otherwise every output tile has to be
+/// assembled from several input tiles.
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#ifndef ASKAP_UTILITIES_TILE_UTILS_H
+#define ASKAP_UTILITIES_TILE_UTILS_H
+
+// std
+#include <vector>
+
+// casa
+#include <casacore/casa/aips.h>
+
+namespace askap {
+
+namespace utils {
+
+/// @brief greatest common divisor
+/// @param[in] a first number
+/// @param[in] b second number
+/// @return greatest common divisor, gcd(0, b) is b
+casacore::uInt greatestCommonDivisor(casacore::uInt a, casacore::uInt b);
+
+/// @brief number of channels per tile for the merge of the given inputs
+/// @details The result divides the number of channels and the number of channels per tile
+/// of every input. Therefore, output tiles never straddle the boundary between two inputs
+/// (which are concatenated in frequency) and never cut across input tiles.
+/// @param[in] nChan number of channels of each input
+/// @param[in] tileNchan number of channels per tile of each input
+/// @return number of channels per output tile, at least 1
+casacore::uInt commonTileNchan(const std::vector<casacore::uInt> &nChan,
+                               const std::vector<casacore::uInt> &tileNchan);
+
+} // namespace utils
+
+} // namespace askap
+
+#endif // #ifndef ASKAP_UTILITIES_TILE_UTILS_H
@@ -0,0 +1,175 @@
+/// @file
+///
+/// Unit test for the polarisation converter with precomputed matrices
+///
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/gridding/FastPolConverter.h>
+#include <askap/scimath/utils/PolConverter.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <casacore/casa/Arrays/Vector.h>
+#include <casacore/casa/BasicSL/Complex.h>
+#include <casacore/measures/Measures/Stokes.h>
+
+namespace askap {
+
+namespace synthesis {
+
+class FastPolConverterTest : public CppUnit::TestFixture
+{
+   CPPUNIT_TEST_SUITE(FastPolConverterTest);
+   CPPUNIT_TEST(testLinearToI);
+   CPPUNIT_TEST(testLinearToIQUV);
+   CPPUNIT_TEST(testIQUVToLinear);
+   CPPUNIT_TEST(testParAngle);
+   CPPUNIT_TEST(testParAngleToLinear);
+   CPPUNIT_TEST_SUITE_END();
+public:
+
+   void testLinearToI() {
+       casacore::Vector<casacore::Stokes::StokesTypes> out(1, casacore::Stokes::I);
+       scimath::PolConverter pc(linear(), out);
+       FastPolConverter fpc;
+       fpc.init(pc, 4, 1);
+       compare(pc, fpc, 4, 1);
+   }
+
+   void testLinearToIQUV() {
+       scimath::PolConverter pc(linear(), iquv());
+       FastPolConverter fpc;
+       fpc.init(pc, 4, 4);
+       compare(pc, fpc, 4, 4);
+   }
+
+   void testIQUVToLinear() {
+       // this is the set up used for degridding
+       scimath::PolConverter pc(iquv(), linear(), false);
+       FastPolConverter fpc;
+       fpc.init(pc, 4, 4);
+       compare(pc, fpc, 4, 4, false);
+   }
+
+   void testParAngle() {
+       scimath::PolConverter pc(linear(), iquv());
+       FastPolConverter fpc;
+       fpc.init(pc, 4, 4, true);
+       CPPUNIT_ASSERT_EQUAL(size_t(0u), fpc.cacheSize());
+       CPPUNIT_ASSERT(!fpc.separable());
+       pc.setSwapPols(true);
+       for (int i = 0; i < 3; ++i) {
+            const double pa1 = 0.1 * i;
+            const double pa2 = 0.1 * i + 0.05;
+            fpc.setParAngle(pa1, pa2);
+            pc.setParAngle(pa1, pa2);
+            compare(pc, fpc, 4, 4);
+       }
+       CPPUNIT_ASSERT(fpc.separable());
+       CPPUNIT_ASSERT(fpc.fastNoise());
+       // one rotation per distinct angle
+       CPPUNIT_ASSERT_EQUAL(size_t(6u), fpc.cacheSize());
+       // new pairs of known angles are combined from the cached rotations
+       fpc.setParAngle(0.2, 0.05);
+       pc.setParAngle(0.2, 0.05);
+       compare(pc, fpc, 4, 4);
+       fpc.setParAngle(0.15, 0.);
+       pc.setParAngle(0.15, 0.);
+       compare(pc, fpc, 4, 4);
+       CPPUNIT_ASSERT_EQUAL(size_t(6u), fpc.cacheSize());
+   }
+
+   void testParAngleToLinear() {
+       // degridding with rotation, angles of both antennas differ considerably
+       scimath::PolConverter pc(iquv(), linear(), false);
+       FastPolConverter fpc;
+       fpc.init(pc, 4, 4);
+       for (int i = 0; i < 5; ++i) {
+            const double pa1 = -1.3 + 0.7 * i;
+            const double pa2 = 2.9 - 1.1 * i;
+            fpc.setParAngle(pa1, pa2);
+            pc.setSwapPols(false);
+            pc.setParAngle(pa1, pa2);
+            compare(pc, fpc, 4, 4, false);
+       }
+       CPPUNIT_ASSERT(fpc.separable());
+   }
+
+protected:
+
+   /// @return XX,XY,YX,YY frame
+   static casacore::Vector<casacore::Stokes::StokesTypes> linear() {
+       casacore::Vector<casacore::Stokes::StokesTypes> stokes(4);
+       stokes[0] = casacore::Stokes::XX;
+       stokes[1] = casacore::Stokes::XY;
+       stokes[2] = casacore::Stokes::YX;
+       stokes[3] = casacore::Stokes::YY;
+       return stokes;
+   }
+
+   /// @return IQUV frame
+   static casacore::Vector<casacore::Stokes::StokesTypes> iquv() {
+       casacore::Vector<casacore::Stokes::StokesTypes> stokes(4);
+       stokes[0] = casacore::Stokes::I;
+       stokes[1] = casacore::Stokes::Q;
+       stokes[2] = casacore::Stokes::U;
+       stokes[3] = casacore::Stokes::V;
+       return stokes;
+   }
+
+   /// @brief compare fast converter against the reference on a few vectors
+   /// @param[in] pc reference converter
+   /// @param[in] fpc converter to test
+   /// @param[in] nIn number of input polarisations
+   /// @param[in] nOut number of output polarisations
+   /// @param[in] checkNoise if true, noise propagation is compared as well
+   static void compare(scimath::PolConverter &pc, const FastPolConverter &fpc, casacore::uInt nIn,
+                       casacore::uInt nOut, bool checkNoise = true) {
+       casacore::Vector<casacore::Complex> in(nIn), expected(nOut), result(nOut);
+       for (int trial = 0; trial < 3; ++trial) {
+            for (casacore::uInt pol = 0; pol < nIn; ++pol) {
+                 in[pol] = casacore::Complex(0.3 * trial + 0.7 * pol + 0.1, 1. - 0.4 * pol + 0.2 * trial);
+            }
+            pc.convert(expected, in);
+            fpc.convert(result.data(), in.data());
+            for (casacore::uInt pol = 0; pol < nOut; ++pol) {
+                 CPPUNIT_ASSERT_DOUBLES_EQUAL(0., std::abs(expected[pol] - result[pol]), 1e-5);
+            }
+            if (checkNoise) {
+                for (casacore::uInt pol = 0; pol < nIn; ++pol) {
+                     in[pol] = casacore::Complex(std::abs(in[pol].real()), std::abs(in[pol].imag()));
+                }
+                pc.noise(expected, in);
+                fpc.noise(result.data(), in.data());
+                for (casacore::uInt pol = 0; pol < nOut; ++pol) {
+                     CPPUNIT_ASSERT_DOUBLES_EQUAL(0., std::abs(expected[pol] - result[pol]), 1e-5);
+                }
+            }
+       }
+   }
+};
+
+} // namespace synthesis
+
+} // namespace askap
@@ -0,0 +1,146 @@
+/// @file
+///
+/// Unit test for the image plane regridder used in snap-shot imaging
+///
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/gridding/ImagePlaneRegridder.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <casacore/casa/Arrays/Matrix.h>
+#include <casacore/casa/Arrays/ArrayMath.h>
+#include <casacore/casa/Quanta/Quantum.h>
+#include <casacore/coordinates/Coordinates/CoordinateSystem.h>
+#include <casacore/coordinates/Coordinates/DirectionCoordinate.h>
+#include <casacore/coordinates/Coordinates/Projection.h>
+#include <casacore/images/Images/TempImage.h>
+#include <casacore/images/Images/ImageRegrid.h>
+
+#include <cmath>
+
+namespace askap {
+
+namespace synthesis {
+
+class ImagePlaneRegridderTest : public CppUnit::TestFixture
+{
+   CPPUNIT_TEST_SUITE(ImagePlaneRegridderTest);
+   CPPUNIT_TEST(testLinear);
+   CPPUNIT_TEST(testCubic);
+   CPPUNIT_TEST(testAddAndCache);
+   CPPUNIT_TEST_SUITE_END();
+public:
+
+   void setUp() {
+       itsTarget = makeCoordinate(0., 0.);
+       // plane w = 0.05u - 0.03v, as formed by SnapShotImagingGridderAdapter
+       itsCurrent = makeCoordinate(-0.05, 0.03);
+       itsInput.resize(casacore::IPosition(2, 128, 128));
+       for (int y = 0; y < 128; ++y) {
+            for (int x = 0; x < 128; ++x) {
+                 const double dx = (x - 60.3) / 12.;
+                 const double dy = (y - 70.7) / 9.;
+                 itsInput(x, y) = exp(-dx * dx - dy * dy) + 0.1 * sin(0.2 * x) * cos(0.15 * y);
+            }
+       }
+   }
+
+   void testLinear() {
+       compareWithImageRegrid(casacore::Interpolate2D::LINEAR);
+   }
+
+   void testCubic() {
+       compareWithImageRegrid(casacore::Interpolate2D::CUBIC);
+   }
+
+   void testAddAndCache() {
+       ImagePlaneRegridder regridder(casacore::Interpolate2D::LINEAR);
+       casacore::Matrix<imtype> first(itsInput.shape(), imtype(0.));
+       regridder.regrid(itsInput, itsCurrent, first, itsTarget, false);
+       CPPUNIT_ASSERT_EQUAL(0ul, regridder.cacheHits());
+       CPPUNIT_ASSERT_EQUAL(1ul, regridder.cacheMisses());
+       // the same pair of planes again, but adding to the existing output
+       casacore::Matrix<imtype> sum(first.copy());
+       regridder.regrid(itsInput, itsCurrent, sum, itsTarget, true);
+       CPPUNIT_ASSERT_EQUAL(1ul, regridder.cacheHits());
+       CPPUNIT_ASSERT_EQUAL(1ul, regridder.cacheMisses());
+       for (int y = 0; y < 128; ++y) {
+            for (int x = 0; x < 128; ++x) {
+                 CPPUNIT_ASSERT_DOUBLES_EQUAL(2. * first(x, y), sum(x, y), 1e-6);
+            }
+       }
+       // reverse direction is a different mapping
+       regridder.regrid(itsInput, itsTarget, first, itsCurrent, false);
+       CPPUNIT_ASSERT_EQUAL(1ul, regridder.cacheHits());
+       CPPUNIT_ASSERT_EQUAL(2ul, regridder.cacheMisses());
+   }
+
+protected:
+
+   /// @brief coordinate with SIN projection parameters corresponding to the plane fit
+   static casacore::DirectionCoordinate makeCoordinate(const double p1, const double p2) {
+       casacore::Matrix<casacore::Double> xform(2, 2, 0.);
+       xform.diagonal() = 1.;
+       casacore::Vector<casacore::Double> projParams(2);
+       projParams[0] = p1;
+       projParams[1] = p2;
+       const casacore::Projection projection(casacore::Projection::SIN, projParams);
+       return casacore::DirectionCoordinate(casacore::MDirection::J2000, projection,
+                   casacore::Quantity(187.5, "deg"), casacore::Quantity(-45., "deg"),
+                   casacore::Quantity(-30., "arcsec"), casacore::Quantity(30., "arcsec"),
+                   xform, 64., 64.);
+   }
+
+   /// @brief compare the result with casacore::ImageRegrid without coordinate decimation
+   void compareWithImageRegrid(const casacore::Interpolate2D::Method method) {
+       casacore::CoordinateSystem csIn;
+       csIn.addCoordinate(itsCurrent);
+       casacore::CoordinateSystem csOut;
+       csOut.addCoordinate(itsTarget);
+       casacore::TempImage<imtype> inImg(casacore::TiledShape(itsInput.shape()), csIn, 100.);
+       casacore::TempImage<imtype> outImg(casacore::TiledShape(itsInput.shape()), csOut, 100.);
+       inImg.put(itsInput);
+       casacore::ImageRegrid<imtype> reference;
+       reference.regrid(outImg, method, casacore::IPosition(2, 0, 1), inImg, false, 0);
+       const casacore::Array<imtype> expected = outImg.get();
+
+       ImagePlaneRegridder regridder(method);
+       casacore::Matrix<imtype> result(itsInput.shape(), imtype(0.));
+       regridder.regrid(itsInput, itsCurrent, result, itsTarget, false);
+       CPPUNIT_ASSERT(casacore::max(casacore::abs(result - expected)) < 1e-4);
+   }
+
+private:
+   /// @brief target coordinate
+   casacore::DirectionCoordinate itsTarget;
+   /// @brief coordinate of the fitted plane
+   casacore::DirectionCoordinate itsCurrent;
+   /// @brief test image
+   casacore::Matrix<imtype> itsInput;
+};
+
+} // namespace synthesis
+
+} // namespace askap
@@ -33,6 +33,7 @@
 #include <askap/scimath/fitting/Params.h>
 #include <askap/measurementequation/ComponentEquation.h>
 #include <askap/dataaccess/DataIteratorStub.h>
+#include <askap/dataaccess/DataAccessorStub.h>
 #include <casacore/casa/aips.h>
 #include <casacore/casa/Arrays/Matrix.h>
 #include <casacore/measures/Measures/MPosition.h>
@@ -41,10 +42,15 @@
 #include <casacore/casa/BasicSL/Constants.h>
 #include <askap/askap/AskapError.h>
 #include <askap/gridding/VisGridderFactory.h>
+#include <askap/gridding/VisWeightsMultiFrequency.h>
+#include <askap/utils/MetricsRegistry.h>
+#include <casacore/casa/Arrays/ArrayMath.h>
 
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <stdexcept>
+#include <sstream>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 
 using namespace askap::scimath;
@@ -76,6 +82,12 @@ namespace askap
       CPPUNIT_TEST(testReverseAProjectWStack);
       CPPUNIT_TEST(testForwardATCAIllumination);
       CPPUNIT_TEST(testReverseATCAIllumination);
+      CPPUNIT_TEST(testMultiTerm);
+      CPPUNIT_TEST(testActiveWPlanes);
+      CPPUNIT_TEST(testPACache);
+      CPPUNIT_TEST(testMetrics);
+      CPPUNIT_TEST(testBulkVisWeights);
+      CPPUNIT_TEST(testSubtractModel);
       CPPUNIT_TEST_SUITE_END();
 
   private:
@@ -187,6 +199,50 @@ namespace askap
         itsSphFunc->initialiseDegrid(*itsAxes, *itsModel);
         itsSphFunc->degrid(*idi);
       }
+      void testBulkVisWeights()
+      {
+        casacore::Double refFreq = 1.4e9;
+        VisWeightsMultiFrequency wt(refFreq);
+        casacore::Vector<casacore::Double> freqs(5);
+        for (casacore::uInt chan = 0; chan < freqs.nelements(); ++chan) {
+             freqs[chan] = 1.2e9 + 1e8 * chan;
+        }
+        casacore::Vector<float> weights;
+        for (int order = 0; order < 4; ++order) {
+             wt.setParameters(order);
+             wt.getWeights(freqs, weights);
+             CPPUNIT_ASSERT_EQUAL(freqs.nelements(), weights.nelements());
+             for (casacore::uInt chan = 0; chan < freqs.nelements(); ++chan) {
+                  CPPUNIT_ASSERT_DOUBLES_EQUAL(wt.getWeight(0, freqs[chan], 0), weights[chan], 1e-6);
+             }
+        }
+      }
+      void testMetrics()
+      {
+        utils::MetricsRegistry &registry = utils::MetricsRegistry::instance();
+        registry.clear();
+        itsSphFunc->initialiseGrid(*itsAxes, itsModel->shape(), false);
+        itsSphFunc->grid(*idi);
+        utils::MetricsRegistry::MetricMap metrics = registry.take();
+        CPPUNIT_ASSERT(metrics.count("gridder.grid.samples") == 1);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(itsSphFunc->samplesGridded(), metrics["gridder.grid.samples"].total, 1e-6);
+        CPPUNIT_ASSERT_EQUAL(1ul, metrics["gridder.grid.samples"].count);
+        CPPUNIT_ASSERT(metrics.count("gridder.degrid.samples") == 0);
+        CPPUNIT_ASSERT(registry.snapshot().empty());
+        // only increments are published when the gridder is reused
+        itsSphFunc->grid(*idi);
+        metrics = registry.take();
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(itsSphFunc->samplesGridded() / 2, metrics["gridder.grid.samples"].total, 1e-6);
+        itsSphFunc->finaliseGrid(*itsModel);
+        // aggregation
+        utils::MetricsRegistry::MetricMap total = metrics;
+        utils::MetricsRegistry::merge(total, metrics);
+        CPPUNIT_ASSERT_DOUBLES_EQUAL(itsSphFunc->samplesGridded(), total["gridder.grid.samples"].total, 1e-6);
+        CPPUNIT_ASSERT_EQUAL(2ul, total["gridder.grid.samples"].count);
+        std::ostringstream os;
+        utils::MetricsRegistry::writeCSV(os, total, 1, 0, true);
+        CPPUNIT_ASSERT(os.str().find("rank,cycle,name,total,count,min,max\n1,0,gridder.") == 0);
+      }
       void testReverseAWProject()
       {
         itsAWProject->initialiseGrid(*itsAxes, itsModel->shape(), false);
@@ -268,6 +324,156 @@ namespace askap
         itsAProjectWStack->initialiseDegrid(*itsAxes, *itsModel);
         itsAProjectWStack->degrid(*idi);
       }
+      void testMultiTerm()
+      {
+        // three Taylor terms processed separately and in one pass should give the same result
+        std::vector<boost::shared_ptr<TableVisGridder> > separate;
+        std::vector<boost::shared_ptr<TableVisGridder> > fused;
+        for (int order = 0; order < 3; ++order) {
+             boost::shared_ptr<TableVisGridder> gridder(new SphFuncVisGridder());
+             gridder->initVisWeights(IVisWeights::ShPtr(new VisWeightsMultiFrequency(1e9)));
+             std::ostringstream context;
+             context<<".i.cena.taylor."<<order;
+             gridder->customiseForContext(context.str());
+             separate.push_back(gridder);
+             fused.push_back(boost::dynamic_pointer_cast<TableVisGridder>(gridder->clone()));
+             CPPUNIT_ASSERT(fused.back());
+        }
+        const std::vector<boost::shared_ptr<TableVisGridder> > others(fused.begin() + 1, fused.end());
+
+        for (size_t term = 0; term < separate.size(); ++term) {
+             separate[term]->initialiseGrid(*itsAxes, itsModel->shape(), false);
+             separate[term]->grid(*idi);
+             fused[term]->initialiseGrid(*itsAxes, itsModel->shape(), false);
+        }
+        fused[0]->gridMultiTerm(*idi, others);
+        for (size_t term = 0; term < separate.size(); ++term) {
+             casa::Array<imtype> expected(itsModel->shape());
+             casa::Array<imtype> result(itsModel->shape());
+             separate[term]->finaliseGrid(expected);
+             fused[term]->finaliseGrid(result);
+             CPPUNIT_ASSERT(casa::max(casa::abs(expected)) > 0.);
+             CPPUNIT_ASSERT(casa::max(casa::abs(result - expected)) < 1e-5 * casa::max(casa::abs(expected)));
+             separate[term]->finaliseWeights(expected);
+             fused[term]->finaliseWeights(result);
+             CPPUNIT_ASSERT(casa::max(casa::abs(result - expected)) < 1e-5 * casa::max(casa::abs(expected)));
+        }
+
+        casa::Array<imtype> model(itsModel->shape(), 0.);
+        model(casa::IPosition(4, 200, 300, 0, 0)) = 1.;
+        idi->rwVisibility().set(0.);
+        for (size_t term = 0; term < separate.size(); ++term) {
+             separate[term]->initialiseDegrid(*itsAxes, model * imtype(term + 1));
+             separate[term]->degrid(*idi);
+        }
+        const casa::Cube<casa::Complex> expectedVis = idi->visibility().copy();
+        idi->rwVisibility().set(0.);
+        for (size_t term = 0; term < fused.size(); ++term) {
+             fused[term]->initialiseDegrid(*itsAxes, model * imtype(term + 1));
+        }
+        fused[0]->degridMultiTerm(*idi, others);
+        CPPUNIT_ASSERT(casa::max(casa::abs(expectedVis)) > 0.);
+        CPPUNIT_ASSERT(casa::max(casa::abs(idi->visibility() - expectedVis)) < 1e-5 * casa::max(casa::abs(expectedVis)));
+      }
+      void testSubtractModel()
+      {
+        // subtraction in the degridder should match subtraction of separately degridded model
+        casa::Array<imtype> model(itsModel->shape(), 0.);
+        model(casa::IPosition(4, 200, 300, 0, 0)) = 1.;
+        const casa::Cube<casa::Complex> observed = idi->visibility().copy();
+        idi->rwVisibility().set(0.);
+        itsWStack->initialiseDegrid(*itsAxes, model);
+        itsWStack->degrid(*idi);
+        const casa::Cube<casa::Complex> expectedVis = observed - idi->visibility();
+        CPPUNIT_ASSERT(casa::max(casa::abs(idi->visibility())) > 0.);
+
+        idi->rwVisibility() = observed;
+        itsWStack->initialiseDegrid(*itsAxes, model);
+        itsWStack->doSubtractModel(true);
+        itsWStack->degrid(*idi);
+        itsWStack->doSubtractModel(false);
+        CPPUNIT_ASSERT(casa::max(casa::abs(idi->visibility() - expectedVis)) < 1e-5 * casa::max(casa::abs(observed)));
+      }
+      void testActiveWPlanes()
+      {
+        // keeping only 2 out of 9 w-planes in memory should give the same result
+        boost::shared_ptr<WStackVisGridder> limited(new WStackVisGridder(10000.0, 9));
+        limited->maxActivePlanes(2);
+        CPPUNIT_ASSERT(itsWStack->canProcessTermsTogether());
+        CPPUNIT_ASSERT(!limited->canProcessTermsTogether());
+
+        casa::Array<imtype> expected(itsModel->shape());
+        casa::Array<imtype> result(itsModel->shape());
+        itsWStack->initialiseGrid(*itsAxes, itsModel->shape(), false);
+        itsWStack->grid(*idi);
+        itsWStack->finaliseGrid(expected);
+        limited->initialiseGrid(*itsAxes, itsModel->shape(), false);
+        limited->grid(*idi);
+        limited->finaliseGrid(result);
+        CPPUNIT_ASSERT(casa::max(casa::abs(expected)) > 0.);
+        CPPUNIT_ASSERT(casa::max(casa::abs(result - expected)) < 1e-5 * casa::max(casa::abs(expected)));
+        itsWStack->finaliseWeights(expected);
+        limited->finaliseWeights(result);
+        CPPUNIT_ASSERT(casa::max(casa::abs(result - expected)) < 1e-5 * casa::max(casa::abs(expected)));
+
+        casa::Array<imtype> model(itsModel->shape(), 0.);
+        model(casa::IPosition(4, 200, 300, 0, 0)) = 1.;
+        model(casa::IPosition(4, 350, 100, 0, 0)) = 0.5;
+        idi->rwVisibility().set(0.);
+        itsWStack->initialiseDegrid(*itsAxes, model);
+        itsWStack->degrid(*idi);
+        const casa::Cube<casa::Complex> expectedVis = idi->visibility().copy();
+        idi->rwVisibility().set(0.);
+        limited->initialiseDegrid(*itsAxes, model);
+        limited->degrid(*idi);
+        limited->finaliseDegrid();
+        CPPUNIT_ASSERT(casa::max(casa::abs(expectedVis)) > 0.);
+        CPPUNIT_ASSERT(casa::max(casa::abs(idi->visibility() - expectedVis)) < 1e-5 * casa::max(casa::abs(expectedVis)));
+      }
+      void testPACache()
+      {
+        // CFs restored for a previously seen parallactic angle bin should match those recomputed
+        boost::shared_ptr<ATCAIllumination> illum(new ATCAIllumination(12.0, 2.0));
+        illum->simulateTapering(1.0);
+        // feed legs make the pattern asymmetric, otherwise parallactic angle is ignored
+        illum->simulateFeedLegShadows(1.0, casa::C::pi/4, 0.);
+        CPPUNIT_ASSERT(!illum->isSymmetric());
+        boost::shared_ptr<AProjectWStackVisGridder> cached(new AProjectWStackVisGridder(illum, 10000.0, 9, 0.,
+                     1, 128, 1, 1, 1, 0.0001, 0.1));
+        cached->paCacheSize(64 * 1024 * 1024);
+        itsAProjectWStack.reset(new AProjectWStackVisGridder(illum, 10000.0, 9, 0., 1, 128, 1, 1, 1, 0.0001, 0.1));
+
+        accessors::DataAccessorStub &da = dynamic_cast<accessors::DataAccessorStub&>(*idi);
+        cached->initialiseGrid(*itsAxes, itsModel->shape(), false);
+        itsAProjectWStack->initialiseGrid(*itsAxes, itsModel->shape(), false);
+        // the last angle falls into the same bin as the first one
+        const float angles[3] = {0., 0.5, 0.02};
+        for (int i = 0; i < 3; ++i) {
+             da.itsFeed1PA.set(angles[i]);
+             cached->grid(*idi);
+             itsAProjectWStack->grid(*idi);
+             if (i == 0) {
+                 CPPUNIT_ASSERT_EQUAL(0u, cached->numberOfCFGenerationsDueToPA());
+             } else if (i == 1) {
+                 // 0.5 rad falls into a different bin, so CFs are recomputed
+                 CPPUNIT_ASSERT(cached->numberOfCFGenerationsDueToPA() > 0);
+                 CPPUNIT_ASSERT_EQUAL(0u, cached->numberOfCFRestores());
+             }
+        }
+        // the first bin is restored from the cache rather than recomputed
+        CPPUNIT_ASSERT(cached->numberOfCFRestores() > 0);
+        CPPUNIT_ASSERT_EQUAL(0u, itsAProjectWStack->numberOfCFRestores());
+        CPPUNIT_ASSERT(itsAProjectWStack->numberOfCFGenerationsDueToPA() > cached->numberOfCFGenerationsDueToPA());
+        casa::Array<imtype> expected(itsModel->shape());
+        casa::Array<imtype> result(itsModel->shape());
+        itsAProjectWStack->finaliseGrid(expected);
+        cached->finaliseGrid(result);
+        CPPUNIT_ASSERT(casa::max(casa::abs(expected)) > 0.);
+        CPPUNIT_ASSERT(casa::max(casa::abs(result - expected)) < 1e-5 * casa::max(casa::abs(expected)));
+        itsAProjectWStack->finaliseWeights(expected);
+        cached->finaliseWeights(result);
+        CPPUNIT_ASSERT(casa::max(casa::abs(result - expected)) < 1e-5 * casa::max(casa::abs(expected)));
+      }
     };
 
   }
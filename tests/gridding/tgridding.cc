@@ -32,6 +32,8 @@
 #include "SupportSearcherTest.h"
 #include "FrequencyMapperTest.h"
 #include "NonLinearWSamplingTest.h"
+#include "ImagePlaneRegridderTest.h"
+#include "FastPolConverterTest.h"
 
 int main(int argc, char *argv[])
 {
@@ -40,6 +42,8 @@ int main(int argc, char *argv[])
     runner.addTest( askap::synthesis::SupportSearcherTest::suite());
     runner.addTest( askap::synthesis::FrequencyMapperTest::suite());
     runner.addTest( askap::synthesis::NonLinearWSamplingTest::suite());
+    runner.addTest( askap::synthesis::ImagePlaneRegridderTest::suite());
+    runner.addTest( askap::synthesis::FastPolConverterTest::suite());
 
     bool wasSucessful = runner.run();
 
@@ -38,6 +38,7 @@
 #include <casacore/casa/Quanta/Quantum.h>
 #include <casacore/casa/Quanta/MVPosition.h>
 #include <casacore/casa/BasicSL/Constants.h>
+#include <casacore/casa/Arrays/ArrayMath.h>
 
 #include <askap/askap/AskapError.h>
 
@@ -67,6 +68,8 @@ namespace askap
       CPPUNIT_TEST(testSolveAntIllum);
       CPPUNIT_TEST_EXCEPTION(testFixed, CheckError);
       CPPUNIT_TEST(testFullPol);
+      CPPUNIT_TEST(testCachedPSF);
+      CPPUNIT_TEST(testGridderThreads);
       CPPUNIT_TEST_SUITE_END();
 
   private:
@@ -229,6 +232,60 @@ namespace askap
             0))-0.700)<0.005);
       }
 
+      void testCachedPSF()
+      {
+        p1->predict();
+        ImagingNormalEquations reference(*params2);
+        p2->calcEquations(reference);
+        CPPUNIT_ASSERT(reference.normalMatrixSlice().count("image.i.cena") == 1);
+        const casacore::Vector<imtype> expected = reference.normalMatrixSlice().find("image.i.cena")->second;
+        CPPUNIT_ASSERT(casacore::max(expected) > 0.);
+
+        // the second major cycle reuses the PSF gridded in the first one
+        ImageFFTEquation eq(*params2, idi);
+        eq.cachePSF(true);
+        for (size_t cycle = 0; cycle < 2; ++cycle) {
+             ImagingNormalEquations ne(*params2);
+             eq.calcEquations(ne);
+             CPPUNIT_ASSERT(ne.normalMatrixSlice().count("image.i.cena") == 1);
+             const casacore::Vector<imtype> psf = ne.normalMatrixSlice().find("image.i.cena")->second;
+             CPPUNIT_ASSERT_EQUAL(expected.nelements(), psf.nelements());
+             CPPUNIT_ASSERT(casacore::max(casacore::abs(psf - expected)) < 1e-6);
+        }
+      }
+
+      void testGridderThreads()
+      {
+        p1->predict();
+        // another image, so several gridders go through each chunk of data
+        casacore::Array<double> imagePixels(casacore::IPosition(4, npix, npix, 1, 1));
+        imagePixels.set(0.0);
+        imagePixels(casacore::IPosition(4, 5*npix/8, npix/2, 0, 0))=0.5;
+        params2->add("image.i.cenb", imagePixels, params2->axes("image.i.cena"));
+
+        ImageFFTEquation serial(*params2, idi);
+        ImagingNormalEquations reference(*params2);
+        serial.calcEquations(reference);
+        ImageFFTEquation threaded(*params2, idi);
+        threaded.gridderThreads(4);
+        ImagingNormalEquations ne(*params2);
+        threaded.calcEquations(ne);
+
+        const std::string names[2] = {"image.i.cena", "image.i.cenb"};
+        for (size_t i = 0; i < 2; ++i) {
+             CPPUNIT_ASSERT(ne.normalMatrixSlice().count(names[i]) == 1);
+             const casacore::Vector<imtype> expectedPSF = reference.normalMatrixSlice().find(names[i])->second;
+             const casacore::Vector<imtype> psf = ne.normalMatrixSlice().find(names[i])->second;
+             CPPUNIT_ASSERT_EQUAL(expectedPSF.nelements(), psf.nelements());
+             CPPUNIT_ASSERT(casacore::max(casacore::abs(psf - expectedPSF)) < 1e-5 * casacore::max(expectedPSF));
+             const casacore::Vector<imtype> expectedResidual = reference.dataVector(names[i]);
+             const casacore::Vector<imtype> residual = ne.dataVector(names[i]);
+             CPPUNIT_ASSERT_EQUAL(expectedResidual.nelements(), residual.nelements());
+             CPPUNIT_ASSERT(casacore::max(casacore::abs(residual - expectedResidual)) <
+                            1e-5 * casacore::max(casacore::abs(expectedResidual)));
+        }
+      }
+
       void testFixed()
       {
         ImagingNormalEquations ne(*params1);
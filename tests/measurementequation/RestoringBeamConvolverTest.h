@@ -0,0 +1,195 @@
+/// @file
+///
+/// @brief Unit tests for RestoringBeamConvolver.
+/// @details RestoringBeamConvolver convolves model images with the restoring
+/// beam in the Fourier domain using the analytic transfer function of the gaussian.
+///
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#ifndef RESTORING_BEAM_CONVOLVER_TEST_H
+#define RESTORING_BEAM_CONVOLVER_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <askap/measurementequation/RestoringBeamConvolver.h>
+#include <askap/measurementequation/Image2DConvolver.h>
+#include <askap/measurementequation/SynthesisParamsHelper.h>
+#include <askap/scimath/fitting/Params.h>
+#include <casacore/images/Images/TempImage.h>
+#include <casacore/measures/Measures/Stokes.h>
+#include <casacore/casa/Arrays/Cube.h>
+#include <casacore/casa/Arrays/ArrayMath.h>
+#include <casacore/casa/BasicSL/Constants.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace askap
+{
+  namespace synthesis
+  {
+
+    class RestoringBeamConvolverTest : public CppUnit::TestFixture
+    {
+      CPPUNIT_TEST_SUITE(RestoringBeamConvolverTest);
+      CPPUNIT_TEST(testGoodSize);
+      CPPUNIT_TEST(testPointSource);
+      CPPUNIT_TEST(testCacheAndEmptyPlanes);
+      CPPUNIT_TEST(testImage2DConvolver);
+      CPPUNIT_TEST_SUITE_END();
+    public:
+
+      void setUp() {
+         itsIncrements.resize(2);
+         // RA increment is negative as in real images
+         itsIncrements[0] = -1e-5;
+         itsIncrements[1] = 1e-5;
+         itsBeam.resize(3);
+         itsBeam[0] = casacore::Quantity(6e-5, "rad");
+         itsBeam[1] = casacore::Quantity(4e-5, "rad");
+         itsBeam[2] = casacore::Quantity(30., "deg");
+      }
+
+      void testGoodSize() {
+         CPPUNIT_ASSERT_EQUAL(2, RestoringBeamConvolver::goodSize(1));
+         CPPUNIT_ASSERT_EQUAL(64, RestoringBeamConvolver::goodSize(64));
+         CPPUNIT_ASSERT_EQUAL(72, RestoringBeamConvolver::goodSize(65));
+         CPPUNIT_ASSERT_EQUAL(80, RestoringBeamConvolver::goodSize(77));
+         CPPUNIT_ASSERT_EQUAL(100, RestoringBeamConvolver::goodSize(98));
+      }
+
+      void testPointSource() {
+         // one source in the middle and another close to the edge to check that nothing wraps around
+         casacore::Array<imtype> image(casacore::IPosition(2, 64, 64), imtype(0.));
+         image(casacore::IPosition(2, 31, 35)) = 1.;
+         image(casacore::IPosition(2, 2, 60)) = 0.5;
+         RestoringBeamConvolver convolver;
+         convolver.convolve(image, itsIncrements, itsBeam);
+         for (int y = 0; y < 64; ++y) {
+              for (int x = 0; x < 64; ++x) {
+                   const double expected = gaussian(x - 31, y - 35) + 0.5 * gaussian(x - 2, y - 60);
+                   CPPUNIT_ASSERT_DOUBLES_EQUAL(expected, image(casacore::IPosition(2, x, y)), 1e-4);
+              }
+         }
+      }
+
+      void testCacheAndEmptyPlanes() {
+         casacore::Cube<imtype> cube(64, 48, 3, imtype(0.));
+         cube(20, 20, 0) = 1.;
+         cube(30, 25, 2) = 2.;
+         RestoringBeamConvolver convolver;
+         casacore::Array<imtype> image(cube);
+         convolver.convolve(image, itsIncrements, itsBeam);
+         CPPUNIT_ASSERT_EQUAL(1ul, convolver.cacheMisses());
+         CPPUNIT_ASSERT_EQUAL(1ul, convolver.cacheHits());
+         CPPUNIT_ASSERT_EQUAL(1ul, convolver.skippedPlanes());
+         CPPUNIT_ASSERT_DOUBLES_EQUAL(1., cube(20, 20, 0), 1e-4);
+         CPPUNIT_ASSERT_DOUBLES_EQUAL(2., cube(30, 25, 2), 1e-4);
+         CPPUNIT_ASSERT_DOUBLES_EQUAL(0., casacore::max(casacore::abs(cube.xyPlane(1))), 1e-10);
+
+         // another term with the same beam reuses the transfer function, an empty one needs no FFT at all
+         casacore::Array<imtype> term(casacore::IPosition(2, 64, 48), imtype(0.));
+         convolver.convolve(term, itsIncrements, itsBeam);
+         CPPUNIT_ASSERT_EQUAL(1ul, convolver.cacheMisses());
+         CPPUNIT_ASSERT_EQUAL(2ul, convolver.skippedPlanes());
+         term(casacore::IPosition(2, 10, 10)) = 1.;
+         convolver.convolve(term, itsIncrements, itsBeam);
+         CPPUNIT_ASSERT_EQUAL(1ul, convolver.cacheMisses());
+         CPPUNIT_ASSERT_EQUAL(2ul, convolver.cacheHits());
+
+         // different beam
+         itsBeam[2] = casacore::Quantity(-10., "deg");
+         convolver.convolve(term, itsIncrements, itsBeam);
+         CPPUNIT_ASSERT_EQUAL(2ul, convolver.cacheMisses());
+      }
+
+      void testImage2DConvolver() {
+         // the restore solver used Image2DConvolver before, which works in the world coordinates
+         // of the image, so this checks the position angle convention independently
+         std::vector<std::string> direction(3);
+         direction[0] = "12h30m00.0";
+         direction[1] = "-45.00.00.00";
+         direction[2] = "J2000";
+         const std::vector<int> shape(2, 96);
+         const std::vector<std::string> cellsize(2, "2arcsec");
+         const casacore::Vector<casacore::Stokes::StokesTypes> stokes(1, casacore::Stokes::I);
+         scimath::Params params(true);
+         SynthesisParamsHelper::add(params, "image.test", direction, cellsize, shape, false, 1.4e9, 1.4e9, 1, stokes);
+
+         casacore::Array<imtype> model(params.valueT("image.test").shape(), imtype(0.));
+         model(casacore::IPosition(4, 48, 48, 0, 0)) = 1.;
+         model(casacore::IPosition(4, 30, 60, 0, 0)) = 0.5;
+         model(casacore::IPosition(4, 70, 25, 0, 0)) = -0.3;
+         params.update("image.test", model.copy());
+
+         // elliptical beam with the position angle which is neither 0 nor 90 deg
+         casacore::Vector<casacore::Quantum<double> > beam(3);
+         beam[0] = casacore::Quantity(12., "arcsec");
+         beam[1] = casacore::Quantity(7., "arcsec");
+         beam[2] = casacore::Quantity(35., "deg");
+
+         const casacore::Vector<double> increments = params.axes("image.test").directionAxis().increment();
+         casacore::Array<imtype> result = model.copy();
+         RestoringBeamConvolver convolver;
+         convolver.convolve(result, increments, beam);
+
+         // restore as ImageRestoreSolver does with fftconvolution=false
+         boost::shared_ptr<casacore::TempImage<float> > image(SynthesisParamsHelper::tempImage(params, "image.test"));
+         Image2DConvolver<float> reference;
+         reference.convolve(*image, *image, casacore::VectorKernel::GAUSSIAN, casacore::IPosition(2, 0, 1),
+                            beam, true, 1.0, false);
+         SynthesisParamsHelper::update(params, "image.test", *image);
+         const casacore::Array<imtype> expected = params.valueT("image.test");
+
+         CPPUNIT_ASSERT_DOUBLES_EQUAL(1., casacore::max(result), 1e-3);
+         CPPUNIT_ASSERT_DOUBLES_EQUAL(0., casacore::max(casacore::abs(result - expected)), 1e-3);
+         // the same beam mirrored about the north-south axis is clearly different
+         beam[2] = casacore::Quantity(-35., "deg");
+         casacore::Array<imtype> mirrored = model.copy();
+         convolver.convolve(mirrored, increments, beam);
+         CPPUNIT_ASSERT(casacore::max(casacore::abs(mirrored - expected)) > 0.05);
+      }
+
+    protected:
+      /// @brief expected response to a unit point source with the given pixel offset
+      double gaussian(const int dx, const int dy) const {
+         const double l = dx * itsIncrements[0];
+         const double m = dy * itsIncrements[1];
+         const double pa = itsBeam[2].getValue("rad");
+         const double alongMajor = (l * sin(pa) + m * cos(pa)) / itsBeam[0].getValue("rad");
+         const double alongMinor = (l * cos(pa) - m * sin(pa)) / itsBeam[1].getValue("rad");
+         return exp(-4. * log(2.) * (alongMajor * alongMajor + alongMinor * alongMinor));
+      }
+
+    private:
+      casacore::Vector<double> itsIncrements;
+      casacore::Vector<casacore::Quantum<double> > itsBeam;
+    };
+
+  } // namespace synthesis
+} // namespace askap
+
+#endif // #ifndef RESTORING_BEAM_CONVOLVER_TEST_H
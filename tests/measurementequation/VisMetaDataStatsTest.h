@@ -58,6 +58,7 @@ namespace askap
       CPPUNIT_TEST(testProcessModified);
       CPPUNIT_TEST(testProcess);
       CPPUNIT_TEST(testProcessFlag);
+      CPPUNIT_TEST(testProcessPartialFlag);
       CPPUNIT_TEST(testMerge);
       CPPUNIT_TEST(testBlobStream);
       CPPUNIT_TEST(testSnapShot);
@@ -165,6 +166,23 @@ namespace askap
          checkCombined(stats);
       }
 
+      void testProcessPartialFlag() {
+         accessors::DataAccessorStub acc(true);
+         // only one polarisation of one row and one channel is unflagged
+         casacore::Cube<casacore::Bool> flags = acc.flag();
+         flags = casacore::True;
+         flags(1, 2, flags.nplane() - 1) = casacore::False;
+         VisMetaDataStats stats;
+         stats.process(acc);
+         CPPUNIT_ASSERT_EQUAL(1ul, stats.nVis());
+         CPPUNIT_ASSERT_DOUBLES_EQUAL(acc.frequency()[2], stats.maxFreq(), 1.);
+         CPPUNIT_ASSERT_DOUBLES_EQUAL(acc.frequency()[2], stats.minFreq(), 1.);
+         // fully flagged data should be ignored
+         flags = casacore::True;
+         stats.process(acc);
+         CPPUNIT_ASSERT_EQUAL(1ul, stats.nVis());
+      }
+
       void testProcessFlag() {
          accessors::DataAccessorStub acc(true);
          // modify the flags - flag first row and first channel
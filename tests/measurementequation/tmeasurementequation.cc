@@ -44,6 +44,7 @@
 #include "PolLeakageTest.h"
 #include "PreAvgCalBufferTest.h"
 #include "RestoringBeamHelperTest.h"
+#include "RestoringBeamConvolverTest.h"
 #include "VisMetaDataStatsTest.h"
 
 // avoid use of MPI for unit tests
@@ -70,6 +71,7 @@ int main( int argc, char **argv)
     runner.addTest(askap::synthesis::GaussianNoiseMETest::suite());
     runner.addTest(askap::synthesis::PolLeakageTest::suite());
     runner.addTest(askap::synthesis::RestoringBeamHelperTest::suite());
+    runner.addTest(askap::synthesis::RestoringBeamConvolverTest::suite());
     runner.addTest(askap::synthesis::VisMetaDataStatsTest::suite());
 
     const bool wasSucessful = runner.run();
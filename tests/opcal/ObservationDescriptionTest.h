@@ -46,6 +46,7 @@ namespace askap
     {
       CPPUNIT_TEST_SUITE(ObservationDescriptionTest);
       CPPUNIT_TEST(testCreate);
+      CPPUNIT_TEST(testValidData);
       CPPUNIT_TEST_EXCEPTION(testAccessUninitialised, askap::CheckError);
       CPPUNIT_TEST_EXCEPTION(testIllegalUpdate, askap::CheckError);
       CPPUNIT_TEST_SUITE_END();
@@ -112,6 +113,33 @@ namespace askap
          CPPUNIT_ASSERT(obs2.name() == "another");                  
       }
       
+      void testValidData() {
+         const casa::MVDirection dir(casa::Quantity(1.01,"rad"), casa::Quantity(-1.1,"rad"));
+         ObservationDescription obs("test",5,3600.5, 3, dir, 1e9);
+         CPPUNIT_ASSERT(!obs.hasValidData(0,1));
+         casacore::Vector<casacore::Stokes::StokesTypes> stokes(2);
+         stokes[0] = casacore::Stokes::XX;
+         stokes[1] = casacore::Stokes::YY;
+         obs.setStokes(stokes);
+         CPPUNIT_ASSERT(!obs.hasValidData(0,1));
+         casacore::Vector<casacore::Bool> flags(2, false);
+         flags[1] = true;
+         obs.processBaselineFlags(0,1,flags);
+         // YY is still flagged
+         CPPUNIT_ASSERT(!obs.hasValidData(0,1));
+         flags[0] = true;
+         flags[1] = false;
+         obs.processBaselineFlags(1,2,flags);
+         CPPUNIT_ASSERT(obs.hasValidData(1,1));
+         CPPUNIT_ASSERT(!obs.hasValidData(0,1));
+         CPPUNIT_ASSERT(!obs.hasValidData(1,2));
+         flags.set(false);
+         obs.processBaselineFlags(0,2,flags);
+         CPPUNIT_ASSERT(obs.hasValidData(0,1));
+         CPPUNIT_ASSERT(obs.hasValidData(1,2));
+         CPPUNIT_ASSERT(!obs.hasValidData(1,3));
+      }
+      
       void testAccessUninitialised() {
          ObservationDescription obs;
          obs.startCycle();
@@ -0,0 +1,176 @@
+/// @file
+///
+/// Unit test for the metadata statistics cache of AdviseParallel
+///
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/parallel/AdviseParallel.h>
+#include <askap/measurementequation/VisMetaDataStats.h>
+#include <askap/dataaccess/DataAccessorStub.h>
+#include <Common/ParameterSet.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+namespace askap {
+
+namespace synthesis {
+
+/// @brief exposes cache helpers of AdviseParallel, which are not public
+struct AdviseParallelCacheAccess : public AdviseParallel {
+   using AdviseParallel::tableModificationTime;
+   using AdviseParallel::selectionKey;
+   using AdviseParallel::loadCachedStats;
+   using AdviseParallel::saveCachedStats;
+};
+
+class AdviseParallelTest : public CppUnit::TestFixture
+{
+   CPPUNIT_TEST_SUITE(AdviseParallelTest);
+   CPPUNIT_TEST(testSelectionKey);
+   CPPUNIT_TEST(testCacheInvalidation);
+   CPPUNIT_TEST_SUITE_END();
+public:
+
+   void setUp() {
+       char dirTemplate[] = "/tmp/tadviseXXXXXX";
+       const char *dir = mkdtemp(dirTemplate);
+       CPPUNIT_ASSERT(dir != NULL);
+       itsDir = dir;
+       // mock table with a subtable, only the file structure matters
+       itsMS = itsDir + "/test.ms";
+       CPPUNIT_ASSERT_EQUAL(0, mkdir(itsMS.c_str(), 0755));
+       CPPUNIT_ASSERT_EQUAL(0, mkdir((itsMS + "/ANTENNA").c_str(), 0755));
+       touch(itsMS + "/table.dat", 1000);
+       touch(itsMS + "/ANTENNA/table.dat", 1000);
+       touch(itsMS + "/ANTENNA/table.f0", 1000);
+       touch(itsMS + "/ANTENNA", 1000);
+       touch(itsMS, 1000);
+       itsCache = itsDir + "/test.ms.advise";
+   }
+
+   void tearDown() {
+       std::remove(itsCache.c_str());
+       std::remove((itsMS + "/ANTENNA/table.lock").c_str());
+       std::remove((itsMS + "/ANTENNA/table.f0").c_str());
+       std::remove((itsMS + "/ANTENNA/table.dat").c_str());
+       rmdir((itsMS + "/ANTENNA").c_str());
+       std::remove((itsMS + "/table.dat").c_str());
+       rmdir(itsMS.c_str());
+       rmdir(itsDir.c_str());
+   }
+
+   void testSelectionKey() {
+       LOFAR::ParameterSet parset;
+       parset.add("dataset", "a.ms");
+       parset.add("Channels", "[1, 0]");
+       const std::string key = AdviseParallelCacheAccess::selectionKey(parset);
+       // list of datasets doesn't affect the statistics of each dataset
+       parset.replace("dataset", "[a.ms, b.ms]");
+       CPPUNIT_ASSERT_EQUAL(key, AdviseParallelCacheAccess::selectionKey(parset));
+       // any other parameter may be a selection keyword
+       parset.add("Scans", "[2]");
+       CPPUNIT_ASSERT(key != AdviseParallelCacheAccess::selectionKey(parset));
+       parset.remove("Scans");
+       CPPUNIT_ASSERT_EQUAL(key, AdviseParallelCacheAccess::selectionKey(parset));
+       parset.replace("Channels", "[2, 0]");
+       CPPUNIT_ASSERT(key != AdviseParallelCacheAccess::selectionKey(parset));
+   }
+
+   void testCacheInvalidation() {
+       accessors::DataAccessorStub acc(true);
+       VisMetaDataStats stats;
+       stats.process(acc);
+       CPPUNIT_ASSERT(stats.nVis() > 0ul);
+
+       LOFAR::ParameterSet parset;
+       parset.add("Channels", "[1, 0]");
+       const std::string mtime = AdviseParallelCacheAccess::tableModificationTime(itsMS);
+       CPPUNIT_ASSERT(mtime != "");
+       const std::string key = mtime + AdviseParallelCacheAccess::selectionKey(parset);
+       AdviseParallelCacheAccess::saveCachedStats(itsCache, key, stats);
+
+       VisMetaDataStats loaded;
+       CPPUNIT_ASSERT(AdviseParallelCacheAccess::loadCachedStats(itsCache, key, loaded));
+       CPPUNIT_ASSERT_EQUAL(stats.nVis(), loaded.nVis());
+       CPPUNIT_ASSERT_DOUBLES_EQUAL(stats.maxW(), loaded.maxW(), 1e-6);
+
+       // lock files are rewritten by readers, they don't invalidate the cache
+       touch(itsMS + "/ANTENNA/table.lock", 2000);
+       touch(itsMS + "/ANTENNA", 1000);
+       CPPUNIT_ASSERT_EQUAL(mtime, AdviseParallelCacheAccess::tableModificationTime(itsMS));
+
+       // rewriting a subtable file changes neither the table nor the subtable directory time
+       touch(itsMS + "/ANTENNA/table.f0", 3000);
+       touch(itsMS + "/ANTENNA", 1000);
+       const std::string newMtime = AdviseParallelCacheAccess::tableModificationTime(itsMS);
+       CPPUNIT_ASSERT(newMtime != mtime);
+       VisMetaDataStats stale;
+       CPPUNIT_ASSERT(!AdviseParallelCacheAccess::loadCachedStats(itsCache,
+                      newMtime + AdviseParallelCacheAccess::selectionKey(parset), stale));
+
+       // a different selection invalidates the cache too
+       parset.add("Feed", "1");
+       CPPUNIT_ASSERT(!AdviseParallelCacheAccess::loadCachedStats(itsCache,
+                      mtime + AdviseParallelCacheAccess::selectionKey(parset), stale));
+   }
+
+protected:
+   /// @brief create the file if necessary and set its modification time
+   /// @param[in] name file or directory name
+   /// @param[in] seconds modification time (seconds since epoch)
+   static void touch(const std::string &name, time_t seconds) {
+       struct stat buf;
+       if (stat(name.c_str(), &buf) != 0) {
+           std::ofstream os(name.c_str());
+           os << name;
+       }
+       struct timeval times[2];
+       times[0].tv_sec = seconds;
+       times[0].tv_usec = 0;
+       times[1] = times[0];
+       CPPUNIT_ASSERT_EQUAL(0, utimes(name.c_str(), times));
+   }
+
+private:
+   /// @brief temporary directory
+   std::string itsDir;
+   /// @brief mock measurement set
+   std::string itsMS;
+   /// @brief cache file name
+   std::string itsCache;
+};
+
+} // namespace synthesis
+
+} // namespace askap
+
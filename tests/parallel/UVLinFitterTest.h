@@ -0,0 +1,342 @@
+/// @file
+///
+/// Unit test for the 'uvlin' like continuum fit used in ContSubtractParallel
+///
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+
+#include <askap/parallel/UVLinFitter.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <casacore/casa/Arrays/ArrayMath.h>
+#include <casacore/casa/Arrays/Vector.h>
+#include <casacore/casa/BasicMath/Random.h>
+#include <casacore/casa/BasicSL/Constants.h>
+#include <casacore/casa/Containers/Block.h>
+#include <casacore/scimath/Fitting/LSQaips.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace askap {
+
+namespace synthesis {
+
+class UVLinFitterTest : public CppUnit::TestFixture
+{
+   CPPUNIT_TEST_SUITE(UVLinFitterTest);
+   CPPUNIT_TEST(testUnflagged);
+   CPPUNIT_TEST(testThreshold);
+   CPPUNIT_TEST(testSparseMask);
+   CPPUNIT_TEST(testFailedFit);
+   CPPUNIT_TEST(testSubtractContFit);
+   CPPUNIT_TEST_SUITE_END();
+public:
+
+   void testUnflagged() {
+       const casacore::Matrix<casacore::Float> spectra = makeSpectra(8, 64, 0.1, 1);
+       const casacore::Matrix<casacore::Bool> masks(spectra.shape(), true);
+       compare(UVLinFitter(1, 1, 0, 0, 0.), spectra, masks, 1, 1, 0, 0, 0.);
+       // several bins, the first one is shorter
+       compare(UVLinFitter(2, 1, 20, 5, 0.), spectra, masks, 2, 1, 20, 5, 0.);
+   }
+
+   void testThreshold() {
+       casacore::Matrix<casacore::Float> spectra = makeSpectra(12, 96, 1., 2);
+       // lines in some of the spectra, rejected in threshold iterations
+       for (casacore::uInt s = 0; s < spectra.nrow(); s += 2) {
+            for (casacore::uInt chan = 40 + s; chan < 46 + s; ++chan) {
+                 spectra(s, chan) += 20.;
+            }
+       }
+       const casacore::Matrix<casacore::Bool> masks(spectra.shape(), true);
+       const casacore::Matrix<casacore::Float> models = compare(UVLinFitter(1, 1, 0, 0, 2.5), spectra, masks,
+                                                                1, 1, 0, 0, 2.5);
+       // the line shouldn't be absorbed by the model, unlike in the fit without rejection
+       casacore::Matrix<casacore::Float> unclipped;
+       UVLinFitter(1, 1, 0, 0, 0.).modelSpectra(unclipped, spectra, masks);
+       float lineResidual = 0., unclippedLineResidual = 0.;
+       for (casacore::uInt chan = 40; chan < 46; ++chan) {
+            lineResidual += spectra(0, chan) - models(0, chan);
+            unclippedLineResidual += spectra(0, chan) - unclipped(0, chan);
+       }
+       CPPUNIT_ASSERT(lineResidual > unclippedLineResidual);
+       compare(UVLinFitter(2, 2, 32, 8, 3.), spectra, masks, 2, 2, 32, 8, 3.);
+   }
+
+   void testSparseMask() {
+       const casacore::Matrix<casacore::Float> spectra = makeSpectra(10, 64, 0.3, 3);
+       casacore::Matrix<casacore::Bool> masks(spectra.shape(), true);
+       for (casacore::uInt chan = 0; chan < spectra.ncolumn(); ++chan) {
+            // less than 60% of channels, order is reduced
+            masks(0, chan) = masks(1, chan) = masks(2, chan) = (chan % 5 < 2) || (chan > 60);
+            // a large gap, both order and harmonic terms are reduced
+            masks(3, chan) = masks(4, chan) = (chan < 12);
+            // only a few channels, a constant is fitted
+            masks(5, chan) = (chan % 16 == 3);
+            // a different mask for each spectrum
+            masks(6 + chan % 4, chan) = false;
+       }
+       compare(UVLinFitter(3, 2, 0, 0, 0.), spectra, masks, 3, 2, 0, 0, 0.);
+       compare(UVLinFitter(3, 2, 0, 0, 2.5), spectra, masks, 3, 2, 0, 0, 2.5);
+       compare(UVLinFitter(1, 1, 24, 4, 2.5), spectra, masks, 1, 1, 24, 4, 2.5);
+   }
+
+   void testFailedFit() {
+       const casacore::Matrix<casacore::Float> spectra = makeSpectra(4, 48, 0.2, 4);
+       casacore::Matrix<casacore::Bool> masks(spectra.shape(), true);
+       // fully flagged spectrum and spectra with a fully flagged bin, the normal matrix is singular
+       for (casacore::uInt chan = 0; chan < spectra.ncolumn(); ++chan) {
+            masks(0, chan) = false;
+            masks(1, chan) = (chan < 16) || (chan >= 32);
+            masks(2, chan) = (chan >= 16);
+       }
+       const casacore::Matrix<casacore::Float> models = compare(UVLinFitter(1, 1, 16, 0, 2.5), spectra, masks,
+                                                                1, 1, 16, 0, 2.5);
+       // model is zero where the fit has failed
+       for (casacore::uInt chan = 0; chan < spectra.ncolumn(); ++chan) {
+            CPPUNIT_ASSERT_EQUAL(0.f, models(0, chan));
+            CPPUNIT_ASSERT((models(1, chan) == 0.f) == (chan >= 16 && chan < 32));
+            CPPUNIT_ASSERT((models(2, chan) == 0.f) == (chan < 16));
+       }
+       compare(UVLinFitter(2, 1, 0, 0, 0.), spectra, masks, 2, 1, 0, 0, 0.);
+   }
+
+   void testSubtractContFit() {
+       // more rows than in one batch, the last batch is partial
+       const casacore::uInt nPol = 2, nChan = 48, nRow = 37;
+       const casacore::Matrix<casacore::Float> re = makeSpectra(nPol * nRow, nChan, 0.5, 5);
+       const casacore::Matrix<casacore::Float> im = makeSpectra(nPol * nRow, nChan, 0.5, 6);
+       casacore::Cube<casacore::Complex> vis(nPol, nChan, nRow);
+       casacore::Cube<casacore::Bool> flag(nPol, nChan, nRow, false);
+       for (casacore::uInt row = 0; row < nRow; ++row) {
+            for (casacore::uInt pol = 0; pol < nPol; ++pol) {
+                 for (casacore::uInt chan = 0; chan < nChan; ++chan) {
+                      vis(pol, chan, row) = casacore::Complex(re(row * nPol + pol, chan), im(row * nPol + pol, chan));
+                      flag(pol, chan, row) = (row % 3 == 0) && ((chan + pol) % 4 == 0);
+                 }
+            }
+       }
+       // fully flagged spectrum
+       for (casacore::uInt chan = 0; chan < nChan; ++chan) {
+            flag(0, chan, 5) = true;
+       }
+       casacore::Cube<casacore::Complex> result(vis.copy());
+       UVLinFitter(1, 1, 0, 0, 2.5).subtractContFit(result, flag);
+
+       // per-spectrum reference, as subtraction was done before batching
+       casacore::Vector<casacore::Float> visreal(nChan), visimag(nChan), modelreal(nChan), modelimag(nChan);
+       casacore::Vector<casacore::Bool> mask(nChan);
+       for (casacore::uInt row = 0; row < nRow; ++row) {
+            for (casacore::uInt pol = 0; pol < nPol; ++pol) {
+                 for (casacore::uInt chan = 0; chan < nChan; ++chan) {
+                      visreal(chan) = casacore::real(vis(pol, chan, row));
+                      visimag(chan) = casacore::imag(vis(pol, chan, row));
+                      mask(chan) = !flag(pol, chan, row);
+                 }
+                 referenceModel(modelreal, visreal, mask, 1, 1, 0, 0, 2.5);
+                 referenceModel(modelimag, visimag, mask, 1, 1, 0, 0, 2.5);
+                 for (casacore::uInt chan = 0; chan < nChan; ++chan) {
+                      const casacore::Complex expected = vis(pol, chan, row) -
+                                                         casacore::Complex(modelreal(chan), modelimag(chan));
+                      CPPUNIT_ASSERT_DOUBLES_EQUAL(0., std::abs(expected - result(pol, chan, row)), 2e-4);
+                 }
+            }
+       }
+   }
+
+protected:
+
+   /// @brief make test spectra
+   /// @details Each spectrum is a random linear continuum with a ripple and gaussian noise
+   /// @param[in] nSpec number of spectra
+   /// @param[in] nChan number of channels
+   /// @param[in] sigma noise rms
+   /// @param[in] seed seed of the random generator
+   /// @return spectra, one row per spectrum
+   static casacore::Matrix<casacore::Float> makeSpectra(casacore::uInt nSpec, casacore::uInt nChan, double sigma,
+                                                        casacore::Int seed) {
+       casacore::MLCG gen(seed, 2 * seed + 1);
+       casacore::Normal noise(&gen, 0., 1.);
+       casacore::Matrix<casacore::Float> spectra(nSpec, nChan);
+       for (casacore::uInt s = 0; s < nSpec; ++s) {
+            const double offset = 5. * noise();
+            const double slope = noise();
+            const double ripple = 0.5 * noise();
+            for (casacore::uInt chan = 0; chan < nChan; ++chan) {
+                 const double x = double(chan) / nChan;
+                 spectra(s, chan) = offset + slope * x + ripple * std::sin(3. * casacore::C::pi * x) +
+                                    sigma * noise();
+            }
+       }
+       return spectra;
+   }
+
+   /// @brief compare the batched fit with the reference fit of individual spectra
+   /// @param[in] fitter fitter to test
+   /// @param[in] spectra input spectra, one row per spectrum
+   /// @param[in] masks input masks
+   /// @param[in] order, harmonic, width, offset, threshold parameters of the fitter
+   /// @return models obtained by the fitter
+   static casacore::Matrix<casacore::Float> compare(const UVLinFitter &fitter,
+             const casacore::Matrix<casacore::Float> &spectra, const casacore::Matrix<casacore::Bool> &masks,
+             int order, int harmonic, int width, int offset, float threshold) {
+       casacore::Matrix<casacore::Float> models;
+       fitter.modelSpectra(models, spectra, masks);
+       CPPUNIT_ASSERT(models.shape().isEqual(spectra.shape()));
+       casacore::Vector<casacore::Float> expected(spectra.ncolumn());
+       for (casacore::uInt s = 0; s < spectra.nrow(); ++s) {
+            referenceModel(expected, spectra.row(s), masks.row(s), order, harmonic, width, offset, threshold);
+            for (casacore::uInt chan = 0; chan < spectra.ncolumn(); ++chan) {
+                 CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[chan], models(s, chan), 2e-4);
+            }
+       }
+       return models;
+   }
+
+   /// @brief fit of a single spectrum with LSQaips
+   /// @details This is the per-spectrum algorithm used by ContSubtractParallel before the fit
+   /// was batched, it serves as the reference.
+   /// @param[out] model output model spectrum
+   /// @param[in] spec input spectrum
+   /// @param[in] mask input mask, true for channels used in the fit
+   /// @param[in] order, harmonic, width, offset, threshold parameters of the fit
+   static void referenceModel(casacore::Vector<casacore::Float> &model, const casacore::Vector<casacore::Float> &spec,
+             const casacore::Vector<casacore::Bool> &mask, int order0, int harmonic0, int width0, int offset,
+             float threshold) {
+       const int nChan = spec.size();
+       const int nParams = order0 + 1 + harmonic0 * 2;
+       casacore::LSQaips fitter(nParams);
+       casacore::Vector<casacore::Double> xx(nParams);
+       casacore::Vector<casacore::Double> solution(nParams);
+       casacore::Vector<casacore::Bool> tmask(mask.copy());
+       const int niter = (threshold > 0 ? 3 : 1);
+       model.resize(nChan);
+       model = 0.f;
+       const int width = (width0 == 0 ? nChan : width0);
+       casacore::Vector<casacore::Float> y(width);
+       casacore::Block<casacore::Float> tmp;
+       int lastDof = nParams;
+       for (int binStart = -offset; binStart < nChan; binStart += width) {
+            const int start = std::max(0, binStart);
+            const int end = std::min(binStart + width, nChan);
+            const int binWidth = end - start;
+            for (int iter = 0; iter < niter; ++iter) {
+                 if (threshold > 0) {
+                     int n = 0;
+                     for (int i = start; i < end; ++i) {
+                          if (tmask(i)) {
+                              y(n++) = spec(i) - model(i);
+                          }
+                     }
+                     if (n > 0) {
+                         const casacore::Float q25 = casacore::fractile(y(casacore::Slice(0, n)), tmp, 0.25f, casacore::False, casacore::True);
+                         const casacore::Float q50 = casacore::fractile(y(casacore::Slice(0, n)), tmp, 0.50f, casacore::False, casacore::True);
+                         const casacore::Float q75 = casacore::fractile(y(casacore::Slice(0, n)), tmp, 0.75f, casacore::False, casacore::True);
+                         const casacore::Float sigma = (q75 - q25) / 1.35;
+                         int count = 0;
+                         for (int i = start; i < end; ++i) {
+                              if (mask(i) && (std::abs((spec(i) - model(i)) - q50) > threshold * sigma)) {
+                                  tmask(i) = false;
+                                  ++count;
+                              } else {
+                                  tmask(i) = mask(i);
+                              }
+                         }
+                         if (iter > 0 && count == 0) {
+                             break;
+                         }
+                     }
+                 }
+                 int valid = 0;
+                 for (int i = start; i < end; ++i) {
+                      if (tmask(i)) {
+                          ++valid;
+                      }
+                 }
+                 int order = order0;
+                 int harm = harmonic0;
+                 if (float(valid) < 0.6 * binWidth) {
+                     if (order > harm) {
+                         order = std::max(0, order - 1);
+                     } else {
+                         harm = std::max(0, harm - 1);
+                     }
+                 }
+                 int dof = order + 1 + 2 * harm;
+                 while (valid < 5 * dof) {
+                     if (order > harm) {
+                         order = std::max(0, order - 1);
+                     } else {
+                         harm = std::max(0, harm - 1);
+                     }
+                     dof = order + 1 + 2 * harm;
+                     if (dof == 1) break;
+                 }
+                 if (lastDof != dof) {
+                     fitter.set(casacore::uInt(dof));
+                     lastDof = dof;
+                 } else {
+                     fitter.reset();
+                 }
+                 for (int i = start; i < end; ++i) {
+                      const float x = (i - start) / float(binWidth);
+                      if (tmask(i)) {
+                          xx(0) = 1;
+                          for (int j = 1; j < order + 1; ++j) {
+                               xx(j) = xx(j - 1) * x;
+                          }
+                          for (int j = 0; j < harm; ++j) {
+                               xx(order + 1 + 2 * j) = std::sin((j + 1) * casacore::C::pi * x);
+                               xx(order + 1 + 2 * j + 1) = std::cos((j + 1) * casacore::C::pi * x);
+                          }
+                          fitter.makeNorm(xx.data(), 1.0, casacore::Double(spec(i)));
+                      }
+                 }
+                 casacore::uInt nr1;
+                 if (!fitter.invert(nr1)) {
+                     // keep the last model or zero
+                     break;
+                 }
+                 fitter.solve(solution.data());
+                 for (int i = start; i < end; ++i) {
+                      const float x = (i - start) / float(binWidth);
+                      model(i) = solution(order);
+                      for (int j = order - 1; j >= 0; --j) {
+                           model(i) = x * model(i) + solution(j);
+                      }
+                      for (int j = 0; j < harm; ++j) {
+                           model(i) += solution(order + 1 + 2 * j) * std::sin((j + 1) * casacore::C::pi * x);
+                           model(i) += solution(order + 1 + 2 * j + 1) * std::cos((j + 1) * casacore::C::pi * x);
+                      }
+                 }
+            }
+       }
+   }
+};
+
+} // namespace synthesis
+
+} // namespace askap
@@ -0,0 +1,134 @@
+/// @file
+///
+/// Unit test for the FFT-based delay estimate of DelaySolverImpl
+///
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/utils/DelaySolverImpl.h>
+#include <askap/scimath/utils/DelayEstimator.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <casacore/casa/Arrays/Vector.h>
+#include <casacore/casa/BasicMath/Random.h>
+#include <casacore/casa/BasicSL/Constants.h>
+#include <casacore/scimath/Mathematics/FFTServer.h>
+
+#include <cmath>
+
+namespace askap {
+
+namespace utils {
+
+/// @brief exposes the delay estimate of DelaySolverImpl, which is not public
+struct DelaySolverImplAccess : public DelaySolverImpl {
+   using DelaySolverImpl::fftDelay;
+   using DelaySolverImpl::fftPadding;
+};
+
+class DelaySolverImplTest : public CppUnit::TestFixture
+{
+   CPPUNIT_TEST_SUITE(DelaySolverImplTest);
+   CPPUNIT_TEST(testDelay);
+   CPPUNIT_TEST(testFractionalDelay);
+   CPPUNIT_TEST(testNegativeDelay);
+   CPPUNIT_TEST(testNoisySpectrum);
+   CPPUNIT_TEST_SUITE_END();
+public:
+
+   void testDelay() {
+       // an integral number of lag channels (4 ns at this resolution)
+       check(makeSpectrum(256, 1e6, 20e-9, 0.4, 0.), 1e6, 20e-9, 0.99);
+       check(makeSpectrum(256, 1e6, 0., 1.1, 0.), 1e6, 0., 0.99);
+   }
+
+   void testFractionalDelay() {
+       check(makeSpectrum(256, 1e6, 21.3e-9, -0.3, 0.), 1e6, 21.3e-9, 0.99);
+       // less than a lag channel
+       check(makeSpectrum(256, 1e6, 1.5e-9, 2., 0.), 1e6, 1.5e-9, 0.99);
+       // coarser resolution and fewer channels
+       check(makeSpectrum(54, 4e6, 7.77e-9, 0., 0.), 4e6, 7.77e-9, 0.99);
+   }
+
+   void testNegativeDelay() {
+       check(makeSpectrum(256, 1e6, -37.7e-9, 0.8, 0.), 1e6, -37.7e-9, 0.99);
+       check(makeSpectrum(256, 1e6, -0.7e-9, -1.5, 0.), 1e6, -0.7e-9, 0.99);
+       check(makeSpectrum(128, 1e6, -100.2e-9, 0., 0.), 1e6, -100.2e-9, 0.99);
+   }
+
+   void testNoisySpectrum() {
+       check(makeSpectrum(256, 1e6, 33.3e-9, 0.2, 0.1), 1e6, 33.3e-9, 0.9);
+       check(makeSpectrum(256, 1e6, -12.6e-9, 0.2, 0.1), 1e6, -12.6e-9, 0.9);
+   }
+
+protected:
+
+   /// @brief make a spectrum with the given delay
+   /// @details The phase of each channel is 2*pi*delay*resolution*chan + phase, i.e. the phase
+   /// slope corresponds to a positive delay if the delay is positive.
+   /// @param[in] nChan number of spectral channels
+   /// @param[in] resolution spectral resolution in Hz
+   /// @param[in] delay delay in seconds
+   /// @param[in] phase phase of the first channel in radians
+   /// @param[in] sigma rms of the noise added to the real and imaginary parts
+   /// @return spectrum with unit amplitude
+   static casacore::Vector<casacore::Complex> makeSpectrum(casacore::uInt nChan, double resolution, double delay,
+                                                           double phase, double sigma) {
+       casacore::MLCG gen(1, 2);
+       casacore::Normal noise(&gen, 0., 1.);
+       casacore::Vector<casacore::Complex> spectrum(nChan);
+       for (casacore::uInt chan = 0; chan < nChan; ++chan) {
+            const double arg = casacore::C::_2pi * resolution * chan * delay + phase;
+            spectrum[chan] = casacore::Complex(std::cos(arg) + sigma * noise(), std::sin(arg) + sigma * noise());
+       }
+       return spectrum;
+   }
+
+   /// @brief check the delay estimate against the true delay and the original estimator
+   /// @details The new estimate is expected to be within half a channel of the zero padded lag
+   /// spectrum of the true delay. The original estimator (scimath::DelayEstimator without padding)
+   /// is expected to agree within one channel of the lag spectrum.
+   /// @param[in] spectrum spectrum to test
+   /// @param[in] resolution spectral resolution in Hz
+   /// @param[in] delay true delay in seconds
+   /// @param[in] minQuality lower limit on the quality of the estimate
+   static void check(const casacore::Vector<casacore::Complex> &spectrum, double resolution, double delay,
+                     double minQuality) {
+       const casacore::uInt nChan = spectrum.nelements();
+       const double lagResolution = 1. / (nChan * resolution);
+       casacore::FFTServer<casacore::Float, casacore::Complex> server;
+       double quality = 0.;
+       const double result = DelaySolverImplAccess::fftDelay(spectrum, resolution, server, quality);
+       CPPUNIT_ASSERT_DOUBLES_EQUAL(delay, result, 0.5 * lagResolution / DelaySolverImplAccess::fftPadding());
+       CPPUNIT_ASSERT(quality > minQuality);
+       CPPUNIT_ASSERT(quality <= 1. + 1e-6);
+
+       scimath::DelayEstimator estimator(resolution);
+       CPPUNIT_ASSERT_DOUBLES_EQUAL(estimator.getDelayWithFFT(spectrum), result, lagResolution);
+   }
+};
+
+} // namespace utils
+
+} // namespace askap
@@ -0,0 +1,84 @@
+/// @file
+///
+/// Unit test for the helpers choosing the tiling of merged measurement sets
+///
+///
+/// @copyright (c) 2021 CSIRO
+/// Australia Telescope National Facility (ATNF)
+/// Commonwealth Scientific and Industrial Research Organisation (CSIRO)
+/// PO Box 76, Epping NSW 1710, Australia
+/// atnf-enquiries@csiro.au
+///
+/// This file is part of the ASKAP software distribution.
+///
+/// The ASKAP software distribution is free software: you can redistribute it
+/// and/or modify it under the terms of the GNU General Public License as
+/// published by the Free Software Foundation; either version 2 of the License,
+/// or (at your option) any later version.
+///
+/// This program is distributed in the hope that it will be useful,
+/// but WITHOUT ANY WARRANTY; without even the implied warranty of
+/// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+/// GNU General Public License for more details.
+///
+/// You should have received a copy of the GNU General Public License
+/// along with this program; if not, write to the Free Software
+/// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+///
+
+#include <askap/utils/TileUtils.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+namespace askap {
+
+namespace utils {
+
+class TileUtilsTest : public CppUnit::TestFixture
+{
+   CPPUNIT_TEST_SUITE(TileUtilsTest);
+   CPPUNIT_TEST(testUniformLayout);
+   CPPUNIT_TEST(testMixedLayout);
+   CPPUNIT_TEST_SUITE_END();
+public:
+
+   void testUniformLayout() {
+       const std::vector<casacore::uInt> nChan(3, 16);
+       const std::vector<casacore::uInt> tileNchan(3, 8);
+       CPPUNIT_ASSERT_EQUAL(8u, commonTileNchan(nChan, tileNchan));
+       CPPUNIT_ASSERT_EQUAL(1u, commonTileNchan(std::vector<casacore::uInt>(), std::vector<casacore::uInt>()));
+   }
+
+   void testMixedLayout() {
+       std::vector<casacore::uInt> nChan(2), tileNchan(2);
+       // 9 channels in a single tile followed by 8 channels in tiles of 4, the only tiling
+       // which doesn't straddle the boundary after the first input is 1 channel
+       nChan[0] = 9;
+       tileNchan[0] = 9;
+       nChan[1] = 8;
+       tileNchan[1] = 4;
+       CPPUNIT_ASSERT_EQUAL(1u, commonTileNchan(nChan, tileNchan));
+       // equal number of channels, but tiles of 6 and 4 channels: only 2 divides both
+       nChan[0] = 12;
+       tileNchan[0] = 6;
+       nChan[1] = 12;
+       tileNchan[1] = 4;
+       CPPUNIT_ASSERT_EQUAL(2u, commonTileNchan(nChan, tileNchan));
+       // the result divides all channel counts and tilings
+       nChan[0] = 24;
+       tileNchan[0] = 12;
+       nChan[1] = 36;
+       tileNchan[1] = 18;
+       const casacore::uInt result = commonTileNchan(nChan, tileNchan);
+       CPPUNIT_ASSERT_EQUAL(6u, result);
+       for (size_t i = 0; i < nChan.size(); ++i) {
+            CPPUNIT_ASSERT_EQUAL(0u, nChan[i] % result);
+            CPPUNIT_ASSERT_EQUAL(0u, tileNchan[i] % result);
+       }
+   }
+};
+
+} // namespace utils
+
+} // namespace askap